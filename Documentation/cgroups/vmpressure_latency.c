@@ -0,0 +1,311 @@
+/*
+ * vmpressure_latency.c - latency of memory pressure notifications
+ *
+ * Registers an eventfd for each level of memory.pressure_level of the
+ * given memory cgroup, then starts an allocation storm in it: a child
+ * moved into the group allocates and touches anonymous memory at a rate
+ * that grows by one step every interval. Meanwhile the start of reclaim
+ * is taken from the first increment of memory.failcnt, or of the pgscan
+ * counters of /proc/vmstat for the root group, polled every millisecond.
+ *
+ * Reported are, for every level, the time of its first notification
+ * since the start of the storm and since the start of reclaim, the memory
+ * the child had allocated by then, and the number of notifications until
+ * the end. The run ends at the first critical notification, when the
+ * child is killed, when the child dies, e.g. by the OOM killer, which
+ * should not happen before a critical notification came, or a second
+ * after the child allocated all it was asked to.
+ *
+ * For a group with a limit of 512MB, allocating 4MB more every 50ms:
+ *
+ *	# mkdir /cgroup/memory/storm
+ *	# echo 512M > /cgroup/memory/storm/memory.limit_in_bytes
+ *	# ./vmpressure_latency -g /cgroup/memory/storm -s 4 -i 50
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NR_LEVELS	3
+#define MB		(1UL << 20)
+
+static const char * const level_names[NR_LEVELS] = {
+	"low", "medium", "critical",
+};
+
+struct level {
+	int efd;
+	unsigned long long first_ns;	/* 0 until the first notification */
+	unsigned long mb;		/* allocated at the first one */
+	unsigned long long count;
+};
+
+static const char *cg = ".";
+static int is_root;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int open_cg(const char *file, int flags)
+{
+	char path[4096];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", cg, file);
+	fd = open(path, flags);
+	if (fd < 0)
+		perror(path);
+	return fd;
+}
+
+/* pgscan of all zones, or failcnt of the group, whatever grows on reclaim */
+static unsigned long long reclaim_counter(void)
+{
+	unsigned long long val, sum = 0;
+	char key[64], buf[64];
+	FILE *f;
+	int fd;
+	ssize_t n;
+
+	if (!is_root) {
+		fd = open_cg("memory.failcnt", O_RDONLY);
+		if (fd < 0)
+			return 0;
+		n = read(fd, buf, sizeof(buf) - 1);
+		close(fd);
+		if (n <= 0)
+			return 0;
+		buf[n] = '\0';
+		return strtoull(buf, NULL, 10);
+	}
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %llu", key, &val) == 2) {
+		if (!strncmp(key, "pgscan_", 7))
+			sum += val;
+	}
+	fclose(f);
+	return sum;
+}
+
+static int register_level(struct level *lv, const char *name)
+{
+	char line[128];
+	int cfd, ecfd, ret = -1;
+
+	lv->efd = eventfd(0, EFD_NONBLOCK);
+	if (lv->efd < 0) {
+		perror("eventfd");
+		return -1;
+	}
+	cfd = open_cg("memory.pressure_level", O_RDONLY);
+	ecfd = open_cg("cgroup.event_control", O_WRONLY);
+	if (cfd >= 0 && ecfd >= 0) {
+		snprintf(line, sizeof(line), "%d %d %s", lv->efd, cfd, name);
+		if (write(ecfd, line, strlen(line)) < 0)
+			fprintf(stderr, "cannot register %s: %s\n", name,
+				strerror(errno));
+		else
+			ret = 0;
+	}
+	if (cfd >= 0)
+		close(cfd);
+	if (ecfd >= 0)
+		close(ecfd);
+	return ret;
+}
+
+/* Allocate @step_mb more every @interval_ms: step, 2 * step, 3 * step, ... */
+static void __attribute__((noreturn)) storm(unsigned long step_mb,
+					     int interval_ms,
+					     unsigned long max_mb,
+					     volatile unsigned long *allocated)
+{
+	long pagesize = sysconf(_SC_PAGESIZE);
+	unsigned long round = 0, mb, i;
+	char *p;
+
+	while (*allocated < max_mb) {
+		round++;
+		mb = round * step_mb;
+		if (mb > max_mb - *allocated)
+			mb = max_mb - *allocated;
+		p = mmap(NULL, mb * MB, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			_exit(1);
+		for (i = 0; i < mb * MB; i += pagesize) {
+			p[i] = 1;
+			if (!((i + pagesize) % MB))
+				(*allocated)++;
+		}
+		usleep(interval_ms * 1000);
+	}
+	for (;;)
+		pause();
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -g cgroup [-s step_mb] [-i interval_ms] [-m max_mb]\n"
+		"  -g  memory cgroup directory to run the storm in\n"
+		"  -s  growth of the allocation per interval in MB (default 8)\n"
+		"  -i  interval in ms (default 100)\n"
+		"  -m  stop allocating after this many MB (default 4096)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long step_mb = 8, max_mb = 4096;
+	unsigned long long start, reclaim_ns = 0, full_ns = 0, t, count, rc0;
+	volatile unsigned long *allocated;
+	struct level levels[NR_LEVELS];
+	struct pollfd pfd[NR_LEVELS];
+	int interval_ms = 100, opt, i, status, tasks, done = 0;
+	unsigned long reclaim_mb = 0;
+	char buf[4096];
+	pid_t pid;
+	ssize_t n;
+
+	while ((opt = getopt(argc, argv, "g:s:i:m:h")) != -1) {
+		switch (opt) {
+		case 'g':
+			cg = optarg;
+			break;
+		case 's':
+			step_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		case 'm':
+			max_mb = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!step_mb || interval_ms <= 0 || !max_mb)
+		usage(argv[0]);
+
+	/* the root group has no limit, so no failcnt worth watching */
+	snprintf(buf, sizeof(buf), "%s/../memory.limit_in_bytes", cg);
+	is_root = access(buf, F_OK) != 0;
+
+	memset(levels, 0, sizeof(levels));
+	for (i = 0; i < NR_LEVELS; i++) {
+		if (register_level(&levels[i], level_names[i]))
+			return 1;
+		pfd[i].fd = levels[i].efd;
+		pfd[i].events = POLLIN;
+	}
+
+	allocated = mmap(NULL, sizeof(*allocated), PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (allocated == MAP_FAILED)
+		return 1;
+	*allocated = 0;
+
+	printf("%s group %s, %lu MB more every %d ms, up to %lu MB\n",
+	       is_root ? "root" : "memory", cg, step_mb, interval_ms, max_mb);
+
+	rc0 = reclaim_counter();
+	start = now_ns();
+	pid = fork();
+	if (pid < 0)
+		return 1;
+	if (!pid) {
+		tasks = open_cg("tasks", O_WRONLY);
+		snprintf(buf, sizeof(buf), "%d", getpid());
+		if (tasks < 0 || write(tasks, buf, strlen(buf)) < 0)
+			_exit(1);
+		close(tasks);
+		storm(step_mb, interval_ms, max_mb, allocated);
+	}
+
+	while (!done) {
+		poll(pfd, NR_LEVELS, 1);
+		t = now_ns();
+		if (!reclaim_ns && reclaim_counter() != rc0) {
+			reclaim_ns = t;
+			reclaim_mb = *allocated;
+		}
+		for (i = 0; i < NR_LEVELS; i++) {
+			if (!(pfd[i].revents & POLLIN))
+				continue;
+			n = read(levels[i].efd, &count, sizeof(count));
+			if (n != sizeof(count))
+				continue;
+			levels[i].count += count;
+			if (!levels[i].first_ns) {
+				levels[i].first_ns = t;
+				levels[i].mb = *allocated;
+			}
+			if (i == NR_LEVELS - 1)
+				done = 1;
+		}
+		if (!full_ns && *allocated >= max_mb)
+			full_ns = t;
+		if (full_ns && t - full_ns > 1000000000ULL)
+			done = 1;
+		if (waitpid(pid, &status, WNOHANG) == pid) {
+			printf("allocator %s after %lu MB\n",
+			       WIFSIGNALED(status) ? "killed" : "exited",
+			       *allocated);
+			pid = 0;
+			done = 1;
+		}
+	}
+	if (pid) {
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+	}
+
+	if (reclaim_ns)
+		printf("reclaim started at %.1f ms, %lu MB\n",
+		       (reclaim_ns - start) / 1e6, reclaim_mb);
+	else
+		printf("no reclaim seen\n");
+	printf("%-9s %12s %14s %8s %8s\n", "level", "since_start",
+	       "since_reclaim", "MB", "events");
+	for (i = 0; i < NR_LEVELS; i++) {
+		printf("%-9s ", level_names[i]);
+		if (!levels[i].first_ns) {
+			printf("%12s %14s %8s %8s\n", "-", "-", "-", "0");
+			continue;
+		}
+		printf("%9.1f ms ", (levels[i].first_ns - start) / 1e6);
+		if (reclaim_ns && levels[i].first_ns >= reclaim_ns)
+			printf("%11.1f ms ",
+			       (levels[i].first_ns - reclaim_ns) / 1e6);
+		else
+			printf("%14s ", "-");
+		printf("%8lu %8llu\n", levels[i].mb, levels[i].count);
+	}
+	return 0;
+}
@@ -0,0 +1,376 @@
+/*
+ * softirq_latency: timer softirq delay under a network receive flood
+ *
+ * Sets up a veth pair swlat0/swlat1, and pins itself and the flooders to
+ * one cpu. The flooders send UDP frames into swlat0 from packet sockets;
+ * veth hands each of them to the receive path of swlat1 on the sending
+ * cpu, so they are all processed by its NET_RX softirq. The measuring
+ * task waits in recv() on a UDP socket nothing is sent to, with a receive
+ * timeout: that timeout is a timer wheel timer, run by the TIMER softirq.
+ *
+ * Reported are the median, p99 and maximum lateness of the timeouts past
+ * their requested length, once without and once with the flood, and the
+ * time the cpu spent in the NET_RX and TIMER vectors meanwhile, from
+ * /proc/softirq_time when it exists. The lateness includes up to one
+ * jiffy of timer wheel rounding in both runs.
+ *
+ * Run it as root, booted with and without softirq_threads. It needs ip(8)
+ * and removes the veth pair when done.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <netpacket/packet.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SAMPLES	(1 << 16)
+#define MAX_FLOODERS	64
+#define FRAME_LEN	(14 + 20 + 8 + 64)
+
+#define DEV_TX		"swlat0"
+#define DEV_RX		"swlat1"
+#define ADDR_TX		"10.253.0.1"
+#define ADDR_RX		"10.253.0.2"
+#define FLOOD_PORT	9
+
+struct vec_time {
+	unsigned long long net_rx;
+	unsigned long long timer;
+};
+
+static pid_t flooders[MAX_FLOODERS];
+static int nr_flooders = 1;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* NET_RX and TIMER time of @cpu in us from /proc/softirq_time, 0 on success */
+static int read_vec_time(int cpu, struct vec_time *vt)
+{
+	char line[4096], *p;
+	unsigned long long val = 0, *dst;
+	int i, found = 0;
+	FILE *f = fopen("/proc/softirq_time", "r");
+
+	memset(vt, 0, sizeof(*vt));
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		p = line;
+		while (*p == ' ')
+			p++;
+		if (!strncmp(p, "NET_RX:", 7))
+			dst = &vt->net_rx;
+		else if (!strncmp(p, "TIMER:", 6))
+			dst = &vt->timer;
+		else
+			continue;
+		p = strchr(p, ':') + 1;
+		for (i = 0; i <= cpu; i++)
+			val = strtoull(p, &p, 10);
+		*dst = val;
+		found++;
+	}
+	fclose(f);
+	return found == 2 ? 0 : -1;
+}
+
+static int run_cmd(const char *fmt, ...)
+{
+	char cmd[256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(cmd, sizeof(cmd), fmt, ap);
+	va_end(ap);
+	return system(cmd) ? -1 : 0;
+}
+
+static void veth_teardown(void)
+{
+	run_cmd("ip link del " DEV_TX " 2>/dev/null");
+}
+
+static int veth_setup(unsigned char *mac)
+{
+	unsigned int m[6];
+	FILE *f;
+	int i;
+
+	veth_teardown();
+	if (run_cmd("ip link add " DEV_TX " type veth peer name " DEV_RX) ||
+	    run_cmd("ip addr add " ADDR_RX "/24 dev " DEV_RX) ||
+	    run_cmd("ip link set " DEV_TX " up") ||
+	    run_cmd("ip link set " DEV_RX " up"))
+		return -1;
+
+	f = fopen("/sys/class/net/" DEV_RX "/address", "r");
+	if (!f)
+		return -1;
+	i = fscanf(f, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3],
+		   &m[4], &m[5]);
+	fclose(f);
+	if (i != 6)
+		return -1;
+	for (i = 0; i < 6; i++)
+		mac[i] = m[i];
+	return 0;
+}
+
+static unsigned short ip_csum(const void *data, int len)
+{
+	const unsigned short *p = data;
+	unsigned int sum = 0;
+
+	for (; len > 1; len -= 2)
+		sum += *p++;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+/* Build one UDP frame to swlat1, the UDP checksum is left out */
+static void build_frame(unsigned char *frame, const unsigned char *mac)
+{
+	struct iphdr *ip = (struct iphdr *)(frame + 14);
+	struct udphdr *udp = (struct udphdr *)(ip + 1);
+
+	memset(frame, 0, FRAME_LEN);
+	memcpy(frame, mac, 6);
+	frame[6] = 0x02;		/* locally administered source */
+	frame[12] = 0x08;		/* ETH_P_IP */
+
+	ip->version = 4;
+	ip->ihl = 5;
+	ip->ttl = 64;
+	ip->protocol = IPPROTO_UDP;
+	ip->tot_len = htons(FRAME_LEN - 14);
+	ip->saddr = inet_addr(ADDR_TX);
+	ip->daddr = inet_addr(ADDR_RX);
+	ip->check = ip_csum(ip, sizeof(*ip));
+
+	udp->source = htons(FLOOD_PORT);
+	udp->dest = htons(FLOOD_PORT);
+	udp->len = htons(FRAME_LEN - 14 - sizeof(*ip));
+}
+
+static void __attribute__((noreturn)) flood(const unsigned char *mac)
+{
+	unsigned char frame[FRAME_LEN];
+	struct sockaddr_ll sll;
+	int fd;
+
+	fd = socket(AF_PACKET, SOCK_RAW, htons(0x0800));
+	if (fd < 0) {
+		perror("packet socket");
+		_exit(1);
+	}
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_ifindex = if_nametoindex(DEV_TX);
+	sll.sll_halen = 6;
+	memcpy(sll.sll_addr, mac, 6);
+
+	build_frame(frame, mac);
+	for (;;)
+		sendto(fd, frame, FRAME_LEN, 0, (struct sockaddr *)&sll,
+		       sizeof(sll));
+}
+
+static void stop_flood(void)
+{
+	int i;
+
+	for (i = 0; i < nr_flooders; i++) {
+		if (flooders[i] > 0) {
+			kill(flooders[i], SIGKILL);
+			waitpid(flooders[i], NULL, 0);
+			flooders[i] = 0;
+		}
+	}
+}
+
+static void cleanup(int sig)
+{
+	stop_flood();
+	veth_teardown();
+	_exit(1);
+}
+
+/* Wait for timeouts of @timeout_us for @duration seconds, and report */
+static int measure(const char *name, int cpu, int duration, int timeout_us)
+{
+	static unsigned long long late[MAX_SAMPLES];
+	unsigned long long start, end, t, expected = timeout_us * 1000ULL;
+	struct vec_time vt0, vt1;
+	struct sockaddr_in sin;
+	struct timeval tv;
+	unsigned long nr = 0;
+	int fd, have_vt;
+	char buf[64];
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return -1;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = inet_addr(ADDR_RX);
+	tv.tv_sec = timeout_us / 1000000;
+	tv.tv_usec = timeout_us % 1000000;
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) ||
+	    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) {
+		perror("timeout socket");
+		close(fd);
+		return -1;
+	}
+
+	have_vt = !read_vec_time(cpu, &vt0);
+	start = now_ns();
+	end = start + duration * 1000000000ULL;
+	while (now_ns() < end && nr < MAX_SAMPLES) {
+		t = now_ns();
+		if (recv(fd, buf, sizeof(buf), 0) >= 0 || errno != EAGAIN)
+			continue;
+		t = now_ns() - t;
+		late[nr++] = t > expected ? t - expected : 0;
+	}
+	have_vt = have_vt && !read_vec_time(cpu, &vt1);
+	close(fd);
+
+	printf("%-10s %6lu timeouts", name, nr);
+	if (nr) {
+		qsort(late, nr, sizeof(*late), cmp_ull);
+		printf(", late us: p50 %.1f p99 %.1f max %.1f",
+		       late[nr / 2] / 1e3, late[nr * 99 / 100] / 1e3,
+		       late[nr - 1] / 1e3);
+	}
+	if (have_vt)
+		printf(", NET_RX %llu us, TIMER %llu us",
+		       vt1.net_rx - vt0.net_rx, vt1.timer - vt0.timer);
+	printf("\n");
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-c cpu] [-d seconds] [-f flooders] [-t timeout_us] [-p prio]\n"
+		"  -c  cpu to run on (default 1)\n"
+		"  -d  run time of each measurement in seconds (default 10)\n"
+		"  -f  number of flooding processes (default 1)\n"
+		"  -t  receive timeout in us (default 10000)\n"
+		"  -p  run the measuring task at this SCHED_FIFO priority\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int cpu = 1, duration = 10, timeout_us = 10000, prio = 0, opt, i;
+	unsigned char mac[6];
+	struct sched_param sp;
+	cpu_set_t set;
+	int ret = 1;
+
+	while ((opt = getopt(argc, argv, "c:d:f:t:p:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			cpu = atoi(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'f':
+			nr_flooders = atoi(optarg);
+			break;
+		case 't':
+			timeout_us = atoi(optarg);
+			break;
+		case 'p':
+			prio = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (cpu < 0 || duration <= 0 || timeout_us <= 0 || prio < 0 ||
+	    nr_flooders <= 0 || nr_flooders > MAX_FLOODERS)
+		usage(argv[0]);
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set)) {
+		perror("sched_setaffinity");
+		return 1;
+	}
+
+	if (veth_setup(mac)) {
+		fprintf(stderr, "cannot set up the veth pair\n");
+		veth_teardown();
+		return 1;
+	}
+	signal(SIGINT, cleanup);
+	signal(SIGTERM, cleanup);
+
+	printf("cpu %d, %d s each, timeout %d us, %d flooders\n", cpu,
+	       duration, timeout_us, nr_flooders);
+
+	if (prio) {
+		sp.sched_priority = prio;
+		if (sched_setscheduler(0, SCHED_FIFO, &sp)) {
+			perror("sched_setscheduler");
+			goto out;
+		}
+	}
+
+	if (measure("idle", cpu, duration, timeout_us))
+		goto out;
+
+	/* the flooders inherit the affinity, but not the priority */
+	for (i = 0; i < nr_flooders; i++) {
+		flooders[i] = fork();
+		if (!flooders[i]) {
+			sp.sched_priority = 0;
+			sched_setscheduler(0, SCHED_OTHER, &sp);
+			flood(mac);
+		}
+	}
+	sleep(1);
+	ret = measure("flood", cpu, duration, timeout_us) ? 1 : 0;
+out:
+	stop_flood();
+	veth_teardown();
+	return ret;
+}
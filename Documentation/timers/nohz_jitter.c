@@ -0,0 +1,198 @@
+/*
+ * nohz_jitter: busy loop jitter on a single cpu
+ *
+ * Pins itself to a cpu and spins on clock_gettime() for the given time.
+ * Every gap between two reads longer than the threshold is an interruption
+ * of the loop: the tick, another interrupt, or a task being scheduled in.
+ * Reported are the number of interruptions per second, their median, p99
+ * and maximum length, and over the run the change of the local timer
+ * interrupt count of the cpu (the LOC line in /proc/interrupts, on x86)
+ * and of its tick counters in /proc/timer_list.
+ *
+ * Run it on a cpu of the nohz_adaptive= list, with nothing else on it,
+ * and compare against a run on a housekeeping cpu.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_GAPS	(1 << 20)
+
+struct tick_stats {
+	unsigned long long nr_ticks;
+	unsigned long long adaptive_stops;
+	unsigned long long adaptive_ticks_avoided;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Local timer interrupts of @cpu, or -1 */
+static long long read_loc(int cpu)
+{
+	char line[4096], *p;
+	long long val = -1;
+	int i;
+	FILE *f = fopen("/proc/interrupts", "r");
+
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		p = line;
+		while (*p == ' ')
+			p++;
+		if (strncmp(p, "LOC:", 4))
+			continue;
+		p += 4;
+		for (i = 0; i <= cpu; i++)
+			val = strtoll(p, &p, 10);
+		break;
+	}
+	fclose(f);
+	return val;
+}
+
+/* The tick counters of @cpu in /proc/timer_list, 0 on success */
+static int read_tick_stats(int cpu, struct tick_stats *st)
+{
+	char line[256], key[64];
+	unsigned long long val;
+	int this_cpu = -1, found = 0;
+	FILE *f = fopen("/proc/timer_list", "r");
+
+	memset(st, 0, sizeof(*st));
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "cpu: %d", &this_cpu) == 1)
+			continue;
+		if (this_cpu != cpu)
+			continue;
+		if (sscanf(line, " .%63[^ :] : %llu", key, &val) != 2)
+			continue;
+		if (!strcmp(key, "nr_ticks")) {
+			st->nr_ticks = val;
+			found = 1;
+		} else if (!strcmp(key, "adaptive_stops")) {
+			st->adaptive_stops = val;
+		} else if (!strcmp(key, "adaptive_ticks_avoided")) {
+			st->adaptive_ticks_avoided = val;
+		}
+	}
+	fclose(f);
+	return found ? 0 : -1;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-c cpu] [-d seconds] [-t threshold_ns]\n"
+		"  -c  cpu to run on (default 1)\n"
+		"  -d  run time in seconds (default 10)\n"
+		"  -t  gaps longer than this are interruptions (default 1000)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int cpu = 1, duration = 10, opt, have_ticks;
+	unsigned long long threshold = 1000, *gaps;
+	unsigned long long start, end, prev, t;
+	long long loc0, loc1;
+	struct tick_stats st0, st1;
+	unsigned long nr = 0, dropped = 0;
+	cpu_set_t set;
+	double secs;
+
+	while ((opt = getopt(argc, argv, "c:d:t:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			cpu = atoi(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 't':
+			threshold = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (cpu < 0 || duration <= 0 || !threshold)
+		usage(argv[0]);
+
+	gaps = malloc(MAX_GAPS * sizeof(*gaps));
+	if (!gaps)
+		return 1;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set)) {
+		perror("sched_setaffinity");
+		return 1;
+	}
+
+	loc0 = read_loc(cpu);
+	have_ticks = !read_tick_stats(cpu, &st0);
+
+	start = prev = now_ns();
+	end = start + duration * 1000000000ULL;
+	while ((t = now_ns()) < end) {
+		if (t - prev > threshold) {
+			if (nr < MAX_GAPS)
+				gaps[nr++] = t - prev;
+			else
+				dropped++;
+		}
+		prev = t;
+	}
+	secs = (t - start) / 1e9;
+
+	loc1 = read_loc(cpu);
+	have_ticks = have_ticks && !read_tick_stats(cpu, &st1);
+
+	printf("cpu %d, %.1f s, threshold %llu ns\n", cpu, secs, threshold);
+	printf("interruptions: %lu (%.1f/s)\n", nr + dropped,
+	       (nr + dropped) / secs);
+	if (nr) {
+		qsort(gaps, nr, sizeof(*gaps), cmp_ull);
+		printf("length us: p50 %.2f p99 %.2f max %.2f\n",
+		       gaps[nr / 2] / 1e3, gaps[nr * 99 / 100] / 1e3,
+		       gaps[nr - 1] / 1e3);
+	}
+	if (loc0 >= 0 && loc1 >= 0)
+		printf("local timer interrupts: %lld (%.1f/s)\n", loc1 - loc0,
+		       (loc1 - loc0) / secs);
+	if (have_ticks)
+		printf("ticks: %llu, deferrals %llu, ticks avoided %llu\n",
+		       st1.nr_ticks - st0.nr_ticks,
+		       st1.adaptive_stops - st0.adaptive_stops,
+		       st1.adaptive_ticks_avoided - st0.adaptive_ticks_avoided);
+	else
+		printf("(tick counters not available in /proc/timer_list)\n");
+	return 0;
+}
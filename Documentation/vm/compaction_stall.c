@@ -0,0 +1,274 @@
+/*
+ * compaction_stall: high-order allocation stalls after fragmentation
+ *
+ * Fragments free memory, waits, then makes the kernel allocate high-order
+ * pages, and measures how long that takes:
+ *
+ *  1. maps and touches an anonymous area of most of the free memory, then
+ *     frees every other page of it: the free memory is left in single
+ *     pages between movable ones, which compaction can move away
+ *  2. stays idle for a while, which is when kcompactd gets to work
+ *  3. sends UDP datagrams over the loopback device, each of which needs a
+ *     buffer of several contiguous pages (order 3 for the default 16KB),
+ *     and forks children, which need an order-1 kernel stack on most
+ *     architectures
+ *
+ * Reported are the median, p99 and maximum time of a send and of a fork
+ * and wait, the compact_frag_score of /proc/vmstat after steps 1 and 2,
+ * and the change of the compaction counters during steps 2 and 3. Run it
+ * once with kcompactd on and once with it off:
+ *
+ *	# echo 0 > /proc/sys/vm/kcompactd_order
+ *	# ./compaction_stall
+ *	# echo 3 > /proc/sys/vm/kcompactd_order
+ *	# ./compaction_stall
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NR_COUNTERS	6
+
+static const char * const counter_names[NR_COUNTERS] = {
+	"compact_frag_score",
+	"compact_stall",
+	"compact_stall_us",
+	"compact_daemon_wake",
+	"compact_daemon_migrated",
+	"compact_pages_moved",
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* The counters of interest in /proc/vmstat, 0 on success */
+static int read_counters(unsigned long long *val)
+{
+	char key[64];
+	unsigned long long v;
+	int i, found = 0;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	memset(val, 0, NR_COUNTERS * sizeof(*val));
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %llu", key, &v) == 2) {
+		for (i = 0; i < NR_COUNTERS; i++) {
+			if (!strcmp(key, counter_names[i])) {
+				val[i] = v;
+				found++;
+			}
+		}
+	}
+	fclose(f);
+	return found == NR_COUNTERS ? 0 : -1;
+}
+
+static unsigned long mem_free_mb(void)
+{
+	char key[64];
+	unsigned long val, mb = 0;
+	FILE *f = fopen("/proc/meminfo", "r");
+
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %lu kB\n", key, &val) == 2) {
+		if (!strcmp(key, "MemFree:")) {
+			mb = val >> 10;
+			break;
+		}
+	}
+	fclose(f);
+	return mb;
+}
+
+/* Map and touch @mb, then free every other page of it */
+static char *fragment(unsigned long mb)
+{
+	long pagesize = sysconf(_SC_PAGESIZE);
+	size_t i, len = (size_t)mb << 20;
+	char *p;
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	/* keep the forks from copying its page tables */
+	madvise(p, len, MADV_DONTFORK);
+	for (i = 0; i < len; i += pagesize)
+		p[i] = 1;
+	for (i = pagesize; i < len; i += 2 * pagesize)
+		madvise(p + i, pagesize, MADV_DONTNEED);
+	return p;
+}
+
+static void report(const char *name, unsigned long long *t, int nr)
+{
+	qsort(t, nr, sizeof(*t), cmp_ull);
+	printf("%-6s %6d, us: p50 %.1f p99 %.1f max %.1f\n", name, nr,
+	       t[nr / 2] / 1e3, t[nr * 99 / 100] / 1e3, t[nr - 1] / 1e3);
+}
+
+static int run_sends(unsigned long long *t, int nr, int size)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	int rx, tx, i, ret = -1;
+	char *buf;
+
+	buf = calloc(1, size);
+	rx = socket(AF_INET, SOCK_DGRAM, 0);
+	tx = socket(AF_INET, SOCK_DGRAM, 0);
+	if (!buf || rx < 0 || tx < 0)
+		goto out;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(rx, (struct sockaddr *)&sin, sizeof(sin)) ||
+	    getsockname(rx, (struct sockaddr *)&sin, &len)) {
+		perror("bind");
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		t[i] = now_ns();
+		if (sendto(tx, buf, size, 0, (struct sockaddr *)&sin,
+			   sizeof(sin)) != size) {
+			perror("sendto");
+			goto out;
+		}
+		t[i] = now_ns() - t[i];
+		recv(rx, buf, size, 0);
+	}
+	ret = 0;
+out:
+	if (rx >= 0)
+		close(rx);
+	if (tx >= 0)
+		close(tx);
+	free(buf);
+	return ret;
+}
+
+static int run_forks(unsigned long long *t, int nr)
+{
+	pid_t pid;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		t[i] = now_ns();
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			return -1;
+		}
+		if (!pid)
+			_exit(0);
+		waitpid(pid, NULL, 0);
+		t[i] = now_ns() - t[i];
+	}
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-m mb] [-i seconds] [-n count] [-s size]\n"
+		"  -m  size of the area to fragment in MB (default 90%% of MemFree)\n"
+		"  -i  idle time after fragmenting in seconds (default 5)\n"
+		"  -n  number of sends and of forks (default 2000)\n"
+		"  -s  size of a datagram in bytes (default 16384)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long c0[NR_COUNTERS], c1[NR_COUNTERS], c2[NR_COUNTERS];
+	unsigned long long *t;
+	unsigned long mb = 0;
+	int idle = 5, nr = 2000, size = 16384, opt, i, have_c;
+
+	while ((opt = getopt(argc, argv, "m:i:n:s:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			idle = atoi(optarg);
+			break;
+		case 'n':
+			nr = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!mb)
+		mb = mem_free_mb() * 9 / 10;
+	if (!mb || idle < 0 || nr <= 0 || size <= 0 || size > 65507)
+		usage(argv[0]);
+	t = malloc(nr * sizeof(*t));
+	if (!t)
+		return 1;
+
+	printf("fragmenting %lu MB, idle %d s, %d sends of %d bytes and %d forks\n",
+	       mb, idle, nr, size, nr);
+	if (!fragment(mb))
+		return 1;
+
+	have_c = !read_counters(c0);
+	if (!have_c)
+		printf("(compaction counters not available in /proc/vmstat)\n");
+	sleep(idle);
+	read_counters(c1);
+
+	if (run_sends(t, nr, size))
+		return 1;
+	report("send", t, nr);
+	if (run_forks(t, nr))
+		return 1;
+	report("fork", t, nr);
+	read_counters(c2);
+
+	if (!have_c)
+		return 0;
+	printf("frag score: %llu after fragmenting, %llu after idle, %llu at the end\n",
+	       c0[0], c1[0], c2[0]);
+	printf("%-24s %10s %10s\n", "", "idle", "allocating");
+	for (i = 1; i < NR_COUNTERS; i++)
+		printf("%-24s %10llu %10llu\n", counter_names[i],
+		       c1[i] - c0[i], c2[i] - c1[i]);
+	return 0;
+}
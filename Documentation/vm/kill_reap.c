@@ -0,0 +1,232 @@
+/*
+ * kill_reap: time from SIGKILL until the memory of the victim is free
+ *
+ * Starts a victim, a child which maps and touches an anonymous area and
+ * then sleeps at nice 19, and optionally busy children at nice 0 on every
+ * cpu, as when a low memory killer kills a background application while
+ * the foreground is busy.  The victim is then sent SIGKILL, and the free
+ * memory of /proc/meminfo polled until most of the area has come back.
+ *
+ * Reported for every round are the time from the kill until then, and
+ * until waitpid() returns the victim, and at the end the medians and the
+ * change of the oom_reap counters of /proc/vmstat.  Compare freeing at
+ * exit with the oom reaper:
+ *
+ *	# echo 0 > /proc/sys/vm/reap_mem_on_sigkill
+ *	# ./kill_reap -m 256 -b 8
+ *	# echo 1 > /proc/sys/vm/reap_mem_on_sigkill
+ *	# ./kill_reap -m 256 -b 8
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_BUSY	256
+#define NR_COUNTERS	3
+
+static const char * const counter_names[NR_COUNTERS] = {
+	"oom_reap_tasks",
+	"oom_reap_pages",
+	"oom_reap_us",
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void read_counters(unsigned long long *val)
+{
+	char key[64];
+	unsigned long long v;
+	int i;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	memset(val, 0, NR_COUNTERS * sizeof(*val));
+	if (!f)
+		return;
+	while (fscanf(f, "%63s %llu", key, &v) == 2) {
+		for (i = 0; i < NR_COUNTERS; i++) {
+			if (!strcmp(key, counter_names[i]))
+				val[i] = v;
+		}
+	}
+	fclose(f);
+}
+
+static unsigned long mem_free_kb(void)
+{
+	char key[64];
+	unsigned long val, kb = 0;
+	FILE *f = fopen("/proc/meminfo", "r");
+
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %lu kB\n", key, &val) == 2) {
+		if (!strcmp(key, "MemFree:")) {
+			kb = val;
+			break;
+		}
+	}
+	fclose(f);
+	return kb;
+}
+
+static void __attribute__((noreturn)) victim(int ack, size_t len)
+{
+	long pagesize = sysconf(_SC_PAGESIZE);
+	size_t i;
+	char *p;
+
+	if (setpriority(PRIO_PROCESS, 0, 19))
+		perror("setpriority");
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		_exit(1);
+	for (i = 0; i < len; i += pagesize)
+		p[i] = 1;
+	if (write(ack, "r", 1) != 1)
+		_exit(1);
+	for (;;)
+		pause();
+}
+
+static void __attribute__((noreturn)) busy(void)
+{
+	for (;;)
+		;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-m mb] [-b busy] [-r rounds] [-t timeout_ms]\n"
+		"  -m  size of the memory of the victim in MB (default 128)\n"
+		"  -b  number of busy children (default the number of cpus)\n"
+		"  -r  number of rounds (default 10)\n"
+		"  -t  give up waiting for the memory after this long "
+		"(default 10000)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long c0[NR_COUNTERS], c1[NR_COUNTERS];
+	unsigned long long *t_free, *t_exit, t0, t;
+	unsigned long mb = 128, before, target;
+	int nr_busy = sysconf(_SC_NPROCESSORS_ONLN), rounds = 10;
+	int timeout_ms = 10000, opt, i, ack[2];
+	pid_t pid, busy_pids[MAX_BUSY];
+	char c;
+
+	while ((opt = getopt(argc, argv, "m:b:r:t:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			nr_busy = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 't':
+			timeout_ms = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!mb || nr_busy < 0 || nr_busy > MAX_BUSY || rounds <= 0 ||
+	    timeout_ms <= 0)
+		usage(argv[0]);
+	t_free = calloc(rounds, sizeof(*t_free));
+	t_exit = calloc(rounds, sizeof(*t_exit));
+	if (!t_free || !t_exit || pipe(ack))
+		return 1;
+
+	for (i = 0; i < nr_busy; i++) {
+		busy_pids[i] = fork();
+		if (busy_pids[i] < 0) {
+			perror("fork");
+			nr_busy = i;
+			break;
+		}
+		if (!busy_pids[i])
+			busy();
+	}
+
+	printf("victim %lu MB, %d busy, %d rounds\n", mb, nr_busy, rounds);
+	printf("%6s %12s %12s\n", "round", "freed_ms", "exited_ms");
+	read_counters(c0);
+	for (i = 0; i < rounds; i++) {
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			break;
+		}
+		if (!pid)
+			victim(ack[1], (size_t)mb << 20);
+		if (read(ack[0], &c, 1) != 1) {
+			fprintf(stderr, "victim failed to start\n");
+			break;
+		}
+
+		/* most of the memory of the victim is back */
+		before = mem_free_kb();
+		target = before + (mb << 10) * 9 / 10;
+		t0 = now_ns();
+		kill(pid, SIGKILL);
+		while (mem_free_kb() < target) {
+			if ((now_ns() - t0) / 1000000 > (unsigned)timeout_ms)
+				break;
+			usleep(100);
+		}
+		t = now_ns() - t0;
+		t_free[i] = t;
+		waitpid(pid, NULL, 0);
+		t_exit[i] = now_ns() - t0;
+		printf("%6d %12.2f %12.2f%s\n", i, t_free[i] / 1e6,
+		       t_exit[i] / 1e6, t / 1000000 > (unsigned)timeout_ms ?
+		       " (timed out)" : "");
+	}
+	read_counters(c1);
+
+	for (i = 0; i < nr_busy; i++)
+		kill(busy_pids[i], SIGKILL);
+	for (i = 0; i < nr_busy; i++)
+		waitpid(busy_pids[i], NULL, 0);
+
+	qsort(t_free, rounds, sizeof(*t_free), cmp_ull);
+	qsort(t_exit, rounds, sizeof(*t_exit), cmp_ull);
+	printf("median %12.2f %12.2f\n", t_free[rounds / 2] / 1e6,
+	       t_exit[rounds / 2] / 1e6);
+	for (i = 0; i < NR_COUNTERS; i++)
+		printf("%-16s %10llu\n", counter_names[i], c1[i] - c0[i]);
+	return 0;
+}
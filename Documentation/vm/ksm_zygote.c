@@ -0,0 +1,327 @@
+/*
+ * ksm_zygote: KSM merging of children forked from a zygote
+ *
+ * Builds a heap of distinct pages in a parent, the zygote, then forks
+ * children which, as the children of Android's zygote do, write all of
+ * the heap with what it already held, turning it into private copies of
+ * the same content, and keep writing a small volatile area of their own.
+ * Their memory is made mergeable either by putting the zygote into a
+ * memory cgroup with memory.ksm set, which the children inherit, or by
+ * madvise(MADV_MERGEABLE) of the areas.
+ *
+ * Reported every interval are pages_sharing of KSM, the pages merged by
+ * the children from their /proc/<pid>/ksm_merging_pages, the full scans
+ * and the pages left out by skip_volatile so far, the batch of ksmd and
+ * the CPU time ksmd used.  Compare the fixed scan rate with the adaptive
+ * one and with volatile pages skipped:
+ *
+ *	# echo 1 > /sys/kernel/mm/ksm/run
+ *	# mkdir /cgroup/memory/apps
+ *	# echo 1 > /cgroup/memory/apps/memory.ksm
+ *	# ./ksm_zygote -g /cgroup/memory/apps
+ *	# echo 1 > /sys/kernel/mm/ksm/adaptive_scan
+ *	# echo 1 > /sys/kernel/mm/ksm/skip_volatile
+ *	# ./ksm_zygote -g /cgroup/memory/apps
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KSM_DIR		"/sys/kernel/mm/ksm/"
+#define MAX_CHILDREN	1024
+
+static long pagesize;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* A number from a file of one, 0 if it cannot be read */
+static unsigned long read_ulong(const char *path)
+{
+	unsigned long val = 0;
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+		return 0;
+	if (fscanf(f, "%lu", &val) != 1)
+		val = 0;
+	fclose(f);
+	return val;
+}
+
+static unsigned long ksm_counter(const char *name)
+{
+	char path[128];
+
+	snprintf(path, sizeof(path), KSM_DIR "%s", name);
+	return read_ulong(path);
+}
+
+static pid_t find_ksmd(void)
+{
+	char path[300], comm[32];
+	struct dirent *d;
+	pid_t pid = 0;
+	DIR *dir = opendir("/proc");
+	FILE *f;
+
+	if (!dir)
+		return 0;
+	while (!pid && (d = readdir(dir))) {
+		if (d->d_name[0] < '0' || d->d_name[0] > '9')
+			continue;
+		snprintf(path, sizeof(path), "/proc/%s/comm", d->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (fscanf(f, "%31s", comm) == 1 && !strcmp(comm, "ksmd"))
+			pid = atoi(d->d_name);
+		fclose(f);
+	}
+	closedir(dir);
+	return pid;
+}
+
+/* utime + stime of @pid in ms */
+static unsigned long long cpu_ms(pid_t pid)
+{
+	unsigned long long utime, stime;
+	char path[64], buf[1024], *p;
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return 0;
+	buf[n] = '\0';
+	/* the fields after the comm, which may contain spaces */
+	p = strrchr(buf, ')');
+	if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+			 "%llu %llu", &utime, &stime) != 2)
+		return 0;
+	return (utime + stime) * 1000 / sysconf(_SC_CLK_TCK);
+}
+
+static int join_cgroup(const char *cg)
+{
+	char path[4096], buf[32];
+	int fd, ret = 0;
+
+	snprintf(path, sizeof(path), "%s/tasks", cg);
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	snprintf(buf, sizeof(buf), "%d", getpid());
+	if (write(fd, buf, strlen(buf)) < 0) {
+		perror(path);
+		ret = -1;
+	}
+	close(fd);
+	return ret;
+}
+
+static char *map_anon(size_t len, int advise)
+{
+	char *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	if (advise && madvise(p, len, MADV_MERGEABLE)) {
+		perror("madvise(MADV_MERGEABLE)");
+		return NULL;
+	}
+	return p;
+}
+
+/* Different in every page, so that pages only merge across processes */
+static void fill_heap(unsigned long *heap, size_t len)
+{
+	size_t i, words = len / sizeof(*heap);
+
+	for (i = 0; i < words; i++)
+		heap[i] = i * 2654435761UL + 1;
+}
+
+static void __attribute__((noreturn)) child(volatile unsigned long *heap,
+					    size_t len, size_t vlen, int advise)
+{
+	size_t i, step = pagesize / sizeof(*heap);
+	unsigned long round = 0;
+	volatile unsigned long *vol;
+
+	/* copy the heap, without changing it */
+	for (i = 0; i < len / sizeof(*heap); i += step)
+		heap[i] = heap[i];
+
+	vol = (volatile unsigned long *)map_anon(vlen, advise);
+	if (!vol)
+		_exit(1);
+	for (;;) {
+		round++;
+		for (i = 0; i < vlen / sizeof(*vol); i += step)
+			vol[i] = round;
+		usleep(10000);
+	}
+}
+
+static unsigned long children_merged(pid_t *pids, int nr)
+{
+	char path[64];
+	unsigned long sum = 0;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		snprintf(path, sizeof(path), "/proc/%d/ksm_merging_pages",
+			 pids[i]);
+		sum += read_ulong(path);
+	}
+	return sum;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-g cgroup] [-n children] [-m heap_mb] [-v vol_kb] "
+		"[-t seconds] [-i interval]\n"
+		"  -g  memory cgroup with memory.ksm set to run in; without it,\n"
+		"      the areas are madvised MADV_MERGEABLE\n"
+		"  -n  number of children (default 16)\n"
+		"  -m  size of the heap in MB (default 32)\n"
+		"  -v  size of the volatile area of each child in KB "
+		"(default 256)\n"
+		"  -t  run time in seconds (default 60)\n"
+		"  -i  report interval in seconds (default 5)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long start, cpu0, sharing0, scans0, skipped0;
+	unsigned long mb = 32, vkb = 256, heap_pages;
+	int nr = 16, seconds = 60, interval = 5, opt, i, advise;
+	const char *cg = NULL;
+	unsigned long *heap;
+	pid_t pids[MAX_CHILDREN], ksmd;
+	size_t len, vlen;
+
+	while ((opt = getopt(argc, argv, "g:n:m:v:t:i:h")) != -1) {
+		switch (opt) {
+		case 'g':
+			cg = optarg;
+			break;
+		case 'n':
+			nr = atoi(optarg);
+			break;
+		case 'm':
+			mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			vkb = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nr <= 0 || nr > MAX_CHILDREN || !mb || !vkb || seconds <= 0 ||
+	    interval <= 0)
+		usage(argv[0]);
+
+	pagesize = sysconf(_SC_PAGESIZE);
+	len = (size_t)mb << 20;
+	vlen = (size_t)vkb << 10;
+	heap_pages = len / pagesize;
+	advise = !cg;
+	if (!ksm_counter("run"))
+		fprintf(stderr, "warning: ksmd is not running, see "
+			KSM_DIR "run\n");
+	ksmd = find_ksmd();
+
+	/* before the heap is mapped, so that merge-any covers it */
+	if (cg && join_cgroup(cg))
+		return 1;
+	heap = (unsigned long *)map_anon(len, advise);
+	if (!heap)
+		return 1;
+	fill_heap(heap, len);
+
+	printf("%d children, heap %lu MB, volatile %lu KB each, %s\n", nr, mb,
+	       vkb, cg ? "memory.ksm" : "madvise");
+	printf("ksm: pages_to_scan %lu sleep_millisecs %lu adaptive_scan %lu "
+	       "skip_volatile %lu\n", ksm_counter("pages_to_scan"),
+	       ksm_counter("sleep_millisecs"), ksm_counter("adaptive_scan"),
+	       ksm_counter("skip_volatile"));
+	printf("at most %lu pages can be saved\n", heap_pages * nr);
+
+	sharing0 = ksm_counter("pages_sharing");
+	scans0 = ksm_counter("full_scans");
+	skipped0 = ksm_counter("pages_skipped");
+	cpu0 = ksmd ? cpu_ms(ksmd) : 0;
+	start = now_ns();
+
+	for (i = 0; i < nr; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			perror("fork");
+			nr = i;
+			break;
+		}
+		if (!pids[i])
+			child(heap, len, vlen, advise);
+	}
+
+	printf("%6s %10s %10s %6s %10s %7s %10s\n", "s", "sharing",
+	       "merged", "scans", "skipped", "batch", "ksmd_ms");
+	while ((now_ns() - start) / 1000000000ULL < (unsigned)seconds) {
+		sleep(interval);
+		printf("%6.1f %10lu %10lu %6lu %10lu %7lu %10llu\n",
+		       (now_ns() - start) / 1e9,
+		       ksm_counter("pages_sharing") - (unsigned long)sharing0,
+		       children_merged(pids, nr),
+		       ksm_counter("full_scans") - (unsigned long)scans0,
+		       ksm_counter("pages_skipped") - (unsigned long)skipped0,
+		       ksm_counter("pages_to_scan_current"),
+		       ksmd ? cpu_ms(ksmd) - cpu0 : 0);
+		fflush(stdout);
+	}
+
+	for (i = 0; i < nr; i++)
+		kill(pids[i], SIGKILL);
+	for (i = 0; i < nr; i++)
+		waitpid(pids[i], NULL, 0);
+	return 0;
+}
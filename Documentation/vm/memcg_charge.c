@@ -0,0 +1,209 @@
+/*
+ * memcg_charge: cost of the memory controller in the page fault path
+ *
+ * Every page a task faults in is charged to its memory cgroup, and
+ * uncharged again when freed.  This maps and touches an anonymous area,
+ * then unmaps it, for a number of rounds, and reports the time per page
+ * fault and per page unmapped.  It does the same for the page cache, by
+ * reading a file dropped from the cache before every round.
+ *
+ * Run it in the root group, whose pages are not charged to a counter, in
+ * a group of its own, and with the controller disabled on the kernel
+ * command line (cgroup_disable=memory); the differences are the cost of
+ * the charge and uncharge paths:
+ *
+ *	# ./memcg_charge
+ *	# mkdir /cgroup/memory/test
+ *	# ./memcg_charge -g /cgroup/memory/test
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MB		(1UL << 20)
+
+static long pagesize;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int join_cgroup(const char *cg)
+{
+	char path[4096], buf[32];
+	int fd, ret = 0;
+
+	snprintf(path, sizeof(path), "%s/tasks", cg);
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	snprintf(buf, sizeof(buf), "%d", getpid());
+	if (write(fd, buf, strlen(buf)) < 0) {
+		perror(path);
+		ret = -1;
+	}
+	close(fd);
+	return ret;
+}
+
+/* Anonymous faults and unmaps of @len; adds the times to @fault, @unmap */
+static int anon_round(size_t len, unsigned long long *fault,
+		      unsigned long long *unmap)
+{
+	unsigned long long t0;
+	size_t i;
+	char *p;
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	t0 = now_ns();
+	for (i = 0; i < len; i += pagesize)
+		p[i] = 1;
+	*fault += now_ns() - t0;
+
+	t0 = now_ns();
+	munmap(p, len);
+	*unmap += now_ns() - t0;
+	return 0;
+}
+
+/* Page cache reads of @len from @fd, after dropping it from the cache */
+static int file_round(int fd, size_t len, char *buf, unsigned long long *read_ns)
+{
+	unsigned long long t0;
+	size_t done;
+
+	if (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED))
+		return -1;
+	t0 = now_ns();
+	for (done = 0; done < len; done += MB) {
+		if (pread(fd, buf, MB, done) != (ssize_t)MB) {
+			perror("read");
+			return -1;
+		}
+	}
+	*read_ns += now_ns() - t0;
+	return 0;
+}
+
+static int make_file(const char *path, size_t len, char *buf)
+{
+	size_t done;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	memset(buf, 0x5a, MB);
+	for (done = 0; done < len; done += MB) {
+		if (write(fd, buf, MB) != (ssize_t)MB) {
+			perror("write");
+			close(fd);
+			return -1;
+		}
+	}
+	fsync(fd);
+	return fd;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-g cgroup] [-m mb] [-r rounds] [-d dir]\n"
+		"  -g  memory cgroup to run in (default the current one)\n"
+		"  -m  size of the area and of the file in MB (default 64)\n"
+		"  -r  number of rounds (default 20)\n"
+		"  -d  directory for the file, none to leave out the page "
+		"cache\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long fault = 0, unmap = 0, read_ns = 0;
+	unsigned long mb = 64, pages;
+	const char *cg = NULL, *dir = NULL;
+	int rounds = 20, opt, i, fd = -1;
+	char path[4096], *buf;
+	size_t len;
+
+	while ((opt = getopt(argc, argv, "g:m:r:d:h")) != -1) {
+		switch (opt) {
+		case 'g':
+			cg = optarg;
+			break;
+		case 'm':
+			mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!mb || rounds <= 0)
+		usage(argv[0]);
+	pagesize = sysconf(_SC_PAGESIZE);
+	len = mb * MB;
+	pages = len / pagesize * rounds;
+	buf = malloc(MB);
+	if (!buf)
+		return 1;
+
+	if (cg && join_cgroup(cg))
+		return 1;
+	if (dir) {
+		snprintf(path, sizeof(path), "%s/memcg_charge.dat", dir);
+		fd = make_file(path, len, buf);
+		if (fd < 0)
+			return 1;
+		unlink(path);
+	}
+
+	/* a round to warm up the page tables and the allocator */
+	if (anon_round(len, &fault, &unmap))
+		return 1;
+	fault = unmap = 0;
+
+	for (i = 0; i < rounds; i++) {
+		if (anon_round(len, &fault, &unmap))
+			return 1;
+		if (fd >= 0 && file_round(fd, len, buf, &read_ns))
+			return 1;
+	}
+
+	printf("%s, %lu MB, %d rounds\n", cg ? cg : "current group", mb,
+	       rounds);
+	printf("anon fault  %8.1f ns/page\n", (double)fault / pages);
+	printf("anon unmap  %8.1f ns/page\n", (double)unmap / pages);
+	if (fd >= 0)
+		printf("cache read  %8.1f ns/page\n", (double)read_ns / pages);
+	return 0;
+}
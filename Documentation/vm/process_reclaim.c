@@ -0,0 +1,291 @@
+/*
+ * process_reclaim: trimming a background process instead of killing it
+ *
+ * Starts an "application": a child which builds an anonymous heap and reads
+ * a file through a mapping, then waits in the background.  The time that
+ * takes is the cost of a cold start.  The child's pages are then reclaimed
+ * by writing to /proc/<pid>/reclaim, and the child brought back to the
+ * foreground, where it uses all of its memory again and checks the heap:
+ * the time that takes, faulting its pages back from swap or zram and from
+ * the file, is the cost of a warm start after reclaim.
+ *
+ * Reported are both times, the time of the reclaim itself, the RSS of the
+ * child before and after, and the process_reclaim and swap counters of
+ * /proc/vmstat.  With a zram swap device:
+ *
+ *	# ./process_reclaim -a 128 -f 32 -t all
+ *	# ./process_reclaim -a 128 -f 32 -t anon -n 8192
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MB		(1UL << 20)
+#define NR_COUNTERS	5
+
+static const char * const counter_names[NR_COUNTERS] = {
+	"process_reclaim_scanned",
+	"process_reclaim_reclaimed",
+	"process_reclaim_us",
+	"pswpout",
+	"pswpin",
+};
+
+static long pagesize;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void read_counters(unsigned long long *val)
+{
+	char key[64];
+	unsigned long long v;
+	int i;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	memset(val, 0, NR_COUNTERS * sizeof(*val));
+	if (!f)
+		return;
+	while (fscanf(f, "%63s %llu", key, &v) == 2) {
+		for (i = 0; i < NR_COUNTERS; i++) {
+			if (!strcmp(key, counter_names[i]))
+				val[i] = v;
+		}
+	}
+	fclose(f);
+}
+
+static unsigned long rss_kb(pid_t pid)
+{
+	char path[64];
+	unsigned long size, rss = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%lu %lu", &size, &rss) != 2)
+		rss = 0;
+	fclose(f);
+	return rss * (pagesize >> 10);
+}
+
+/* Half of every page zero, as much of an application heap compresses */
+static unsigned long heap_word(size_t i)
+{
+	if ((i * sizeof(unsigned long)) % pagesize >= (size_t)pagesize / 2)
+		return 0;
+	return i * 2654435761UL + 1;
+}
+
+static int make_file(const char *path, size_t len)
+{
+	char *buf = malloc(MB);
+	size_t done;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0 || !buf) {
+		perror(path);
+		return -1;
+	}
+	memset(buf, 0x5a, MB);
+	for (done = 0; done < len; done += MB) {
+		if (write(fd, buf, MB) != (ssize_t)MB) {
+			perror("write");
+			close(fd);
+			return -1;
+		}
+	}
+	free(buf);
+	fsync(fd);
+	return fd;
+}
+
+/* Use all pages of the heap and the file; returns the bad words of the heap */
+static unsigned long use_memory(unsigned long *heap, size_t hlen,
+				volatile char *map, size_t flen)
+{
+	unsigned long bad = 0;
+	size_t i, step = pagesize / sizeof(*heap);
+
+	for (i = 0; i < hlen / sizeof(*heap); i += step / 4) {
+		if (heap[i] != heap_word(i))
+			bad++;
+	}
+	for (i = 0; i < flen; i += pagesize)
+		(void)map[i];
+	return bad;
+}
+
+/*
+ * The application: builds its state, reports, then waits for a byte on
+ * @cmd to use its memory again and report the bad words found.
+ */
+static void __attribute__((noreturn)) app(int cmd, int ack, int fd,
+					  size_t hlen, size_t flen)
+{
+	unsigned long *heap, bad;
+	char *map, c;
+	size_t i;
+
+	heap = mmap(NULL, hlen, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	map = mmap(NULL, flen, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (heap == MAP_FAILED || map == MAP_FAILED)
+		_exit(1);
+	for (i = 0; i < hlen / sizeof(*heap); i++)
+		heap[i] = heap_word(i);
+	use_memory(heap, hlen, map, flen);
+	bad = 0;
+	if (write(ack, &bad, sizeof(bad)) != sizeof(bad))
+		_exit(1);
+
+	if (read(cmd, &c, 1) != 1)
+		_exit(1);
+	bad = use_memory(heap, hlen, map, flen);
+	if (write(ack, &bad, sizeof(bad)) != sizeof(bad))
+		_exit(1);
+	_exit(0);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-a anon_mb] [-f file_mb] [-t type] [-n pages] "
+		"[-d dir]\n"
+		"  -a  size of the anonymous heap in MB (default 64)\n"
+		"  -f  size of the mapped file in MB (default 32)\n"
+		"  -t  what to reclaim: file, anon or all (default all)\n"
+		"  -n  reclaim at most this many pages (default no limit)\n"
+		"  -d  directory for the file (default .)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long c0[NR_COUNTERS], c1[NR_COUNTERS], c2[NR_COUNTERS];
+	unsigned long long t0, cold_ns, reclaim_ns, warm_ns;
+	unsigned long anon_mb = 64, file_mb = 32, pages = 0, bad;
+	unsigned long rss_before, rss_after;
+	const char *type = "all", *dir = ".";
+	char path[4096], buf[64];
+	int cmd[2], ack[2], opt, fd, rfd, i;
+	ssize_t len;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "a:f:t:n:d:h")) != -1) {
+		switch (opt) {
+		case 'a':
+			anon_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			file_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			type = optarg;
+			break;
+		case 'n':
+			pages = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!anon_mb || !file_mb || (strcmp(type, "file") &&
+	    strcmp(type, "anon") && strcmp(type, "all")))
+		usage(argv[0]);
+	pagesize = sysconf(_SC_PAGESIZE);
+
+	snprintf(path, sizeof(path), "%s/process_reclaim.dat", dir);
+	fd = make_file(path, file_mb * MB);
+	if (fd < 0)
+		return 1;
+	unlink(path);
+	/* the file is read from the device at the cold start too */
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+	if (pipe(cmd) || pipe(ack))
+		return 1;
+	t0 = now_ns();
+	pid = fork();
+	if (pid < 0)
+		return 1;
+	if (!pid)
+		app(cmd[0], ack[1], fd, anon_mb * MB, file_mb * MB);
+	if (read(ack[0], &bad, sizeof(bad)) != sizeof(bad)) {
+		fprintf(stderr, "application failed to start\n");
+		return 1;
+	}
+	cold_ns = now_ns() - t0;
+	rss_before = rss_kb(pid);
+
+	snprintf(path, sizeof(path), "/proc/%d/reclaim", pid);
+	rfd = open(path, O_WRONLY);
+	if (rfd < 0) {
+		perror(path);
+		kill(pid, SIGKILL);
+		return 1;
+	}
+	if (pages)
+		len = snprintf(buf, sizeof(buf), "%s %lu", type, pages);
+	else
+		len = snprintf(buf, sizeof(buf), "%s", type);
+
+	read_counters(c0);
+	t0 = now_ns();
+	if (write(rfd, buf, len) != len) {
+		perror(path);
+		kill(pid, SIGKILL);
+		return 1;
+	}
+	reclaim_ns = now_ns() - t0;
+	close(rfd);
+	read_counters(c1);
+	rss_after = rss_kb(pid);
+
+	t0 = now_ns();
+	if (write(cmd[1], "r", 1) != 1 ||
+	    read(ack[0], &bad, sizeof(bad)) != sizeof(bad)) {
+		fprintf(stderr, "application failed to resume\n");
+		return 1;
+	}
+	warm_ns = now_ns() - t0;
+	read_counters(c2);
+	waitpid(pid, NULL, 0);
+
+	printf("heap %lu MB, file %lu MB, reclaim \"%s\"\n", anon_mb, file_mb,
+	       buf);
+	printf("cold start       %10.1f ms\n", cold_ns / 1e6);
+	printf("reclaim          %10.1f ms, RSS %lu -> %lu KB\n",
+	       reclaim_ns / 1e6, rss_before, rss_after);
+	printf("warm start       %10.1f ms%s\n", warm_ns / 1e6,
+	       bad ? ", HEAP CORRUPTED" : "");
+	printf("%-26s %10s %10s\n", "", "reclaim", "warm start");
+	for (i = 0; i < NR_COUNTERS; i++)
+		printf("%-26s %10llu %10llu\n", counter_names[i],
+		       c1[i] - c0[i], c2[i] - c1[i]);
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * thp_tlb: speedup and memory bloat of transparent hugepages
+ *
+ * Maps an anonymous heap twice, once madvised MADV_NOHUGEPAGE and once
+ * MADV_HUGEPAGE, touches one in every few of its pages, then reads words
+ * of the touched pages in random order.  With small pages almost every
+ * read over a heap much larger than the TLB covers misses it; a hugepage
+ * maps 512 or 1024 times as much with one entry.
+ *
+ * Reported for each are the time per first touch, which includes the
+ * page faults, the time per random read, and the RSS and AnonHugePages of
+ * the heap: touching one page in every few gets a whole hugepage, which
+ * is the bloat.  Needs transparent_hugepage/enabled at "madvise" or
+ * "always":
+ *
+ *	# echo madvise > /sys/kernel/mm/transparent_hugepage/enabled
+ *	# ./thp_tlb -m 256
+ *	# ./thp_tlb -m 256 -s 8
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MB		(1UL << 20)
+/* the largest hugepage, 4M on 32-bit x86 without PAE */
+#define HPAGE_ALIGN	(4 * MB)
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE	14
+#define MADV_NOHUGEPAGE	15
+#endif
+
+struct result {
+	double touch_ns;
+	double read_ns;
+	unsigned long rss_kb;
+	unsigned long huge_kb;
+};
+
+static long pagesize;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Rss and AnonHugePages of the area starting at @addr, from smaps */
+static void area_usage(void *addr, unsigned long *rss, unsigned long *huge)
+{
+	char line[256], start[32];
+	unsigned long val, lo, hi;
+	int found = 0;
+	FILE *f = fopen("/proc/self/smaps", "r");
+
+	*rss = *huge = 0;
+	if (!f)
+		return;
+	snprintf(start, sizeof(start), "%lx-", (unsigned long)addr);
+	while (fgets(line, sizeof(line), f)) {
+		if (!strncmp(line, start, strlen(start))) {
+			found = 1;
+			continue;
+		}
+		if (!found)
+			continue;
+		/* the next area */
+		if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2)
+			break;
+		if (sscanf(line, "Rss: %lu kB", &val) == 1)
+			*rss = val;
+		else if (sscanf(line, "AnonHugePages: %lu kB", &val) == 1)
+			*huge = val;
+	}
+	fclose(f);
+}
+
+/* An area of @len aligned to HPAGE_ALIGN, so that hugepages can map it */
+static char *map_aligned(size_t len)
+{
+	char *p, *q;
+
+	p = mmap(NULL, len + HPAGE_ALIGN, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	q = (char *)(((uintptr_t)p + HPAGE_ALIGN - 1) & ~(HPAGE_ALIGN - 1));
+	if (q > p)
+		munmap(p, q - p);
+	munmap(q + len, p + HPAGE_ALIGN - q);
+	return q;
+}
+
+static int run(int advice, size_t len, int stride, unsigned long reads,
+	       struct result *r)
+{
+	unsigned long pages = len / pagesize / stride, i, sum = 0;
+	unsigned long long t0;
+	uint32_t x = 2463534242U;
+	size_t words = pagesize / sizeof(unsigned long);
+	char *heap;
+
+	heap = map_aligned(len);
+	if (!heap) {
+		perror("mmap");
+		return -1;
+	}
+	if (madvise(heap, len, advice))
+		perror("madvise");
+
+	t0 = now_ns();
+	for (i = 0; i < pages; i++)
+		heap[i * stride * pagesize] = 1;
+	r->touch_ns = (double)(now_ns() - t0) / pages;
+
+	t0 = now_ns();
+	for (i = 0; i < reads; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		/* a random word of a random touched page */
+		sum += ((unsigned long *)(heap + (x % pages) * stride *
+					  pagesize))[(x >> 8) % words];
+	}
+	r->read_ns = (double)(now_ns() - t0) / reads;
+
+	area_usage(heap, &r->rss_kb, &r->huge_kb);
+	munmap(heap, len);
+	/* keep the reads */
+	return sum == 42 ? 1 : 0;
+}
+
+static void report(const char *name, struct result *r)
+{
+	printf("%-10s %10.1f %10.2f %10lu %10lu\n", name, r->touch_ns,
+	       r->read_ns, r->rss_kb, r->huge_kb);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-m mb] [-s stride] [-n reads]\n"
+		"  -m  size of the heap in MB (default 256)\n"
+		"  -s  touch one page in this many (default 1)\n"
+		"  -n  number of random reads in millions (default 20)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long mb = 256, reads = 20;
+	struct result small, huge;
+	char mode[64] = "";
+	int stride = 1, opt;
+	FILE *f;
+
+	while ((opt = getopt(argc, argv, "m:s:n:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			mb = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			stride = atoi(optarg);
+			break;
+		case 'n':
+			reads = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	pagesize = sysconf(_SC_PAGESIZE);
+	if (!mb || stride <= 0 || !reads ||
+	    mb * MB / pagesize / stride == 0)
+		usage(argv[0]);
+
+	f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if (!f || !fgets(mode, sizeof(mode), f))
+		fprintf(stderr, "warning: no transparent hugepage support\n");
+	else if (strstr(mode, "[never]"))
+		fprintf(stderr, "warning: transparent hugepages are disabled\n");
+	if (f)
+		fclose(f);
+
+	if (run(MADV_NOHUGEPAGE, mb * MB, stride, reads * 1000000, &small) < 0 ||
+	    run(MADV_HUGEPAGE, mb * MB, stride, reads * 1000000, &huge) < 0)
+		return 1;
+
+	printf("heap %lu MB, touching 1 page in %d, %lu million reads\n", mb,
+	       stride, reads);
+	printf("%-10s %10s %10s %10s %10s\n", "", "touch_ns", "read_ns",
+	       "rss_kb", "huge_kb");
+	report("small", &small);
+	report("huge", &huge);
+	printf("speedup %.2fx, bloat %.2fx\n",
+	       huge.read_ns > 0 ? small.read_ns / huge.read_ns : 0,
+	       small.rss_kb ? (double)huge.rss_kb / small.rss_kb : 0);
+	return 0;
+}
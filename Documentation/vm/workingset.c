@@ -0,0 +1,240 @@
+/*
+ * workingset: page cache working set under a streaming read
+ *
+ * Creates two files in the given directory: a working set file, read
+ * again and again, and a larger stream file, read once from start to end
+ * in between. Every round reads the whole working set file and the next
+ * chunk of the stream file. Before reading the working set, mincore()
+ * tells how much of it is still cached.
+ *
+ * Reported are, per round and in total, the share of the working set
+ * which was found cached, the time it took to read it, and the change of
+ * the workingset_refault, workingset_activate and pgpgin counters of
+ * /proc/vmstat. Without refault detection the stream keeps pushing the
+ * working set out; with it, the refaulting working set pages should be
+ * activated and stay cached after a few rounds.
+ *
+ * Size the working set below and the stream well above the memory
+ * available for the page cache, e.g. on a 1GB device:
+ *
+ *	# ./workingset -w 300 -s 2048 -r 20 /data/tmp
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHUNK	(1 << 20)
+
+struct vmstat {
+	unsigned long long refault;
+	unsigned long long activate;
+	unsigned long long pgpgin;
+};
+
+static char buf[CHUNK];
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* The counters of interest in /proc/vmstat, 0 on success */
+static int read_vmstat(struct vmstat *vs)
+{
+	char key[64];
+	unsigned long long val;
+	int found = 0;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	memset(vs, 0, sizeof(*vs));
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %llu", key, &val) == 2) {
+		if (!strcmp(key, "workingset_refault")) {
+			vs->refault = val;
+			found++;
+		} else if (!strcmp(key, "workingset_activate")) {
+			vs->activate = val;
+			found++;
+		} else if (!strcmp(key, "pgpgin")) {
+			vs->pgpgin = val;
+		}
+	}
+	fclose(f);
+	return found == 2 ? 0 : -1;
+}
+
+static int create_file(const char *path, unsigned long mb)
+{
+	unsigned long i;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	memset(buf, 0x5a, sizeof(buf));
+	for (i = 0; i < mb; i++) {
+		if (write(fd, buf, CHUNK) != CHUNK) {
+			perror("write");
+			close(fd);
+			return -1;
+		}
+	}
+	/* start out uncached, like files which were not read yet */
+	fsync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	return fd;
+}
+
+/* Percentage of the pages of @fd which are cached */
+static double cached(int fd, unsigned long mb)
+{
+	size_t len = (size_t)mb * CHUNK;
+	long pagesize = sysconf(_SC_PAGESIZE);
+	size_t i, nr = len / pagesize, present = 0;
+	unsigned char *vec;
+	void *map;
+
+	map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		return -1.0;
+	vec = malloc(nr);
+	if (vec && !mincore(map, len, vec)) {
+		for (i = 0; i < nr; i++)
+			present += vec[i] & 1;
+	}
+	free(vec);
+	munmap(map, len);
+	return 100.0 * present / nr;
+}
+
+static int read_range(int fd, off_t start, unsigned long mb)
+{
+	unsigned long i;
+
+	for (i = 0; i < mb; i++) {
+		if (pread(fd, buf, CHUNK, start + (off_t)i * CHUNK) < 0) {
+			perror("read");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-w ws_mb] [-s stream_mb] [-r rounds] [dir]\n"
+		"  -w  size of the working set file in MB (default 256)\n"
+		"  -s  size of the stream file in MB (default 1024)\n"
+		"  -r  number of rounds (default 16)\n"
+		"  dir directory for the files (default .)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long ws_mb = 256, stream_mb = 1024, chunk_mb;
+	unsigned long long t, total_ns = 0;
+	struct vmstat vs0, vs1, vs_start;
+	char ws_path[4096], stream_path[4096];
+	const char *dir = ".";
+	int rounds = 16, opt, i, ws, stream, have_vs, ret = 1;
+	double hit, total_hit = 0.0;
+
+	while ((opt = getopt(argc, argv, "w:s:r:h")) != -1) {
+		switch (opt) {
+		case 'w':
+			ws_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			stream_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind < argc)
+		dir = argv[optind];
+	if (!ws_mb || !stream_mb || rounds <= 0)
+		usage(argv[0]);
+	chunk_mb = stream_mb / rounds;
+	if (!chunk_mb)
+		chunk_mb = 1;
+
+	snprintf(ws_path, sizeof(ws_path), "%s/workingset.ws", dir);
+	snprintf(stream_path, sizeof(stream_path), "%s/workingset.stream", dir);
+	ws = create_file(ws_path, ws_mb);
+	if (ws < 0)
+		return 1;
+	stream = create_file(stream_path, stream_mb);
+	if (stream < 0)
+		goto out_ws;
+
+	/* fault the working set in once before the stream starts */
+	if (read_range(ws, 0, ws_mb))
+		goto out;
+
+	have_vs = !read_vmstat(&vs_start);
+	if (!have_vs)
+		printf("(workingset counters not available in /proc/vmstat)\n");
+	printf("working set %lu MB, stream %lu MB in %d rounds of %lu MB\n",
+	       ws_mb, stream_mb, rounds, chunk_mb);
+	printf("%5s %8s %10s %10s %10s %10s\n", "round", "cached%",
+	       "ws_ms", "refault", "activate", "pgpgin");
+
+	for (i = 0; i < rounds; i++) {
+		read_vmstat(&vs0);
+		hit = cached(ws, ws_mb);
+		t = now_ns();
+		if (read_range(ws, 0, ws_mb))
+			goto out;
+		t = now_ns() - t;
+		if (read_range(stream, (off_t)i * chunk_mb * CHUNK, chunk_mb))
+			goto out;
+		read_vmstat(&vs1);
+
+		total_hit += hit;
+		total_ns += t;
+		printf("%5d %8.1f %10.1f %10llu %10llu %10llu\n", i, hit,
+		       t / 1e6, vs1.refault - vs0.refault,
+		       vs1.activate - vs0.activate, vs1.pgpgin - vs0.pgpgin);
+	}
+
+	read_vmstat(&vs1);
+	printf("total: cached %.1f%%, ws read %.1f ms/round", total_hit / rounds,
+	       total_ns / 1e6 / rounds);
+	if (have_vs)
+		printf(", refault %llu, activate %llu",
+		       vs1.refault - vs_start.refault,
+		       vs1.activate - vs_start.activate);
+	printf(", pgpgin %llu\n", vs1.pgpgin - vs_start.pgpgin);
+	ret = 0;
+out:
+	close(stream);
+	unlink(stream_path);
+out_ws:
+	close(ws);
+	unlink(ws_path);
+	return ret;
+}
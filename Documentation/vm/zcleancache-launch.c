@@ -0,0 +1,281 @@
+/*
+ * zcleancache-launch: repeated application launches under memory pressure
+ *
+ * Every argument is an "application": a file, or a directory whose regular
+ * files are all part of it (libraries, the package, its resources).  A
+ * launch maps each file and touches every page, the way the dynamic linker
+ * and the runtime fault in an app.  Between launches a churn file can be
+ * streamed through the page cache, and an anonymous balloon can be held for
+ * the whole run, so that the application files get evicted between two
+ * launches of the same app.
+ *
+ * Reported are the launch time percentiles, major faults per launch and the
+ * change of the cleancache counters in /sys/kernel/mm/cleancache and, with
+ * -d, of /sys/kernel/mm/zcleancache/<dev>/stat over the run.  Compare a run
+ * without a zcleancache pool for the mount against one with a pool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_FILES	1024
+#define NR_POOL_STATS	8
+
+struct app {
+	const char *name;
+	int nr_files;
+	char *files[MAX_FILES];
+};
+
+static const char *cc_stats[] = { "succ_gets", "failed_gets", "puts" };
+static const char *pool_stats[NR_POOL_STATS] = {
+	"stored_pages", "stored_kb", "puts", "hits",
+	"misses", "evicts", "rejects", "flushes",
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long majflt(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_majflt;
+}
+
+static void add_file(struct app *app, const char *path)
+{
+	if (app->nr_files == MAX_FILES)
+		return;
+	app->files[app->nr_files] = strdup(path);
+	if (app->files[app->nr_files])
+		app->nr_files++;
+}
+
+static void load_app(struct app *app, const char *name)
+{
+	struct stat st;
+	struct dirent *de;
+	char path[4096];
+	DIR *dir;
+
+	app->name = name;
+	if (stat(name, &st)) {
+		perror(name);
+		exit(1);
+	}
+	if (!S_ISDIR(st.st_mode)) {
+		add_file(app, name);
+		return;
+	}
+	dir = opendir(name);
+	if (!dir) {
+		perror(name);
+		exit(1);
+	}
+	while ((de = readdir(dir)) != NULL) {
+		snprintf(path, sizeof(path), "%s/%s", name, de->d_name);
+		if (!stat(path, &st) && S_ISREG(st.st_mode) && st.st_size)
+			add_file(app, path);
+	}
+	closedir(dir);
+}
+
+static void launch(struct app *app)
+{
+	long pagesize = sysconf(_SC_PAGESIZE);
+	volatile char sum = 0;
+	struct stat st;
+	char *p;
+	off_t off;
+	int i, fd;
+
+	for (i = 0; i < app->nr_files; i++) {
+		fd = open(app->files[i], O_RDONLY);
+		if (fd < 0)
+			continue;
+		if (fstat(fd, &st) || !st.st_size) {
+			close(fd);
+			continue;
+		}
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED)
+			continue;
+		for (off = 0; off < st.st_size; off += pagesize)
+			sum += p[off];
+		munmap(p, st.st_size);
+	}
+}
+
+static void churn(const char *file)
+{
+	static char buf[1 << 20];
+	int fd = open(file, O_RDONLY);
+
+	if (fd < 0)
+		return;
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+	close(fd);
+}
+
+static int read_counters(const char *dev, unsigned long *cc,
+			 unsigned long *pool)
+{
+	char path[256];
+	FILE *f;
+	int i, ret = 0;
+
+	for (i = 0; i < 3; i++) {
+		snprintf(path, sizeof(path), "/sys/kernel/mm/cleancache/%s",
+			 cc_stats[i]);
+		f = fopen(path, "r");
+		if (!f || fscanf(f, "%lu", &cc[i]) != 1)
+			ret = -1;
+		if (f)
+			fclose(f);
+	}
+	if (!dev)
+		return ret;
+	snprintf(path, sizeof(path), "/sys/kernel/mm/zcleancache/%s/stat", dev);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	for (i = 0; i < NR_POOL_STATS; i++)
+		if (fscanf(f, "%lu", &pool[i]) != 1)
+			ret = -1;
+	fclose(f);
+	return ret;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-r rounds] [-m balloon_mb] [-c churn_file] [-d dev] app...\n"
+		"  -r  number of times every app is launched (default 20)\n"
+		"  -m  anonymous memory in MB held during the run (default 0)\n"
+		"  -c  file read through the page cache before every launch\n"
+		"  -d  zcleancache pool to report, e.g. mmcblk0p9\n"
+		"An app is a file or a directory of files.\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long cc0[3] = { 0 }, cc1[3] = { 0 };
+	unsigned long pool0[NR_POOL_STATS] = { 0 }, pool1[NR_POOL_STATS] = { 0 };
+	const char *churn_file = NULL, *dev = NULL;
+	int rounds = 20, balloon_mb = 0;
+	struct app *apps;
+	double *lat, total = 0;
+	long faults;
+	int nr_apps, nr, opt, r, a, i, have0, have1;
+
+	while ((opt = getopt(argc, argv, "r:m:c:d:h")) != -1) {
+		switch (opt) {
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'm':
+			balloon_mb = atoi(optarg);
+			break;
+		case 'c':
+			churn_file = optarg;
+			break;
+		case 'd':
+			dev = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	nr_apps = argc - optind;
+	if (rounds <= 0 || balloon_mb < 0 || nr_apps <= 0)
+		usage(argv[0]);
+
+	apps = calloc(nr_apps, sizeof(*apps));
+	lat = calloc(rounds * nr_apps, sizeof(*lat));
+	if (!apps || !lat)
+		return 1;
+	for (a = 0; a < nr_apps; a++)
+		load_app(&apps[a], argv[optind + a]);
+
+	if (balloon_mb) {
+		size_t size = (size_t)balloon_mb << 20;
+		char *balloon = malloc(size);
+
+		if (!balloon) {
+			perror("balloon");
+			return 1;
+		}
+		memset(balloon, 0x5a, size);
+	}
+
+	have0 = !read_counters(dev, cc0, pool0);
+	faults = majflt();
+	for (nr = 0, r = 0; r < rounds; r++) {
+		for (a = 0; a < nr_apps; a++) {
+			double start;
+
+			if (churn_file)
+				churn(churn_file);
+			start = now();
+			launch(&apps[a]);
+			lat[nr] = (now() - start) * 1e3;
+			total += lat[nr++];
+		}
+	}
+	faults = majflt() - faults;
+	have1 = !read_counters(dev, cc1, pool1);
+
+	qsort(lat, nr, sizeof(*lat), cmp_double);
+	printf("apps %d, rounds %d, launches %d\n", nr_apps, rounds, nr);
+	printf("launch ms: mean %.2f p50 %.2f p99 %.2f max %.2f\n",
+	       total / nr, lat[nr / 2], lat[nr * 99 / 100], lat[nr - 1]);
+	printf("major faults per launch: %.1f\n", (double)faults / nr);
+
+	if (have0 && have1) {
+		printf("cleancache:");
+		for (i = 0; i < 3; i++)
+			printf(" %s %lu", cc_stats[i], cc1[i] - cc0[i]);
+		printf("\n");
+		if (dev) {
+			printf("zcleancache %s:", dev);
+			for (i = 0; i < NR_POOL_STATS; i++)
+				printf(" %s %lu", pool_stats[i],
+				       i < 2 ? pool1[i] : pool1[i] - pool0[i]);
+			printf("\n");
+		}
+	} else {
+		printf("(cleancache counters not available)\n");
+	}
+	return 0;
+}
@@ -0,0 +1,464 @@
+/*
+ *  ROW (Read Over Write) i/o scheduler.
+ *
+ *  A simple, non-sorting, non-idling scheduler for flash based block
+ *  devices (eMMC, SD). Synchronous reads are dispatched ahead of writes,
+ *  which are only allowed to pass once reads have used up their quantum
+ *  or a write has waited longer than its expire time.
+ *
+ *  See Documentation/block/row-iosched.txt
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/ktime.h>
+
+enum row_queue_prio {
+	ROWQ_READ = 0,		/* all reads, they are synchronous */
+	ROWQ_SYNC_WRITE,	/* O_SYNC/fsync writes */
+	ROWQ_ASYNC_WRITE,	/* background writeback */
+	ROWQ_MAX,
+};
+
+static const int read_quantum = 16;	/* reads dispatched while writes wait */
+static const int write_quantum = 4;	/* writes dispatched once reads yield */
+static const int sync_write_expire = HZ / 4;	/* max wait of a sync write */
+static const int async_write_expire = HZ;	/* ditto for async writes */
+
+struct row_queue {
+	struct list_head fifo;
+	unsigned int nr_queued;
+
+	/* dispatch latency statistics, protected by the queue lock */
+	unsigned long dispatched;
+	u64 total_wait_us;
+	unsigned long max_wait_us;
+};
+
+struct row_data {
+	struct request_queue *queue;
+	struct row_queue queues[ROWQ_MAX];
+
+	unsigned int reads_in_row;	/* reads dispatched since the last write */
+	unsigned int write_budget;	/* writes left in the current write turn */
+	unsigned long writes_starved;	/* write turns forced by read_quantum */
+	unsigned long writes_expired;	/* write turns forced by expiry */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int read_quantum;
+	int write_quantum;
+	int write_expire[2];		/* indexed by rq_is_sync() */
+};
+
+/*
+ * The queue a request was added to and the time (in usecs, truncated to
+ * an unsigned long) it was added at are kept in the elevator private
+ * pointers while the request is owned by the scheduler.
+ */
+#define rq_row_prio(rq)		((unsigned long) (rq)->elevator_private[0])
+#define rq_set_row_prio(rq, p)	((rq)->elevator_private[0] = (void *) (p))
+#define rq_row_stamp(rq)	((unsigned long) (rq)->elevator_private[1])
+#define rq_set_row_stamp(rq, t)	((rq)->elevator_private[1] = (void *) (t))
+
+static inline unsigned long row_now_us(void)
+{
+	return (unsigned long) ktime_to_us(ktime_get());
+}
+
+static inline enum row_queue_prio row_rq_prio(struct request *rq)
+{
+	if (rq_data_dir(rq) == READ)
+		return ROWQ_READ;
+	if (rq_is_sync(rq))
+		return ROWQ_SYNC_WRITE;
+	return ROWQ_ASYNC_WRITE;
+}
+
+static inline int row_writes_queued(struct row_data *rd)
+{
+	return rd->queues[ROWQ_SYNC_WRITE].nr_queued +
+		rd->queues[ROWQ_ASYNC_WRITE].nr_queued;
+}
+
+/*
+ * returns 1 if the oldest request on queue @prio has waited past its
+ * expire time. Requires a non-empty queue.
+ */
+static inline int row_queue_expired(struct row_data *rd, int prio)
+{
+	struct request *rq = rq_entry_fifo(rd->queues[prio].fifo.next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+static void row_add_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	enum row_queue_prio prio = row_rq_prio(rq);
+	struct row_queue *rqueue = &rd->queues[prio];
+
+	rq_set_row_prio(rq, prio);
+	rq_set_row_stamp(rq, row_now_us());
+	if (prio != ROWQ_READ)
+		rq_set_fifo_time(rq, jiffies +
+				 rd->write_expire[prio == ROWQ_SYNC_WRITE]);
+
+	list_add_tail(&rq->queuelist, &rqueue->fifo);
+	rqueue->nr_queued++;
+}
+
+static void row_remove_request(struct row_data *rd, struct request *rq)
+{
+	struct row_queue *rqueue = &rd->queues[rq_row_prio(rq)];
+
+	rq_fifo_clear(rq);
+	rqueue->nr_queued--;
+}
+
+/*
+ * Never merge an async bio into a sync write, it would drag the bio
+ * ahead of the rest of the background writeback, nor the other way round.
+ */
+static int row_allow_merge(struct request_queue *q, struct request *rq,
+			   struct bio *bio)
+{
+	if (bio_data_dir(bio) == READ)
+		return 1;
+
+	return (rq_row_prio(rq) == ROWQ_SYNC_WRITE) == !!(bio->bi_rw & REQ_SYNC);
+}
+
+static void row_merged_requests(struct request_queue *q, struct request *rq,
+				struct request *next)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	/*
+	 * the merged request inherits the earlier deadline and queue time
+	 * of the two, so merging never delays a write past its expiry
+	 */
+	if (rq_row_prio(rq) == rq_row_prio(next) && rq_row_prio(rq) != ROWQ_READ &&
+	    time_before(rq_fifo_time(next), rq_fifo_time(rq))) {
+		list_move(&rq->queuelist, &next->queuelist);
+		rq_set_fifo_time(rq, rq_fifo_time(next));
+	}
+	if ((long) (rq_row_stamp(next) - rq_row_stamp(rq)) < 0)
+		rq_set_row_stamp(rq, rq_row_stamp(next));
+
+	row_remove_request(rd, next);
+}
+
+static void row_dispatch_insert(struct request_queue *q, struct row_data *rd,
+				struct request *rq)
+{
+	struct row_queue *rqueue = &rd->queues[rq_row_prio(rq)];
+	unsigned long wait = row_now_us() - rq_row_stamp(rq);
+
+	rqueue->dispatched++;
+	rqueue->total_wait_us += wait;
+	if (wait > rqueue->max_wait_us)
+		rqueue->max_wait_us = wait;
+
+	row_remove_request(rd, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * pick the write queue to serve: sync writes go first unless the oldest
+ * async write has expired.
+ */
+static int row_choose_write_queue(struct row_data *rd)
+{
+	struct row_queue *sync_q = &rd->queues[ROWQ_SYNC_WRITE];
+	struct row_queue *async_q = &rd->queues[ROWQ_ASYNC_WRITE];
+
+	if (!async_q->nr_queued)
+		return ROWQ_SYNC_WRITE;
+	if (!sync_q->nr_queued || row_queue_expired(rd, ROWQ_ASYNC_WRITE))
+		return ROWQ_ASYNC_WRITE;
+	return ROWQ_SYNC_WRITE;
+}
+
+/*
+ * row_dispatch_requests selects the next request: reads unless the write
+ * queues have been starved for read_quantum dispatches or a write has
+ * expired, in which case up to write_quantum writes are let through.
+ */
+static int row_dispatch_requests(struct request_queue *q, int force)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	const int reads = rd->queues[ROWQ_READ].nr_queued;
+	const int writes = row_writes_queued(rd);
+	struct request *rq;
+	int prio;
+
+	if (unlikely(force)) {
+		int dispatched = 0;
+
+		for (prio = 0; prio < ROWQ_MAX; prio++) {
+			struct list_head *fifo = &rd->queues[prio].fifo;
+
+			while (!list_empty(fifo)) {
+				row_dispatch_insert(q, rd, rq_entry_fifo(fifo->next));
+				dispatched++;
+			}
+		}
+		rd->reads_in_row = 0;
+		rd->write_budget = 0;
+		return dispatched;
+	}
+
+	if (!reads && !writes)
+		return 0;
+
+	if (reads && writes && !rd->write_budget) {
+		if (rd->reads_in_row >= rd->read_quantum) {
+			rd->writes_starved++;
+			rd->write_budget = rd->write_quantum;
+		} else if ((rd->queues[ROWQ_SYNC_WRITE].nr_queued &&
+			    row_queue_expired(rd, ROWQ_SYNC_WRITE)) ||
+			   (rd->queues[ROWQ_ASYNC_WRITE].nr_queued &&
+			    row_queue_expired(rd, ROWQ_ASYNC_WRITE))) {
+			rd->writes_expired++;
+			rd->write_budget = rd->write_quantum;
+		}
+	}
+
+	if (reads && !rd->write_budget) {
+		/* only reads that actually hold back a write count */
+		prio = ROWQ_READ;
+		if (writes)
+			rd->reads_in_row++;
+		else
+			rd->reads_in_row = 0;
+	} else if (writes) {
+		prio = row_choose_write_queue(rd);
+		rd->reads_in_row = 0;
+		if (rd->write_budget)
+			rd->write_budget--;
+	} else {
+		/* the write turn ended early, nothing left to write */
+		rd->write_budget = 0;
+		prio = ROWQ_READ;
+		rd->reads_in_row = 0;
+	}
+
+	rq = rq_entry_fifo(rd->queues[prio].fifo.next);
+	row_dispatch_insert(q, rd, rq);
+
+	return 1;
+}
+
+static struct request *
+row_former_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	if (rq->queuelist.prev == &rd->queues[rq_row_prio(rq)].fifo)
+		return NULL;
+	return list_entry(rq->queuelist.prev, struct request, queuelist);
+}
+
+static struct request *
+row_latter_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	if (rq->queuelist.next == &rd->queues[rq_row_prio(rq)].fifo)
+		return NULL;
+	return list_entry(rq->queuelist.next, struct request, queuelist);
+}
+
+static void row_exit_queue(struct elevator_queue *e)
+{
+	struct row_data *rd = e->elevator_data;
+	int prio;
+
+	for (prio = 0; prio < ROWQ_MAX; prio++)
+		BUG_ON(!list_empty(&rd->queues[prio].fifo));
+
+	kfree(rd);
+}
+
+/*
+ * initialize elevator private data (row_data).
+ */
+static void *row_init_queue(struct request_queue *q)
+{
+	struct row_data *rd;
+	int prio;
+
+	rd = kmalloc_node(sizeof(*rd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!rd)
+		return NULL;
+
+	for (prio = 0; prio < ROWQ_MAX; prio++)
+		INIT_LIST_HEAD(&rd->queues[prio].fifo);
+	rd->queue = q;
+	rd->read_quantum = read_quantum;
+	rd->write_quantum = write_quantum;
+	rd->write_expire[1] = sync_write_expire;
+	rd->write_expire[0] = async_write_expire;
+	return rd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+row_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+row_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return row_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(row_read_quantum_show, rd->read_quantum, 0);
+SHOW_FUNCTION(row_write_quantum_show, rd->write_quantum, 0);
+SHOW_FUNCTION(row_sync_write_expire_show, rd->write_expire[1], 1);
+SHOW_FUNCTION(row_async_write_expire_show, rd->write_expire[0], 1);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data;							\
+	int ret = row_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(row_read_quantum_store, &rd->read_quantum, 1, INT_MAX, 0);
+STORE_FUNCTION(row_write_quantum_store, &rd->write_quantum, 1, INT_MAX, 0);
+STORE_FUNCTION(row_sync_write_expire_store, &rd->write_expire[1], 0, INT_MAX, 1);
+STORE_FUNCTION(row_async_write_expire_store, &rd->write_expire[0], 0, INT_MAX, 1);
+#undef STORE_FUNCTION
+
+/*
+ * dispatch latency of a queue: requests dispatched, average and maximum
+ * time in usecs spent in the scheduler. Writing anything resets them.
+ */
+#define STATS_FUNCTION(__NAME, __PRIO)					\
+static ssize_t row_##__NAME##_show(struct elevator_queue *e, char *page)	\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	struct row_queue *rqueue = &rd->queues[__PRIO];			\
+	unsigned long dispatched, max_wait;				\
+	u64 avg;							\
+	spin_lock_irq(rd->queue->queue_lock);				\
+	dispatched = rqueue->dispatched;				\
+	avg = rqueue->total_wait_us;					\
+	max_wait = rqueue->max_wait_us;					\
+	spin_unlock_irq(rd->queue->queue_lock);				\
+	if (dispatched)							\
+		do_div(avg, dispatched);				\
+	return sprintf(page, "%lu %llu %lu\n", dispatched,		\
+		       (unsigned long long) avg, max_wait);		\
+}									\
+static ssize_t row_##__NAME##_store(struct elevator_queue *e,		\
+				    const char *page, size_t count)	\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	struct row_queue *rqueue = &rd->queues[__PRIO];			\
+	spin_lock_irq(rd->queue->queue_lock);				\
+	rqueue->dispatched = 0;						\
+	rqueue->total_wait_us = 0;					\
+	rqueue->max_wait_us = 0;					\
+	spin_unlock_irq(rd->queue->queue_lock);				\
+	return count;							\
+}
+STATS_FUNCTION(read_stats, ROWQ_READ);
+STATS_FUNCTION(sync_write_stats, ROWQ_SYNC_WRITE);
+STATS_FUNCTION(async_write_stats, ROWQ_ASYNC_WRITE);
+#undef STATS_FUNCTION
+
+static ssize_t row_write_turns_show(struct elevator_queue *e, char *page)
+{
+	struct row_data *rd = e->elevator_data;
+
+	return sprintf(page, "%lu %lu\n", rd->writes_starved,
+		       rd->writes_expired);
+}
+
+#define ROW_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
+				      row_##name##_store)
+
+static struct elv_fs_entry row_attrs[] = {
+	ROW_ATTR(read_quantum),
+	ROW_ATTR(write_quantum),
+	ROW_ATTR(sync_write_expire),
+	ROW_ATTR(async_write_expire),
+	ROW_ATTR(read_stats),
+	ROW_ATTR(sync_write_stats),
+	ROW_ATTR(async_write_stats),
+	__ATTR(write_turns, S_IRUGO, row_write_turns_show, NULL),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_row = {
+	.ops = {
+		.elevator_allow_merge_fn =	row_allow_merge,
+		.elevator_merge_req_fn =	row_merged_requests,
+		.elevator_dispatch_fn =		row_dispatch_requests,
+		.elevator_add_req_fn =		row_add_request,
+		.elevator_former_req_fn =	row_former_request,
+		.elevator_latter_req_fn =	row_latter_request,
+		.elevator_init_fn =		row_init_queue,
+		.elevator_exit_fn =		row_exit_queue,
+	},
+
+	.elevator_attrs = row_attrs,
+	.elevator_name = "row",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init row_init(void)
+{
+	elv_register(&iosched_row);
+
+	return 0;
+}
+
+static void __exit row_exit(void)
+{
+	elv_unregister(&iosched_row);
+}
+
+module_init(row_init);
+module_exit(row_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("ROW (Read Over Write) IO scheduler");
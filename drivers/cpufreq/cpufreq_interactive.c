@@ -184,6 +184,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 		&per_cpu(cpuinfo, data);
 	u64 now_idle;
 	unsigned int new_freq;
+	unsigned int min_freq_hint;
 	unsigned int index;
 	unsigned long flags;
 
@@ -267,6 +268,17 @@ static void cpufreq_interactive_timer(unsigned long data)
 
 	new_freq = pcpu->freq_table[index].frequency;
 
+	/*
+	 * Stay at or above the minimum frequency asked for by the cpu
+	 * cgroup of the task running here.
+	 */
+	min_freq_hint = sched_min_freq_hint(data);
+	if (new_freq < min_freq_hint &&
+	    !cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
+					    min_freq_hint, CPUFREQ_RELATION_L,
+					    &index))
+		new_freq = pcpu->freq_table[index].frequency;
+
 	/*
 	 * Do not scale below floor_freq unless we have been at or above the
 	 * floor frequency for the minimum sample time since last validated.
@@ -562,6 +574,49 @@ static void cpufreq_interactive_boost(void)
 		wake_up_process(up_task);
 }
 
+/*
+ * A task whose cpu cgroup asks for at least @freq was switched in on @cpu.
+ * Called on @cpu with preemption disabled, from the context switch.
+ */
+static void cpufreq_interactive_freq_hint(int cpu, unsigned int freq)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	unsigned int index;
+	unsigned long flags;
+	int raised = 0;
+
+	if (freq <= pcpu->target_freq)
+		return;
+
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return;
+	if (!pcpu->governor_enabled)
+		goto exit;
+
+	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
+					   freq, CPUFREQ_RELATION_L, &index))
+		goto exit;
+	freq = pcpu->freq_table[index].frequency;
+
+	spin_lock_irqsave(&up_cpumask_lock, flags);
+	if (pcpu->target_freq < freq) {
+		trace_cpufreq_interactive_boost("sched");
+		pcpu->target_freq = freq;
+		pcpu->target_set_time_in_idle =
+			get_cpu_idle_time(cpu, &pcpu->target_set_time);
+		pcpu->floor_freq = freq;
+		pcpu->floor_validate_time = pcpu->target_set_time;
+		cpumask_set_cpu(cpu, &up_cpumask);
+		raised = 1;
+	}
+	spin_unlock_irqrestore(&up_cpumask_lock, flags);
+
+	if (raised)
+		wake_up_process(up_task);
+exit:
+	up_read(&pcpu->enable_sem);
+}
+
 /*
  * Pulsed boost on input event raises CPUs to hispeed_freq and lets
  * usual algorithm of min_sample_time  decide when to allow speed
@@ -971,6 +1026,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			pr_warn("%s: failed to register input handler\n",
 				__func__);
 		idle_notifier_register(&cpufreq_interactive_idle_nb);
+		sched_set_freq_hint_notifier(cpufreq_interactive_freq_hint);
 
 		break;
 
@@ -987,6 +1043,8 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		if (atomic_dec_return(&active_count) > 0)
 			return 0;
 
+		sched_set_freq_hint_notifier(NULL);
+		synchronize_sched();
 		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
 		input_unregister_handler(&cpufreq_interactive_input_handler);
 		sysfs_remove_group(cpufreq_global_kobject,
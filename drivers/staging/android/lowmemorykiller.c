@@ -195,6 +195,8 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		trace_lmk_kill(selected->pid, selected->comm, selected_oom_adj,
 				selected_tasksize, min_adj);
 		force_sig(SIGKILL, selected);
+		if (sysctl_reap_mem_on_sigkill)
+			wake_oom_reaper(selected);
 		rem -= selected_tasksize;
 	}
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
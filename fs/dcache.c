@@ -79,6 +79,12 @@
 int sysctl_vfs_cache_pressure __read_mostly = 100;
 EXPORT_SYMBOL_GPL(sysctl_vfs_cache_pressure);
 
+/*
+ * Default s_negative_dentry_ratio of new superblocks, 0 disables the
+ * negative-first pruning policy.
+ */
+int sysctl_negative_dentry_ratio __read_mostly;
+
 static __cacheline_aligned_in_smp DEFINE_SPINLOCK(dcache_lru_lock);
 __cacheline_aligned_in_smp DEFINE_SEQLOCK(rename_lock);
 
@@ -213,6 +219,15 @@ static void dentry_unlink_inode(struct dentry * dentry)
 	struct inode *inode = dentry->d_inode;
 	dentry->d_inode = NULL;
 	list_del_init(&dentry->d_alias);
+	if (!list_empty(&dentry->d_lru)) {
+		spin_lock(&dcache_lru_lock);
+		if (!list_empty(&dentry->d_lru) &&
+		    !(dentry->d_flags & DCACHE_NEGATIVE_LRU)) {
+			dentry->d_flags |= DCACHE_NEGATIVE_LRU;
+			dentry->d_sb->s_nr_dentry_negative++;
+		}
+		spin_unlock(&dcache_lru_lock);
+	}
 	dentry_rcuwalk_barrier(dentry);
 	spin_unlock(&dentry->d_lock);
 	spin_unlock(&inode->i_lock);
@@ -227,13 +242,22 @@ static void dentry_unlink_inode(struct dentry * dentry)
 /*
  * dentry_lru_(add|del|move_tail) must be called with d_lock held.
  */
+static void __dentry_lru_account(struct dentry *dentry)
+{
+	dentry->d_sb->s_nr_dentry_unused++;
+	dentry_stat.nr_unused++;
+	if (!dentry->d_inode) {
+		dentry->d_flags |= DCACHE_NEGATIVE_LRU;
+		dentry->d_sb->s_nr_dentry_negative++;
+	}
+}
+
 static void dentry_lru_add(struct dentry *dentry)
 {
 	if (list_empty(&dentry->d_lru)) {
 		spin_lock(&dcache_lru_lock);
 		list_add(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
-		dentry->d_sb->s_nr_dentry_unused++;
-		dentry_stat.nr_unused++;
+		__dentry_lru_account(dentry);
 		spin_unlock(&dcache_lru_lock);
 	}
 }
@@ -244,6 +268,10 @@ static void __dentry_lru_del(struct dentry *dentry)
 	dentry->d_flags &= ~DCACHE_SHRINK_LIST;
 	dentry->d_sb->s_nr_dentry_unused--;
 	dentry_stat.nr_unused--;
+	if (dentry->d_flags & DCACHE_NEGATIVE_LRU) {
+		dentry->d_flags &= ~DCACHE_NEGATIVE_LRU;
+		dentry->d_sb->s_nr_dentry_negative--;
+	}
 }
 
 static void dentry_lru_del(struct dentry *dentry)
@@ -260,8 +288,7 @@ static void dentry_lru_move_tail(struct dentry *dentry)
 	spin_lock(&dcache_lru_lock);
 	if (list_empty(&dentry->d_lru)) {
 		list_add_tail(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
-		dentry->d_sb->s_nr_dentry_unused++;
-		dentry_stat.nr_unused++;
+		__dentry_lru_account(dentry);
 	} else {
 		list_move_tail(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
 	}
@@ -721,6 +748,22 @@ static void shrink_dentry_list(struct list_head *list)
  *
  * If flags contains DCACHE_REFERENCED reference dentries will not be pruned.
  */
+/*
+ * Are there more negative dentries left on the LRU of @sb than its
+ * s_negative_dentry_ratio allows? @neg and @taken are the negative and
+ * total dentries already picked for pruning in this pass.
+ */
+static inline int dcache_negative_excess(struct super_block *sb,
+					 int neg, int taken)
+{
+	unsigned int ratio = sb->s_negative_dentry_ratio;
+
+	if (!ratio)
+		return 0;
+	return (sb->s_nr_dentry_negative - neg) * 100 >
+		(sb->s_nr_dentry_unused - taken) * ratio;
+}
+
 static void __shrink_dcache_sb(struct super_block *sb, int *count, int flags)
 {
 	/* called from prune_dcache() and shrink_dcache_parent() */
@@ -728,6 +771,7 @@ static void __shrink_dcache_sb(struct super_block *sb, int *count, int flags)
 	LIST_HEAD(referenced);
 	LIST_HEAD(tmp);
 	int cnt = *count;
+	int neg = 0;
 
 relock:
 	spin_lock(&dcache_lru_lock);
@@ -752,7 +796,19 @@ relock:
 			dentry->d_flags &= ~DCACHE_REFERENCED;
 			list_move(&dentry->d_lru, &referenced);
 			spin_unlock(&dentry->d_lock);
+		} else if (flags & DCACHE_REFERENCED &&
+			   !(dentry->d_flags & DCACHE_NEGATIVE_LRU) &&
+			   dcache_negative_excess(sb, neg, *count - cnt)) {
+			/*
+			 * Too many lookup misses are cached on this sb: prune
+			 * the negative dentries first and leave the positive
+			 * ones, which are the working set, alone for now.
+			 */
+			list_move(&dentry->d_lru, &referenced);
+			spin_unlock(&dentry->d_lock);
 		} else {
+			if (dentry->d_flags & DCACHE_NEGATIVE_LRU)
+				neg++;
 			list_move_tail(&dentry->d_lru, &tmp);
 			dentry->d_flags |= DCACHE_SHRINK_LIST;
 			spin_unlock(&dentry->d_lock);
@@ -1380,6 +1436,12 @@ static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 		if (unlikely(IS_AUTOMOUNT(inode)))
 			dentry->d_flags |= DCACHE_NEED_AUTOMOUNT;
 		list_add(&dentry->d_alias, &inode->i_dentry);
+		if (unlikely(dentry->d_flags & DCACHE_NEGATIVE_LRU)) {
+			spin_lock(&dcache_lru_lock);
+			dentry->d_flags &= ~DCACHE_NEGATIVE_LRU;
+			dentry->d_sb->s_nr_dentry_negative--;
+			spin_unlock(&dcache_lru_lock);
+		}
 	}
 	dentry->d_inode = inode;
 	dentry_rcuwalk_barrier(dentry);
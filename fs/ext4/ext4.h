@@ -917,6 +917,9 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
 #define EXT4_MOUNT_INIT_INODE_TABLE	0x80000000 /* Initialize uninitialized itables */
 
+#define EXT4_MOUNT2_IDLE_DISCARD	0x00000001 /* Batch DISCARDs until the
+						    * device is idle */
+
 #define clear_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt &= \
 						~EXT4_MOUNT_##opt
 #define set_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt |= \
@@ -1192,6 +1195,14 @@ struct ext4_sb_info {
 	atomic_t s_mb_discarded;
 	atomic_t s_lock_busy;
 
+	/* deferred discard of freed blocks while the device is idle */
+	struct delayed_work s_idle_discard_work;
+	unsigned int s_idle_discard_ms;		/* idle time before trimming */
+	ext4_group_t s_idle_discard_group;	/* next group to look at */
+	unsigned long s_idle_discard_stamp;	/* end of our last trim slice */
+	atomic_t s_idle_discard_deferred;	/* extents waiting for trim */
+	atomic64_t s_idle_discard_bytes;	/* bytes trimmed so far */
+
 	/* locality groups */
 	struct ext4_locality_group __percpu *s_locality_groups;
 
@@ -2058,6 +2069,9 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
 	struct          list_head bb_prealloc_list;
+	ext4_grpblk_t	bb_trim_start;	/* freed range awaiting idle discard */
+	ext4_grpblk_t	bb_trim_end;
+	unsigned int	bb_trim_extents;	/* nr of extents in that range */
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
 #endif
@@ -212,6 +212,24 @@ int ext4_sync_file(struct file *file, int datasync)
 	}
 
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
+
+	/*
+	 * fdatasync() of a file whose last change that matters for reading
+	 * the data back is already committed, e.g. an in-place overwrite of a
+	 * database file: only the data written back by our caller has to
+	 * reach stable storage. Skip the commit request, which takes
+	 * j_state_lock for writing, and the wait, which would count us as
+	 * a waiter and delay the running transaction for commit batching.
+	 */
+	if (datasync && jbd2_transaction_committed(journal, commit_tid)) {
+		if (journal->j_flags & JBD2_BARRIER)
+			ret = blkdev_issue_flush(inode->i_sb->s_bdev,
+						 GFP_KERNEL, NULL);
+		if (!ret && is_journal_aborted(journal))
+			ret = -EIO;
+		goto out;
+	}
+
 	if (journal->j_flags & JBD2_BARRIER &&
 	    !jbd2_trans_will_send_data_barrier(journal, commit_tid))
 		needs_barrier = true;
@@ -2415,6 +2415,8 @@ static int ext4_groupinfo_create_slab(size_t size)
 	return 0;
 }
 
+static void ext4_idle_discard_work(struct work_struct *work);
+
 int ext4_mb_init(struct super_block *sb, int needs_recovery)
 {
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
@@ -2466,6 +2468,12 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	spin_lock_init(&sbi->s_md_lock);
 	spin_lock_init(&sbi->s_bal_lock);
 
+	INIT_DELAYED_WORK_DEFERRABLE(&sbi->s_idle_discard_work,
+				     ext4_idle_discard_work);
+	sbi->s_idle_discard_ms = MB_DEFAULT_IDLE_DISCARD_MS;
+	/* jiffies starts out negative, a zero stamp would read as idle */
+	sbi->s_idle_discard_stamp = jiffies;
+
 	sbi->s_mb_max_to_scan = MB_DEFAULT_MAX_TO_SCAN;
 	sbi->s_mb_min_to_scan = MB_DEFAULT_MIN_TO_SCAN;
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
@@ -2528,6 +2536,8 @@ int ext4_mb_release(struct super_block *sb)
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct kmem_cache *cachep = get_groupinfo_cache(sb->s_blocksize_bits);
 
+	cancel_delayed_work_sync(&sbi->s_idle_discard_work);
+
 	if (sbi->s_proc)
 		remove_proc_entry("mb_groups", sbi->s_proc);
 
@@ -2593,6 +2603,32 @@ static inline int ext4_issue_discard(struct super_block *sb,
 	return sb_issue_discard(sb, discard_block, count, GFP_NOFS, 0);
 }
 
+/*
+ * Remember a freed extent for the idle discard worker instead of trimming
+ * it right away. Only the span of the freed blocks is recorded per group;
+ * the worker trims whatever is still free inside it, so blocks that get
+ * reallocated in the meantime are never discarded. Must be called with
+ * the group lock held.
+ */
+static void ext4_mb_defer_discard(struct super_block *sb,
+				  struct ext4_group_info *db,
+				  struct ext4_free_data *entry)
+{
+	ext4_grpblk_t end = entry->start_blk + entry->count;
+
+	assert_spin_locked(ext4_group_lock_ptr(sb, entry->group));
+
+	if (db->bb_trim_start >= db->bb_trim_end) {
+		db->bb_trim_start = entry->start_blk;
+		db->bb_trim_end = end;
+	} else {
+		db->bb_trim_start = min(db->bb_trim_start, entry->start_blk);
+		db->bb_trim_end = max(db->bb_trim_end, end);
+	}
+	db->bb_trim_extents++;
+	atomic_inc(&EXT4_SB(sb)->s_idle_discard_deferred);
+}
+
 /*
  * This function is called by the jbd2 layer once the commit has finished,
  * so we know we can free the blocks that were released with that commit.
@@ -2602,7 +2638,7 @@ static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 	struct super_block *sb = journal->j_private;
 	struct ext4_buddy e4b;
 	struct ext4_group_info *db;
-	int err, count = 0, count2 = 0;
+	int err, count = 0, count2 = 0, deferred = 0;
 	struct ext4_free_data *entry;
 	struct list_head *l, *ltmp;
 
@@ -2628,6 +2664,10 @@ static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 		/* Take it out of per group rb tree */
 		rb_erase(&entry->node, &(db->bb_free_root));
 		mb_free_blocks(NULL, &e4b, entry->start_blk, entry->count);
+		if (!test_opt(sb, DISCARD) && test_opt2(sb, IDLE_DISCARD)) {
+			ext4_mb_defer_discard(sb, db, entry);
+			deferred++;
+		}
 
 		if (!db->bb_free_root.rb_node) {
 			/* No more items in the per group rb tree
@@ -2642,6 +2682,11 @@ static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 	}
 
 	mb_debug(1, "freed %u blocks in %u structures\n", count, count2);
+
+	if (deferred)
+		queue_delayed_work(system_freezable_wq,
+				   &EXT4_SB(sb)->s_idle_discard_work,
+				   msecs_to_jiffies(EXT4_SB(sb)->s_idle_discard_ms));
 }
 
 #ifdef CONFIG_EXT4_DEBUG
@@ -4808,6 +4853,7 @@ static void ext4_trim_extent(struct super_block *sb, int start, int count,
  * @start:		first group block to examine
  * @max:		last group block to examine
  * @minblocks:		minimum extent block count
+ * @align:		trim only blocks aligned to this (power of 2) count
  *
  * ext4_trim_all_free walks through group's buddy bitmap searching for free
  * extents. When the free block is found, ext4_trim_extent is called to TRIM
@@ -4822,10 +4868,12 @@ static void ext4_trim_extent(struct super_block *sb, int start, int count,
 static ext4_grpblk_t
 ext4_trim_all_free(struct super_block *sb, ext4_group_t group,
 		   ext4_grpblk_t start, ext4_grpblk_t max,
-		   ext4_grpblk_t minblocks)
+		   ext4_grpblk_t minblocks, ext4_grpblk_t align)
 {
 	void *bitmap;
 	ext4_grpblk_t next, count = 0;
+	ext4_grpblk_t astart, aend;
+	ext4_fsblk_t first = ext4_group_first_block_no(sb, group);
 	struct ext4_buddy e4b;
 	int ret;
 
@@ -4847,10 +4895,14 @@ ext4_trim_all_free(struct super_block *sb, ext4_group_t group,
 			break;
 		next = mb_find_next_bit(bitmap, max, start);
 
-		if ((next - start) >= minblocks) {
-			ext4_trim_extent(sb, start,
-					 next - start, group, &e4b);
-			count += next - start;
+		/* shrink the extent to the device's discard granularity */
+		astart = ALIGN(first + start, align) - first;
+		aend = ((first + next) & ~((ext4_fsblk_t) align - 1)) - first;
+
+		if (aend > astart && (aend - astart) >= minblocks) {
+			ext4_trim_extent(sb, astart,
+					 aend - astart, group, &e4b);
+			count += aend - astart;
 		}
 		start = next + 1;
 
@@ -4943,7 +4995,7 @@ int ext4_trim_fs(struct super_block *sb, struct fstrim_range *range)
 
 		if (grp->bb_free >= minlen) {
 			cnt = ext4_trim_all_free(sb, group, first_block,
-						last_block, minlen);
+						last_block, minlen, 1);
 			if (cnt < 0) {
 				ret = cnt;
 				break;
@@ -4956,3 +5008,95 @@ int ext4_trim_fs(struct super_block *sb, struct fstrim_range *range)
 
 	return ret;
 }
+
+/*
+ * The device counts as idle when nothing is in flight on our partition
+ * and either no I/O has been accounted for s_idle_discard_ms, or the last
+ * accounted I/O was our own previous trim slice. A runtime suspended
+ * device is left alone, system suspend is covered by running on a
+ * freezable workqueue.
+ */
+static int ext4_idle_discard_device_idle(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct hd_struct *part = sb->s_bdev->bd_part;
+	struct device *dev = disk_to_dev(sb->s_bdev->bd_disk)->parent;
+
+	if (sb->s_frozen != SB_UNFROZEN)
+		return 0;
+	if (dev && pm_runtime_suspended(dev))
+		return 0;
+	if (!part || part_in_flight(part))
+		return 0;
+	if (!time_after(part->stamp, sbi->s_idle_discard_stamp))
+		return 1;
+	return time_after_eq(jiffies, part->stamp +
+			     msecs_to_jiffies(sbi->s_idle_discard_ms));
+}
+
+/*
+ * Trim the deferred range of one group per run, so a burst of new I/O
+ * never waits for more than a group's worth of discards.
+ */
+static void ext4_idle_discard_work(struct work_struct *work)
+{
+	struct ext4_sb_info *sbi = container_of(to_delayed_work(work),
+				struct ext4_sb_info, s_idle_discard_work);
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+	struct request_queue *q = bdev_get_queue(sb->s_bdev);
+	ext4_group_t group, ngroups = ext4_get_groups_count(sb);
+	ext4_grpblk_t start = 0, end = 0, minblocks, align = 1;
+	struct ext4_group_info *grp;
+	unsigned int extents = 0;
+	ext4_grpblk_t trimmed;
+	ext4_group_t i;
+
+	if (!atomic_read(&sbi->s_idle_discard_deferred))
+		return;
+
+	if (!ext4_idle_discard_device_idle(sb)) {
+		queue_delayed_work(system_freezable_wq, &sbi->s_idle_discard_work,
+				   msecs_to_jiffies(sbi->s_idle_discard_ms));
+		return;
+	}
+
+	group = sbi->s_idle_discard_group;
+	for (i = 0; i < ngroups; i++, group++) {
+		if (group >= ngroups)
+			group = 0;
+		grp = ext4_get_group_info(sb, group);
+		ext4_lock_group(sb, group);
+		start = grp->bb_trim_start;
+		end = grp->bb_trim_end;
+		extents = grp->bb_trim_extents;
+		grp->bb_trim_start = grp->bb_trim_end = 0;
+		grp->bb_trim_extents = 0;
+		ext4_unlock_group(sb, group);
+		if (start < end)
+			break;
+	}
+	/*
+	 * Every extent counted has its range recorded first under the group
+	 * lock, so nothing was left to handle and whatever is counted now was
+	 * freed since; leave it for the run its commit queues.
+	 */
+	if (start >= end)
+		return;
+	sbi->s_idle_discard_group = group + 1;
+
+	if (q && q->limits.discard_granularity > sb->s_blocksize &&
+	    is_power_of_2(q->limits.discard_granularity))
+		align = q->limits.discard_granularity >> sb->s_blocksize_bits;
+	minblocks = align;
+
+	trimmed = ext4_trim_all_free(sb, group, start, end, minblocks, align);
+	if (trimmed > 0)
+		atomic64_add((u64) trimmed << sb->s_blocksize_bits,
+			     &sbi->s_idle_discard_bytes);
+	sbi->s_idle_discard_stamp = jiffies;
+
+	if (atomic_sub_return(extents, &sbi->s_idle_discard_deferred) > 0)
+		queue_delayed_work(system_freezable_wq,
+				   &sbi->s_idle_discard_work, 1);
+}
+
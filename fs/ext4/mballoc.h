@@ -19,6 +19,8 @@
 #include <linux/seq_file.h>
 #include <linux/blkdev.h>
 #include <linux/mutex.h>
+#include <linux/genhd.h>
+#include <linux/pm_runtime.h>
 #include "ext4_jbd2.h"
 #include "ext4.h"
 
@@ -94,6 +96,12 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * with 'idle_discard' freed blocks are trimmed once the device has seen
+ * no other I/O for this many milliseconds
+ */
+#define MB_DEFAULT_IDLE_DISCARD_MS	5000
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
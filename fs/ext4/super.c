@@ -1103,6 +1103,9 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, DISCARD) && !(def_mount_opts & EXT4_DEFM_DISCARD))
 		seq_puts(seq, ",discard");
 
+	if (test_opt2(sb, IDLE_DISCARD))
+		seq_puts(seq, ",idle_discard");
+
 	if (test_opt(sb, NOLOAD))
 		seq_puts(seq, ",norecovery");
 
@@ -1293,6 +1296,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
+	Opt_idle_discard, Opt_noidle_discard,
 };
 
 static const match_table_t tokens = {
@@ -1365,6 +1369,8 @@ static const match_table_t tokens = {
 	{Opt_dioread_lock, "dioread_lock"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_idle_discard, "idle_discard"},
+	{Opt_noidle_discard, "noidle_discard"},
 	{Opt_init_itable, "init_itable=%u"},
 	{Opt_init_itable, "init_itable"},
 	{Opt_noinit_itable, "noinit_itable"},
@@ -1838,6 +1844,12 @@ set_qf_format:
 		case Opt_nodiscard:
 			clear_opt(sb, DISCARD);
 			break;
+		case Opt_idle_discard:
+			set_opt2(sb, IDLE_DISCARD);
+			break;
+		case Opt_noidle_discard:
+			clear_opt2(sb, IDLE_DISCARD);
+			break;
 		case Opt_dioread_nolock:
 			set_opt(sb, DIOREAD_NOLOCK);
 			break;
@@ -1948,7 +1960,6 @@ static int ext4_setup_super(struct super_block *sb, struct ext4_super_block *es,
 			EXT4_INODES_PER_GROUP(sb),
 			sbi->s_mount_opt, sbi->s_mount_opt2);
 
-	cleancache_init_fs(sb);
 	return res;
 }
 
@@ -2462,6 +2473,66 @@ static ssize_t extent_cache_misses_show(struct ext4_attr *a,
 	return snprintf(buf, PAGE_SIZE, "%lu\n", sbi->extent_cache_misses);
 }
 
+static ssize_t idle_discard_bytes_show(struct ext4_attr *a,
+				       struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%llu\n", (unsigned long long)
+			atomic64_read(&sbi->s_idle_discard_bytes));
+}
+
+static ssize_t idle_discard_deferred_show(struct ext4_attr *a,
+					  struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n",
+			atomic_read(&sbi->s_idle_discard_deferred));
+}
+
+static ssize_t negative_dentry_ratio_show(struct ext4_attr *a,
+					  struct ext4_sb_info *sbi, char *buf)
+{
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", sb->s_negative_dentry_ratio);
+}
+
+static ssize_t negative_dentry_ratio_store(struct ext4_attr *a,
+					   struct ext4_sb_info *sbi,
+					   const char *buf, size_t count)
+{
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+	unsigned long t;
+
+	if (parse_strtoul(buf, 100, &t))
+		return -EINVAL;
+
+	sb->s_negative_dentry_ratio = t;
+	return count;
+}
+
+static ssize_t fsync_batch_us_show(struct ext4_attr *a,
+				   struct ext4_sb_info *sbi, char *buf)
+{
+	if (!sbi->s_journal)
+		return snprintf(buf, PAGE_SIZE, "0\n");
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			sbi->s_journal->j_fsync_batch_us);
+}
+
+static ssize_t fsync_batch_us_store(struct ext4_attr *a,
+				    struct ext4_sb_info *sbi,
+				    const char *buf, size_t count)
+{
+	unsigned long t;
+
+	if (!sbi->s_journal)
+		return -EINVAL;
+	if (parse_strtoul(buf, USEC_PER_SEC, &t))
+		return -EINVAL;
+
+	sbi->s_journal->j_fsync_batch_us = t;
+	return count;
+}
+
 static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 					  struct ext4_sb_info *sbi,
 					  const char *buf, size_t count)
@@ -2521,6 +2592,10 @@ EXT4_RO_ATTR(session_write_kbytes);
 EXT4_RO_ATTR(lifetime_write_kbytes);
 EXT4_RO_ATTR(extent_cache_hits);
 EXT4_RO_ATTR(extent_cache_misses);
+EXT4_RO_ATTR(idle_discard_bytes);
+EXT4_RO_ATTR(idle_discard_deferred);
+EXT4_RW_ATTR(negative_dentry_ratio);
+EXT4_RW_ATTR(fsync_batch_us);
 EXT4_ATTR_OFFSET(inode_readahead_blks, 0644, sbi_ui_show,
 		 inode_readahead_blks_store, s_inode_readahead_blks);
 EXT4_RW_ATTR_SBI_UI(inode_goal, s_inode_goal);
@@ -2531,6 +2606,7 @@ EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
+EXT4_RW_ATTR_SBI_UI(idle_discard_ms, s_idle_discard_ms);
 
 static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(delayed_allocation_blocks),
@@ -2547,6 +2623,11 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
 	ATTR_LIST(max_writeback_mb_bump),
+	ATTR_LIST(idle_discard_ms),
+	ATTR_LIST(idle_discard_bytes),
+	ATTR_LIST(idle_discard_deferred),
+	ATTR_LIST(negative_dentry_ratio),
+	ATTR_LIST(fsync_batch_us),
 	NULL,
 };
 
@@ -3621,6 +3702,11 @@ no_journal:
 
 	if (ext4_setup_super(sb, es, sb->s_flags & MS_RDONLY))
 		sb->s_flags |= MS_RDONLY;
+	/*
+	 * Not in ext4_setup_super(): read-only mounts want a cleancache pool
+	 * too, and a remount must not ask for a second one.
+	 */
+	cleancache_init_fs(sb);
 
 	/* determine the minimum size of new large inodes, if present */
 	if (sbi->s_inode_size > EXT4_GOOD_OLD_INODE_SIZE) {
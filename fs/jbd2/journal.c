@@ -127,6 +127,70 @@ static void commit_timeout(unsigned long __data)
  *    known as checkpointing, and this thread is responsible for that job.
  */
 
+/*
+ * Floor of the adaptive fsync batching delay, in nanoseconds.
+ */
+#define JBD2_FSYNC_BATCH_MIN_NS	(20 * NSEC_PER_USEC)
+
+/*
+ * Several tasks are waiting for the commit we are about to start. If it is
+ * still the running transaction, hold it back for a moment so that fsyncs
+ * arriving right behind them land in the same transaction and share both
+ * the commit and the cache flush, instead of each forcing one of their own.
+ *
+ * The delay adapts to the workload: it doubles, up to j_fsync_batch_us, as
+ * long as waiting pulls in more waiters, and halves when it does not. It
+ * is never longer than the average commit time, so that a device which
+ * commits quickly is not slowed down.
+ */
+static void jbd2_fsync_batch(journal_t *journal)
+{
+	transaction_t *transaction;
+	u64 max_ns, delay;
+	ktime_t start, expires;
+	int waiters, joined;
+
+	max_ns = (u64)journal->j_fsync_batch_us * NSEC_PER_USEC;
+	if (!max_ns)
+		return;
+
+	read_lock(&journal->j_state_lock);
+	transaction = journal->j_running_transaction;
+	if (!transaction || transaction->t_tid != journal->j_commit_request ||
+	    (journal->j_flags & JBD2_UNMOUNT)) {
+		read_unlock(&journal->j_state_lock);
+		return;
+	}
+	delay = min(journal->j_fsync_batch_ns, journal->j_average_commit_time);
+	read_unlock(&journal->j_state_lock);
+
+	waiters = atomic_read(&journal->j_fsync_waiters);
+	if (waiters < 2 || !delay)
+		return;
+
+	start = ktime_get();
+	expires = ktime_set(0, delay);
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&expires, HRTIMER_MODE_REL);
+
+	joined = atomic_read(&journal->j_fsync_waiters) - waiters;
+	if (joined > 0)
+		journal->j_fsync_batch_ns = min(journal->j_fsync_batch_ns * 2,
+						max_ns);
+	else
+		journal->j_fsync_batch_ns = max_t(u64,
+				journal->j_fsync_batch_ns / 2,
+				JBD2_FSYNC_BATCH_MIN_NS);
+
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_fsync_delayed++;
+	journal->j_stats.ts_fsync_delay_ns +=
+		ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (joined > 0)
+		journal->j_stats.ts_fsync_joined += joined;
+	spin_unlock(&journal->j_history_lock);
+}
+
 static int kjournald2(void *arg)
 {
 	journal_t *journal = arg;
@@ -159,6 +223,7 @@ loop:
 		jbd_debug(1, "OK, requests differ\n");
 		write_unlock(&journal->j_state_lock);
 		del_timer_sync(&journal->j_commit_timer);
+		jbd2_fsync_batch(journal);
 		jbd2_journal_commit_transaction(journal);
 		write_lock(&journal->j_state_lock);
 		goto loop;
@@ -628,6 +693,23 @@ out:
 }
 EXPORT_SYMBOL(jbd2_trans_will_send_data_barrier);
 
+/*
+ * Return 1 if the transaction with the given tid has already been committed
+ * to the log. Unlike jbd2_log_wait_commit() this does not count the caller
+ * as a commit waiter, which would make kjournald2 hold back the running
+ * transaction for it.
+ */
+int jbd2_transaction_committed(journal_t *journal, tid_t tid)
+{
+	int ret;
+
+	read_lock(&journal->j_state_lock);
+	ret = tid_geq(journal->j_commit_sequence, tid);
+	read_unlock(&journal->j_state_lock);
+	return ret;
+}
+EXPORT_SYMBOL(jbd2_transaction_committed);
+
 /*
  * Wait for a specified commit to complete.
  * The caller may not hold the journal lock.
@@ -636,6 +718,7 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 {
 	int err = 0;
 
+	atomic_inc(&journal->j_fsync_waiters);
 	read_lock(&journal->j_state_lock);
 #ifdef CONFIG_JBD2_DEBUG
 	if (!tid_geq(journal->j_commit_request, tid)) {
@@ -654,6 +737,7 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 		read_lock(&journal->j_state_lock);
 	}
 	read_unlock(&journal->j_state_lock);
+	atomic_dec(&journal->j_fsync_waiters);
 
 	if (unlikely(is_journal_aborted(journal))) {
 		printk(KERN_EMERG "journal commit I/O error\n");
@@ -869,6 +953,17 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "%lu commits delayed for fsync batching, "
+		   "max %uus, currently %lluus\n",
+		   s->stats->ts_fsync_delayed, s->journal->j_fsync_batch_us,
+		   div_u64(s->journal->j_fsync_batch_ns, 1000));
+	if (s->stats->ts_fsync_delayed == 0)
+		return 0;
+	seq_printf(seq, "  %lluus delay per delayed commit\n",
+		   div_u64(s->stats->ts_fsync_delay_ns,
+			   s->stats->ts_fsync_delayed));
+	seq_printf(seq, "  %lu waiters joined per delayed commit\n",
+		   s->stats->ts_fsync_joined / s->stats->ts_fsync_delayed);
 	return 0;
 }
 
@@ -982,6 +1077,8 @@ static journal_t * journal_init_common (void)
 	journal->j_commit_interval = (HZ * JBD2_DEFAULT_MAX_COMMIT_AGE);
 	journal->j_min_batch_time = 0;
 	journal->j_max_batch_time = 15000; /* 15ms */
+	journal->j_fsync_batch_us = JBD2_DEFAULT_FSYNC_BATCH_US;
+	journal->j_fsync_batch_ns = JBD2_FSYNC_BATCH_MIN_NS;
 
 	/* The journal is marked for error until we succeed with recovery! */
 	journal->j_flags = JBD2_ABORT;
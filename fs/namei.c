@@ -32,6 +32,8 @@
 #include <linux/fcntl.h>
 #include <linux/device_cgroup.h>
 #include <linux/fs_struct.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <asm/uaccess.h>
 
 #include "internal.h"
@@ -405,6 +407,16 @@ EXPORT_SYMBOL(path_put);
  * to restart the path walk from the beginning in ref-walk mode.
  */
 
+/*
+ * Account a completed rcu-walk, or the reason for leaving it, to the
+ * superblock the walk is currently on. Must be called while nd->path is
+ * still valid, i.e. before rcu_read_unlock() on the failure paths.
+ */
+static inline void lookup_stat(struct nameidata *nd, enum lookup_stat_item item)
+{
+	this_cpu_inc(nd->path.dentry->d_sb->s_lookup_stats->count[item]);
+}
+
 /**
  * unlazy_walk - try to switch to ref-walk mode.
  * @nd: nameidata pathwalk data
@@ -538,12 +550,14 @@ static int complete_walk(struct nameidata *nd)
 		spin_lock(&dentry->d_lock);
 		if (unlikely(!__d_rcu_to_refcount(dentry, nd->seq))) {
 			spin_unlock(&dentry->d_lock);
+			lookup_stat(nd, LOOKUP_STAT_RESTART);
 			rcu_read_unlock();
 			br_read_unlock(vfsmount_lock);
 			return -ECHILD;
 		}
 		BUG_ON(nd->inode != dentry->d_inode);
 		spin_unlock(&dentry->d_lock);
+		lookup_stat(nd, LOOKUP_STAT_RCU);
 		mntget(nd->path.mnt);
 		rcu_read_unlock();
 		br_read_unlock(vfsmount_lock);
@@ -1013,6 +1027,7 @@ static int follow_dotdot_rcu(struct nameidata *nd)
 	return 0;
 
 failed:
+	lookup_stat(nd, LOOKUP_STAT_RESTART);
 	nd->flags &= ~LOOKUP_RCU;
 	if (!(nd->flags & LOOKUP_ROOT))
 		nd->root.mnt = NULL;
@@ -1159,6 +1174,7 @@ static int do_lookup(struct nameidata *nd, struct qstr *name,
 	 * do the non-racy lookup, below.
 	 */
 	if (nd->flags & LOOKUP_RCU) {
+		enum lookup_stat_item why = LOOKUP_STAT_MISS;
 		unsigned seq;
 		*inode = nd->inode;
 		dentry = __d_lookup_rcu(parent, name, &seq, inode);
@@ -1166,8 +1182,10 @@ static int do_lookup(struct nameidata *nd, struct qstr *name,
 			goto unlazy;
 
 		/* Memory barrier in read_seqcount_begin of child is enough */
-		if (__read_seqcount_retry(&parent->d_seq, nd->seq))
+		if (__read_seqcount_retry(&parent->d_seq, nd->seq)) {
+			lookup_stat(nd, LOOKUP_STAT_RESTART);
 			return -ECHILD;
+		}
 		nd->seq = seq;
 
 		if (unlikely(dentry->d_flags & DCACHE_OP_REVALIDATE)) {
@@ -1175,19 +1193,24 @@ static int do_lookup(struct nameidata *nd, struct qstr *name,
 			if (unlikely(status <= 0)) {
 				if (status != -ECHILD)
 					need_reval = 0;
+				why = LOOKUP_STAT_REVALIDATE;
 				goto unlazy;
 			}
 		}
 		path->mnt = mnt;
 		path->dentry = dentry;
+		why = LOOKUP_STAT_MOUNT;
 		if (unlikely(!__follow_mount_rcu(nd, path, inode)))
 			goto unlazy;
 		if (unlikely(path->dentry->d_flags & DCACHE_NEED_AUTOMOUNT))
 			goto unlazy;
 		return 0;
 unlazy:
-		if (unlazy_walk(nd, dentry))
+		if (unlazy_walk(nd, dentry)) {
+			lookup_stat(nd, LOOKUP_STAT_RESTART);
 			return -ECHILD;
+		}
+		lookup_stat(nd, why);
 	} else {
 		dentry = __d_lookup(parent, name);
 	}
@@ -1245,8 +1268,11 @@ static inline int may_lookup(struct nameidata *nd)
 		int err = exec_permission(nd->inode, IPERM_FLAG_RCU);
 		if (err != -ECHILD)
 			return err;
-		if (unlazy_walk(nd, NULL))
+		if (unlazy_walk(nd, NULL)) {
+			lookup_stat(nd, LOOKUP_STAT_RESTART);
 			return -ECHILD;
+		}
+		lookup_stat(nd, LOOKUP_STAT_PERMISSION);
 	}
 	return exec_permission(nd->inode, 0);
 }
@@ -1301,9 +1327,11 @@ static inline int walk_component(struct nameidata *nd, struct path *path,
 	if (unlikely(inode->i_op->follow_link) && follow) {
 		if (nd->flags & LOOKUP_RCU) {
 			if (unlikely(unlazy_walk(nd, path->dentry))) {
+				lookup_stat(nd, LOOKUP_STAT_RESTART);
 				terminate_walk(nd);
 				return -ECHILD;
 			}
+			lookup_stat(nd, LOOKUP_STAT_SYMLINK);
 		}
 		BUG_ON(inode != path->dentry->d_inode);
 		return 1;
@@ -3367,6 +3395,66 @@ const struct inode_operations page_symlink_inode_operations = {
 	.put_link	= page_put_link,
 };
 
+#ifdef CONFIG_PROC_FS
+static const char * const lookup_stat_names[NR_LOOKUP_STAT_ITEMS] = {
+	"rcu", "miss", "revalidate", "mount", "permission", "symlink",
+	"restart",
+};
+
+static void lookup_stats_show_sb(struct super_block *sb, void *arg)
+{
+	struct seq_file *m = arg;
+	unsigned long sum[NR_LOOKUP_STAT_ITEMS] = { 0, };
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct lookup_stats *stats = per_cpu_ptr(sb->s_lookup_stats, cpu);
+
+		for (i = 0; i < NR_LOOKUP_STAT_ITEMS; i++)
+			sum[i] += stats->count[i];
+	}
+
+	seq_printf(m, "%-16s %-10s %8d %8d %3u", sb->s_id, sb->s_type->name,
+		   sb->s_nr_dentry_unused, sb->s_nr_dentry_negative,
+		   sb->s_negative_dentry_ratio);
+	for (i = 0; i < NR_LOOKUP_STAT_ITEMS; i++)
+		seq_printf(m, " %lu", sum[i]);
+	seq_putc(m, '\n');
+}
+
+static int lookup_stats_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_printf(m, "%-16s %-10s %8s %8s %3s", "dev", "type",
+		   "unused", "negative", "neg%");
+	for (i = 0; i < NR_LOOKUP_STAT_ITEMS; i++)
+		seq_printf(m, " %s", lookup_stat_names[i]);
+	seq_putc(m, '\n');
+	iterate_supers(lookup_stats_show_sb, m);
+	return 0;
+}
+
+static int lookup_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lookup_stats_show, NULL);
+}
+
+static const struct file_operations lookup_stats_fops = {
+	.open		= lookup_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init lookup_stats_init(void)
+{
+	proc_create("fs/lookup_stats", 0, NULL, &lookup_stats_fops);
+	return 0;
+}
+module_init(lookup_stats_init);
+#endif /* CONFIG_PROC_FS */
+
 EXPORT_SYMBOL(user_path_at);
 EXPORT_SYMBOL(follow_down_one);
 EXPORT_SYMBOL(follow_down);
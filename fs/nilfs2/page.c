@@ -347,6 +347,18 @@ repeat:
 			spin_unlock_irq(&smap->tree_lock);
 
 			spin_lock_irq(&dmap->tree_lock);
+			if (dmap->nrshadows) {
+				void *entry;
+
+				/* drop a shadow entry left by reclaim */
+				entry = radix_tree_lookup(&dmap->page_tree,
+							  offset);
+				if (entry && radix_tree_exceptional_entry(entry)) {
+					radix_tree_delete(&dmap->page_tree,
+							  offset);
+					dmap->nrshadows--;
+				}
+			}
 			err = radix_tree_insert(&dmap->page_tree, offset, page);
 			if (unlikely(err < 0)) {
 				WARN_ON(err == -EEXIST);
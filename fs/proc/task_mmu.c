@@ -11,6 +11,8 @@
 #include <linux/rmap.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/mm_inline.h>
+#include <linux/hrtimer.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -601,6 +603,160 @@ const struct file_operations proc_clear_refs_operations = {
 	.llseek		= noop_llseek,
 };
 
+#ifdef CONFIG_PROCESS_RECLAIM
+#define RECLAIM_FILE 1
+#define RECLAIM_ANON 2
+#define RECLAIM_ALL (RECLAIM_FILE | RECLAIM_ANON)
+
+struct reclaim_walk {
+	struct vm_area_struct *vma;
+	int type;
+	unsigned long nr_to_reclaim;	/* 0 for all */
+	unsigned long nr_scanned;
+	unsigned long nr_reclaimed;
+};
+
+static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
+			     unsigned long end, struct mm_walk *walk)
+{
+	struct reclaim_walk *rw = walk->private;
+	struct vm_area_struct *vma = rw->vma;
+	unsigned long nr_isolated = 0, budget = ULONG_MAX;
+	LIST_HEAD(page_list);
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+
+	if (rw->nr_to_reclaim)
+		budget = rw->nr_to_reclaim - rw->nr_reclaimed;
+
+	split_huge_page_pmd(walk->mm, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end && nr_isolated < budget; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		if (!(rw->type & (PageAnon(page) ? RECLAIM_ANON : RECLAIM_FILE)))
+			continue;
+
+		/* Pages other processes map are left to global reclaim */
+		if (page_mapcount(page) != 1)
+			continue;
+
+		if (isolate_lru_page(page))
+			continue;
+
+		list_add(&page->lru, &page_list);
+		inc_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+		nr_isolated++;
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	if (nr_isolated) {
+		rw->nr_scanned += nr_isolated;
+		rw->nr_reclaimed += reclaim_pages_from_list(&page_list);
+	}
+	cond_resched();
+
+	/* a non-zero return ends the walk */
+	return rw->nr_to_reclaim && rw->nr_reclaimed >= rw->nr_to_reclaim;
+}
+
+/*
+ * Writing "file", "anon" or "all" to /proc/pid/reclaim reclaims those pages
+ * mapped by the process alone, optionally followed by the maximum number
+ * of pages to reclaim: "anon 2560".
+ */
+static ssize_t reclaim_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[32], *type_str, *nr_str;
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	struct reclaim_walk rw;
+	ktime_t start;
+	int rv;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	memset(&rw, 0, sizeof(rw));
+	nr_str = strstrip(buffer);
+	type_str = strsep(&nr_str, " \t");
+	if (!strcmp(type_str, "file"))
+		rw.type = RECLAIM_FILE;
+	else if (!strcmp(type_str, "anon"))
+		rw.type = RECLAIM_ANON;
+	else if (!strcmp(type_str, "all"))
+		rw.type = RECLAIM_ALL;
+	else
+		return -EINVAL;
+	if (nr_str) {
+		rv = kstrtoul(skip_spaces(nr_str), 10, &rw.nr_to_reclaim);
+		if (rv < 0)
+			return rv;
+	}
+
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+	mm = get_task_mm(task);
+	if (mm) {
+		struct mm_walk reclaim_walk = {
+			.pmd_entry = reclaim_pte_range,
+			.mm = mm,
+			.private = &rw,
+		};
+
+		start = ktime_get();
+		down_read(&mm->mmap_sem);
+		for (vma = mm->mmap; vma; vma = vma->vm_next) {
+			if (is_vm_hugetlb_page(vma))
+				continue;
+			if (vma->vm_flags & (VM_LOCKED | VM_PFNMAP | VM_IO))
+				continue;
+			/* only private mappings of files hold anon pages */
+			if (rw.type == RECLAIM_ANON && !vma->anon_vma)
+				continue;
+			if (rw.type == RECLAIM_FILE && !vma->vm_file)
+				continue;
+			rw.vma = vma;
+			if (walk_page_range(vma->vm_start, vma->vm_end,
+					    &reclaim_walk))
+				break;
+		}
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+
+		count_vm_events(PROCRECLAIM_SCANNED, rw.nr_scanned);
+		count_vm_events(PROCRECLAIM_RECLAIMED, rw.nr_reclaimed);
+		count_vm_events(PROCRECLAIM_US,
+			ktime_to_us(ktime_sub(ktime_get(), start)));
+	}
+	put_task_struct(task);
+
+	return count;
+}
+
+const struct file_operations proc_reclaim_operations = {
+	.write		= reclaim_write,
+	.llseek		= noop_llseek,
+};
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 struct pagemapread {
 	int pos, len;
 	u64 *buffer;
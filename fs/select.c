@@ -69,7 +69,7 @@ static long __estimate_accuracy(struct timespec *tv)
 
 long select_estimate_accuracy(struct timespec *tv)
 {
-	unsigned long ret;
+	unsigned long ret, slack;
 	struct timespec now;
 
 	/*
@@ -82,8 +82,9 @@ long select_estimate_accuracy(struct timespec *tv)
 	ktime_get_ts(&now);
 	now = timespec_sub(*tv, now);
 	ret = __estimate_accuracy(&now);
-	if (ret < current->timer_slack_ns)
-		return current->timer_slack_ns;
+	slack = task_get_effective_timer_slack(current);
+	if (ret < slack)
+		return slack;
 	return ret;
 }
 
@@ -78,6 +78,15 @@ struct mmu_gather_batch {
 #define MAX_GATHER_BATCH	\
 	((PAGE_SIZE - sizeof(struct mmu_gather_batch)) / sizeof(void *))
 
+/*
+ * Limit the number of pages gathered before a TLB flush frees them, so
+ * that tearing down a large address space gives its memory back as it
+ * goes, rather than all of it at the end, and without a soft lockup in
+ * the final free on !CONFIG_PREEMPT.  Every flush of a full gather is
+ * still a single flush_tlb_mm(), one IPI to each cpu which ran the mm.
+ */
+#define MAX_GATHER_BATCH_COUNT	(10000UL / MAX_GATHER_BATCH)
+
 /* struct mmu_gather is an opaque type used by the mm code for passing around
  * any data needed by arch specific code for tlb_remove_page.
  */
@@ -91,6 +100,7 @@ struct mmu_gather {
 
 	unsigned int		fullmm;
 
+	unsigned int		batch_count;
 	struct mmu_gather_batch *active;
 	struct mmu_gather_batch	local;
 	struct page		*__pages[MMU_GATHER_BUNDLE];
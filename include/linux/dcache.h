@@ -220,6 +220,8 @@ struct dentry_operations {
 #define DCACHE_MANAGED_DENTRY \
 	(DCACHE_MOUNTED|DCACHE_NEED_AUTOMOUNT|DCACHE_MANAGE_TRANSIT)
 
+#define DCACHE_NEGATIVE_LRU	0x80000	/* counted in s_nr_dentry_negative */
+
 extern seqlock_t rename_lock;
 
 static inline int dname_external(struct dentry *dentry)
@@ -421,5 +423,6 @@ static inline bool d_mountpoint(struct dentry *dentry)
 extern struct dentry *lookup_create(struct nameidata *nd, int is_dir);
 
 extern int sysctl_vfs_cache_pressure;
+extern int sysctl_negative_dentry_ratio;
 
 #endif	/* __LINUX_DCACHE_H */
@@ -641,6 +641,7 @@ struct address_space {
 	struct mutex		i_mmap_mutex;	/* protect tree, count, list */
 	/* Protected by tree_lock together with the radix tree */
 	unsigned long		nrpages;	/* number of total pages */
+	unsigned long		nrshadows;	/* number of shadow entries */
 	pgoff_t			writeback_index;/* writeback starts here */
 	const struct address_space_operations *a_ops;	/* methods */
 	unsigned long		flags;		/* error bits/gfp mask */
@@ -1362,6 +1363,26 @@ extern int send_sigurg(struct fown_struct *fown);
 extern struct list_head super_blocks;
 extern spinlock_t sb_lock;
 
+/*
+ * Path walk statistics, kept per superblock: how many walks completed in
+ * rcu-walk mode, and why the others had to drop to ref-walk. A walk is
+ * accounted to the superblock it was on when it completed or dropped.
+ */
+enum lookup_stat_item {
+	LOOKUP_STAT_RCU,		/* completed in rcu-walk mode */
+	LOOKUP_STAT_MISS,		/* dentry not in the dcache */
+	LOOKUP_STAT_REVALIDATE,		/* ->d_revalidate() needs ref-walk */
+	LOOKUP_STAT_MOUNT,		/* mount or automount point */
+	LOOKUP_STAT_PERMISSION,		/* ->permission() needs ref-walk */
+	LOOKUP_STAT_SYMLINK,		/* symlink to follow */
+	LOOKUP_STAT_RESTART,		/* raced, walk redone in ref-walk */
+	NR_LOOKUP_STAT_ITEMS
+};
+
+struct lookup_stats {
+	unsigned long count[NR_LOOKUP_STAT_ITEMS];
+};
+
 struct super_block {
 	struct list_head	s_list;		/* Keep this first */
 	dev_t			s_dev;		/* search index; _not_ kdev_t */
@@ -1396,6 +1417,11 @@ struct super_block {
 	/* s_dentry_lru, s_nr_dentry_unused protected by dcache.c lru locks */
 	struct list_head	s_dentry_lru;	/* unused dentry lru */
 	int			s_nr_dentry_unused;	/* # of dentry on lru */
+	int			s_nr_dentry_negative;	/* # of those negative */
+	/* % of s_nr_dentry_unused above which negatives are pruned first */
+	unsigned int		s_negative_dentry_ratio;
+
+	struct lookup_stats __percpu *s_lookup_stats;
 
 	struct block_device	*s_bdev;
 	struct backing_dev_info *s_bdi;
@@ -341,6 +341,12 @@ extern struct page *alloc_pages_vma(gfp_t gfp_mask, int order,
 #define alloc_page_vma_node(gfp_mask, vma, addr, node)		\
 	alloc_pages_vma(gfp_mask, 0, vma, addr, node)
 
+extern unsigned int alloc_pages_bulk(gfp_t gfp_mask, unsigned int nr_pages,
+				     struct page **pages);
+
+extern void *page_frag_alloc(unsigned int fragsz, gfp_t gfp_mask);
+extern void page_frag_free(void *addr);
+
 extern unsigned long __get_free_pages(gfp_t gfp_mask, unsigned int order);
 extern unsigned long get_zeroed_page(gfp_t gfp_mask);
 
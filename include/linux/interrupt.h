@@ -427,6 +427,17 @@ enum
  */
 extern char *softirq_to_name[NR_SOFTIRQS];
 
+#ifdef CONFIG_SOFTIRQ_THREADS
+extern bool softirq_threads;
+extern int softirq_thread_prio[NR_SOFTIRQS];
+struct ctl_table;
+extern int softirq_thread_prio_handler(struct ctl_table *table, int write,
+				       void __user *buffer, size_t *lenp,
+				       loff_t *ppos);
+#else
+#define softirq_threads		(0)
+#endif
+
 /* softirq mask and active fields moved to irq_cpustat_t in
  * asm/hardirq.h to get better cache usage.  KAO
  */
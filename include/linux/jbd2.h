@@ -49,6 +49,12 @@
  */
 #define JBD2_DEFAULT_MAX_COMMIT_AGE 5
 
+/*
+ * The default upper bound, in microseconds, for holding back a commit that
+ * several tasks are waiting on, so that fsyncs right behind them can share it.
+ */
+#define JBD2_DEFAULT_FSYNC_BATCH_US 300
+
 #ifdef CONFIG_JBD2_DEBUG
 /*
  * Define JBD2_EXPENSIVE_CHECKING to enable more expensive internal
@@ -684,6 +690,9 @@ struct transaction_run_stats_s {
 
 struct transaction_stats_s {
 	unsigned long		ts_tid;
+	unsigned long		ts_fsync_delayed;
+	unsigned long		ts_fsync_joined;
+	u64			ts_fsync_delay_ns;
 	struct transaction_run_stats_s run;
 };
 
@@ -983,6 +992,15 @@ struct journal_s
 	u32			j_min_batch_time;
 	u32			j_max_batch_time;
 
+	/*
+	 * number of tasks waiting in jbd2_log_wait_commit(), the upper bound
+	 * in microseconds for delaying a commit they wait on, and the current
+	 * adaptive delay in nanoseconds [j_fsync_batch_ns: kjournald2 only]
+	 */
+	atomic_t		j_fsync_waiters;
+	u32			j_fsync_batch_us;
+	u64			j_fsync_batch_ns;
+
 	/* This function is called when a transaction is closed */
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
@@ -1236,6 +1254,7 @@ int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
+int jbd2_transaction_committed(journal_t *journal, tid_t tid);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
 extern void __jbd2_journal_drop_transaction(journal_t *, transaction_t *);
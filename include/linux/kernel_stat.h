@@ -35,6 +35,9 @@ struct kernel_stat {
 #endif
 	unsigned long irqs_sum;
 	unsigned int softirqs[NR_SOFTIRQS];
+#ifdef CONFIG_SOFTIRQ_THREADS
+	u64 softirq_time[NR_SOFTIRQS];	/* ns in the action of each vector */
+#endif
 };
 
 DECLARE_PER_CPU(struct kernel_stat, kstat);
@@ -82,6 +85,18 @@ static inline unsigned int kstat_softirqs_cpu(unsigned int irq, int cpu)
        return kstat_cpu(cpu).softirqs[irq];
 }
 
+#ifdef CONFIG_SOFTIRQ_THREADS
+static inline void kstat_add_softirq_time_this_cpu(unsigned int irq, u64 ns)
+{
+	__this_cpu_add(kstat.softirq_time[irq], ns);
+}
+
+static inline u64 kstat_softirq_time_cpu(unsigned int irq, int cpu)
+{
+	return kstat_cpu(cpu).softirq_time[irq];
+}
+#endif
+
 /*
  * Number of interrupts per specific IRQ source, since bootup
  */
@@ -24,6 +24,9 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
 void __ksm_exit(struct mm_struct *mm);
+unsigned long __ksm_vm_flags(struct mm_struct *mm, unsigned long vm_flags);
+int ksm_enable_merge_any(struct mm_struct *mm);
+void ksm_disable_merge_any(struct mm_struct *mm);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
@@ -38,6 +41,18 @@ static inline void ksm_exit(struct mm_struct *mm)
 		__ksm_exit(mm);
 }
 
+/*
+ * The flags of a new anonymous area of @mm: VM_MERGEABLE is added without
+ * madvise when the process was put in merge-any mode, by its memory cgroup.
+ */
+static inline unsigned long ksm_vm_flags(struct mm_struct *mm,
+					 unsigned long vm_flags)
+{
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return __ksm_vm_flags(mm, vm_flags);
+	return vm_flags;
+}
+
 /*
  * A KSM page is one of those write-protected "shared pages" or "merged pages"
  * which KSM maps into multiple mms, wherever identical anonymous page content
@@ -101,6 +116,21 @@ static inline void ksm_exit(struct mm_struct *mm)
 {
 }
 
+static inline unsigned long ksm_vm_flags(struct mm_struct *mm,
+					 unsigned long vm_flags)
+{
+	return vm_flags;
+}
+
+static inline int ksm_enable_merge_any(struct mm_struct *mm)
+{
+	return 0;
+}
+
+static inline void ksm_disable_merge_any(struct mm_struct *mm)
+{
+}
+
 static inline int PageKsm(struct page *page)
 {
 	return 0;
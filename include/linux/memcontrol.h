@@ -152,6 +152,10 @@ static inline void mem_cgroup_dec_page_stat(struct page *page,
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 						gfp_t gfp_mask,
 						unsigned long *total_scanned);
+struct mem_cgroup *mem_cgroup_reclaim_priority_next(struct mem_cgroup *prev,
+						    int *priority,
+						    unsigned int *swappiness);
+void mem_cgroup_reclaim_priority_break(struct mem_cgroup *mem);
 u64 mem_cgroup_get_limit(struct mem_cgroup *mem);
 
 void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx);
@@ -357,6 +361,17 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	return 0;
 }
 
+static inline struct mem_cgroup *
+mem_cgroup_reclaim_priority_next(struct mem_cgroup *prev, int *priority,
+				 unsigned int *swappiness)
+{
+	return NULL;
+}
+
+static inline void mem_cgroup_reclaim_priority_break(struct mem_cgroup *mem)
+{
+}
+
 static inline
 u64 mem_cgroup_get_limit(struct mem_cgroup *mem)
 {
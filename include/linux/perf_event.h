@@ -218,8 +218,9 @@ struct perf_event_attr {
 				precise_ip     :  2, /* skid constraint       */
 				mmap_data      :  1, /* non-exec mmap data    */
 				sample_id_all  :  1, /* sample_type all events */
+				aggregate_stacks: 1, /* count callchains in kernel */
 
-				__reserved_1   : 45;
+				__reserved_1   : 44;
 
 	union {
 		__u32		wakeup_events;	  /* wakeup every n events */
@@ -247,11 +248,35 @@ struct perf_event_attr {
 #define PERF_EVENT_IOC_PERIOD		_IOW('$', 4, __u64)
 #define PERF_EVENT_IOC_SET_OUTPUT	_IO ('$', 5)
 #define PERF_EVENT_IOC_SET_FILTER	_IOW('$', 6, char *)
+#define PERF_EVENT_IOC_READ_STACKS	_IOWR('$', 7, struct perf_stack_read)
 
 enum perf_event_ioc_flags {
 	PERF_IOC_FLAG_GROUP		= 1U << 0,
 };
 
+/*
+ * Argument of PERF_EVENT_IOC_READ_STACKS, which reads and resets the
+ * callchains an attr.aggregate_stacks event counted. buf is filled with
+ * records of
+ *
+ * struct {
+ *	u64	count;		-- samples of this callchain, skip if 0
+ *	u32	pid;
+ *	u32	nr;
+ *	u64	ips[nr];	-- as PERF_SAMPLE_CALLCHAIN
+ * };
+ *
+ * If size is too small for the table, the ioctl fails with ENOSPC and
+ * sets size to what is needed.
+ */
+struct perf_stack_read {
+	__u64	buf;			/* user buffer for the records */
+	__u32	size;			/* in: size of buf, out: bytes of records */
+	__u32	nr_stacks;		/* out: callchains in buf */
+	__u64	samples;		/* out: samples since the last read */
+	__u64	dropped;		/* out: samples which did not fit */
+};
+
 /*
  * Structure of the page that can be mapped via mmap
  */
@@ -856,6 +881,9 @@ struct perf_event {
 
 	perf_overflow_handler_t		overflow_handler;
 
+	/* attr.aggregate_stacks, shared with the inherited events */
+	struct perf_stacks		*stacks;
+
 #ifdef CONFIG_EVENT_TRACING
 	struct ftrace_event_call	*tp_event;
 	struct event_filter		*filter;
@@ -1110,6 +1138,7 @@ static inline void perf_callchain_store(struct perf_callchain_entry *entry, u64
 extern int sysctl_perf_event_paranoid;
 extern int sysctl_perf_event_mlock;
 extern int sysctl_perf_event_sample_rate;
+extern int sysctl_perf_event_stacks;
 
 extern int perf_proc_update_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
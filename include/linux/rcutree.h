@@ -87,4 +87,14 @@ static inline int rcu_blocking_is_gp(void)
 extern void rcu_scheduler_starting(void);
 extern int rcu_scheduler_active __read_mostly;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+extern int rcu_nocb_cpu_set(int cpu, bool offload);
+extern int rcu_is_nocb_cpu(int cpu);
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+static inline int rcu_is_nocb_cpu(int cpu)
+{
+	return 0;
+}
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
+
 #endif /* __LINUX_RCUTREE_H */
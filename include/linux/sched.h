@@ -448,8 +448,11 @@ extern int get_dumpable(struct mm_struct *mm);
 					/* leave room for more dump flags */
 #define MMF_VM_MERGEABLE	16	/* KSM may merge identical pages */
 #define MMF_VM_HUGEPAGE		17	/* set when VM_HUGEPAGE is set on vma */
+#define MMF_VM_MERGE_ANY	18	/* KSM may merge all anonymous areas */
+#define MMF_OOM_REAPED		19	/* the oom reaper freed the memory */
 
-#define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
+#define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK |\
+				 (1 << MMF_VM_MERGE_ANY))
 
 struct sighand_struct {
 	atomic_t		count;
@@ -1109,6 +1112,7 @@ struct sched_class {
 
 #ifdef CONFIG_SMP
 	int  (*select_task_rq)(struct task_struct *p, int sd_flag, int flags);
+	void (*migrate_task_rq)(struct task_struct *p, int next_cpu);
 
 	void (*pre_schedule) (struct rq *this_rq, struct task_struct *task);
 	void (*post_schedule) (struct rq *this_rq);
@@ -1179,6 +1183,20 @@ struct sched_statistics {
 };
 #endif
 
+/*
+ * Per-entity load tracking: the time an entity was runnable, as a sum of
+ * ~1ms (1024us) periods where each period's contribution decays
+ * geometrically by y, with y^32 = 1/2. runnable_avg_period is the same
+ * sum over all time, so runnable_avg_sum / runnable_avg_period is the
+ * entity's recent runnable fraction.
+ */
+struct sched_avg {
+	u32 runnable_avg_sum, runnable_avg_period;
+	u64 last_runnable_update;
+	s64 decay_count;
+	unsigned long load_avg_contrib;
+};
+
 struct sched_entity {
 	struct load_weight	load;		/* for load-balancing */
 	struct rb_node		run_node;
@@ -1191,6 +1209,7 @@ struct sched_entity {
 	u64			prev_sum_exec_runtime;
 
 	u64			nr_migrations;
+	u64			wakeup_start;	/* rq clock at the last wakeup */
 
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
@@ -1203,6 +1222,9 @@ struct sched_entity {
 	/* rq "owned" by this entity/group: */
 	struct cfs_rq		*my_q;
 #endif
+#if defined(CONFIG_SMP) && defined(CONFIG_FAIR_GROUP_SCHED)
+	struct sched_avg	avg;
+#endif
 };
 
 struct sched_rt_entity {
@@ -1580,6 +1602,10 @@ struct task_struct {
 		unsigned long memsw_nr_pages; /* uncharged mem+swap usage */
 	} memcg_batch;
 #endif
+#ifdef CONFIG_MMU
+	struct task_struct *oom_reaper_list;	/* next task to reap */
+	ktime_t oom_reaper_queued;	/* when queued to be reaped, else 0 */
+#endif
 #ifdef CONFIG_HAVE_HW_BREAKPOINT
 	atomic_t ptrace_bp_refcnt;
 #endif
@@ -1976,6 +2002,28 @@ extern void wake_up_idle_cpu(int cpu);
 static inline void wake_up_idle_cpu(int cpu) { }
 #endif
 
+#ifdef CONFIG_NO_HZ_ADAPTIVE
+extern int sched_can_stop_tick(void);
+#endif
+
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+extern unsigned long task_get_effective_timer_slack(struct task_struct *tsk);
+extern int task_timer_slack_raised(struct task_struct *tsk);
+extern void timer_slack_account_wakeup(struct task_struct *tsk, int saved);
+#else
+static inline unsigned long task_get_effective_timer_slack(
+		struct task_struct *tsk)
+{
+	return tsk->timer_slack_ns;
+}
+static inline int task_timer_slack_raised(struct task_struct *tsk)
+{
+	return 0;
+}
+static inline void timer_slack_account_wakeup(struct task_struct *tsk,
+					      int saved) { }
+#endif
+
 extern unsigned int sysctl_sched_latency;
 extern unsigned int sysctl_sched_min_granularity;
 extern unsigned int sysctl_sched_wakeup_granularity;
@@ -2619,6 +2667,8 @@ extern void sched_move_task(struct task_struct *tsk);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 extern unsigned long sched_group_shares(struct task_group *tg);
+extern const char *sched_task_group_name(struct task_struct *p);
+extern unsigned int sched_task_latency_class(struct task_struct *p);
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 extern int sched_group_set_rt_runtime(struct task_group *tg,
@@ -2631,6 +2681,26 @@ extern int sched_rt_can_attach(struct task_group *tg, struct task_struct *tsk);
 #endif
 #endif
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * Minimum cpu frequency, in kHz, asked for by the cpu cgroup of the task
+ * running on @cpu. A cpufreq governor can register a callback that is
+ * invoked on the cpu itself, from the context switch without the rq lock
+ * but with preemption disabled, when a task with a hint is switched in.
+ */
+extern unsigned int sched_min_freq_hint(int cpu);
+extern void sched_set_freq_hint_notifier(void (*fn)(int cpu, unsigned int freq));
+#else
+static inline unsigned int sched_min_freq_hint(int cpu)
+{
+	return 0;
+}
+static inline void
+sched_set_freq_hint_notifier(void (*fn)(int cpu, unsigned int freq))
+{
+}
+#endif
+
 extern int task_can_switch_user(struct user_struct *up,
 					struct task_struct *tsk);
 
@@ -45,6 +45,13 @@ enum tick_nohz_mode {
  * @iowait_sleeptime:	Sum of the time slept in idle with sched tick stopped, with IO outstanding
  * @sleep_length:	Duration of the current idle sleep
  * @do_timer_lst:	CPU was the last one doing do_timer before going idle
+ * @nr_ticks:		Number of sched ticks handled
+ * @adaptive_stopped:	The tick is deferred while a single task runs
+ * @adaptive_user:	The task was in user mode when the tick was deferred
+ * @adaptive_tick:	Last tick expiry before the tick was deferred
+ * @adaptive_jiffies:	jiffies when the tick was deferred, for accounting
+ * @adaptive_stops:	Number of times the tick was deferred
+ * @adaptive_ticks_avoided: Ticks not taken while deferred
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -67,6 +74,15 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+	unsigned long			nr_ticks;
+#ifdef CONFIG_NO_HZ_ADAPTIVE
+	int				adaptive_stopped;
+	int				adaptive_user;
+	ktime_t				adaptive_tick;
+	unsigned long			adaptive_jiffies;
+	unsigned long			adaptive_stops;
+	unsigned long			adaptive_ticks_avoided;
+#endif
 };
 
 extern void __init tick_init(void);
@@ -139,4 +155,16 @@ static inline u64 get_cpu_idle_time_us(int cpu, u64 *unused) { return -1; }
 static inline u64 get_cpu_iowait_time_us(int cpu, u64 *unused) { return -1; }
 # endif /* !NO_HZ */
 
+# ifdef CONFIG_NO_HZ_ADAPTIVE
+extern int tick_nohz_adaptive_cpu(int cpu);
+extern int tick_nohz_adaptive_pending(void);
+extern void tick_nohz_adaptive_exit(void);
+extern void tick_nohz_adaptive_kick(int cpu);
+# else
+static inline int tick_nohz_adaptive_cpu(int cpu) { return 0; }
+static inline int tick_nohz_adaptive_pending(void) { return 0; }
+static inline void tick_nohz_adaptive_exit(void) { }
+static inline void tick_nohz_adaptive_kick(int cpu) { }
+# endif /* !NO_HZ_ADAPTIVE */
+
 #endif
@@ -237,6 +237,7 @@ extern unsigned long get_next_timer_interrupt(unsigned long now);
 extern int timer_stats_active;
 
 #define TIMER_STATS_FLAG_DEFERRABLE	0x1
+#define TIMER_STATS_FLAG_SAVED		0x2
 
 extern void init_timer_stats(void);
 
@@ -258,6 +259,15 @@ static inline void timer_stats_timer_clear_start_info(struct timer_list *timer)
 {
 	timer->start_site = NULL;
 }
+
+struct seq_file;
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+extern void timer_slack_stats_start(void);
+extern void timer_slack_stats_show(struct seq_file *m);
+#else
+static inline void timer_slack_stats_start(void) { }
+static inline void timer_slack_stats_show(struct seq_file *m) { }
+#endif
 #else
 static inline void init_timer_stats(void)
 {
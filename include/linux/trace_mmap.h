@@ -0,0 +1,43 @@
+#ifndef _LINUX_TRACE_MMAP_H
+#define _LINUX_TRACE_MMAP_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * Memory mapped consumer of a per cpu ftrace ring buffer, see
+ * per_cpu/cpuN/trace_pipe_raw in Documentation/trace/ftrace.txt.
+ *
+ * The first page of the mapping is a struct trace_buffer_meta, it is
+ * followed by the nr_subbufs sub-buffers of the ring, in the layout of
+ * events/header_page. The mapping is read only: the reader asks the
+ * kernel for its next sub-buffer with TRACE_MMAP_IOCTL_GET_READER.
+ */
+struct trace_buffer_meta {
+	__u32	meta_page_size;		/* size of this page */
+	__u32	meta_struct_len;	/* size of this structure */
+
+	__u32	subbuf_size;		/* size of a sub-buffer, with its header */
+	__u32	nr_subbufs;		/* sub-buffers after this page */
+
+	struct {
+		__u64	lost_events;	/* overwritten before this sub-buffer */
+		__u32	id;		/* sub-buffer owned by the reader */
+		__u32	read;		/* bytes of it consumed before */
+	} reader;
+
+	__u64	entries;		/* events written */
+	__u64	overrun;		/* events overwritten */
+	__u64	read;			/* events consumed */
+	__u64	dropped;		/* events not written, buffer full */
+};
+
+/*
+ * Consume the events committed to the reader sub-buffer so far or, when
+ * there are none left, swap in the next sub-buffer; then update the meta
+ * page. After every call the reader must process the reader sub-buffer
+ * up to its commit: the events the kernel consumed are not kept for it.
+ */
+#define TRACE_MMAP_IOCTL_GET_READER	_IO(0xB4, 0x1)
+
+#endif /* _LINUX_TRACE_MMAP_H */
@@ -38,7 +38,14 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
-		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS, COMPACTSTALL_US,
+		KCOMPACTD_WAKE, KCOMPACTD_MIGRATED,
+#endif
+#ifdef CONFIG_PROCESS_RECLAIM
+		PROCRECLAIM_SCANNED, PROCRECLAIM_RECLAIMED, PROCRECLAIM_US,
+#endif
+#ifdef CONFIG_MMU
+		OOM_REAP_TASKS, OOM_REAP_PAGES, OOM_REAP_US,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -0,0 +1,74 @@
+#ifndef __LINUX_VMPRESSURE_H
+#define __LINUX_VMPRESSURE_H
+
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
+#include <linux/gfp.h>
+#include <linux/types.h>
+#include <linux/cgroup.h>
+
+enum vmpressure_levels {
+	VMPRESSURE_LOW = 0,
+	VMPRESSURE_MEDIUM,
+	VMPRESSURE_CRITICAL,
+	VMPRESSURE_NUM_LEVELS,
+};
+
+struct vmpressure {
+	/* pages scanned and reclaimed in the current window */
+	unsigned long scanned;
+	unsigned long reclaimed;
+	/* protects scanned and reclaimed */
+	spinlock_t sr_lock;
+
+	/* level of the last window, and when it ended, for hysteresis */
+	enum vmpressure_levels level;
+	unsigned long level_stamp;
+	/* windows evaluated at each level */
+	unsigned long nr_windows[VMPRESSURE_NUM_LEVELS];
+
+	/* the eventfds listening for this group */
+	struct list_head events;
+	/* protects events, level and nr_windows */
+	struct mutex events_lock;
+
+	struct work_struct work;
+};
+
+struct mem_cgroup;
+
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+extern void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
+		       unsigned long scanned, unsigned long reclaimed);
+extern void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio);
+
+extern void vmpressure_init(struct vmpressure *vmpr);
+extern void vmpressure_cleanup(struct vmpressure *vmpr);
+
+/* provided by the memory controller */
+extern struct vmpressure *memcg_to_vmpressure(struct mem_cgroup *memcg);
+extern struct vmpressure *cgroup_to_vmpressure(struct cgroup *cgrp);
+extern struct vmpressure *vmpressure_parent(struct vmpressure *vmpr);
+
+extern int vmpressure_register_event(struct cgroup *cgrp, struct cftype *cft,
+				     struct eventfd_ctx *eventfd,
+				     const char *args);
+extern void vmpressure_unregister_event(struct cgroup *cgrp,
+					struct cftype *cft,
+					struct eventfd_ctx *eventfd);
+extern int vmpressure_read(struct cgroup *cgrp, struct cftype *cft,
+			   struct cgroup_map_cb *cb);
+#else
+static inline void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
+			      unsigned long scanned, unsigned long reclaimed)
+{
+}
+
+static inline void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg,
+				   int prio)
+{
+}
+#endif /* CONFIG_CGROUP_MEM_RES_CTLR */
+#endif /* __LINUX_VMPRESSURE_H */
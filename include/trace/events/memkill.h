@@ -125,6 +125,34 @@ TRACE_EVENT(lmk_kill,
 				__entry->cached, __entry->freeswap)
 );
 
+TRACE_EVENT(oom_reap,
+		TP_PROTO(pid_t pid_nr, const char *comm,
+			unsigned long pages, unsigned int latency_us,
+			unsigned int reap_us),
+
+		TP_ARGS(pid_nr, comm, pages, latency_us, reap_us),
+
+		TP_STRUCT__entry(
+			__field(	pid_t,		pid_nr		)
+			__array(	char,		comm,	TASK_COMM_LEN)
+			__field(	unsigned long,	pages		)
+			__field(	unsigned int,	latency_us	)
+			__field(	unsigned int,	reap_us		)
+		),
+
+		TP_fast_assign(
+			__entry->pid_nr = pid_nr;
+			strncpy(__entry->comm, comm, TASK_COMM_LEN);
+			__entry->pages = pages;
+			__entry->latency_us = latency_us;
+			__entry->reap_us = reap_us;
+		),
+
+		TP_printk("%d %s %lu %u %u", __entry->pid_nr, __entry->comm,
+				__entry->pages, __entry->latency_us,
+				__entry->reap_us)
+);
+
 #endif /* _TRACE_MEMKILL_H */
 
 /* This part must be outside protection */
@@ -362,6 +362,43 @@ TRACE_EVENT(sched_stat_runtime,
 			(unsigned long long)__entry->vruntime)
 );
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * Tracepoint for the time from a task's wakeup until it runs, with the
+ * cpu cgroup and its latency class:
+ */
+TRACE_EVENT(sched_wakeup_latency,
+
+	TP_PROTO(struct task_struct *tsk, u64 delay),
+
+	TP_ARGS(tsk, delay),
+
+	TP_STRUCT__entry(
+		__array( char,	comm,	TASK_COMM_LEN	)
+		__field( pid_t,	pid			)
+		__field( u64,	delay			)
+		__field( unsigned int,	latency_class	)
+		__string( group, sched_task_group_name(tsk)	)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, tsk->comm, TASK_COMM_LEN);
+		__entry->pid		= tsk->pid;
+		__entry->delay		= delay;
+		__entry->latency_class	= sched_task_latency_class(tsk);
+		__assign_str(group, sched_task_group_name(tsk));
+	)
+	TP_perf_assign(
+		__perf_count(delay);
+	),
+
+	TP_printk("comm=%s pid=%d group=%s class=%u delay=%Lu [ns]",
+			__entry->comm, __entry->pid, __get_str(group),
+			__entry->latency_class,
+			(unsigned long long)__entry->delay)
+);
+#endif
+
 /*
  * Tracepoint for showing priority inheritance modifying a tasks
  * priority.
@@ -115,6 +115,107 @@ DEFINE_EVENT(workqueue_work, workqueue_execute_end,
 	TP_ARGS(work)
 );
 
+/**
+ * workqueue_work_latency - called after the workqueue callback returned
+ * @function:	the callback
+ * @cpu:	the cpu of the worker pool, WORK_CPU_UNBOUND for unbound
+ * @delay:	ns from queueing to the start of the execution
+ * @runtime:	ns the callback ran
+ *
+ * Only available with CONFIG_WQ_STATS.
+ */
+TRACE_EVENT(workqueue_work_latency,
+
+	TP_PROTO(work_func_t function, unsigned int cpu, u64 delay,
+		 u64 runtime),
+
+	TP_ARGS(function, cpu, delay, runtime),
+
+	TP_STRUCT__entry(
+		__field( void *,	function)
+		__field( unsigned int,	cpu	)
+		__field( u64,		delay	)
+		__field( u64,		runtime	)
+	),
+
+	TP_fast_assign(
+		__entry->function	= function;
+		__entry->cpu		= cpu;
+		__entry->delay		= delay;
+		__entry->runtime	= runtime;
+	),
+
+	TP_printk("function=%pf cpu=%u delay=%llu runtime=%llu [ns]",
+		  __entry->function, __entry->cpu,
+		  (unsigned long long)__entry->delay,
+		  (unsigned long long)__entry->runtime)
+);
+
+/**
+ * workqueue_mayday - called when a rescuer is summoned
+ * @cwq:	pointer to struct cpu_workqueue_struct needing rescue
+ *
+ * This event occurs when the worker pool of a cpu can not create a
+ * new worker in time and wakes the rescuer of a workqueue with works
+ * pending on it.
+ */
+TRACE_EVENT(workqueue_mayday,
+
+	TP_PROTO(struct cpu_workqueue_struct *cwq),
+
+	TP_ARGS(cwq),
+
+	TP_STRUCT__entry(
+		__string( name,		cwq->wq->name	)
+		__field( unsigned int,	cpu		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, cwq->wq->name);
+		__entry->cpu		= cwq->gcwq->cpu;
+	),
+
+	TP_printk("workqueue=%s cpu=%u", __get_str(name), __entry->cpu)
+);
+
+/**
+ * workqueue_stall - called when a worker pool stopped making progress
+ * @cpu:	the cpu of the worker pool, WORK_CPU_UNBOUND for unbound
+ * @function:	callback of the first pending work
+ * @stalled:	ms since the pool last started a work
+ * @nr_running:	concurrency of the pool
+ * @nr_idle:	idle workers of the pool
+ *
+ * Only available with CONFIG_WQ_STATS.
+ */
+TRACE_EVENT(workqueue_stall,
+
+	TP_PROTO(unsigned int cpu, work_func_t function, unsigned int stalled,
+		 int nr_running, int nr_idle),
+
+	TP_ARGS(cpu, function, stalled, nr_running, nr_idle),
+
+	TP_STRUCT__entry(
+		__field( unsigned int,	cpu		)
+		__field( void *,	function	)
+		__field( unsigned int,	stalled		)
+		__field( int,		nr_running	)
+		__field( int,		nr_idle		)
+	),
+
+	TP_fast_assign(
+		__entry->cpu		= cpu;
+		__entry->function	= function;
+		__entry->stalled	= stalled;
+		__entry->nr_running	= nr_running;
+		__entry->nr_idle	= nr_idle;
+	),
+
+	TP_printk("cpu=%u first pending %pf stalled=%u ms nr_running=%d nr_idle=%d",
+		  __entry->cpu, __entry->function, __entry->stalled,
+		  __entry->nr_running, __entry->nr_idle)
+);
+
 #endif /*  _TRACE_WORKQUEUE_H */
 
 /* This part must be outside protection */
@@ -0,0 +1,292 @@
+/*
+ * cgroup_timer_slack.c - control group timer slack subsystem
+ *
+ * The timer slack of a task is raised to the min_slack_ns of its group
+ * for the timeouts of nanosleep, select, poll, epoll and futexes. With a
+ * large slack for the group of background applications their timers are
+ * expired together with the ones which have to run anyway, instead of
+ * each waking a cpu up from a deep idle state on its own.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/hrtimer.h>
+#include <linux/limits.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+
+struct timer_slack_stat {
+	unsigned long		wakeups;	/* timeouts which woke a task */
+	unsigned long		saved;		/* of them, run on another's wakeup */
+};
+
+struct timer_slack_cgroup {
+	struct cgroup_subsys_state	css;
+	unsigned long			min_slack_ns;
+	struct timer_slack_stat __percpu *stat;
+	/* timer_stats baseline, see timer_slack_stats_start() */
+	struct timer_slack_stat		base;
+	struct list_head		list;
+};
+
+/* All groups, for timer_stats; protected by timer_slack_mutex */
+static LIST_HEAD(timer_slack_groups);
+static DEFINE_MUTEX(timer_slack_mutex);
+
+static inline struct timer_slack_cgroup *cgroup_timer_slack(
+		struct cgroup *cgroup)
+{
+	return container_of(
+		cgroup_subsys_state(cgroup, timer_slack_subsys_id),
+		struct timer_slack_cgroup, css);
+}
+
+static inline struct timer_slack_cgroup *task_timer_slack(
+		struct task_struct *task)
+{
+	return container_of(task_subsys_state(task, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+/**
+ * task_get_effective_timer_slack - timer slack of a task
+ * @tsk: the task
+ *
+ * Returns the larger of the timer slack of @tsk and the minimum slack of
+ * its timer_slack group.
+ */
+unsigned long task_get_effective_timer_slack(struct task_struct *tsk)
+{
+	unsigned long slack;
+
+	rcu_read_lock();
+	slack = max(tsk->timer_slack_ns, task_timer_slack(tsk)->min_slack_ns);
+	rcu_read_unlock();
+
+	return slack;
+}
+
+/**
+ * task_timer_slack_raised - does the group set the timer slack of a task
+ * @tsk: the task
+ *
+ * True when the minimum slack of the timer_slack group of @tsk is above
+ * the slack of @tsk itself.
+ */
+int task_timer_slack_raised(struct task_struct *tsk)
+{
+	int ret;
+
+	rcu_read_lock();
+	ret = task_timer_slack(tsk)->min_slack_ns > tsk->timer_slack_ns;
+	rcu_read_unlock();
+
+	return ret;
+}
+
+/**
+ * timer_slack_account_wakeup - account a timeout which woke a task
+ * @tsk: the task woken by the expiry of its sleep timer
+ * @saved: the timer was run from the interrupt of another timer
+ *
+ * Called from hard interrupt context.
+ */
+void timer_slack_account_wakeup(struct task_struct *tsk, int saved)
+{
+	struct timer_slack_cgroup *tslack;
+
+	rcu_read_lock();
+	tslack = task_timer_slack(tsk);
+	this_cpu_inc(tslack->stat->wakeups);
+	if (saved)
+		this_cpu_inc(tslack->stat->saved);
+	rcu_read_unlock();
+}
+
+static void timer_slack_read_stat(struct timer_slack_cgroup *tslack,
+				  struct timer_slack_stat *sum)
+{
+	int cpu;
+
+	sum->wakeups = sum->saved = 0;
+	for_each_possible_cpu(cpu) {
+		struct timer_slack_stat *stat = per_cpu_ptr(tslack->stat, cpu);
+
+		sum->wakeups += stat->wakeups;
+		sum->saved += stat->saved;
+	}
+}
+
+#ifdef CONFIG_TIMER_STATS
+/*
+ * Called when timer_stats starts collecting: the per group counters which
+ * /proc/timer_stats shows are relative to this point.
+ */
+void timer_slack_stats_start(void)
+{
+	struct timer_slack_cgroup *tslack;
+
+	mutex_lock(&timer_slack_mutex);
+	list_for_each_entry(tslack, &timer_slack_groups, list)
+		timer_slack_read_stat(tslack, &tslack->base);
+	mutex_unlock(&timer_slack_mutex);
+}
+
+void timer_slack_stats_show(struct seq_file *m)
+{
+	struct timer_slack_cgroup *tslack;
+	struct timer_slack_stat sum;
+	char *path;
+
+	path = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!path)
+		return;
+
+	seq_puts(m, "Timer slack groups:\n");
+	mutex_lock(&timer_slack_mutex);
+	list_for_each_entry(tslack, &timer_slack_groups, list) {
+		timer_slack_read_stat(tslack, &sum);
+		rcu_read_lock();
+		if (cgroup_path(tslack->css.cgroup, path, PATH_MAX))
+			strcpy(path, "?");
+		rcu_read_unlock();
+		seq_printf(m, "%8lu wakeups, %8lu saved, slack %8lu ns %s\n",
+			   sum.wakeups - tslack->base.wakeups,
+			   sum.saved - tslack->base.saved,
+			   tslack->min_slack_ns, path);
+	}
+	mutex_unlock(&timer_slack_mutex);
+
+	kfree(path);
+}
+#endif /* CONFIG_TIMER_STATS */
+
+static struct cgroup_subsys_state *timer_slack_create(
+		struct cgroup_subsys *ss, struct cgroup *cgroup)
+{
+	struct timer_slack_cgroup *tslack;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	tslack->stat = alloc_percpu(struct timer_slack_stat);
+	if (!tslack->stat) {
+		kfree(tslack);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	if (cgroup->parent)
+		tslack->min_slack_ns =
+			cgroup_timer_slack(cgroup->parent)->min_slack_ns;
+
+	mutex_lock(&timer_slack_mutex);
+	list_add_tail(&tslack->list, &timer_slack_groups);
+	mutex_unlock(&timer_slack_mutex);
+
+	return &tslack->css;
+}
+
+static void timer_slack_destroy(struct cgroup_subsys *ss,
+				struct cgroup *cgroup)
+{
+	struct timer_slack_cgroup *tslack = cgroup_timer_slack(cgroup);
+
+	mutex_lock(&timer_slack_mutex);
+	list_del(&tslack->list);
+	mutex_unlock(&timer_slack_mutex);
+
+	free_percpu(tslack->stat);
+	kfree(tslack);
+}
+
+static u64 timer_slack_read(struct cgroup *cgroup, struct cftype *cft)
+{
+	return cgroup_timer_slack(cgroup)->min_slack_ns;
+}
+
+/* Raise the slack of the groups below @cgroup to at least @val */
+static void timer_slack_propagate(struct cgroup *cgroup, unsigned long val)
+{
+	struct cgroup *child;
+
+	list_for_each_entry(child, &cgroup->children, sibling) {
+		struct timer_slack_cgroup *tslack = cgroup_timer_slack(child);
+
+		if (tslack->min_slack_ns < val)
+			tslack->min_slack_ns = val;
+		timer_slack_propagate(child, val);
+	}
+}
+
+/*
+ * The slack of a group can not be below the one of its parent, raising
+ * it raises the one of the groups below.
+ */
+static int timer_slack_write(struct cgroup *cgroup, struct cftype *cft,
+			     u64 val)
+{
+	int ret = 0;
+
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	if (!cgroup_lock_live_group(cgroup))
+		return -ENODEV;
+
+	if (cgroup->parent &&
+	    val < cgroup_timer_slack(cgroup->parent)->min_slack_ns) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	cgroup_timer_slack(cgroup)->min_slack_ns = val;
+	timer_slack_propagate(cgroup, val);
+out:
+	cgroup_unlock();
+	return ret;
+}
+
+static int timer_slack_stat_show(struct cgroup *cgroup, struct cftype *cft,
+				 struct cgroup_map_cb *cb)
+{
+	struct timer_slack_stat sum;
+
+	timer_slack_read_stat(cgroup_timer_slack(cgroup), &sum);
+	cb->fill(cb, "wakeups", sum.wakeups);
+	cb->fill(cb, "saved", sum.saved);
+	return 0;
+}
+
+static struct cftype files[] = {
+	{
+		.name = "min_slack_ns",
+		.read_u64 = timer_slack_read,
+		.write_u64 = timer_slack_write,
+	},
+	{
+		.name = "stat",
+		.read_map = timer_slack_stat_show,
+	},
+};
+
+static int timer_slack_populate(struct cgroup_subsys *ss,
+				struct cgroup *cgroup)
+{
+	return cgroup_add_files(cgroup, ss, files, ARRAY_SIZE(files));
+}
+
+struct cgroup_subsys timer_slack_subsys = {
+	.name		= "timer_slack",
+	.create		= timer_slack_create,
+	.destroy	= timer_slack_destroy,
+	.populate	= timer_slack_populate,
+	.subsys_id	= timer_slack_subsys_id,
+};
@@ -18,6 +18,7 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/hash.h>
+#include <linux/jhash.h>
 #include <linux/sysfs.h>
 #include <linux/dcache.h>
 #include <linux/percpu.h>
@@ -2891,6 +2892,7 @@ static void free_event_rcu(struct rcu_head *head)
 }
 
 static void perf_buffer_put(struct perf_buffer *buffer);
+static void perf_stacks_free(struct perf_stacks *stacks);
 
 static void free_event(struct perf_event *event)
 {
@@ -2907,6 +2909,8 @@ static void free_event(struct perf_event *event)
 			atomic_dec(&nr_task_events);
 		if (event->attr.sample_type & PERF_SAMPLE_CALLCHAIN)
 			put_callchain_buffers();
+		if (event->stacks)
+			perf_stacks_free(event->stacks);
 		if (is_cgroup_event(event)) {
 			atomic_dec(&per_cpu(perf_cgroup_events, event->cpu));
 			jump_label_dec(&perf_sched_events);
@@ -3261,6 +3265,8 @@ static struct perf_event *perf_fget_light(int fd, int *fput_needed)
 static int perf_event_set_output(struct perf_event *event,
 				 struct perf_event *output_event);
 static int perf_event_set_filter(struct perf_event *event, void __user *arg);
+static int perf_event_read_stacks(struct perf_event *event,
+				  struct perf_stack_read __user *uread);
 
 static long perf_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
@@ -3307,6 +3313,9 @@ static long perf_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case PERF_EVENT_IOC_SET_FILTER:
 		return perf_event_set_filter(event, (void __user *)arg);
 
+	case PERF_EVENT_IOC_READ_STACKS:
+		return perf_event_read_stacks(event, (void __user *)arg);
+
 	default:
 		return -ENOTTY;
 	}
@@ -4409,6 +4418,260 @@ exit:
 	rcu_read_unlock();
 }
 
+/*
+ * In-kernel callchain aggregation, attr.aggregate_stacks:
+ *
+ * Instead of writing a sample record per overflow, the callchain of the
+ * sample is counted in a hash table of (pid, callchain) to count, and user
+ * space periodically reads and resets the table with
+ * PERF_EVENT_IOC_READ_STACKS. A profiler which only needs the hot stacks
+ * so costs one hash lookup per sample, not a record and a wakeup.
+ *
+ * The event and its inherited children share two tables of
+ * sysctl_perf_event_stacks kiB together: the handler adds to the active
+ * one, the reader swaps them, waits for the handlers still using the old
+ * table and copies it out. Entries are allocated from an arena and are
+ * never freed until the reset; a sample which finds the arena or its
+ * probe sequence full is counted as dropped.
+ */
+int sysctl_perf_event_stacks __read_mostly = 512; /* kiB per event */
+
+#define PERF_STACKS_BUCKET_BYTES	64	/* arena bytes per bucket */
+#define PERF_STACKS_MAX_PROBE		16
+
+struct perf_stack_entry {
+	atomic64_t		count;
+	u32			pid;
+	u32			nr;
+	u64			ip[0];
+};
+
+struct perf_stack_table {
+	u32			*buckets;	/* arena offset + 1, or 0 */
+	unsigned int		nr_buckets;
+	void			*arena;
+	unsigned int		arena_size;
+	atomic_t		used;
+	atomic_long_t		samples;
+	atomic_long_t		dropped;
+};
+
+struct perf_stacks {
+	struct perf_stack_table __rcu	*active;
+	struct perf_stack_table		*spare;
+	struct mutex			mutex;	/* serializes readers */
+	void				*mem;
+	struct perf_stack_table		tables[2];
+};
+
+static struct perf_stacks *perf_stacks_alloc(void)
+{
+	unsigned long size = (unsigned long)sysctl_perf_event_stacks << 10;
+	unsigned long half = size / 2;
+	struct perf_stacks *stacks;
+	unsigned int nr_buckets;
+	void *mem;
+	int i;
+
+	if (half < 2 * PERF_STACKS_BUCKET_BYTES)
+		return ERR_PTR(-EINVAL);
+	nr_buckets = rounddown_pow_of_two(half / PERF_STACKS_BUCKET_BYTES);
+
+	stacks = kzalloc(sizeof(*stacks), GFP_KERNEL);
+	if (!stacks)
+		return ERR_PTR(-ENOMEM);
+
+	mem = vzalloc(size);
+	if (!mem) {
+		kfree(stacks);
+		return ERR_PTR(-ENOMEM);
+	}
+	/* the tables are written from NMI context, which must not fault */
+	vmalloc_sync_all();
+
+	stacks->mem = mem;
+	for (i = 0; i < 2; i++) {
+		struct perf_stack_table *t = &stacks->tables[i];
+
+		t->buckets = mem + i * half;
+		t->nr_buckets = nr_buckets;
+		t->arena = t->buckets + nr_buckets;
+		t->arena_size = half - nr_buckets * sizeof(u32);
+	}
+	mutex_init(&stacks->mutex);
+	RCU_INIT_POINTER(stacks->active, &stacks->tables[0]);
+	stacks->spare = &stacks->tables[1];
+
+	return stacks;
+}
+
+static void perf_stacks_free(struct perf_stacks *stacks)
+{
+	/* wait for the handlers still adding to the tables */
+	synchronize_sched();
+	vfree(stacks->mem);
+	kfree(stacks);
+}
+
+static void perf_stack_table_reset(struct perf_stack_table *t)
+{
+	memset(t->buckets, 0, t->nr_buckets * sizeof(u32));
+	atomic_set(&t->used, 0);
+	atomic_long_set(&t->samples, 0);
+	atomic_long_set(&t->dropped, 0);
+}
+
+static inline bool perf_stack_match(struct perf_stack_entry *e, u32 pid,
+				    struct perf_callchain_entry *chain)
+{
+	return e->pid == pid && e->nr == chain->nr &&
+	       !memcmp(e->ip, chain->ip, chain->nr * sizeof(u64));
+}
+
+/* Carve an entry out of the arena, without ever going past its end */
+static struct perf_stack_entry *
+perf_stack_new(struct perf_stack_table *t, u32 pid,
+	       struct perf_callchain_entry *chain, u32 *off)
+{
+	unsigned int size = sizeof(struct perf_stack_entry) +
+			    chain->nr * sizeof(u64);
+	struct perf_stack_entry *e;
+	int used, old;
+
+	used = atomic_read(&t->used);
+	do {
+		if (used + size > t->arena_size)
+			return NULL;
+		old = used;
+		used = atomic_cmpxchg(&t->used, old, old + size);
+	} while (used != old);
+
+	e = t->arena + used;
+	atomic64_set(&e->count, 1);
+	e->pid = pid;
+	e->nr = chain->nr;
+	memcpy(e->ip, chain->ip, chain->nr * sizeof(u64));
+	*off = used + 1;
+
+	return e;
+}
+
+static void perf_stack_add(struct perf_stack_table *t, u32 pid,
+			   struct perf_callchain_entry *chain)
+{
+	u32 hash = jhash2((u32 *)chain->ip, chain->nr * 2, pid);
+	struct perf_stack_entry *e, *new = NULL;
+	u32 *slot, off, new_off = 0;
+	int i;
+
+	atomic_long_inc(&t->samples);
+
+	for (i = 0; i < PERF_STACKS_MAX_PROBE; i++) {
+		slot = &t->buckets[(hash + i) & (t->nr_buckets - 1)];
+		off = ACCESS_ONCE(*slot);
+		if (!off) {
+			if (!new) {
+				new = perf_stack_new(t, pid, chain, &new_off);
+				if (!new)
+					break;
+			}
+			off = cmpxchg(slot, 0, new_off);
+			if (!off)
+				return;
+			/* somebody else took the slot, it may be our stack */
+		}
+		e = t->arena + off - 1;
+		if (perf_stack_match(e, pid, chain)) {
+			atomic64_inc(&e->count);
+			if (new)
+				atomic64_set(&new->count, 0);
+			return;
+		}
+	}
+
+	/* an entry we could not publish is skipped by the reader */
+	if (new)
+		atomic64_set(&new->count, 0);
+	atomic_long_inc(&t->dropped);
+}
+
+static void perf_stacks_overflow(struct perf_event *event, int nmi,
+				 struct perf_sample_data *data,
+				 struct pt_regs *regs)
+{
+	struct perf_callchain_entry *chain;
+	struct perf_stack_table *t;
+
+	/* protect the callchain buffers */
+	rcu_read_lock();
+
+	t = rcu_dereference_sched(event->stacks->active);
+	chain = perf_callchain(regs);
+	if (chain && chain->nr)
+		perf_stack_add(t, perf_event_pid(event, current), chain);
+	else
+		atomic_long_inc(&t->dropped);
+
+	rcu_read_unlock();
+}
+
+static int perf_event_read_stacks(struct perf_event *event,
+				  struct perf_stack_read __user *uread)
+{
+	struct perf_stacks *stacks = event->stacks;
+	struct perf_stack_table *t;
+	struct perf_stack_read read;
+	unsigned int used, off;
+	int ret = 0;
+
+	if (!stacks)
+		return -EINVAL;
+	if (copy_from_user(&read, uread, sizeof(read)))
+		return -EFAULT;
+
+	mutex_lock(&stacks->mutex);
+
+	t = stacks->spare;
+	if (read.size < t->arena_size) {
+		read.size = t->arena_size;
+		ret = -ENOSPC;
+		goto out;
+	}
+
+	/* switch the handlers to the spare table and wait for them */
+	stacks->spare = rcu_dereference_protected(stacks->active,
+					lockdep_is_held(&stacks->mutex));
+	rcu_assign_pointer(stacks->active, t);
+	synchronize_sched();
+	t = stacks->spare;
+
+	used = atomic_read(&t->used);
+	read.nr_stacks = 0;
+	for (off = 0; off < used; ) {
+		struct perf_stack_entry *e = t->arena + off;
+
+		if (atomic64_read(&e->count))
+			read.nr_stacks++;
+		off += sizeof(*e) + e->nr * sizeof(u64);
+	}
+	read.size = used;
+	read.samples = atomic_long_read(&t->samples);
+	read.dropped = atomic_long_read(&t->dropped);
+
+	if (copy_to_user((void __user *)(unsigned long)read.buf, t->arena,
+			 used))
+		ret = -EFAULT;
+
+	perf_stack_table_reset(t);
+out:
+	mutex_unlock(&stacks->mutex);
+
+	if (copy_to_user(uread, &read, sizeof(read)))
+		ret = -EFAULT;
+
+	return ret;
+}
+
 /*
  * read event_id
  */
@@ -6208,6 +6471,19 @@ perf_event_alloc(struct perf_event_attr *attr, int cpu,
 	if (!overflow_handler && parent_event)
 		overflow_handler = parent_event->overflow_handler;
 
+	if (parent_event) {
+		event->stacks = parent_event->stacks;
+	} else if (attr->aggregate_stacks && !overflow_handler) {
+		event->stacks = perf_stacks_alloc();
+		if (IS_ERR(event->stacks)) {
+			err = PTR_ERR(event->stacks);
+			put_pid_ns(event->ns);
+			kfree(event);
+			return ERR_PTR(err);
+		}
+		overflow_handler = perf_stacks_overflow;
+	}
+
 	event->overflow_handler	= overflow_handler;
 
 	if (attr->disabled)
@@ -6239,6 +6515,8 @@ done:
 		err = PTR_ERR(pmu);
 
 	if (err) {
+		if (event->stacks && !event->parent)
+			perf_stacks_free(event->stacks);
 		if (event->ns)
 			put_pid_ns(event->ns);
 		kfree(event);
@@ -6333,6 +6611,11 @@ static int perf_copy_attr(struct perf_event_attr __user *uattr,
 	if (attr->__reserved_1)
 		return -EINVAL;
 
+	/* the stacks are the callchains of the samples */
+	if (attr->aggregate_stacks &&
+	    !(attr->sample_type & PERF_SAMPLE_CALLCHAIN))
+		return -EINVAL;
+
 	if (attr->sample_type & ~(PERF_SAMPLE_MAX-1))
 		return -EINVAL;
 
@@ -45,6 +45,7 @@
 #include <linux/debugobjects.h>
 #include <linux/sched.h>
 #include <linux/timer.h>
+#include <linux/log2.h>
 
 #include <asm/uaccess.h>
 
@@ -786,13 +787,15 @@ static inline void timer_stats_hrtimer_clear_start_info(struct hrtimer *timer)
 #endif
 }
 
-static inline void timer_stats_account_hrtimer(struct hrtimer *timer)
+static inline void timer_stats_account_hrtimer(struct hrtimer *timer,
+					       int saved)
 {
 #ifdef CONFIG_TIMER_STATS
 	if (likely(!timer_stats_active))
 		return;
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
-				 timer->function, timer->start_comm, 0);
+				 timer->function, timer->start_comm,
+				 saved ? TIMER_STATS_FLAG_SAVED : 0);
 #endif
 }
 
@@ -943,6 +946,47 @@ remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base)
 	return 0;
 }
 
+static enum hrtimer_restart hrtimer_wakeup(struct hrtimer *timer);
+
+/* Is @timer the sleep timer of a task whose slack its timer_slack group set */
+static inline int hrtimer_slack_from_group(struct hrtimer *timer)
+{
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+	struct hrtimer_sleeper *t;
+
+	if (timer->function != hrtimer_wakeup)
+		return 0;
+	t = container_of(timer, struct hrtimer_sleeper, timer);
+	return t->task && task_timer_slack_raised(t->task);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Pull the hard expiry of the sleep timer of a task in a timer_slack
+ * group back onto a grid of the largest power of two nanoseconds which
+ * fits into its slack. The timers of the tasks in the group then share
+ * their expiry times and with them the wakeup, instead of each of them
+ * firing at the end of its own range. The new expiry is never before the
+ * soft expiry. Other timers keep their expiry.
+ */
+static inline void hrtimer_coalesce_expires(struct hrtimer *timer,
+					    unsigned long delta_ns)
+{
+	s64 expires, grid;
+
+	if (delta_ns < 2 || hrtimer_get_expires_tv64(timer) == KTIME_MAX)
+		return;
+	if (!hrtimer_slack_from_group(timer))
+		return;
+
+	grid = rounddown_pow_of_two(delta_ns);
+	expires = ktime_to_ns(hrtimer_get_expires(timer)) & ~(grid - 1);
+	if (expires >= ktime_to_ns(hrtimer_get_softexpires(timer)))
+		timer->node.expires = ns_to_ktime(expires);
+}
+
 int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 		unsigned long delta_ns, const enum hrtimer_mode mode,
 		int wakeup)
@@ -974,6 +1018,7 @@ int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 	}
 
 	hrtimer_set_expires_range_ns(timer, tim, delta_ns);
+	hrtimer_coalesce_expires(timer, delta_ns);
 
 	timer_stats_hrtimer_set_start_info(timer);
 
@@ -1194,7 +1239,24 @@ int hrtimer_get_res(const clockid_t which_clock, struct timespec *tp)
 }
 EXPORT_SYMBOL_GPL(hrtimer_get_res);
 
-static void __run_hrtimer(struct hrtimer *timer, ktime_t *now)
+/*
+ * Account the timeouts which wake a task to its timer_slack group, @saved
+ * if the timer was expired by the interrupt of another one.
+ */
+static inline void hrtimer_account_wakeup(struct hrtimer *timer, int saved)
+{
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+	struct hrtimer_sleeper *t;
+
+	if (timer->function != hrtimer_wakeup)
+		return;
+	t = container_of(timer, struct hrtimer_sleeper, timer);
+	if (t->task)
+		timer_slack_account_wakeup(t->task, saved);
+#endif
+}
+
+static void __run_hrtimer(struct hrtimer *timer, ktime_t *now, int saved)
 {
 	struct hrtimer_clock_base *base = timer->base;
 	struct hrtimer_cpu_base *cpu_base = base->cpu_base;
@@ -1205,7 +1267,8 @@ static void __run_hrtimer(struct hrtimer *timer, ktime_t *now)
 
 	debug_deactivate(timer);
 	__remove_hrtimer(timer, base, HRTIMER_STATE_CALLBACK, 0);
-	timer_stats_account_hrtimer(timer);
+	timer_stats_account_hrtimer(timer, saved);
+	hrtimer_account_wakeup(timer, saved);
 	fn = timer->function;
 
 	/*
@@ -1244,7 +1307,7 @@ void hrtimer_interrupt(struct clock_event_device *dev)
 {
 	struct hrtimer_cpu_base *cpu_base = &__get_cpu_var(hrtimer_bases);
 	ktime_t expires_next, now, entry_time, delta;
-	int i, retries = 0;
+	int i, retries = 0, saved = 0;
 
 	BUG_ON(!cpu_base->hres_active);
 	cpu_base->nr_events++;
@@ -1303,7 +1366,12 @@ retry:
 				break;
 			}
 
-			__run_hrtimer(timer, &basenow);
+			__run_hrtimer(timer, &basenow, saved);
+			/*
+			 * The timers expired after the first one by this
+			 * interrupt did not need a wakeup of their own.
+			 */
+			saved = 1;
 		}
 	}
 
@@ -1461,7 +1529,7 @@ void hrtimer_run_queues(void)
 					hrtimer_get_expires_tv64(timer))
 				break;
 
-			__run_hrtimer(timer, &base->softirq_time);
+			__run_hrtimer(timer, &base->softirq_time, 0);
 		}
 		raw_spin_unlock(&cpu_base->lock);
 	}
@@ -1564,7 +1632,7 @@ long hrtimer_nanosleep(struct timespec *rqtp, struct timespec __user *rmtp,
 	int ret = 0;
 	unsigned long slack;
 
-	slack = current->timer_slack_ns;
+	slack = task_get_effective_timer_slack(current);
 	if (rt_task(current))
 		slack = 0;
 
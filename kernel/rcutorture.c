@@ -67,6 +67,7 @@ static int fqs_stutter = 3;	/* Wait time between bursts (s). */
 static int test_boost = 1;	/* Test RCU prio boost: 0=no, 1=maybe, 2=yes. */
 static int test_boost_interval = 7; /* Interval between boost tests, seconds. */
 static int test_boost_duration = 4; /* Duration of each boost test, seconds. */
+static int nocb_toggle;		/* Interval between offload toggles (s). */
 static char *torture_type = "rcu"; /* What RCU implementation to torture. */
 
 module_param(nreaders, int, 0444);
@@ -97,6 +98,8 @@ module_param(test_boost_interval, int, 0444);
 MODULE_PARM_DESC(test_boost_interval, "Interval between boost tests, seconds.");
 module_param(test_boost_duration, int, 0444);
 MODULE_PARM_DESC(test_boost_duration, "Duration of each boost test, seconds.");
+module_param(nocb_toggle, int, 0444);
+MODULE_PARM_DESC(nocb_toggle, "Seconds between callback offload toggles");
 module_param(torture_type, charp, 0444);
 MODULE_PARM_DESC(torture_type, "Type of RCU to torture (rcu, rcu_bh, srcu)");
 
@@ -149,6 +152,7 @@ static long n_rcu_torture_boost_rterror;
 static long n_rcu_torture_boost_failure;
 static long n_rcu_torture_boosts;
 static long n_rcu_torture_timers;
+static long n_rcu_torture_nocb_toggles;
 static struct list_head rcu_torture_removed;
 static cpumask_var_t shuffle_tmp_mask;
 
@@ -849,6 +853,87 @@ rcu_torture_fqs(void *arg)
 	return 0;
 }
 
+#ifdef CONFIG_RCU_NOCB_CPU
+
+static struct task_struct *nocb_task;
+
+/* Which CPUs offloaded their callbacks before the test. */
+static DECLARE_BITMAP(nocb_saved_bits, NR_CPUS);
+
+/*
+ * RCU torture callback-offload kthread.  Every nocb_toggle seconds, it
+ * switches callback offloading of the next CPU on or off, so callbacks
+ * keep moving between RCU_SOFTIRQ and the offload kthreads while the
+ * readers check that none of them is invoked early, and the final
+ * rcu_barrier() that none of them is lost.
+ */
+static int
+rcu_torture_nocb(void *arg)
+{
+	int cpu = -1;
+
+	VERBOSE_PRINTK_STRING("rcu_torture_nocb task started");
+	do {
+		schedule_timeout_interruptible(nocb_toggle * HZ);
+		cpu = cpumask_next(cpu, cpu_possible_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_possible_mask);
+		if (rcu_nocb_cpu_set(cpu, !rcu_is_nocb_cpu(cpu)) == 0)
+			n_rcu_torture_nocb_toggles++;
+		rcu_stutter_wait("rcu_torture_nocb");
+	} while (!kthread_should_stop() && fullstop == FULLSTOP_DONTSTOP);
+	VERBOSE_PRINTK_STRING("rcu_torture_nocb task stopping");
+	rcutorture_shutdown_absorb("rcu_torture_nocb");
+	while (!kthread_should_stop())
+		schedule_timeout_uninterruptible(1);
+	return 0;
+}
+
+static int rcu_torture_nocb_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (rcu_is_nocb_cpu(cpu))
+			set_bit(cpu, nocb_saved_bits);
+		else
+			clear_bit(cpu, nocb_saved_bits);
+	nocb_task = kthread_run(rcu_torture_nocb, NULL, "rcu_torture_nocb");
+	if (IS_ERR(nocb_task)) {
+		int err = PTR_ERR(nocb_task);
+
+		nocb_task = NULL;
+		return err;
+	}
+	return 0;
+}
+
+static void rcu_torture_nocb_cleanup(void)
+{
+	int cpu;
+
+	if (!nocb_task)
+		return;
+	VERBOSE_PRINTK_STRING("Stopping rcu_torture_nocb task");
+	kthread_stop(nocb_task);
+	nocb_task = NULL;
+	for_each_possible_cpu(cpu)
+		rcu_nocb_cpu_set(cpu, test_bit(cpu, nocb_saved_bits));
+}
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static int rcu_torture_nocb_init(void)
+{
+	return 0;
+}
+
+static void rcu_torture_nocb_cleanup(void)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
+
 /*
  * RCU torture writer kthread.  Repeatedly substitutes a new structure
  * for that pointed to by rcu_torture_current, freeing the old structure
@@ -1068,7 +1153,7 @@ rcu_torture_printk(char *page)
 	cnt += sprintf(&page[cnt],
 		       "rtc: %p ver: %lu tfle: %d rta: %d rtaf: %d rtf: %d "
 		       "rtmbe: %d rtbke: %ld rtbre: %ld "
-		       "rtbf: %ld rtb: %ld nt: %ld",
+		       "rtbf: %ld rtb: %ld nt: %ld nocbt: %ld",
 		       rcu_torture_current,
 		       rcu_torture_current_version,
 		       list_empty(&rcu_torture_freelist),
@@ -1080,7 +1165,8 @@ rcu_torture_printk(char *page)
 		       n_rcu_torture_boost_rterror,
 		       n_rcu_torture_boost_failure,
 		       n_rcu_torture_boosts,
-		       n_rcu_torture_timers);
+		       n_rcu_torture_timers,
+		       n_rcu_torture_nocb_toggles);
 	if (atomic_read(&n_rcu_torture_mberror) != 0 ||
 	    n_rcu_torture_boost_ktrerror != 0 ||
 	    n_rcu_torture_boost_rterror != 0 ||
@@ -1244,12 +1330,12 @@ rcu_torture_print_module_parms(struct rcu_torture_ops *cur_ops, char *tag)
 		"shuffle_interval=%d stutter=%d irqreader=%d "
 		"fqs_duration=%d fqs_holdoff=%d fqs_stutter=%d "
 		"test_boost=%d/%d test_boost_interval=%d "
-		"test_boost_duration=%d\n",
+		"test_boost_duration=%d nocb_toggle=%d\n",
 		torture_type, tag, nrealreaders, nfakewriters,
 		stat_interval, verbose, test_no_idle_hz, shuffle_interval,
 		stutter, irqreader, fqs_duration, fqs_holdoff, fqs_stutter,
 		test_boost, cur_ops->can_boost,
-		test_boost_interval, test_boost_duration);
+		test_boost_interval, test_boost_duration, nocb_toggle);
 }
 
 static struct notifier_block rcutorture_shutdown_nb = {
@@ -1396,6 +1482,7 @@ rcu_torture_cleanup(void)
 		kthread_stop(fqs_task);
 	}
 	fqs_task = NULL;
+	rcu_torture_nocb_cleanup();
 	if ((test_boost == 1 && cur_ops->can_boost) ||
 	    test_boost == 2) {
 		unregister_cpu_notifier(&rcutorture_cpu_nb);
@@ -1485,6 +1572,7 @@ rcu_torture_init(void)
 	n_rcu_torture_boost_rterror = 0;
 	n_rcu_torture_boost_failure = 0;
 	n_rcu_torture_boosts = 0;
+	n_rcu_torture_nocb_toggles = 0;
 	for (i = 0; i < RCU_TORTURE_PIPE_LEN + 1; i++)
 		atomic_set(&rcu_torture_wcount[i], 0);
 	for_each_possible_cpu(cpu) {
@@ -1598,6 +1686,13 @@ rcu_torture_init(void)
 			goto unwind;
 		}
 	}
+	if (nocb_toggle > 0) {
+		firsterr = rcu_torture_nocb_init();
+		if (firsterr) {
+			VERBOSE_PRINTK_ERRSTRING("Failed to create nocb");
+			goto unwind;
+		}
+	}
 	if (test_boost_interval < 1)
 		test_boost_interval = 1;
 	if (test_boost_duration < 2)
@@ -1190,6 +1190,7 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 {
 	unsigned long flags;
 	struct rcu_head *next, *list, **tail;
+	long offloaded;
 	int count;
 
 	/* If no callbacks are ready, just return.*/
@@ -1210,8 +1211,11 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 			rdp->nxttail[count] = &rdp->nxtlist;
 	local_irq_restore(flags);
 
-	/* Invoke callbacks. */
+	/* Invoke callbacks, unless this CPU's offload kthread does. */
 	count = 0;
+	offloaded = rcu_nocb_queue(rdp, list, tail);
+	if (offloaded)
+		list = NULL;
 	while (list) {
 		next = list->next;
 		prefetch(next);
@@ -1225,7 +1229,7 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 	local_irq_save(flags);
 
 	/* Update count, and requeue any remaining callbacks. */
-	rdp->qlen -= count;
+	rdp->qlen -= count + offloaded;
 	rdp->n_cbs_invoked += count;
 	if (list != NULL) {
 		*tail = rdp->nxtlist;
@@ -1846,6 +1850,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->dynticks = &per_cpu(rcu_dynticks, cpu);
 #endif /* #ifdef CONFIG_NO_HZ */
 	rdp->cpu = cpu;
+	rcu_boot_init_nocb(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
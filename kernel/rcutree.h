@@ -298,6 +298,20 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) callbacks handed to this CPU's offload kthread. */
+	raw_spinlock_t nocb_lock;	/* Protects the nocb fields. */
+	struct rcu_head *nocb_head;	/* CBs ready for the kthread. */
+	struct rcu_head **nocb_tail;
+	long nocb_qlen;			/* # CBs queued or being invoked. */
+	u64 nocb_queued;		/* When nocb_head became non-NULL, */
+					/*  in ns of ktime_get(). */
+	unsigned long n_nocb_invoked;	/* CBs invoked by the kthread. */
+	unsigned long n_nocb_batches;	/* Lists taken by the kthread. */
+	u64 nocb_lat_total;		/* Queue-to-invocation latency of */
+	u64 nocb_lat_max;		/*  those lists, in ns. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 };
 
@@ -466,5 +480,8 @@ static void rcu_yield(void (*f)(unsigned long), unsigned long arg);
 #endif /* #ifdef CONFIG_RCU_BOOST */
 static void rcu_cpu_kthread_setrt(int cpu, int to_rt);
 static void __cpuinit rcu_prepare_kthreads(int cpu);
+static void __init rcu_boot_init_nocb(struct rcu_data *rdp);
+static long rcu_nocb_queue(struct rcu_data *rdp, struct rcu_head *list,
+			   struct rcu_head **tail);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
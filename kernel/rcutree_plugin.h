@@ -48,6 +48,9 @@ static void __init rcu_bootup_announce_oddness(void)
 	printk(KERN_INFO
 	       "\tRCU dyntick-idle grace-period acceleration is enabled.\n");
 #endif
+#ifdef CONFIG_RCU_NOCB_CPU
+	printk(KERN_INFO "\tRCU callback offloading is enabled.\n");
+#endif
 #ifdef CONFIG_PROVE_RCU
 	printk(KERN_INFO "\tRCU lockdep checking is enabled.\n");
 #endif
@@ -1764,6 +1767,335 @@ static void __cpuinit rcu_prepare_kthreads(int cpu)
 
 #endif /* #else #ifdef CONFIG_RCU_BOOST */
 
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Callback offloading.  The CPUs in rcu_nocb_mask still queue their
+ * callbacks and advance them through grace periods themselves, but the
+ * callbacks that are ready to invoke are handed to the CPU's "rcuo"
+ * kthread instead of being invoked from RCU_SOFTIRQ.  The kthreads are
+ * not bound to their CPU: they start out on the CPUs that do not offload,
+ * and may be moved with sched_setaffinity() like any other task.
+ *
+ * The mask is set with the rcutree.nocb_cpus= boot parameter, or at
+ * runtime through /sys/module/rcutree/parameters/nocb_cpus.
+ */
+static DECLARE_BITMAP(rcu_nocb_bits, NR_CPUS) __read_mostly;
+#define rcu_nocb_mask to_cpumask(rcu_nocb_bits)
+static DEFINE_PER_CPU(struct task_struct *, rcu_nocb_task);
+static DEFINE_PER_CPU(wait_queue_head_t, rcu_nocb_wq);
+static DEFINE_MUTEX(rcu_nocb_mutex);	/* Mask updates, kthread spawning. */
+static bool rcu_nocb_spawned;		/* Kthreads can be spawned. */
+
+/*
+ * A kthread that has been woken waits up to nocb_delay jiffies for more
+ * callbacks, unless nocb_batch of them are already queued.
+ */
+static int rcu_nocb_batch = 64;
+static int rcu_nocb_delay;
+module_param_named(nocb_batch, rcu_nocb_batch, int, 0644);
+module_param_named(nocb_delay, rcu_nocb_delay, int, 0644);
+
+static struct rcu_state *const rcu_nocb_states[] = {
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	&rcu_preempt_state,
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	&rcu_sched_state,
+	&rcu_bh_state,
+};
+
+#define for_each_nocb_rdp(rdp, i, cpu) \
+	for ((i) = 0; \
+	     (i) < ARRAY_SIZE(rcu_nocb_states) && \
+	     ((rdp) = per_cpu_ptr(rcu_nocb_states[i]->rda, (cpu))); \
+	     (i)++)
+
+static void __init rcu_boot_init_nocb(struct rcu_data *rdp)
+{
+	raw_spin_lock_init(&rdp->nocb_lock);
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&per_cpu(rcu_nocb_wq, rdp->cpu));
+}
+
+/*
+ * Hand a list of callbacks that are ready to invoke to the CPU's offload
+ * kthread, returning the number of callbacks handed over, zero if the
+ * caller has to invoke them itself.  Called from rcu_do_batch() on the
+ * CPU that owns @rdp.
+ */
+static long rcu_nocb_queue(struct rcu_data *rdp, struct rcu_head *list,
+			   struct rcu_head **tail)
+{
+	unsigned long flags;
+	struct rcu_head *p;
+	long count = 0;
+	long qlen;
+	bool was_empty;
+
+	/*
+	 * Keep handing callbacks over while older ones are still queued,
+	 * even if offloading was just switched off for this CPU, so that
+	 * callbacks are invoked in order and rcu_barrier() works.
+	 */
+	if (!per_cpu(rcu_nocb_task, rdp->cpu) ||
+	    (!cpumask_test_cpu(rdp->cpu, rcu_nocb_mask) &&
+	     !ACCESS_ONCE(rdp->nocb_qlen)))
+		return 0;
+
+	for (p = list; p; p = p->next)
+		count++;
+
+	raw_spin_lock_irqsave(&rdp->nocb_lock, flags);
+	was_empty = !rdp->nocb_head;
+	if (was_empty)
+		rdp->nocb_queued = ktime_to_ns(ktime_get());
+	*rdp->nocb_tail = list;
+	rdp->nocb_tail = tail;
+	rdp->nocb_qlen += count;
+	qlen = rdp->nocb_qlen;
+	raw_spin_unlock_irqrestore(&rdp->nocb_lock, flags);
+
+	/* Start the batching delay, or cut it short once the batch is full. */
+	if (was_empty ||
+	    (qlen >= rcu_nocb_batch && qlen - count < rcu_nocb_batch))
+		wake_up(&per_cpu(rcu_nocb_wq, rdp->cpu));
+	return count;
+}
+
+static bool rcu_nocb_pending(int cpu)
+{
+	struct rcu_data *rdp;
+	int i;
+
+	for_each_nocb_rdp(rdp, i, cpu)
+		if (ACCESS_ONCE(rdp->nocb_head))
+			return true;
+	return false;
+}
+
+static bool rcu_nocb_batch_full(int cpu)
+{
+	struct rcu_data *rdp;
+	long qlen = 0;
+	int i;
+
+	for_each_nocb_rdp(rdp, i, cpu)
+		qlen += ACCESS_ONCE(rdp->nocb_qlen);
+	return qlen >= rcu_nocb_batch;
+}
+
+/*
+ * Invoke the callbacks queued for the offload kthread.  They run with
+ * bottom halves disabled, as they would from RCU_SOFTIRQ.
+ */
+static void rcu_nocb_invoke(struct rcu_data *rdp)
+{
+	unsigned long flags;
+	struct rcu_head *list, *next;
+	long count = 0;
+	u64 lat;
+
+	raw_spin_lock_irqsave(&rdp->nocb_lock, flags);
+	list = rdp->nocb_head;
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = &rdp->nocb_head;
+	lat = rdp->nocb_queued;
+	raw_spin_unlock_irqrestore(&rdp->nocb_lock, flags);
+	if (list == NULL)
+		return;
+	lat = ktime_to_ns(ktime_get()) - lat;
+
+	while (list) {
+		next = list->next;
+		prefetch(next);
+		debug_rcu_head_unqueue(list);
+		local_bh_disable();
+		__rcu_reclaim(list);
+		local_bh_enable();
+		list = next;
+		count++;
+		cond_resched();
+	}
+
+	raw_spin_lock_irqsave(&rdp->nocb_lock, flags);
+	rdp->nocb_qlen -= count;
+	rdp->n_nocb_invoked += count;
+	rdp->n_nocb_batches++;
+	rdp->nocb_lat_total += lat;
+	if (lat > rdp->nocb_lat_max)
+		rdp->nocb_lat_max = lat;
+	raw_spin_unlock_irqrestore(&rdp->nocb_lock, flags);
+}
+
+/*
+ * Per-CPU offload kthread.  Immortal: callbacks may still be queued for
+ * it after its CPU went offline or stopped offloading.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	int cpu = (long)arg;
+	wait_queue_head_t *wq = &per_cpu(rcu_nocb_wq, cpu);
+	struct rcu_data *rdp;
+	int i;
+
+	for (;;) {
+		wait_event_interruptible(*wq, rcu_nocb_pending(cpu));
+		if (rcu_nocb_delay > 0)
+			wait_event_interruptible_timeout(*wq,
+					rcu_nocb_batch_full(cpu),
+					rcu_nocb_delay);
+		for_each_nocb_rdp(rdp, i, cpu)
+			rcu_nocb_invoke(rdp);
+	}
+	return 0;
+}
+
+/*
+ * Spawn the offload kthread for @cpu, on the CPUs that do not offload.
+ * Called with rcu_nocb_mutex held.
+ */
+static int rcu_nocb_spawn(int cpu)
+{
+	struct task_struct *t;
+	cpumask_var_t cm;
+
+	if (per_cpu(rcu_nocb_task, cpu))
+		return 0;
+	t = kthread_create(rcu_nocb_kthread, (void *)(long)cpu,
+			   "rcuo/%d", cpu);
+	if (IS_ERR(t))
+		return PTR_ERR(t);
+	if (alloc_cpumask_var(&cm, GFP_KERNEL)) {
+		cpumask_andnot(cm, cpu_possible_mask, rcu_nocb_mask);
+		cpumask_clear_cpu(cpu, cm);
+		if (!cpumask_empty(cm))
+			set_cpus_allowed_ptr(t, cm);
+		free_cpumask_var(cm);
+	}
+	per_cpu(rcu_nocb_task, cpu) = t;
+	wake_up_process(t);
+	return 0;
+}
+
+static int __rcu_nocb_cpu_set(int cpu, bool offload)
+{
+	int ret = 0;
+
+	if (!offload) {
+		cpumask_clear_cpu(cpu, rcu_nocb_mask);
+		return 0;
+	}
+	if (rcu_nocb_spawned)
+		ret = rcu_nocb_spawn(cpu);
+	if (!ret)
+		cpumask_set_cpu(cpu, rcu_nocb_mask);
+	return ret;
+}
+
+/**
+ * rcu_nocb_cpu_set - start or stop offloading the callbacks of a CPU
+ * @cpu: the CPU
+ * @offload: hand its callbacks to a kthread if true
+ *
+ * Callbacks already handed to the kthread are still invoked by it when
+ * offloading stops.
+ */
+int rcu_nocb_cpu_set(int cpu, bool offload)
+{
+	int ret;
+
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+	mutex_lock(&rcu_nocb_mutex);
+	ret = __rcu_nocb_cpu_set(cpu, offload);
+	mutex_unlock(&rcu_nocb_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rcu_nocb_cpu_set);
+
+/**
+ * rcu_is_nocb_cpu - does a CPU offload its callbacks
+ * @cpu: the CPU
+ */
+int rcu_is_nocb_cpu(int cpu)
+{
+	return cpumask_test_cpu(cpu, rcu_nocb_mask);
+}
+EXPORT_SYMBOL_GPL(rcu_is_nocb_cpu);
+
+/* Parsed under rcu_nocb_mutex; early boot cannot allocate yet. */
+static DECLARE_BITMAP(rcu_nocb_new_bits, NR_CPUS);
+
+static int param_set_nocb_cpus(const char *val, const struct kernel_param *kp)
+{
+	struct cpumask *new = to_cpumask(rcu_nocb_new_bits);
+	int cpu, ret;
+
+	mutex_lock(&rcu_nocb_mutex);
+	ret = cpulist_parse(val, new);
+	if (!ret) {
+		for_each_possible_cpu(cpu) {
+			ret = __rcu_nocb_cpu_set(cpu, cpumask_test_cpu(cpu, new));
+			if (ret)
+				break;
+		}
+	}
+	mutex_unlock(&rcu_nocb_mutex);
+	return ret;
+}
+
+static int param_get_nocb_cpus(char *buffer, const struct kernel_param *kp)
+{
+	int len = cpulist_scnprintf(buffer, PAGE_SIZE - 1, rcu_nocb_mask);
+
+	buffer[len++] = '\n';
+	buffer[len] = '\0';
+	return len;
+}
+
+static struct kernel_param_ops param_ops_nocb_cpus = {
+	.set = param_set_nocb_cpus,
+	.get = param_get_nocb_cpus,
+};
+module_param_cb(nocb_cpus, &param_ops_nocb_cpus, NULL, 0644);
+
+/*
+ * Spawn the kthreads of the CPUs given at boot, as soon as the scheduler
+ * is running.
+ */
+static int __init rcu_spawn_nocb_kthreads(void)
+{
+	int cpu;
+
+	mutex_lock(&rcu_nocb_mutex);
+	rcu_nocb_spawned = true;
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		if (rcu_nocb_spawn(cpu)) {
+			printk(KERN_WARNING "RCU: no offload kthread for CPU %d\n",
+			       cpu);
+			cpumask_clear_cpu(cpu, rcu_nocb_mask);
+		}
+	}
+	mutex_unlock(&rcu_nocb_mutex);
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static void __init rcu_boot_init_nocb(struct rcu_data *rdp)
+{
+}
+
+static long rcu_nocb_queue(struct rcu_data *rdp, struct rcu_head *list,
+			   struct rcu_head **tail)
+{
+	return 0;
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
+
 #ifndef CONFIG_SMP
 
 void synchronize_sched_expedited(void)
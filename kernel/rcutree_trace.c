@@ -42,6 +42,7 @@
 #include <linux/mutex.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #define RCU_TREE_NONCORE
 #include "rcutree.h"
@@ -274,6 +275,77 @@ static int rcu_boost_trace_create_file(struct dentry *rcudir)
 
 #endif /* #else #ifdef CONFIG_RCU_BOOST */
 
+#ifdef CONFIG_RCU_NOCB_CPU
+
+static void print_one_rcu_nocb(struct seq_file *m, struct rcu_data *rdp)
+{
+	unsigned long flags;
+	unsigned long invoked, batches;
+	u64 total, max;
+	long qlen;
+
+	if (!rdp->beenonline)
+		return;
+	raw_spin_lock_irqsave(&rdp->nocb_lock, flags);
+	qlen = rdp->nocb_qlen;
+	invoked = rdp->n_nocb_invoked;
+	batches = rdp->n_nocb_batches;
+	total = rdp->nocb_lat_total;
+	max = rdp->nocb_lat_max;
+	raw_spin_unlock_irqrestore(&rdp->nocb_lock, flags);
+	seq_printf(m, "%3d%c%c nql=%ld ni=%lu nb=%lu lat=%llu/%llu\n",
+		   rdp->cpu,
+		   cpu_is_offline(rdp->cpu) ? '!' : ' ',
+		   rcu_is_nocb_cpu(rdp->cpu) ? 'o' : ' ',
+		   qlen, invoked, batches,
+		   batches ? div64_u64(total, batches * 1000ULL) : 0ULL,
+		   div_u64(max, 1000));
+}
+
+static int show_rcu_nocb(struct seq_file *m, void *unused)
+{
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	seq_puts(m, "rcu_preempt:\n");
+	PRINT_RCU_DATA(rcu_preempt_data, print_one_rcu_nocb, m);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	seq_puts(m, "rcu_sched:\n");
+	PRINT_RCU_DATA(rcu_sched_data, print_one_rcu_nocb, m);
+	seq_puts(m, "rcu_bh:\n");
+	PRINT_RCU_DATA(rcu_bh_data, print_one_rcu_nocb, m);
+	return 0;
+}
+
+static int rcu_nocb_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_rcu_nocb, NULL);
+}
+
+static const struct file_operations rcu_nocb_fops = {
+	.owner = THIS_MODULE,
+	.open = rcu_nocb_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * Create the rcu_nocb debugfs entry.  Standard error return.
+ */
+static int rcu_nocb_trace_create_file(struct dentry *rcudir)
+{
+	return !debugfs_create_file("rcu_nocb", 0444, rcudir, NULL,
+				    &rcu_nocb_fops);
+}
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static int rcu_nocb_trace_create_file(struct dentry *rcudir)
+{
+	return 0;
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
+
 static void print_one_rcu_state(struct seq_file *m, struct rcu_state *rsp)
 {
 	unsigned long gpnum;
@@ -477,6 +549,9 @@ static int __init rcutree_trace_init(void)
 	if (rcu_boost_trace_create_file(rcudir))
 		goto free_out;
 
+	if (rcu_nocb_trace_create_file(rcudir))
+		goto free_out;
+
 	retval = debugfs_create_file("rcugp", 0444, rcudir, NULL, &rcugp_fops);
 	if (!retval)
 		goto free_out;
@@ -257,6 +257,15 @@ struct task_group {
 	unsigned long shares;
 
 	atomic_t load_weight;
+#ifdef CONFIG_SMP
+	/* sum of the per-cpu cfs_rq->tg_load_contrib */
+	atomic64_t load_avg;
+#endif
+
+	/* foreground boost: cpu.latency_class, cpu.min_freq, cpu.prefer_idle */
+	unsigned int latency_class;
+	unsigned int min_freq;
+	unsigned int prefer_idle;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -296,6 +305,13 @@ static DEFINE_SPINLOCK(task_group_lock);
 #define MIN_SHARES	(1UL <<  1)
 #define MAX_SHARES	(1UL << 18)
 
+/*
+ * Woken tasks of a group with a higher latency class preempt, and are
+ * picked ahead of, entities of a lower class, within sched_latency of
+ * vruntime. 0 is the default class.
+ */
+#define SCHED_LATENCY_CLASS_MAX	3
+
 static int root_task_group_load = ROOT_TASK_GROUP_LOAD;
 #endif
 
@@ -374,6 +390,19 @@ struct cfs_rq {
 	u64 load_stamp, load_last, load_unacc_exec_time;
 
 	unsigned long load_contribution;
+
+	/*
+	 * Per-entity load tracking: the decayed load of the entities queued
+	 * here, and of those that went to sleep on it and have not woken up
+	 * yet. decay_counter counts the ~1ms periods blocked_load_avg has
+	 * been decayed by, removed_load is blocked load of tasks that woke
+	 * up on another cpu, not yet subtracted. tg_load_contrib is what
+	 * this cfs_rq last added to tg->load_avg.
+	 */
+	unsigned long runnable_load_avg, blocked_load_avg;
+	atomic64_t decay_counter, removed_load;
+	u64 last_decay;
+	unsigned long tg_load_contrib;
 #endif
 #endif
 };
@@ -480,6 +509,8 @@ struct rq {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this cpu: */
 	struct list_head leaf_cfs_rq_list;
+	/* cpu.min_freq of the current task's group, in kHz */
+	unsigned int min_freq_hint;
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	struct list_head leaf_rt_rq_list;
@@ -524,6 +555,10 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	/* decayed fraction of time the rq was not empty */
+	struct sched_avg avg;
+#endif
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -1783,6 +1818,11 @@ static const struct sched_class rt_sched_class;
 static void inc_nr_running(struct rq *rq)
 {
 	rq->nr_running++;
+#ifdef CONFIG_NO_HZ_ADAPTIVE
+	/* The tick is needed again to preempt between the two */
+	if (rq->nr_running == 2)
+		tick_nohz_adaptive_kick(cpu_of(rq));
+#endif
 }
 
 static void dec_nr_running(struct rq *rq)
@@ -2027,6 +2067,9 @@ static void update_rq_clock_task(struct rq *rq, s64 delta)
 
 #endif /* CONFIG_IRQ_TIME_ACCOUNTING */
 
+static void idle_enter_fair(struct rq *this_rq);
+static void idle_exit_fair(struct rq *this_rq);
+
 #include "sched_idletask.c"
 #include "sched_fair.c"
 #include "sched_rt.c"
@@ -2220,6 +2263,8 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 	trace_sched_migrate_task(p, new_cpu);
 
 	if (task_cpu(p) != new_cpu) {
+		if (p->sched_class->migrate_task_rq)
+			p->sched_class->migrate_task_rq(p, new_cpu);
 		p->se.nr_migrations++;
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, 1, NULL, 0);
 	}
@@ -2478,6 +2523,7 @@ static void ttwu_activate(struct rq *rq, struct task_struct *p, int en_flags)
 {
 	activate_task(rq, p, en_flags);
 	p->on_rq = 1;
+	p->se.wakeup_start = rq->clock;
 
 	/* if a worker is waking up, notify workqueue */
 	if (p->flags & PF_WQ_WORKER)
@@ -2580,7 +2626,7 @@ void scheduler_ipi(void)
 	struct rq *rq = this_rq();
 	struct task_struct *list = xchg(&rq->wake_list, NULL);
 
-	if (!list)
+	if (!list && !tick_nohz_adaptive_pending())
 		return;
 
 	/*
@@ -2597,7 +2643,13 @@ void scheduler_ipi(void)
 	 * somewhat pessimize the simple resched case.
 	 */
 	irq_enter();
-	sched_ttwu_do_pending(list);
+	/*
+	 * A cpu which deferred its tick is kicked to take it up again,
+	 * e.g. by RCU which waits for a quiescent state from it.
+	 */
+	tick_nohz_adaptive_exit();
+	if (list)
+		sched_ttwu_do_pending(list);
 	irq_exit();
 }
 
@@ -2806,9 +2858,14 @@ static void __sched_fork(struct task_struct *p)
 	p->se.sum_exec_runtime		= 0;
 	p->se.prev_sum_exec_runtime	= 0;
 	p->se.nr_migrations		= 0;
+	p->se.wakeup_start		= 0;
 	p->se.vruntime			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
 
+#if defined(CONFIG_SMP) && defined(CONFIG_FAIR_GROUP_SCHED)
+	memset(&p->se.avg, 0, sizeof(p->se.avg));
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
@@ -2990,6 +3047,73 @@ fire_sched_out_preempt_notifiers(struct task_struct *curr,
 
 #endif /* CONFIG_PREEMPT_NOTIFIERS */
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+static void (*freq_hint_notifier)(int cpu, unsigned int freq);
+
+unsigned int sched_min_freq_hint(int cpu)
+{
+	return ACCESS_ONCE(cpu_rq(cpu)->min_freq_hint);
+}
+EXPORT_SYMBOL_GPL(sched_min_freq_hint);
+
+/*
+ * Only one governor at a time can take the hints. Callers clearing the
+ * notifier must wait for a synchronize_sched() before they go away.
+ */
+void sched_set_freq_hint_notifier(void (*fn)(int cpu, unsigned int freq))
+{
+	rcu_assign_pointer(freq_hint_notifier, fn);
+}
+EXPORT_SYMBOL_GPL(sched_set_freq_hint_notifier);
+
+static inline void notify_freq_hint(struct rq *rq)
+{
+	void (*fn)(int cpu, unsigned int freq);
+
+	if (likely(!rq->min_freq_hint))
+		return;
+
+	fn = rcu_dereference_sched(freq_hint_notifier);
+	if (fn)
+		fn(cpu_of(rq), rq->min_freq_hint);
+}
+
+const char *sched_task_group_name(struct task_struct *p)
+{
+	struct cgroup *cgrp = task_group(p)->css.cgroup;
+	struct dentry *dentry;
+
+	/* autogroups have no cgroup */
+	if (!cgrp)
+		return "";
+	dentry = rcu_dereference_check(cgrp->dentry,
+				       lockdep_is_held(&task_rq(p)->lock));
+	return dentry ? (const char *)dentry->d_name.name : "/";
+}
+
+unsigned int sched_task_latency_class(struct task_struct *p)
+{
+	return task_group(p)->latency_class;
+}
+
+static inline void trace_wakeup_latency(struct rq *rq, struct task_struct *p)
+{
+	s64 delay;
+
+	if (!p->se.wakeup_start)
+		return;
+
+	delay = rq->clock - p->se.wakeup_start;
+	p->se.wakeup_start = 0;
+	trace_sched_wakeup_latency(p, delay > 0 ? delay : 0);
+}
+#else
+static inline void notify_freq_hint(struct rq *rq) { }
+static inline void trace_wakeup_latency(struct rq *rq, struct task_struct *p)
+{
+}
+#endif
+
 /**
  * prepare_task_switch - prepare to switch tasks
  * @rq: the runqueue preparing to switch
@@ -3013,6 +3137,10 @@ prepare_task_switch(struct rq *rq, struct task_struct *prev,
 	prepare_lock_switch(rq, next);
 	prepare_arch_switch(next);
 	trace_sched_switch(prev, next);
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	rq->min_freq_hint = task_group(next)->min_freq;
+#endif
+	tick_nohz_adaptive_exit();
 }
 
 /**
@@ -3059,6 +3187,7 @@ static void finish_task_switch(struct rq *rq, struct task_struct *prev)
 	local_irq_enable();
 #endif /* __ARCH_WANT_INTERRUPTS_ON_CTXSW */
 	finish_lock_switch(rq, prev);
+	notify_freq_hint(rq);
 
 	fire_sched_in_preempt_notifiers(current);
 	if (mm)
@@ -4284,6 +4413,7 @@ need_resched:
 		rq->nr_switches++;
 		rq->curr = next;
 		++*switch_count;
+		trace_wakeup_latency(rq, next);
 
 		context_switch(rq, prev, next); /* unlocks the rq */
 		/*
@@ -5003,6 +5133,18 @@ int idle_cpu(int cpu)
 	return cpu_curr(cpu) == cpu_rq(cpu)->idle;
 }
 
+#ifdef CONFIG_NO_HZ_ADAPTIVE
+/**
+ * sched_can_stop_tick - can this cpu run without the scheduler tick?
+ *
+ * With a single task runnable there is nothing to preempt it for.
+ */
+int sched_can_stop_tick(void)
+{
+	return this_rq()->nr_running == 1;
+}
+#endif
+
 /**
  * idle_task - return the idle task for a given cpu.
  * @cpu: the processor in question.
@@ -7927,6 +8069,8 @@ static void init_cfs_rq(struct cfs_rq *cfs_rq, struct rq *rq)
 	/* allow initial update_cfs_load() to truncate */
 #ifdef CONFIG_SMP
 	cfs_rq->load_stamp = 1;
+	atomic64_set(&cfs_rq->decay_counter, 1);
+	atomic64_set(&cfs_rq->removed_load, 0);
 #endif
 #endif
 	cfs_rq->min_vruntime = (u64)(-(1LL << 20));
@@ -9040,6 +9184,48 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) scale_load_down(tg->shares);
 }
+
+static int cpu_latency_class_write_u64(struct cgroup *cgrp,
+				       struct cftype *cftype, u64 val)
+{
+	if (val > SCHED_LATENCY_CLASS_MAX)
+		return -EINVAL;
+	cgroup_tg(cgrp)->latency_class = val;
+	return 0;
+}
+
+static u64 cpu_latency_class_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->latency_class;
+}
+
+static int cpu_min_freq_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				  u64 val)
+{
+	if (val > UINT_MAX)
+		return -EINVAL;
+	cgroup_tg(cgrp)->min_freq = val;
+	return 0;
+}
+
+static u64 cpu_min_freq_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->min_freq;
+}
+
+static int cpu_prefer_idle_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				     u64 val)
+{
+	if (val > 1)
+		return -EINVAL;
+	cgroup_tg(cgrp)->prefer_idle = val;
+	return 0;
+}
+
+static u64 cpu_prefer_idle_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->prefer_idle;
+}
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -9073,6 +9259,21 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency_class",
+		.read_u64 = cpu_latency_class_read_u64,
+		.write_u64 = cpu_latency_class_write_u64,
+	},
+	{
+		.name = "min_freq",
+		.read_u64 = cpu_min_freq_read_u64,
+		.write_u64 = cpu_min_freq_write_u64,
+	},
+	{
+		.name = "prefer_idle",
+		.read_u64 = cpu_prefer_idle_read_u64,
+		.write_u64 = cpu_prefer_idle_write_u64,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
@@ -23,6 +23,7 @@
 #include <linux/latencytop.h>
 #include <linux/sched.h>
 #include <linux/cpumask.h>
+#include <linux/cpufreq.h>
 
 /*
  * Targeted preemption latency for CPU-bound tasks:
@@ -706,6 +707,369 @@ account_entity_dequeue(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	cfs_rq->nr_running--;
 }
 
+#if defined(CONFIG_SMP) && defined(CONFIG_FAIR_GROUP_SCHED)
+/*
+ * Per-entity load tracking.
+ *
+ * Time is divided into ~1ms (1024us) periods. The time an entity was
+ * runnable in period i contributes u_i to its load, and older periods
+ * decay geometrically:
+ *
+ *   runnable_avg_sum = u_0 + u_1*y + u_2*y^2 + ...,   y^32 = 1/2
+ *
+ * The load an entity contributes to its cfs_rq is its weight scaled by
+ * its runnable fraction. Contributions of runnable entities add up to
+ * cfs_rq->runnable_load_avg. When an entity goes to sleep its contribution
+ * moves to cfs_rq->blocked_load_avg, which keeps decaying in ~1ms steps
+ * counted by cfs_rq->decay_counter, so that a task waking up can take back
+ * exactly what it left there. Unlike the windowed average, a task moving
+ * in or out of a group changes the group's load right away, instead of
+ * after one or more sysctl_sched_shares_window periods.
+ */
+#define LOAD_AVG_PERIOD		32
+#define LOAD_AVG_MAX		47742	/* maximum possible runnable_avg_sum */
+#define LOAD_AVG_MAX_N		345	/* periods needed to reach it */
+
+/* y^n * 2^32, for n in 0..LOAD_AVG_PERIOD-1 */
+static const u32 runnable_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2db, 0xf5257d15, 0xefe4b99b, 0xeac0c6e7, 0xe5b906e7,
+	0xe0ccdeec, 0xdbfbb797, 0xd744fcca, 0xd2a81d91, 0xce248c15, 0xc9b9bd86,
+	0xc5672a11, 0xc12c4cca, 0xbd08a39f, 0xb8fbaf47, 0xb504f333, 0xb123f581,
+	0xad583eea, 0xa9a15ab4, 0xa5fed6a9, 0xa2704303, 0x9ef53260, 0x9b8d39b9,
+	0x9837f051, 0x94f4efa8, 0x91c3d373, 0x8ea4398b, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/* 1024 * (y + y^2 + ... + y^n), for n in 0..LOAD_AVG_PERIOD */
+static const u32 runnable_avg_yN_sum[] = {
+	    0,  1002,  1982,  2941,  3880,  4798,  5697,  6576,  7437,  8279,
+	 9103,  9909, 10698, 11470, 12226, 12966, 13690, 14398, 15091, 15769,
+	16433, 17082, 17718, 18340, 18949, 19545, 20128, 20698, 21256, 21802,
+	22336, 22859, 23371,
+};
+
+/* val * y^n; val must fit in 32 bits */
+static __always_inline u64 decay_load(u64 val, u64 n)
+{
+	unsigned int local_n;
+
+	if (!n)
+		return val;
+	else if (unlikely(n > LOAD_AVG_PERIOD * 63))
+		return 0;
+
+	local_n = n;
+	if (unlikely(local_n >= LOAD_AVG_PERIOD)) {
+		val >>= local_n / LOAD_AVG_PERIOD;
+		local_n %= LOAD_AVG_PERIOD;
+	}
+
+	val *= runnable_avg_yN_inv[local_n];
+	return val >> 32;
+}
+
+/* 1024 * (y + y^2 + ... + y^n), the contribution of n full periods */
+static u32 __compute_runnable_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (likely(n <= LOAD_AVG_PERIOD))
+		return runnable_avg_yN_sum[n];
+	else if (unlikely(n >= LOAD_AVG_MAX_N))
+		return LOAD_AVG_MAX;
+
+	do {
+		contrib /= 2;
+		contrib += runnable_avg_yN_sum[LOAD_AVG_PERIOD];
+		n -= LOAD_AVG_PERIOD;
+	} while (n > LOAD_AVG_PERIOD);
+
+	contrib = decay_load(contrib, n);
+	return contrib + runnable_avg_yN_sum[n];
+}
+
+/*
+ * Account the time since the last update, in us, as runnable or not.
+ * Returns 1 when a period boundary was crossed and the sums decayed.
+ */
+static __always_inline int __update_entity_runnable_avg(u64 now,
+							struct sched_avg *sa,
+							int runnable)
+{
+	u64 delta, periods;
+	u32 runnable_contrib;
+	int delta_w, decayed = 0;
+
+	delta = now - sa->last_runnable_update;
+	/* the clock of a new rq may be behind the one we migrated from */
+	if ((s64)delta < 0) {
+		sa->last_runnable_update = now;
+		return 0;
+	}
+
+	delta >>= 10;
+	if (!delta)
+		return 0;
+	sa->last_runnable_update = now;
+
+	/* time already accumulated in the current period */
+	delta_w = sa->runnable_avg_period % 1024;
+	if (delta + delta_w >= 1024) {
+		decayed = 1;
+
+		/* complete the current period and decay it */
+		delta_w = 1024 - delta_w;
+		if (runnable)
+			sa->runnable_avg_sum += delta_w;
+		sa->runnable_avg_period += delta_w;
+		delta -= delta_w;
+
+		periods = delta / 1024;
+		delta %= 1024;
+
+		sa->runnable_avg_sum = decay_load(sa->runnable_avg_sum,
+						  periods + 1);
+		sa->runnable_avg_period = decay_load(sa->runnable_avg_period,
+						     periods + 1);
+
+		/* add the full periods that elapsed since */
+		runnable_contrib = __compute_runnable_contrib(periods);
+		if (runnable)
+			sa->runnable_avg_sum += runnable_contrib;
+		sa->runnable_avg_period += runnable_contrib;
+	}
+
+	/* the remainder starts the new current period */
+	if (runnable)
+		sa->runnable_avg_sum += delta;
+	sa->runnable_avg_period += delta;
+
+	return decayed;
+}
+
+/* Catch a blocked entity's contribution up with its cfs_rq's decay. */
+static inline u64 __synchronize_entity_decay(struct sched_entity *se)
+{
+	struct cfs_rq *cfs_rq = cfs_rq_of(se);
+	u64 decays = atomic64_read(&cfs_rq->decay_counter);
+
+	decays -= se->avg.decay_count;
+	se->avg.decay_count = 0;
+	if (!decays)
+		return 0;
+
+	se->avg.load_avg_contrib = decay_load(se->avg.load_avg_contrib,
+					      decays);
+	return decays;
+}
+
+static inline void __update_cfs_rq_tg_load_contrib(struct cfs_rq *cfs_rq,
+						   int force_update)
+{
+	struct task_group *tg = cfs_rq->tg;
+	long tg_contrib;
+
+	tg_contrib = cfs_rq->runnable_load_avg + cfs_rq->blocked_load_avg;
+	tg_contrib -= cfs_rq->tg_load_contrib;
+
+	if (force_update || abs(tg_contrib) > cfs_rq->tg_load_contrib / 8) {
+		atomic64_add(tg_contrib, &tg->load_avg);
+		cfs_rq->tg_load_contrib += tg_contrib;
+	}
+}
+
+/* A group entity carries its cfs_rq's share of the group's weight. */
+static inline void __update_group_entity_contrib(struct sched_entity *se)
+{
+	struct cfs_rq *cfs_rq = group_cfs_rq(se);
+	struct task_group *tg = cfs_rq->tg;
+	u64 contrib;
+
+	contrib = (u64)cfs_rq->tg_load_contrib * tg->shares;
+	se->avg.load_avg_contrib = div64_u64(contrib,
+					     atomic64_read(&tg->load_avg) + 1);
+}
+
+static inline void __update_task_entity_contrib(struct sched_entity *se)
+{
+	u32 contrib;
+
+	/* avoid overflowing a 32-bit type w/ SCHED_LOAD_SCALE */
+	contrib = se->avg.runnable_avg_sum * se->load.weight;
+	contrib /= (se->avg.runnable_avg_period + 1);
+	se->avg.load_avg_contrib = contrib;
+}
+
+/* Compute the current contribution of an entity, return the change. */
+static long __update_entity_load_avg_contrib(struct sched_entity *se)
+{
+	long old_contrib = se->avg.load_avg_contrib;
+
+	if (entity_is_task(se))
+		__update_task_entity_contrib(se);
+	else
+		__update_group_entity_contrib(se);
+
+	return se->avg.load_avg_contrib - old_contrib;
+}
+
+static inline void subtract_blocked_load_contrib(struct cfs_rq *cfs_rq,
+						 long load_contrib)
+{
+	if (likely(load_contrib < cfs_rq->blocked_load_avg))
+		cfs_rq->blocked_load_avg -= load_contrib;
+	else
+		cfs_rq->blocked_load_avg = 0;
+}
+
+/* Update an entity's load average, and optionally its cfs_rq's sums. */
+static inline void update_entity_load_avg(struct sched_entity *se,
+					  int update_cfs_rq)
+{
+	struct cfs_rq *cfs_rq = cfs_rq_of(se);
+	long contrib_delta;
+
+	if (!__update_entity_runnable_avg(rq_of(cfs_rq)->clock_task,
+					  &se->avg, se->on_rq))
+		return;
+
+	contrib_delta = __update_entity_load_avg_contrib(se);
+
+	if (!update_cfs_rq)
+		return;
+
+	if (se->on_rq)
+		cfs_rq->runnable_load_avg += contrib_delta;
+	else
+		subtract_blocked_load_contrib(cfs_rq, -contrib_delta);
+}
+
+/*
+ * Decay the blocked load for the periods elapsed since the last call, and
+ * fold the removed load of tasks that woke up elsewhere.
+ */
+static void update_cfs_rq_blocked_load(struct cfs_rq *cfs_rq, int force_update)
+{
+	u64 now = rq_of(cfs_rq)->clock_task >> 20;
+	u64 decays;
+
+	decays = now - cfs_rq->last_decay;
+	if (!decays && !force_update)
+		return;
+
+	if (atomic64_read(&cfs_rq->removed_load)) {
+		u64 removed_load = atomic64_xchg(&cfs_rq->removed_load, 0);
+		subtract_blocked_load_contrib(cfs_rq, removed_load);
+	}
+
+	if (decays) {
+		cfs_rq->blocked_load_avg = decay_load(cfs_rq->blocked_load_avg,
+						      decays);
+		atomic64_add(decays, &cfs_rq->decay_counter);
+		cfs_rq->last_decay = now;
+	}
+
+	__update_cfs_rq_tg_load_contrib(cfs_rq, force_update);
+}
+
+static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se,
+					   int wakeup)
+{
+	/*
+	 * A new task, or one that comes from another cpu: a decay_count
+	 * below zero is the number of periods it slept before migrating,
+	 * its contribution was already taken off the old cfs_rq.
+	 */
+	if (unlikely(se->avg.decay_count <= 0)) {
+		se->avg.last_runnable_update = rq_of(cfs_rq)->clock_task;
+		if (se->avg.decay_count) {
+			se->avg.last_runnable_update -=
+				(-se->avg.decay_count) << 20;
+			update_entity_load_avg(se, 0);
+			se->avg.decay_count = 0;
+		}
+		wakeup = 0;
+	} else {
+		__synchronize_entity_decay(se);
+	}
+
+	/* take back what we left as blocked load, then account the sleep */
+	if (wakeup) {
+		subtract_blocked_load_contrib(cfs_rq, se->avg.load_avg_contrib);
+		update_entity_load_avg(se, 0);
+	}
+
+	cfs_rq->runnable_load_avg += se->avg.load_avg_contrib;
+	update_cfs_rq_blocked_load(cfs_rq, !wakeup);
+}
+
+static inline void dequeue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se,
+					   int sleep)
+{
+	update_entity_load_avg(se, 1);
+	update_cfs_rq_blocked_load(cfs_rq, !sleep);
+
+	cfs_rq->runnable_load_avg -= se->avg.load_avg_contrib;
+	if (sleep) {
+		cfs_rq->blocked_load_avg += se->avg.load_avg_contrib;
+		se->avg.decay_count = atomic64_read(&cfs_rq->decay_counter);
+	}
+}
+
+/*
+ * A blocked task is about to wake up on another cpu: take its load off
+ * the old cfs_rq, and remember how long it has slept for the new one.
+ * Only p->pi_lock is held, hence removed_load.
+ */
+static void migrate_task_rq_fair(struct task_struct *p, int next_cpu)
+{
+	struct sched_entity *se = &p->se;
+	struct cfs_rq *cfs_rq = cfs_rq_of(se);
+
+	if (se->avg.decay_count) {
+		se->avg.decay_count = -__synchronize_entity_decay(se);
+		atomic64_add(se->avg.load_avg_contrib, &cfs_rq->removed_load);
+	}
+}
+
+/* Account the time since the last update as time the rq was busy or not */
+static inline void update_rq_runnable_avg(struct rq *rq, int runnable)
+{
+	__update_entity_runnable_avg(rq->clock_task, &rq->avg, runnable);
+}
+
+/*
+ * Nothing updates rq->avg while a cpu is idle: account the time up to
+ * idle entry as busy, and the idle period at its end, so that cpu_util()
+ * decays instead of keeping the load the cpu had when it went idle.
+ */
+static void idle_enter_fair(struct rq *this_rq)
+{
+	update_rq_runnable_avg(this_rq, 1);
+}
+
+static void idle_exit_fair(struct rq *this_rq)
+{
+	update_rq_runnable_avg(this_rq, 0);
+}
+#else
+static inline void update_rq_runnable_avg(struct rq *rq, int runnable) {}
+static void idle_enter_fair(struct rq *this_rq) {}
+static void idle_exit_fair(struct rq *this_rq) {}
+static inline void update_entity_load_avg(struct sched_entity *se,
+					  int update_cfs_rq) {}
+static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se,
+					   int wakeup) {}
+static inline void dequeue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se,
+					   int sleep) {}
+static inline void update_cfs_rq_blocked_load(struct cfs_rq *cfs_rq,
+					      int force_update) {}
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 # ifdef CONFIG_SMP
 static void update_cfs_rq_load_contribution(struct cfs_rq *cfs_rq,
@@ -767,19 +1131,38 @@ static void update_cfs_load(struct cfs_rq *cfs_rq, int global_update)
 		cfs_rq->load_avg /= 2;
 	}
 
-	if (!cfs_rq->curr && !cfs_rq->nr_running && !cfs_rq->load_avg)
+	/* keep decaying blocked load until it no longer counts for the tg */
+	if (!cfs_rq->curr && !cfs_rq->nr_running && !cfs_rq->load_avg &&
+	    !cfs_rq->tg_load_contrib)
 		list_del_leaf_cfs_rq(cfs_rq);
 }
 
+/*
+ * The weight of a group across all cpus, with this cpu's part taken as
+ * its current, rather than its averaged, load.
+ */
+static inline long calc_tg_weight(struct task_group *tg, struct cfs_rq *cfs_rq)
+{
+	long tg_weight;
+
+	if (sched_feat(ENTITY_LOAD_AVG)) {
+		tg_weight = atomic64_read(&tg->load_avg);
+		tg_weight -= cfs_rq->tg_load_contrib;
+	} else {
+		tg_weight = atomic_read(&tg->load_weight);
+		tg_weight -= cfs_rq->load_contribution;
+	}
+	tg_weight += cfs_rq->load.weight;
+
+	return tg_weight;
+}
+
 static long calc_cfs_shares(struct cfs_rq *cfs_rq, struct task_group *tg)
 {
 	long load_weight, load, shares;
 
 	load = cfs_rq->load.weight;
-
-	load_weight = atomic_read(&tg->load_weight);
-	load_weight += load;
-	load_weight -= cfs_rq->load_contribution;
+	load_weight = calc_tg_weight(tg, cfs_rq);
 
 	shares = (tg->shares * load);
 	if (load_weight)
@@ -795,6 +1178,12 @@ static long calc_cfs_shares(struct cfs_rq *cfs_rq, struct task_group *tg)
 
 static void update_entity_shares_tick(struct cfs_rq *cfs_rq)
 {
+	/* the per-entity averages are current on every tick */
+	if (sched_feat(ENTITY_LOAD_AVG)) {
+		update_cfs_shares(cfs_rq);
+		return;
+	}
+
 	if (cfs_rq->load_unacc_exec_time > sysctl_sched_shares_window) {
 		update_cfs_load(cfs_rq, 0);
 		update_cfs_shares(cfs_rq);
@@ -983,6 +1372,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	enqueue_entity_load_avg(cfs_rq, se, flags & ENQUEUE_WAKEUP);
 	update_cfs_load(cfs_rq, 0);
 	account_entity_enqueue(cfs_rq, se);
 	update_cfs_shares(cfs_rq);
@@ -1054,6 +1444,7 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	dequeue_entity_load_avg(cfs_rq, se, flags & DEQUEUE_SLEEP);
 
 	update_stats_dequeue(cfs_rq, se);
 	if (flags & DEQUEUE_SLEEP) {
@@ -1172,6 +1563,35 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se);
  * 3) pick the "last" process, for cache locality
  * 4) do not run the "skip" process, if something else is available
  */
+#ifdef CONFIG_FAIR_GROUP_SCHED
+static inline unsigned int se_latency_class(struct sched_entity *se)
+{
+	if (entity_is_task(se))
+		return cfs_rq_of(se)->tg->latency_class;
+	return group_cfs_rq(se)->tg->latency_class;
+}
+#else
+static inline unsigned int se_latency_class(struct sched_entity *se)
+{
+	return 0;
+}
+#endif
+
+/*
+ * Should @se go ahead of @curr because of its group's latency class? Only
+ * while it is less than a sched_latency period of vruntime ahead, so that
+ * a boosted group can jump the queue but cannot starve the others.
+ */
+static int latency_class_preempt(struct sched_entity *curr,
+				 struct sched_entity *se)
+{
+	if (se_latency_class(se) <= se_latency_class(curr))
+		return 0;
+
+	return (s64)(se->vruntime - curr->vruntime) <
+		(s64)sysctl_sched_latency;
+}
+
 static struct sched_entity *pick_next_entity(struct cfs_rq *cfs_rq)
 {
 	struct sched_entity *se = __pick_first_entity(cfs_rq);
@@ -1194,9 +1614,11 @@ static struct sched_entity *pick_next_entity(struct cfs_rq *cfs_rq)
 		se = cfs_rq->last;
 
 	/*
-	 * Someone really wants this to run. If it's not unfair, run it.
+	 * Someone really wants this to run. If it's not unfair, or it is of
+	 * a higher latency class, run it.
 	 */
-	if (cfs_rq->next && wakeup_preempt_entity(cfs_rq->next, left) < 1)
+	if (cfs_rq->next && (wakeup_preempt_entity(cfs_rq->next, left) < 1 ||
+			     latency_class_preempt(left, cfs_rq->next)))
 		se = cfs_rq->next;
 
 	clear_buddies(cfs_rq, se);
@@ -1218,6 +1640,8 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 		update_stats_wait_start(cfs_rq, prev);
 		/* Put 'current' back into the tree. */
 		__enqueue_entity(cfs_rq, prev);
+		/* in !on_rq case, update occurred at dequeue */
+		update_entity_load_avg(prev, 1);
 	}
 	cfs_rq->curr = NULL;
 }
@@ -1230,6 +1654,12 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 	 */
 	update_curr(cfs_rq);
 
+	/*
+	 * Ensure that runnable average is periodically updated.
+	 */
+	update_entity_load_avg(curr, 1);
+	update_cfs_rq_blocked_load(cfs_rq, 1);
+
 	/*
 	 * Update share accounting for long-running entities.
 	 */
@@ -1327,6 +1757,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+	update_rq_runnable_avg(rq, rq->nr_running);
+
 	for_each_sched_entity(se) {
 		if (se->on_rq)
 			break;
@@ -1340,6 +1772,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 
 		update_cfs_load(cfs_rq, 0);
 		update_cfs_shares(cfs_rq);
+		update_entity_load_avg(se, 1);
 	}
 
 	hrtick_update(rq);
@@ -1358,6 +1791,8 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct sched_entity *se = &p->se;
 	int task_sleep = flags & DEQUEUE_SLEEP;
 
+	update_rq_runnable_avg(rq, 1);
+
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
@@ -1380,6 +1815,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 
 		update_cfs_load(cfs_rq, 0);
 		update_cfs_shares(cfs_rq);
+		update_entity_load_avg(se, 1);
 	}
 
 	hrtick_update(rq);
@@ -1430,9 +1866,8 @@ static long effective_load(struct task_group *tg, int cpu, long wl, long wg)
 		w = se->my_q->load.weight;
 
 		/* use this cpu's instantaneous contribution */
-		lw = atomic_read(&tg->load_weight);
-		lw -= se->my_q->load_contribution;
-		lw += w + wg;
+		lw = calc_tg_weight(tg, se->my_q);
+		lw += wg;
 
 		wl += w;
 
@@ -1623,9 +2058,287 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 	return idlest;
 }
 
+#define CAPACITY_MARGIN		1280	/* 80% */
+#define CAPACITY_LIGHT		(SCHED_POWER_SCALE / 4)
+
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * CPU capacity model
+ *
+ * The capacity of a cpu is the throughput it offers, relative to a cpu
+ * running alone on its core at the highest frequency in the system
+ * (SCHED_POWER_SCALE). It is scaled by the current frequency of the cpu,
+ * and by how busy its SMT siblings are: a hyperthread next to a busy one
+ * shares the execution resources of the core and gets about
+ * smt_gain / span_weight of it.
+ *
+ * The demand of a cpu or a task is the decayed fraction of time it was
+ * runnable, scaled by the capacity of the cpu it ran on, in the same units.
+ * A task fits on a cpu when the demand of both stays below 80% of its
+ * capacity (CAPACITY_MARGIN). Tasks runnable less than a quarter of the
+ * time (CAPACITY_LIGHT) are light.
+ */
+static DEFINE_PER_CPU(unsigned long, freq_capacity) = SCHED_POWER_SCALE;
+
+static inline unsigned long avg_util(struct sched_avg *sa)
+{
+	return (sa->runnable_avg_sum << SCHED_POWER_SHIFT) /
+		(sa->runnable_avg_period + 1);
+}
+
+static inline unsigned long cpu_util(int cpu)
+{
+	return avg_util(&cpu_rq(cpu)->avg);
+}
+
+static inline unsigned long task_util(struct task_struct *p)
+{
+	return avg_util(&p->se.avg);
+}
+
+/* The share of its core a cpu gets, given how busy its siblings are */
+static unsigned long smt_capacity(int cpu)
+{
+	struct sched_domain *sd;
+	unsigned long busy = 0, share;
+	int i;
+
+	sd = rcu_dereference_check_sched_domain(cpu_rq(cpu)->sd);
+	if (!sd || !(sd->flags & SD_SHARE_CPUPOWER) || sd->span_weight < 2)
+		return SCHED_POWER_SCALE;
+
+	for_each_cpu(i, sched_domain_span(sd)) {
+		if (i == cpu || idle_cpu(i))
+			continue;
+		busy = max(busy, cpu_util(i));
+	}
+
+	share = min_t(unsigned long, sd->smt_gain / sd->span_weight,
+		      SCHED_POWER_SCALE);
+	return SCHED_POWER_SCALE -
+		(((SCHED_POWER_SCALE - share) * busy) >> SCHED_POWER_SHIFT);
+}
+
+static unsigned long cpu_capacity(int cpu)
+{
+	return (per_cpu(freq_capacity, cpu) * smt_capacity(cpu)) >>
+		SCHED_POWER_SHIFT;
+}
+
+static unsigned long cpu_demand(int cpu)
+{
+	return (cpu_util(cpu) * cpu_capacity(cpu)) >> SCHED_POWER_SHIFT;
+}
+
+static unsigned long task_demand(struct task_struct *p)
+{
+	return (task_util(p) * cpu_capacity(task_cpu(p))) >>
+		SCHED_POWER_SHIFT;
+}
+
+static inline int capacity_fits(int cpu, unsigned long demand)
+{
+	return (cpu_demand(cpu) + demand) * CAPACITY_MARGIN <
+		cpu_capacity(cpu) * SCHED_POWER_SCALE;
+}
+
+/* Whether @cpu and all its SMT siblings are idle */
+static int core_idle(int cpu)
+{
+	struct sched_domain *sd;
+	int i;
+
+	sd = rcu_dereference_check_sched_domain(cpu_rq(cpu)->sd);
+	if (!sd || !(sd->flags & SD_SHARE_CPUPOWER))
+		return idle_cpu(cpu);
+
+	for_each_cpu(i, sched_domain_span(sd)) {
+		if (!idle_cpu(i))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Wakeup placement by the capacity model, within the domains of @target
+ * sharing its cache. A light task is packed onto the first busy cpu it
+ * fits on, @target first, so that the idle cpus and the siblings of the
+ * busy ones stay idle. A heavy task is spread to a core whose threads are
+ * all idle, where it has the execution resources to itself. Returns -1 to
+ * leave the choice to the idle cpu search.
+ */
+static int select_capacity_cpu(struct task_struct *p, int target)
+{
+	unsigned long demand = task_demand(p);
+	int light = task_util(p) < CAPACITY_LIGHT;
+	struct sched_domain *sd;
+	int i;
+
+	if (light ? !idle_cpu(target) && capacity_fits(target, demand) :
+		    core_idle(target))
+		return target;
+
+	for_each_domain(target, sd) {
+		if (!(sd->flags & SD_SHARE_PKG_RESOURCES))
+			break;
+
+		for_each_cpu_and(i, sched_domain_span(sd), &p->cpus_allowed) {
+			if (light ? !idle_cpu(i) && capacity_fits(i, demand) :
+				    core_idle(i))
+				return i;
+		}
+	}
+
+	return -1;
+}
+
+#ifdef CONFIG_CPU_FREQ
+/*
+ * The frequency part of the capacity, from the current frequency of each
+ * cpu and the highest frequency of all of them.
+ */
+static DEFINE_PER_CPU(unsigned int, capacity_cur_freq);
+static unsigned int capacity_max_freq;
+
+static void update_freq_capacity(int cpu)
+{
+	unsigned int cur = per_cpu(capacity_cur_freq, cpu);
+
+	if (!cur || !capacity_max_freq)
+		return;
+
+	per_cpu(freq_capacity, cpu) = min_t(unsigned long, SCHED_POWER_SCALE,
+		div_u64((u64)cur << SCHED_POWER_SHIFT, capacity_max_freq));
+}
+
+static int capacity_freq_transition(struct notifier_block *nb,
+				    unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+
+	if (val == CPUFREQ_POSTCHANGE) {
+		per_cpu(capacity_cur_freq, freqs->cpu) = freqs->new;
+		update_freq_capacity(freqs->cpu);
+	}
+	return 0;
+}
+
+static int capacity_freq_policy(struct notifier_block *nb,
+				unsigned long val, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	int cpu;
+
+	if (val != CPUFREQ_NOTIFY)
+		return 0;
+
+	for_each_cpu(cpu, policy->cpus)
+		per_cpu(capacity_cur_freq, cpu) = policy->cur;
+
+	if (policy->cpuinfo.max_freq > capacity_max_freq) {
+		capacity_max_freq = policy->cpuinfo.max_freq;
+		for_each_possible_cpu(cpu)
+			update_freq_capacity(cpu);
+	} else {
+		for_each_cpu(cpu, policy->cpus)
+			update_freq_capacity(cpu);
+	}
+	return 0;
+}
+
+static struct notifier_block capacity_freq_transition_nb = {
+	.notifier_call = capacity_freq_transition,
+};
+
+static struct notifier_block capacity_freq_policy_nb = {
+	.notifier_call = capacity_freq_policy,
+};
+
+static int __init sched_capacity_freq_init(void)
+{
+	cpufreq_register_notifier(&capacity_freq_policy_nb,
+				  CPUFREQ_POLICY_NOTIFIER);
+	cpufreq_register_notifier(&capacity_freq_transition_nb,
+				  CPUFREQ_TRANSITION_NOTIFIER);
+	return 0;
+}
+core_initcall(sched_capacity_freq_init);
+#endif /* CONFIG_CPU_FREQ */
+
+#ifdef CONFIG_SCHED_DEBUG
+static int sched_capacity_show(struct seq_file *m, void *v)
+{
+	int cpu;
+
+	seq_printf(m, "margin %d light %ld\n", CAPACITY_MARGIN,
+		   CAPACITY_LIGHT);
+	seq_printf(m, "%4s %8s %8s %8s %8s %8s %4s\n", "cpu", "freq",
+		   "smt", "capacity", "util", "demand", "nr");
+
+	rcu_read_lock();
+	for_each_online_cpu(cpu) {
+		seq_printf(m, "%4d %8lu %8lu %8lu %8lu %8lu %4lu\n", cpu,
+			   per_cpu(freq_capacity, cpu), smt_capacity(cpu),
+			   cpu_capacity(cpu), cpu_util(cpu), cpu_demand(cpu),
+			   cpu_rq(cpu)->nr_running);
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int sched_capacity_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_capacity_show, NULL);
+}
+
+static const struct file_operations sched_capacity_fops = {
+	.open		= sched_capacity_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static __init int sched_capacity_debug_init(void)
+{
+	debugfs_create_file("sched_capacity", 0444, NULL, NULL,
+			&sched_capacity_fops);
+	return 0;
+}
+late_initcall(sched_capacity_debug_init);
+#endif /* CONFIG_SCHED_DEBUG */
+#else
+static inline unsigned long cpu_capacity(int cpu)
+{
+	return 0;
+}
+
+static inline unsigned long cpu_demand(int cpu)
+{
+	return 0;
+}
+
+static inline int select_capacity_cpu(struct task_struct *p, int target)
+{
+	return -1;
+}
+#endif /* CONFIG_FAIR_GROUP_SCHED */
+
 /*
  * Try and locate an idle CPU in the sched_domain.
  */
+#ifdef CONFIG_FAIR_GROUP_SCHED
+static inline int task_prefer_idle(struct task_struct *p)
+{
+	return task_group(p)->prefer_idle;
+}
+#else
+static inline int task_prefer_idle(struct task_struct *p)
+{
+	return 0;
+}
+#endif
+
 static int select_idle_sibling(struct task_struct *p, int target)
 {
 	int cpu = smp_processor_id();
@@ -1633,6 +2346,15 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	struct sched_domain *sd;
 	int i;
 
+	/* packing would only delay the tasks of a prefer_idle group */
+	if (sched_feat(CAPACITY_MODEL) && !task_prefer_idle(p)) {
+		rcu_read_lock();
+		i = select_capacity_cpu(p, target);
+		rcu_read_unlock();
+		if (i >= 0)
+			return i;
+	}
+
 	/*
 	 * If the task is going to be woken-up on this cpu and if it is
 	 * already idle, then it is the right target.
@@ -1647,10 +2369,27 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	if (target == prev_cpu && idle_cpu(prev_cpu))
 		return prev_cpu;
 
+	rcu_read_lock();
+	/*
+	 * Tasks of a prefer_idle group would rather lose their cache than
+	 * wait for the target to go idle: look for an idle cpu in all the
+	 * domains of the target, not only in those sharing its cache.
+	 */
+	if (task_prefer_idle(p)) {
+		for_each_domain(target, sd) {
+			for_each_cpu_and(i, sched_domain_span(sd),
+					 &p->cpus_allowed) {
+				if (idle_cpu(i)) {
+					target = i;
+					goto unlock;
+				}
+			}
+		}
+	}
+
 	/*
 	 * Otherwise, iterate the domains and find an elegible idle cpu.
 	 */
-	rcu_read_lock();
 	for_each_domain(target, sd) {
 		if (!(sd->flags & SD_SHARE_PKG_RESOURCES))
 			break;
@@ -1670,6 +2409,7 @@ static int select_idle_sibling(struct task_struct *p, int target)
 		    cpumask_test_cpu(prev_cpu, sched_domain_span(sd)))
 			break;
 	}
+unlock:
 	rcu_read_unlock();
 
 	return target;
@@ -1924,7 +2664,8 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	find_matching_se(&se, &pse);
 	update_curr(cfs_rq_of(se));
 	BUG_ON(!pse);
-	if (wakeup_preempt_entity(se, pse) == 1) {
+	if (wakeup_preempt_entity(se, pse) == 1 ||
+	    latency_class_preempt(se, pse)) {
 		/*
 		 * Bias pick_next to pick the sched entity that is
 		 * triggering this preemption.
@@ -2218,6 +2959,8 @@ static int update_shares_cpu(struct task_group *tg, int cpu)
 	raw_spin_lock_irqsave(&rq->lock, flags);
 
 	update_rq_clock(rq);
+	update_cfs_rq_blocked_load(cfs_rq, 1);
+	update_entity_load_avg(tg->se[cpu], 1);
 	update_cfs_load(cfs_rq, 1);
 
 	/*
@@ -2371,6 +3114,8 @@ struct sd_lb_stats {
 	unsigned long busiest_group_capacity;
 	unsigned long busiest_has_capacity;
 	unsigned int  busiest_group_weight;
+	unsigned long busiest_demand;
+	unsigned long busiest_cpu_capacity;
 
 	int group_imb; /* Is there imbalance in this sd */
 #if defined(CONFIG_SCHED_MC) || defined(CONFIG_SCHED_SMT)
@@ -2396,6 +3141,8 @@ struct sg_lb_stats {
 	unsigned long group_weight;
 	int group_imb; /* Is there an imbalance in the group ? */
 	int group_has_capacity; /* Is there extra capacity in the group? */
+	unsigned long group_demand; /* Demand of the CPUs, capacity model */
+	unsigned long group_cpu_capacity; /* Capacity of the CPUs */
 };
 
 /**
@@ -2760,6 +3507,10 @@ static inline void update_sg_lb_stats(struct sched_domain *sd,
 		sgs->sum_weighted_load += weighted_cpuload(i);
 		if (idle_cpu(i))
 			sgs->idle_cpus++;
+		if (sched_feat(CAPACITY_MODEL)) {
+			sgs->group_demand += cpu_demand(i);
+			sgs->group_cpu_capacity += cpu_capacity(i);
+		}
 	}
 
 	/*
@@ -2914,6 +3665,8 @@ static inline void update_sd_lb_stats(struct sched_domain *sd, int this_cpu,
 			sds->busiest_load_per_task = sgs.sum_weighted_load;
 			sds->busiest_has_capacity = sgs.group_has_capacity;
 			sds->busiest_group_weight = sgs.group_weight;
+			sds->busiest_demand = sgs.group_demand;
+			sds->busiest_cpu_capacity = sgs.group_cpu_capacity;
 			sds->group_imb = sgs.group_imb;
 		}
 
@@ -3177,6 +3930,16 @@ find_busiest_group(struct sched_domain *sd, int this_cpu,
 	if (sds.group_imb)
 		goto force_balance;
 
+	/*
+	 * With the capacity model, the tasks of a busiest group which has
+	 * capacity to spare were packed there by wakeup placement, so that
+	 * the other cpus can stay idle: leave them.
+	 */
+	if (sched_feat(CAPACITY_MODEL) && sds.busiest_cpu_capacity &&
+	    sds.busiest_demand * CAPACITY_MARGIN <
+	    sds.busiest_cpu_capacity * SCHED_POWER_SCALE)
+		goto out_balanced;
+
 	/* SD_BALANCE_NEWIDLE trumps SMP nice when underutilized */
 	if (idle == CPU_NEWLY_IDLE && sds.this_has_capacity &&
 			!sds.busiest_has_capacity)
@@ -4126,6 +4889,8 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+	update_rq_runnable_avg(rq, 1);
 }
 
 /*
@@ -4255,6 +5020,11 @@ static void set_curr_task_fair(struct rq *rq)
 #ifdef CONFIG_FAIR_GROUP_SCHED
 static void task_move_group_fair(struct task_struct *p, int on_rq)
 {
+#ifdef CONFIG_SMP
+	struct cfs_rq *cfs_rq;
+	int blocked = 0;
+#endif
+
 	/*
 	 * If the task was not on the rq at the time of this cgroup movement
 	 * it must have been asleep, sleeping tasks keep their ->vruntime
@@ -4285,9 +5055,29 @@ static void task_move_group_fair(struct task_struct *p, int on_rq)
 
 	if (!on_rq)
 		p->se.vruntime -= cfs_rq_of(&p->se)->min_vruntime;
+#ifdef CONFIG_SMP
+	/* a sleeping task takes its blocked load along to the new group */
+	if (p->se.avg.decay_count > 0) {
+		cfs_rq = cfs_rq_of(&p->se);
+		__synchronize_entity_decay(&p->se);
+		subtract_blocked_load_contrib(cfs_rq,
+					      p->se.avg.load_avg_contrib);
+		update_cfs_rq_blocked_load(cfs_rq, 1);
+		blocked = 1;
+	}
+#endif
 	set_task_rq(p, task_cpu(p));
 	if (!on_rq)
 		p->se.vruntime += cfs_rq_of(&p->se)->min_vruntime;
+#ifdef CONFIG_SMP
+	if (blocked) {
+		cfs_rq = cfs_rq_of(&p->se);
+		cfs_rq->blocked_load_avg += p->se.avg.load_avg_contrib;
+		p->se.avg.decay_count = atomic64_read(&cfs_rq->decay_counter);
+		list_add_leaf_cfs_rq(cfs_rq);
+		update_cfs_rq_blocked_load(cfs_rq, 1);
+	}
+#endif
 }
 #endif
 
@@ -4323,6 +5113,9 @@ static const struct sched_class fair_sched_class = {
 
 #ifdef CONFIG_SMP
 	.select_task_rq		= select_task_rq_fair,
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	.migrate_task_rq	= migrate_task_rq_fair,
+#endif
 
 	.rq_online		= rq_online_fair,
 	.rq_offline		= rq_offline_fair,
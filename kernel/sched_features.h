@@ -49,6 +49,19 @@ SCHED_FEAT(CACHE_HOT_BUDDY, 1)
  */
 SCHED_FEAT(ARCH_POWER, 0)
 
+/*
+ * Compute group shares and effective_load() from the decayed per-entity
+ * load averages rather than the windowed cfs_rq load average.
+ */
+SCHED_FEAT(ENTITY_LOAD_AVG, 1)
+
+/*
+ * Place woken tasks and balance load by the cpu capacity model: pack
+ * light tasks onto busy cpus with spare capacity, spread heavy ones to
+ * idle cores. Off until measured on the target platforms.
+ */
+SCHED_FEAT(CAPACITY_MODEL, 0)
+
 SCHED_FEAT(HRTICK, 0)
 SCHED_FEAT(DOUBLE_TICK, 0)
 SCHED_FEAT(LB_BIAS, 1)
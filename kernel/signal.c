@@ -28,6 +28,7 @@
 #include <linux/freezer.h>
 #include <linux/pid_namespace.h>
 #include <linux/nsproxy.h>
+#include <linux/oom.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/signal.h>
 
@@ -1256,6 +1257,12 @@ retry:
 			 * new leader.
 			 */
 			goto retry;
+		/*
+		 * A process is usually SIGKILLed for its memory: let the oom
+		 * reaper free that while the process is still on its way out.
+		 */
+		if (!error && sig == SIGKILL && sysctl_reap_mem_on_sigkill)
+			wake_oom_reaper(p);
 	}
 	rcu_read_unlock();
 
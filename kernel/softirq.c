@@ -24,6 +24,8 @@
 #include <linux/ftrace.h>
 #include <linux/smp.h>
 #include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/sysctl.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/irq.h>
@@ -61,6 +63,74 @@ char *softirq_to_name[NR_SOFTIRQS] = {
 	"TASKLET", "SCHED", "HRTIMER", "RCU"
 };
 
+#ifdef CONFIG_SOFTIRQ_THREADS
+/*
+ * Threaded softirqs: with the softirq_threads boot parameter every vector
+ * has a thread of its own on each cpu.  Wherever the pending vectors
+ * would be run inline, they are instead handed to their threads: moved
+ * from the softirq pending mask to softirq_thread_pending and the threads
+ * woken.  A thread runs its vector's action like __do_softirq() would, in
+ * softirq context, and is preemptible between two runs.
+ */
+bool softirq_threads __read_mostly;
+
+static int __init setup_softirq_threads(char *arg)
+{
+	softirq_threads = true;
+	return 0;
+}
+early_param("softirq_threads", setup_softirq_threads);
+
+/*
+ * SCHED_FIFO priority of the vector threads, 0 for SCHED_NORMAL.  The
+ * timer vectors run above all normal tasks but below any real time one.
+ */
+int softirq_thread_prio[NR_SOFTIRQS] = {
+	[HI_SOFTIRQ]		= 1,
+	[TIMER_SOFTIRQ]		= 1,
+	[HRTIMER_SOFTIRQ]	= 1,
+};
+
+struct softirq_thread {
+	struct task_struct	*task;
+	unsigned int		nr;
+	unsigned int		cpu;
+};
+
+static DEFINE_PER_CPU(struct softirq_thread [NR_SOFTIRQS], softirq_thread);
+static DEFINE_PER_CPU(unsigned long, softirq_thread_pending);
+/* the threads of the cpu are up, softirqs are handed to them */
+static DEFINE_PER_CPU(bool, softirq_threads_up);
+
+static inline bool softirq_threaded(void)
+{
+	return softirq_threads && __this_cpu_read(softirq_threads_up);
+}
+
+/* Hand the pending vectors to their threads, with irqs disabled */
+static void softirq_wake_threads(void)
+{
+	__u32 pending = local_softirq_pending();
+	unsigned int nr;
+
+	set_softirq_pending(0);
+	__this_cpu_or(softirq_thread_pending, pending);
+
+	while (pending) {
+		nr = __ffs(pending);
+		pending &= pending - 1;
+		wake_up_process(__this_cpu_read(softirq_thread[nr].task));
+	}
+}
+#else
+static inline bool softirq_threaded(void)
+{
+	return false;
+}
+
+static inline void softirq_wake_threads(void) { }
+#endif /* CONFIG_SOFTIRQ_THREADS */
+
 /*
  * we cannot loop indefinitely here to avoid userspace starvation,
  * but we also don't want to introduce a worst case 1/HZ latency
@@ -72,6 +142,11 @@ static void wakeup_softirqd(void)
 	/* Interrupts are disabled: no need to stop preemption */
 	struct task_struct *tsk = __this_cpu_read(ksoftirqd);
 
+	if (softirq_threaded()) {
+		softirq_wake_threads();
+		return;
+	}
+
 	if (tsk && tsk->state != TASK_RUNNING)
 		wake_up_process(tsk);
 }
@@ -204,6 +279,35 @@ EXPORT_SYMBOL(local_bh_enable_ip);
  */
 #define MAX_SOFTIRQ_RESTART 10
 
+/* Run the action of vector @h in softirq context, with irqs enabled */
+static void softirq_run_action(struct softirq_action *h, int cpu)
+{
+	unsigned int vec_nr = h - softirq_vec;
+	int prev_count = preempt_count();
+#ifdef CONFIG_SOFTIRQ_THREADS
+	u64 start = local_clock();
+#endif
+
+	kstat_incr_softirqs_this_cpu(vec_nr);
+
+	trace_softirq_entry(vec_nr);
+	h->action(h);
+	trace_softirq_exit(vec_nr);
+#ifdef CONFIG_SOFTIRQ_THREADS
+	kstat_add_softirq_time_this_cpu(vec_nr, local_clock() - start);
+#endif
+	if (unlikely(prev_count != preempt_count())) {
+		printk(KERN_ERR "huh, entered softirq %u %s %p"
+		       "with preempt_count %08x,"
+		       " exited with %08x?\n", vec_nr,
+		       softirq_to_name[vec_nr], h->action,
+		       prev_count, preempt_count());
+		preempt_count() = prev_count;
+	}
+
+	rcu_bh_qs(cpu);
+}
+
 asmlinkage void __do_softirq(void)
 {
 	struct softirq_action *h;
@@ -211,6 +315,11 @@ asmlinkage void __do_softirq(void)
 	int max_restart = MAX_SOFTIRQ_RESTART;
 	int cpu;
 
+	if (softirq_threaded()) {
+		softirq_wake_threads();
+		return;
+	}
+
 	pending = local_softirq_pending();
 	account_system_vtime(current);
 
@@ -228,26 +337,8 @@ restart:
 	h = softirq_vec;
 
 	do {
-		if (pending & 1) {
-			unsigned int vec_nr = h - softirq_vec;
-			int prev_count = preempt_count();
-
-			kstat_incr_softirqs_this_cpu(vec_nr);
-
-			trace_softirq_entry(vec_nr);
-			h->action(h);
-			trace_softirq_exit(vec_nr);
-			if (unlikely(prev_count != preempt_count())) {
-				printk(KERN_ERR "huh, entered softirq %u %s %p"
-				       "with preempt_count %08x,"
-				       " exited with %08x?\n", vec_nr,
-				       softirq_to_name[vec_nr], h->action,
-				       prev_count, preempt_count());
-				preempt_count() = prev_count;
-			}
-
-			rcu_bh_qs(cpu);
-		}
+		if (pending & 1)
+			softirq_run_action(h, cpu);
 		h++;
 		pending >>= 1;
 	} while (pending);
@@ -784,6 +875,169 @@ wait_to_die:
 	return 0;
 }
 
+#ifdef CONFIG_SOFTIRQ_THREADS
+static int softirq_thread_fn(void *data)
+{
+	struct softirq_thread *st = data;
+	struct softirq_action *h = softirq_vec + st->nr;
+	unsigned long mask = 1UL << st->nr;
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	while (!kthread_should_stop()) {
+		preempt_disable();
+		if (!(__this_cpu_read(softirq_thread_pending) & mask)) {
+			preempt_enable_no_resched();
+			schedule();
+			preempt_disable();
+		}
+
+		__set_current_state(TASK_RUNNING);
+
+		while (__this_cpu_read(softirq_thread_pending) & mask) {
+			/* see run_ksoftirqd() */
+			if (cpu_is_offline(st->cpu))
+				goto wait_to_die;
+
+			local_irq_disable();
+			__this_cpu_and(softirq_thread_pending, ~mask);
+			account_system_vtime(current);
+			__local_bh_disable((unsigned long)__builtin_return_address(0),
+					   SOFTIRQ_OFFSET);
+			lockdep_softirq_enter();
+			local_irq_enable();
+
+			softirq_run_action(h, st->cpu);
+
+			local_irq_disable();
+			lockdep_softirq_exit();
+			account_system_vtime(current);
+			__local_bh_enable(SOFTIRQ_OFFSET);
+			/* the action may have raised vectors, own one included */
+			if (local_softirq_pending())
+				softirq_wake_threads();
+			local_irq_enable();
+
+			preempt_enable_no_resched();
+			cond_resched();
+			preempt_disable();
+			rcu_note_context_switch(st->cpu);
+		}
+		preempt_enable();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+
+wait_to_die:
+	preempt_enable();
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static void softirq_thread_setprio(struct task_struct *p, int prio)
+{
+	struct sched_param param = { .sched_priority = prio };
+
+	sched_setscheduler_nocheck(p, prio ? SCHED_FIFO : SCHED_NORMAL,
+				   &param);
+}
+
+static int __cpuinit softirq_threads_create(int cpu)
+{
+	struct softirq_thread *st;
+	struct task_struct *p;
+	int nr;
+
+	for (nr = 0; nr < NR_SOFTIRQS; nr++) {
+		st = &per_cpu(softirq_thread[nr], cpu);
+		st->nr = nr;
+		st->cpu = cpu;
+		p = kthread_create_on_node(softirq_thread_fn, st,
+					   cpu_to_node(cpu), "sirq/%d-%s",
+					   cpu, softirq_to_name[nr]);
+		if (IS_ERR(p)) {
+			printk(KERN_ERR "sirq/%d-%s failed\n", cpu,
+			       softirq_to_name[nr]);
+			return PTR_ERR(p);
+		}
+		kthread_bind(p, cpu);
+		softirq_thread_setprio(p, softirq_thread_prio[nr]);
+		st->task = p;
+	}
+	return 0;
+}
+
+/*
+ * @unbind is set when the threads never ran, as after a failed or canceled
+ * bringup: bound to a cpu which never came up they could not exit. Once
+ * they have run, the offlining of the cpu migrates them.
+ */
+static void softirq_threads_stop(int cpu, bool unbind)
+{
+	static const struct sched_param param = {
+		.sched_priority = MAX_RT_PRIO-1
+	};
+	struct softirq_thread *st;
+	int nr;
+
+	per_cpu(softirq_threads_up, cpu) = false;
+	for (nr = 0; nr < NR_SOFTIRQS; nr++) {
+		st = &per_cpu(softirq_thread[nr], cpu);
+		if (!st->task)
+			continue;
+		if (unbind)
+			kthread_bind(st->task, cpumask_any(cpu_online_mask));
+		sched_setscheduler_nocheck(st->task, SCHED_FIFO, &param);
+		kthread_stop(st->task);
+		st->task = NULL;
+	}
+	per_cpu(softirq_thread_pending, cpu) = 0;
+}
+
+static void __cpuinit softirq_threads_start(int cpu)
+{
+	int nr;
+
+	for (nr = 0; nr < NR_SOFTIRQS; nr++)
+		wake_up_process(per_cpu(softirq_thread[nr].task, cpu));
+	per_cpu(softirq_threads_up, cpu) = true;
+}
+
+int softirq_thread_prio_handler(struct ctl_table *table, int write,
+				void __user *buffer, size_t *lenp,
+				loff_t *ppos)
+{
+	int ret, cpu, nr;
+
+	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+	if (ret || !write || !softirq_threads)
+		return ret;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		for (nr = 0; nr < NR_SOFTIRQS; nr++) {
+			struct task_struct *p = per_cpu(softirq_thread[nr].task,
+							cpu);
+
+			if (p)
+				softirq_thread_setprio(p, softirq_thread_prio[nr]);
+		}
+	}
+	put_online_cpus();
+	return 0;
+}
+#else
+static inline int softirq_threads_create(int cpu) { return 0; }
+static inline void softirq_threads_stop(int cpu, bool unbind) { }
+static inline void softirq_threads_start(int cpu) { }
+#endif /* CONFIG_SOFTIRQ_THREADS */
+
 #ifdef CONFIG_HOTPLUG_CPU
 /*
  * tasklet_kill_immediate is called to remove a tasklet which can already be
@@ -863,14 +1117,25 @@ static int __cpuinit cpu_callback(struct notifier_block *nfb,
 		}
 		kthread_bind(p, hotcpu);
   		per_cpu(ksoftirqd, hotcpu) = p;
+		if (softirq_threads) {
+			int err = softirq_threads_create(hotcpu);
+
+			if (err) {
+				softirq_threads_stop(hotcpu, true);
+				return notifier_from_errno(err);
+			}
+		}
  		break;
 	case CPU_ONLINE:
 	case CPU_ONLINE_FROZEN:
 		wake_up_process(per_cpu(ksoftirqd, hotcpu));
+		if (softirq_threads)
+			softirq_threads_start(hotcpu);
 		break;
 #ifdef CONFIG_HOTPLUG_CPU
 	case CPU_UP_CANCELED:
 	case CPU_UP_CANCELED_FROZEN:
+		softirq_threads_stop(hotcpu, true);
 		if (!per_cpu(ksoftirqd, hotcpu))
 			break;
 		/* Unbind so it can run.  Fall thru. */
@@ -882,6 +1147,7 @@ static int __cpuinit cpu_callback(struct notifier_block *nfb,
 			.sched_priority = MAX_RT_PRIO-1
 		};
 
+		softirq_threads_stop(hotcpu, false);
 		p = per_cpu(ksoftirqd, hotcpu);
 		per_cpu(ksoftirqd, hotcpu) = NULL;
 		sched_setscheduler_nocheck(p, SCHED_FIFO, &param);
@@ -123,6 +123,73 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_ADAPTIVE
+/*
+ * CPUs which may defer their tick while they run a single task, and the
+ * ones of them which currently want to. The CPUs not in the adaptive mask
+ * are the housekeepers: while any CPU wants to defer, a housekeeper keeps
+ * its tick and the do_timer duty, even when idle.
+ */
+static cpumask_var_t nohz_adaptive_mask;
+static cpumask_var_t nohz_adaptive_want;
+static int nohz_adaptive_enabled __read_mostly;
+
+/* Longest a tick is deferred, in jiffies */
+#define NOHZ_ADAPTIVE_MAX_DEFER		HZ
+
+static int __init setup_nohz_adaptive(char *str)
+{
+	alloc_bootmem_cpumask_var(&nohz_adaptive_mask);
+	alloc_bootmem_cpumask_var(&nohz_adaptive_want);
+	if (cpulist_parse(str, nohz_adaptive_mask) < 0) {
+		printk(KERN_WARNING "NOHZ: invalid nohz_adaptive= list\n");
+		cpumask_clear(nohz_adaptive_mask);
+		return 1;
+	}
+	/* The boot CPU keeps the timekeeping */
+	if (cpumask_test_cpu(smp_processor_id(), nohz_adaptive_mask)) {
+		printk(KERN_WARNING "NOHZ: boot CPU %d can not be adaptive\n",
+		       smp_processor_id());
+		cpumask_clear_cpu(smp_processor_id(), nohz_adaptive_mask);
+	}
+	nohz_adaptive_enabled = !cpumask_empty(nohz_adaptive_mask);
+	return 1;
+}
+
+__setup("nohz_adaptive=", setup_nohz_adaptive);
+
+int tick_nohz_adaptive_cpu(int cpu)
+{
+	return nohz_adaptive_enabled && cpumask_test_cpu(cpu, nohz_adaptive_mask);
+}
+
+/*
+ * A housekeeper has to keep its tick, and with it the do_timer duty, when
+ * an adaptive CPU wants to defer its tick.
+ */
+static int tick_nohz_adaptive_needs_cpu(int cpu)
+{
+	if (!nohz_adaptive_enabled || cpumask_empty(nohz_adaptive_want))
+		return 0;
+	if (cpumask_test_cpu(cpu, nohz_adaptive_mask))
+		return 0;
+	return tick_do_timer_cpu == cpu ||
+		tick_do_timer_cpu == TICK_DO_TIMER_NONE;
+}
+
+/*
+ * An adaptive CPU which wants to defer its tick must not pick up the
+ * do_timer duty it just dropped.
+ */
+static int tick_nohz_adaptive_handoff(int cpu)
+{
+	return nohz_adaptive_enabled && cpumask_test_cpu(cpu, nohz_adaptive_want);
+}
+#else
+static inline int tick_nohz_adaptive_needs_cpu(int cpu) { return 0; }
+static inline int tick_nohz_adaptive_handoff(int cpu) { return 0; }
+#endif
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -283,6 +350,12 @@ void tick_nohz_stop_sched_tick(int inidle)
 	 */
 	ts->inidle = 1;
 
+#ifdef CONFIG_NO_HZ_ADAPTIVE
+	/* An idle adaptive cpu does not need a housekeeper */
+	if (tick_nohz_adaptive_handoff(cpu))
+		cpumask_clear_cpu(cpu, nohz_adaptive_want);
+#endif
+
 	now = tick_nohz_start_idle(cpu, ts);
 
 	/*
@@ -324,7 +397,7 @@ void tick_nohz_stop_sched_tick(int inidle)
 	} while (read_seqretry(&xtime_lock, seq));
 
 	if (rcu_needs_cpu(cpu) || printk_needs_cpu(cpu) ||
-	    arch_needs_cpu(cpu)) {
+	    arch_needs_cpu(cpu) || tick_nohz_adaptive_needs_cpu(cpu)) {
 		next_jiffies = last_jiffies + 1;
 		delta_jiffies = 1;
 	} else {
@@ -356,7 +429,9 @@ void tick_nohz_stop_sched_tick(int inidle)
 		 * above. Otherwise we can sleep as long as we want.
 		 */
 		if (cpu == tick_do_timer_cpu) {
-			tick_do_timer_cpu = TICK_DO_TIMER_NONE;
+			/* Keep the duty while an adaptive cpu defers its tick */
+			if (!tick_nohz_adaptive_needs_cpu(cpu))
+				tick_do_timer_cpu = TICK_DO_TIMER_NONE;
 			ts->do_timer_last = 1;
 		} else if (tick_do_timer_cpu != TICK_DO_TIMER_NONE) {
 			time_delta = KTIME_MAX;
@@ -466,18 +541,25 @@ ktime_t tick_nohz_get_sleep_length(void)
 	return ts->sleep_length;
 }
 
-static void tick_nohz_restart(struct tick_sched *ts, ktime_t now)
+/*
+ * Restart the tick after @last_tick. With @wakeup clear an expiry which
+ * already passed only marks HRTIMER_SOFTIRQ pending, without waking
+ * ksoftirqd, as callers holding a runqueue lock need.
+ */
+static void tick_nohz_restart(struct tick_sched *ts, ktime_t last_tick,
+			      ktime_t now, int wakeup)
 {
 	hrtimer_cancel(&ts->sched_timer);
-	hrtimer_set_expires(&ts->sched_timer, ts->idle_tick);
+	hrtimer_set_expires(&ts->sched_timer, last_tick);
 
 	while (1) {
 		/* Forward the time to expire in the future */
 		hrtimer_forward(&ts->sched_timer, now, tick_period);
 
 		if (ts->nohz_mode == NOHZ_MODE_HIGHRES) {
-			hrtimer_start_expires(&ts->sched_timer,
-					      HRTIMER_MODE_ABS_PINNED);
+			__hrtimer_start_range_ns(&ts->sched_timer,
+					hrtimer_get_expires(&ts->sched_timer), 0,
+					HRTIMER_MODE_ABS_PINNED, wakeup);
 			/* Check, if the timer was already in the past */
 			if (hrtimer_active(&ts->sched_timer))
 				break;
@@ -552,11 +634,207 @@ void tick_nohz_restart_sched_tick(void)
 	ts->tick_stopped  = 0;
 	ts->idle_exittime = now;
 
-	tick_nohz_restart(ts, now);
+	tick_nohz_restart(ts, ts->idle_tick, now, 1);
 
 	local_irq_restore(flags);
 }
 
+#ifdef CONFIG_NO_HZ_ADAPTIVE
+/*
+ * Adaptive tick: a cpu in the nohz_adaptive= list which runs a single task
+ * defers its tick up to the next timer wheel event, for at most a second.
+ * The scheduler has nothing to preempt, the timekeeping is left to a
+ * housekeeping cpu, and the deferral ends as soon as a second task is
+ * enqueued, the task schedules, or a resched IPI arrives (which is how RCU
+ * asks a cpu for a quiescent state).
+ */
+
+static int nohz_adaptive_housekeeper(void)
+{
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		if (!cpumask_test_cpu(cpu, nohz_adaptive_mask))
+			return cpu;
+	return nr_cpu_ids;
+}
+
+/* Posix cpu timers are run from the tick */
+static int tick_nohz_cpu_timers_armed(struct task_struct *p)
+{
+	if (!cputime_eq(p->cputime_expires.utime, cputime_zero) ||
+	    !cputime_eq(p->cputime_expires.stime, cputime_zero) ||
+	    p->cputime_expires.sum_exec_runtime)
+		return 1;
+	return p->signal->cputimer.running;
+}
+
+static int tick_nohz_adaptive_can_stop(int cpu)
+{
+	if (!sched_can_stop_tick())
+		return 0;
+	if (rcu_needs_cpu(cpu) || printk_needs_cpu(cpu) || arch_needs_cpu(cpu))
+		return 0;
+	return !tick_nohz_cpu_timers_armed(current);
+}
+
+/*
+ * Account the ticks which did not happen while deferred to the running
+ * task. @in_tick is set when called from the tick, which accounts its own
+ * jiffy.
+ */
+static void tick_nohz_adaptive_account(struct tick_sched *ts, int in_tick)
+{
+	unsigned long ticks = jiffies - ts->adaptive_jiffies;
+
+	/* We might be one off. Do not randomly account a huge number of ticks! */
+	if (ticks <= in_tick || ticks >= LONG_MAX)
+		return;
+	ticks -= in_tick;
+	ts->adaptive_ticks_avoided += ticks;
+#ifndef CONFIG_VIRT_CPU_ACCOUNTING
+	{
+		cputime_t t = jiffies_to_cputime(ticks);
+
+		if (ts->adaptive_user)
+			account_user_time(current, t, cputime_to_scaled(t));
+		else
+			account_system_time(current, hardirq_count(), t,
+					    cputime_to_scaled(t));
+	}
+#endif
+}
+
+/*
+ * Called from the tick of an adaptive cpu. Returns 1 when the tick timer
+ * was pushed out, 0 when the tick should be forwarded as usual.
+ */
+static int tick_nohz_adaptive_defer(struct tick_sched *ts, int cpu,
+				    struct pt_regs *regs, ktime_t now)
+{
+	unsigned long last_jiffies, delta_jiffies;
+	int housekeeper;
+
+	if (!tick_nohz_adaptive_cpu(cpu))
+		return 0;
+
+	housekeeper = nohz_adaptive_housekeeper();
+	if (!regs || ts->inidle || !current->pid ||
+	    ts->nohz_mode != NOHZ_MODE_HIGHRES ||
+	    housekeeper >= nr_cpu_ids || !tick_nohz_adaptive_can_stop(cpu)) {
+		cpumask_clear_cpu(cpu, nohz_adaptive_want);
+		return 0;
+	}
+	cpumask_set_cpu(cpu, nohz_adaptive_want);
+
+	/*
+	 * Hand the do_timer duty over. Until a housekeeper has picked it
+	 * up, this cpu keeps ticking; the housekeeper might be idle with
+	 * its tick stopped, so kick it.
+	 */
+	if (tick_do_timer_cpu == cpu)
+		tick_do_timer_cpu = TICK_DO_TIMER_NONE;
+	if (tick_do_timer_cpu == TICK_DO_TIMER_NONE) {
+		smp_send_reschedule(housekeeper);
+		return 0;
+	}
+
+	last_jiffies = jiffies;
+	delta_jiffies = get_next_timer_interrupt(last_jiffies) - last_jiffies;
+	if ((long)delta_jiffies <= 1)
+		return 0;
+	delta_jiffies = min_t(unsigned long, delta_jiffies,
+			      NOHZ_ADAPTIVE_MAX_DEFER);
+
+	/*
+	 * Pairs with the barrier in tick_nohz_adaptive_kick(): either the
+	 * enqueue of a second task sees us deferred and kicks us, or we see
+	 * the second task here.
+	 */
+	ts->adaptive_stopped = 1;
+	smp_mb();
+	if (!sched_can_stop_tick()) {
+		ts->adaptive_stopped = 0;
+		return 0;
+	}
+
+	ts->adaptive_tick = hrtimer_get_expires(&ts->sched_timer);
+	ts->adaptive_jiffies = last_jiffies;
+	ts->adaptive_user = user_mode(regs);
+	ts->adaptive_stops++;
+
+	hrtimer_forward(&ts->sched_timer, now, tick_period);
+	hrtimer_add_expires_ns(&ts->sched_timer,
+			       (delta_jiffies - 1) * ktime_to_ns(tick_period));
+	return 1;
+}
+
+/**
+ * tick_nohz_adaptive_exit - end a tick deferral on this cpu
+ *
+ * Accounts the deferred ticks to the running task and restarts the
+ * periodic tick. Called with interrupts disabled, from the scheduler also
+ * with the runqueue lock held, so the restart must not wake ksoftirqd.
+ */
+void tick_nohz_adaptive_exit(void)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (!ts->adaptive_stopped)
+		return;
+
+	ts->adaptive_stopped = 0;
+	cpumask_clear_cpu(cpu, nohz_adaptive_want);
+	tick_nohz_adaptive_account(ts, 0);
+	tick_nohz_restart(ts, ts->adaptive_tick, ktime_get(), 0);
+}
+
+/**
+ * tick_nohz_adaptive_pending - does a resched IPI have tick work to do
+ *
+ * True when this cpu deferred its tick, or when it is an idle housekeeper
+ * whose tick has to be restarted for an adaptive cpu.
+ */
+int tick_nohz_adaptive_pending(void)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (!nohz_adaptive_enabled)
+		return 0;
+	return ts->adaptive_stopped ||
+		(ts->tick_stopped && tick_nohz_adaptive_needs_cpu(cpu));
+}
+
+/**
+ * tick_nohz_adaptive_kick - a second task was enqueued on @cpu
+ *
+ * Called by the scheduler with the runqueue lock of @cpu held.
+ */
+void tick_nohz_adaptive_kick(int cpu)
+{
+	if (!nohz_adaptive_enabled)
+		return;
+
+	/* Pairs with the barrier in tick_nohz_adaptive_defer() */
+	smp_mb();
+	if (!per_cpu(tick_cpu_sched, cpu).adaptive_stopped)
+		return;
+
+	if (cpu == smp_processor_id())
+		tick_nohz_adaptive_exit();
+	else
+		smp_send_reschedule(cpu);
+}
+#else
+static inline int tick_nohz_adaptive_defer(struct tick_sched *ts, int cpu,
+					   struct pt_regs *regs, ktime_t now)
+{
+	return 0;
+}
+#endif
+
 static int tick_nohz_reprogram(struct tick_sched *ts, ktime_t now)
 {
 	hrtimer_forward(&ts->sched_timer, now, tick_period);
@@ -589,6 +867,8 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	if (tick_do_timer_cpu == cpu)
 		tick_do_update_jiffies64(now);
 
+	ts->nr_ticks++;
+
 	/*
 	 * When we are idle and the tick is stopped, we have to touch
 	 * the watchdog as we might not schedule for a really long
@@ -676,7 +956,7 @@ static void tick_nohz_kick_tick(int cpu, ktime_t now)
 	if (delta.tv64 <= tick_period.tv64)
 		return;
 
-	tick_nohz_restart(ts, now);
+	tick_nohz_restart(ts, ts->idle_tick, now, 1);
 #endif
 }
 
@@ -736,7 +1016,8 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_adaptive_handoff(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -744,6 +1025,15 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	if (tick_do_timer_cpu == cpu)
 		tick_do_update_jiffies64(now);
 
+	ts->nr_ticks++;
+#ifdef CONFIG_NO_HZ_ADAPTIVE
+	/* A deferred tick expired, catch up with the accounting */
+	if (ts->adaptive_stopped) {
+		ts->adaptive_stopped = 0;
+		tick_nohz_adaptive_account(ts, 1);
+	}
+#endif
+
 	/*
 	 * Do not call, when we are not in irq context and have
 	 * no valid regs pointer
@@ -765,6 +1055,11 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 		profile_tick(CPU_PROFILING);
 	}
 
+#ifdef CONFIG_NO_HZ
+	if (tick_nohz_adaptive_defer(ts, cpu, regs, now))
+		return HRTIMER_RESTART;
+#endif
+
 	hrtimer_forward(timer, now, tick_period);
 
 	return HRTIMER_RESTART;
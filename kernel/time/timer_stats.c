@@ -31,6 +31,12 @@
  * Display the information collected so far:
  * # cat /proc/timer_stats
  *
+ * An hrtimer which is expired by the interrupt of another timer, thanks
+ * to its slack or to a shared expiry time, is counted as a saved wakeup.
+ * With CONFIG_CGROUP_TIMER_SLACK the timeouts which woke the tasks of
+ * each timer_slack group, and the saved wakeups among them, are shown
+ * as well.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
@@ -65,9 +71,11 @@ struct entry {
 	pid_t			pid;
 
 	/*
-	 * Number of timeout events:
+	 * Number of timeout events, and of the ones which did not
+	 * need a wakeup of their own:
 	 */
 	unsigned long		count;
+	unsigned long		saved;
 	unsigned int		timer_flag;
 
 	/*
@@ -204,6 +212,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
 	if (curr) {
 		*curr = *entry;
 		curr->count = 0;
+		curr->saved = 0;
 		curr->next = NULL;
 		memcpy(curr->comm, comm, TASK_COMM_LEN);
 
@@ -227,6 +236,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
  * @startf:	pointer to the function which did the timer setup
  * @timerf:	pointer to the timer callback function of the timer
  * @comm:	name of the process which set up the timer
+ * @timer_flag:	TIMER_STATS_FLAG_*
  *
  * When the timer is already registered, then the event counter is
  * incremented. Otherwise the timer is registered in a free slot.
@@ -251,16 +261,18 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	input.start_func = startf;
 	input.expire_func = timerf;
 	input.pid = pid;
-	input.timer_flag = timer_flag;
+	input.timer_flag = timer_flag & ~TIMER_STATS_FLAG_SAVED;
 
 	raw_spin_lock_irqsave(lock, flags);
 	if (!timer_stats_active)
 		goto out_unlock;
 
 	entry = tstat_lookup(&input, comm);
-	if (likely(entry))
+	if (likely(entry)) {
 		entry->count++;
-	else
+		if (timer_flag & TIMER_STATS_FLAG_SAVED)
+			entry->saved++;
+	} else
 		atomic_inc(&overflow_count);
 
  out_unlock:
@@ -282,7 +294,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	struct timespec period;
 	struct entry *entry;
 	unsigned long ms;
-	long events = 0;
+	long events = 0, saved = 0;
 	ktime_t time;
 	int i;
 
@@ -298,7 +310,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	period = ktime_to_timespec(time);
 	ms = period.tv_nsec / 1000000;
 
-	seq_puts(m, "Timer Stats Version: v0.2\n");
+	seq_puts(m, "Timer Stats Version: v0.3\n");
 	seq_printf(m, "Sample period: %ld.%03ld s\n", period.tv_sec, ms);
 	if (atomic_read(&overflow_count))
 		seq_printf(m, "Overflow: %d entries\n",
@@ -317,9 +329,13 @@ static int tstats_show(struct seq_file *m, void *v)
 		print_name_offset(m, (unsigned long)entry->start_func);
 		seq_puts(m, " (");
 		print_name_offset(m, (unsigned long)entry->expire_func);
-		seq_puts(m, ")\n");
+		if (entry->saved)
+			seq_printf(m, ") [%lu saved]\n", entry->saved);
+		else
+			seq_puts(m, ")\n");
 
 		events += entry->count;
+		saved += entry->saved;
 	}
 
 	ms += period.tv_sec * 1000;
@@ -332,6 +348,9 @@ static int tstats_show(struct seq_file *m, void *v)
 			   (events * 1000000 / ms) % 1000);
 	else
 		seq_printf(m, "%ld total events\n", events);
+	seq_printf(m, "%ld saved wakeups\n", saved);
+
+	timer_slack_stats_show(m);
 
 	mutex_unlock(&show_mutex);
 
@@ -379,6 +398,7 @@ static ssize_t tstats_write(struct file *file, const char __user *buf,
 	case '1':
 		if (!timer_stats_active) {
 			reset_entries();
+			timer_slack_stats_start();
 			time_start = ktime_get();
 			smp_mb();
 			timer_stats_active = 1;
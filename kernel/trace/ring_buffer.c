@@ -6,6 +6,7 @@
 #define REALLY_WANT_DEBUGFS
 #include <linux/ring_buffer.h>
 #include <linux/trace_clock.h>
+#include <linux/trace_mmap.h>
 #include <linux/spinlock.h>
 #include <linux/debugfs.h>
 #include <linux/uaccess.h>
@@ -381,6 +382,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* index in the mapping */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -490,6 +492,7 @@ struct ring_buffer_per_cpu {
 	unsigned long			lost_events;
 	unsigned long			last_overrun;
 	local_t				commit_overrun;
+	local_t				dropped_events;
 	local_t				overrun;
 	local_t				entries;
 	local_t				committing;
@@ -497,6 +500,10 @@ struct ring_buffer_per_cpu {
 	unsigned long			read;
 	u64				write_stamp;
 	u64				read_stamp;
+	/* memory mapped reader, see ring_buffer_map() */
+	int				mapped;
+	struct trace_buffer_meta	*meta_page;
+	struct buffer_page		**subbuf_ids;
 };
 
 struct ring_buffer {
@@ -1344,6 +1351,16 @@ int ring_buffer_resize(struct ring_buffer *buffer, unsigned long size)
 	mutex_lock(&buffer->mutex);
 	get_online_cpus();
 
+	/* a mapped reader has the pages of its cpu buffer */
+	for_each_buffer_cpu(buffer, cpu) {
+		if (buffer->buffers[cpu]->mapped) {
+			put_online_cpus();
+			mutex_unlock(&buffer->mutex);
+			atomic_dec(&buffer->record_disabled);
+			return -EBUSY;
+		}
+	}
+
 	nr_pages = DIV_ROUND_UP(size, BUF_PAGE_SIZE);
 
 	if (size < buffer_size) {
@@ -1942,8 +1959,10 @@ rb_move_tail(struct ring_buffer_per_cpu *cpu_buffer,
 			 * If we are not in overwrite mode,
 			 * this is easy, just stop here.
 			 */
-			if (!(buffer->flags & RB_FL_OVERWRITE))
+			if (!(buffer->flags & RB_FL_OVERWRITE)) {
+				local_inc(&cpu_buffer->dropped_events);
 				goto out_reset;
+			}
 
 			ret = rb_handle_head_page(cpu_buffer,
 						  tail_page,
@@ -2706,6 +2725,43 @@ ring_buffer_commit_overrun_cpu(struct ring_buffer *buffer, int cpu)
 }
 EXPORT_SYMBOL_GPL(ring_buffer_commit_overrun_cpu);
 
+/**
+ * ring_buffer_dropped_events_cpu - get the number of events dropped
+ * @buffer: The ring buffer
+ * @cpu: The per CPU buffer to get the number of dropped events from
+ *
+ * Returns the number of events which were not written because the buffer
+ * was full and not in overwrite mode.
+ */
+unsigned long
+ring_buffer_dropped_events_cpu(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return 0;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	return local_read(&cpu_buffer->dropped_events);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_dropped_events_cpu);
+
+/**
+ * ring_buffer_read_events_cpu - get the number of events consumed
+ * @buffer: The ring buffer
+ * @cpu: The per CPU buffer to get the number of consumed events from
+ */
+unsigned long
+ring_buffer_read_events_cpu(struct ring_buffer *buffer, int cpu)
+{
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return 0;
+
+	return buffer->buffers[cpu]->read;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_read_events_cpu);
+
 /**
  * ring_buffer_entries - get the number of entries in a buffer
  * @buffer: The ring buffer
@@ -2874,6 +2930,23 @@ rb_update_iter_read_stamp(struct ring_buffer_iter *iter,
 	return;
 }
 
+/*
+ * Tell the mapped reader which sub-buffer it owns, and how the buffer
+ * is doing. Called with the reader_lock held.
+ */
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->reader.id = cpu_buffer->reader_page->id;
+	meta->reader.read = cpu_buffer->reader_page->read;
+
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+	meta->dropped = local_read(&cpu_buffer->dropped_events);
+}
+
 static struct buffer_page *
 rb_get_reader_page(struct ring_buffer_per_cpu *cpu_buffer)
 {
@@ -3514,6 +3587,7 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 	cpu_buffer->reader_page->read = 0;
 
 	local_set(&cpu_buffer->commit_overrun, 0);
+	local_set(&cpu_buffer->dropped_events, 0);
 	local_set(&cpu_buffer->overrun, 0);
 	local_set(&cpu_buffer->entries, 0);
 	local_set(&cpu_buffer->committing, 0);
@@ -3526,6 +3600,11 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 	cpu_buffer->lost_events = 0;
 	cpu_buffer->last_overrun = 0;
 
+	if (cpu_buffer->mapped) {
+		cpu_buffer->meta_page->reader.lost_events = 0;
+		rb_update_meta_page(cpu_buffer);
+	}
+
 	rb_head_page_activate(cpu_buffer);
 }
 
@@ -3678,6 +3757,12 @@ int ring_buffer_swap_cpu(struct ring_buffer *buffer_a,
 	cpu_buffer_a = buffer_a->buffers[cpu];
 	cpu_buffer_b = buffer_b->buffers[cpu];
 
+	ret = -EBUSY;
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped)
+		goto out;
+
+	ret = -EAGAIN;
+
 	if (atomic_read(&cpu_buffer_a->record_disabled))
 		goto out;
 
@@ -3829,6 +3914,12 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 
 	spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
 
+	/* the pages of a mapped buffer can not be swapped out */
+	if (cpu_buffer->mapped) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
 	reader = rb_get_reader_page(cpu_buffer);
 	if (!reader)
 		goto out_unlock;
@@ -3957,6 +4048,229 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+/**
+ * ring_buffer_map - prepare a cpu buffer for a memory mapped reader
+ * @buffer: the ring buffer
+ * @cpu: the cpu buffer to map
+ *
+ * Sets up the meta page of @cpu and numbers its sub-buffers, for
+ * ring_buffer_map_page() to hand out. The pages of a mapped cpu buffer
+ * stay where they are: the buffer can not be resized or swapped, and
+ * ring_buffer_read_page() fails with -EBUSY.
+ *
+ * Mappings nest, each must be paired with ring_buffer_unmap().
+ *
+ * Returns 0 on success, a negative errno otherwise.
+ */
+int ring_buffer_map(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct buffer_page **subbuf_ids;
+	struct trace_buffer_meta *meta;
+	struct buffer_page *head, *bpage;
+	unsigned id = 0;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+
+	if (cpu_buffer->mapped) {
+		cpu_buffer->mapped++;
+		goto out;
+	}
+
+	meta = (void *)get_zeroed_page(GFP_KERNEL);
+	subbuf_ids = kcalloc(buffer->pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	if (!meta || !subbuf_ids) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	spin_lock_irq(&cpu_buffer->reader_lock);
+
+	head = rb_set_head_page(cpu_buffer);
+	if (!head) {
+		spin_unlock_irq(&cpu_buffer->reader_lock);
+		ret = -EIO;
+		goto out_free;
+	}
+
+	/* The reader page is the first, then the ring from the head */
+	cpu_buffer->reader_page->id = id;
+	subbuf_ids[id++] = cpu_buffer->reader_page;
+	bpage = head;
+	do {
+		if (RB_WARN_ON(cpu_buffer, id > buffer->pages))
+			break;
+		bpage->id = id;
+		subbuf_ids[id++] = bpage;
+		rb_inc_page(cpu_buffer, &bpage);
+	} while (bpage != head);
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->subbuf_size = PAGE_SIZE;
+	meta->nr_subbufs = id;
+
+	cpu_buffer->meta_page = meta;
+	cpu_buffer->subbuf_ids = subbuf_ids;
+	cpu_buffer->mapped = 1;
+	rb_update_meta_page(cpu_buffer);
+
+	spin_unlock_irq(&cpu_buffer->reader_lock);
+	goto out;
+
+ out_free:
+	free_page((unsigned long)meta);
+	kfree(subbuf_ids);
+ out:
+	mutex_unlock(&buffer->mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_unmap - release a mapping of a cpu buffer
+ * @buffer: the ring buffer
+ * @cpu: the cpu buffer to unmap
+ *
+ * The last unmap frees the meta page. No page of the cpu buffer may be
+ * mapped any more by then.
+ */
+int ring_buffer_unmap(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct buffer_page **subbuf_ids;
+	struct trace_buffer_meta *meta;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+
+	if (!cpu_buffer->mapped) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	if (cpu_buffer->mapped > 1) {
+		cpu_buffer->mapped--;
+		goto out;
+	}
+
+	spin_lock_irq(&cpu_buffer->reader_lock);
+	meta = cpu_buffer->meta_page;
+	subbuf_ids = cpu_buffer->subbuf_ids;
+	cpu_buffer->meta_page = NULL;
+	cpu_buffer->subbuf_ids = NULL;
+	cpu_buffer->mapped = 0;
+	spin_unlock_irq(&cpu_buffer->reader_lock);
+
+	free_page((unsigned long)meta);
+	kfree(subbuf_ids);
+ out:
+	mutex_unlock(&buffer->mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_page - get a page of a mapped cpu buffer
+ * @buffer: the ring buffer
+ * @cpu: the mapped cpu buffer
+ * @pgoff: 0 for the meta page, 1 + id for the sub-buffer @id
+ *
+ * The caller must hold a mapping of @cpu. Returns NULL if @pgoff is past
+ * the last sub-buffer.
+ */
+struct page *ring_buffer_map_page(struct ring_buffer *buffer, int cpu,
+				  unsigned long pgoff)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return NULL;
+
+	cpu_buffer = buffer->buffers[cpu];
+	if (WARN_ON_ONCE(!cpu_buffer->mapped))
+		return NULL;
+
+	if (!pgoff)
+		return virt_to_page(cpu_buffer->meta_page);
+
+	if (pgoff > cpu_buffer->meta_page->nr_subbufs)
+		return NULL;
+
+	return virt_to_page(cpu_buffer->subbuf_ids[pgoff - 1]->page);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_page);
+
+/**
+ * ring_buffer_map_get_reader - advance the reader of a mapped cpu buffer
+ * @buffer: the ring buffer
+ * @cpu: the mapped cpu buffer
+ *
+ * The mapped reader sees the whole reader sub-buffer, so everything which
+ * is committed to it is consumed here. If nothing was left, the next
+ * sub-buffer is swapped in instead, and the events which were overwritten
+ * before it are reported in the meta page.
+ *
+ * The reader processes the reader sub-buffer up to its commit after every
+ * call. A new reader sub-buffer is processed from meta->reader.read on.
+ */
+int ring_buffer_map_get_reader(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct buffer_page *reader;
+	unsigned long flags;
+	unsigned size;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (!cpu_buffer->mapped) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	reader = cpu_buffer->reader_page;
+	size = rb_page_size(reader);
+	if (reader->read < size) {
+		while (reader->read < size)
+			rb_advance_reader(cpu_buffer);
+		goto out;
+	}
+
+	/* This may swap the reader page even if the new one is empty */
+	rb_get_reader_page(cpu_buffer);
+	if (cpu_buffer->reader_page != reader) {
+		cpu_buffer->meta_page->reader.lost_events =
+			cpu_buffer->lost_events;
+		cpu_buffer->lost_events = 0;
+	}
+
+ out:
+	rb_update_meta_page(cpu_buffer);
+ out_unlock:
+	spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 #ifdef CONFIG_TRACING
 static ssize_t
 rb_simple_read(struct file *filp, char __user *ubuf,
@@ -4,6 +4,7 @@
  * Copyright (C) 2009 Steven Rostedt <srostedt@redhat.com>
  */
 #include <linux/ring_buffer.h>
+#include <linux/trace_mmap.h>
 #include <linux/completion.h>
 #include <linux/kthread.h>
 #include <linux/module.h>
@@ -16,6 +17,11 @@ struct rb_page {
 	char		data[4080];
 };
 
+/* flags in the commit of a read page, see ring_buffer_read_page() */
+#define RB_MISSED_EVENTS	(1 << 31)
+#define RB_MISSED_STORED	(1 << 30)
+#define RB_COMMIT_MASK		0xfffff
+
 /* run time and sleep time in seconds */
 #define RUN_TIME	10
 #define SLEEP_TIME	10
@@ -31,6 +37,7 @@ static struct ring_buffer *buffer;
 static struct task_struct *producer;
 static struct task_struct *consumer;
 static unsigned long read;
+static unsigned long lost;
 
 static int disable_reader;
 module_param(disable_reader, uint, 0644);
@@ -58,7 +65,30 @@ MODULE_PARM_DESC(producer_fifo, "fifo prio for producer");
 module_param(consumer_fifo, uint, 0644);
 MODULE_PARM_DESC(consumer_fifo, "fifo prio for consumer");
 
-static int read_events;
+/* the consumer cycles through the ways to read the buffer */
+enum read_mode {
+	READ_EVENTS,
+	READ_PAGES,
+	READ_MAPPED,
+	NR_READ_MODES,
+};
+
+static const char *read_mode_names[NR_READ_MODES] = {
+	[READ_EVENTS]	= "events",
+	[READ_PAGES]	= "pages",
+	[READ_MAPPED]	= "mmap",
+};
+
+static int read_mode = NR_READ_MODES - 1;
+
+/* state of the mapped reader of a cpu buffer */
+struct mapped_reader {
+	int		mapped;
+	unsigned	id;	/* reader sub-buffer */
+	unsigned long	pos;	/* read up to here */
+};
+
+static DEFINE_PER_CPU(struct mapped_reader, mapped_readers);
 
 static int kill_test;
 
@@ -78,13 +108,16 @@ enum event_status {
 static enum event_status read_event(int cpu)
 {
 	struct ring_buffer_event *event;
+	unsigned long lost_events = 0;
 	int *entry;
 	u64 ts;
 
-	event = ring_buffer_consume(buffer, cpu, &ts, NULL);
+	event = ring_buffer_consume(buffer, cpu, &ts, &lost_events);
 	if (!event)
 		return EVENT_DROPPED;
 
+	lost += lost_events;
+
 	entry = ring_buffer_event_data(event);
 	if (*entry != cpu) {
 		KILL_TEST();
@@ -95,76 +128,87 @@ static enum event_status read_event(int cpu)
 	return EVENT_FOUND;
 }
 
-static enum event_status read_page(int cpu)
+/* Read the events of @rpage from offset @start up to @commit */
+static void read_page_events(struct rb_page *rpage, unsigned long start,
+			     unsigned long commit, int cpu)
 {
 	struct ring_buffer_event *event;
-	struct rb_page *rpage;
-	unsigned long commit;
-	void *bpage;
 	int *entry;
-	int ret;
 	int inc;
 	int i;
 
-	bpage = ring_buffer_alloc_read_page(buffer);
-	if (!bpage)
-		return EVENT_DROPPED;
+	for (i = start; i < commit && !kill_test; i += inc) {
 
-	ret = ring_buffer_read_page(buffer, &bpage, PAGE_SIZE, cpu, 1);
-	if (ret >= 0) {
-		rpage = bpage;
-		/* The commit may have missed event flags set, clear them */
-		commit = local_read(&rpage->commit) & 0xfffff;
-		for (i = 0; i < commit && !kill_test; i += inc) {
+		if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
+			KILL_TEST();
+			break;
+		}
 
-			if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
+		inc = -1;
+		event = (void *)&rpage->data[i];
+		switch (event->type_len) {
+		case RINGBUF_TYPE_PADDING:
+			/* failed writes may be discarded events */
+			if (!event->time_delta)
+				KILL_TEST();
+			inc = event->array[0] + 4;
+			break;
+		case RINGBUF_TYPE_TIME_EXTEND:
+			inc = 8;
+			break;
+		case 0:
+			entry = ring_buffer_event_data(event);
+			if (*entry != cpu) {
 				KILL_TEST();
 				break;
 			}
-
-			inc = -1;
-			event = (void *)&rpage->data[i];
-			switch (event->type_len) {
-			case RINGBUF_TYPE_PADDING:
-				/* failed writes may be discarded events */
-				if (!event->time_delta)
-					KILL_TEST();
-				inc = event->array[0] + 4;
-				break;
-			case RINGBUF_TYPE_TIME_EXTEND:
-				inc = 8;
-				break;
-			case 0:
-				entry = ring_buffer_event_data(event);
-				if (*entry != cpu) {
-					KILL_TEST();
-					break;
-				}
-				read++;
-				if (!event->array[0]) {
-					KILL_TEST();
-					break;
-				}
-				inc = event->array[0] + 4;
+			read++;
+			if (!event->array[0]) {
+				KILL_TEST();
 				break;
-			default:
-				entry = ring_buffer_event_data(event);
-				if (*entry != cpu) {
-					KILL_TEST();
-					break;
-				}
-				read++;
-				inc = ((event->type_len + 1) * 4);
 			}
-			if (kill_test)
-				break;
-
-			if (inc <= 0) {
+			inc = event->array[0] + 4;
+			break;
+		default:
+			entry = ring_buffer_event_data(event);
+			if (*entry != cpu) {
 				KILL_TEST();
 				break;
 			}
+			read++;
+			inc = ((event->type_len + 1) * 4);
+		}
+		if (kill_test)
+			break;
+
+		if (inc <= 0) {
+			KILL_TEST();
+			break;
 		}
 	}
+}
+
+static enum event_status read_page(int cpu)
+{
+	struct rb_page *rpage;
+	unsigned long commit;
+	void *bpage;
+	int ret;
+
+	bpage = ring_buffer_alloc_read_page(buffer);
+	if (!bpage)
+		return EVENT_DROPPED;
+
+	ret = ring_buffer_read_page(buffer, &bpage, PAGE_SIZE, cpu, 1);
+	if (ret >= 0) {
+		rpage = bpage;
+		commit = local_read(&rpage->commit);
+		if (commit & RB_MISSED_STORED)
+			lost += *(unsigned long *)
+				&rpage->data[commit & RB_COMMIT_MASK];
+		/* The commit may have missed event flags set, clear them */
+		read_page_events(rpage, 0, commit & RB_COMMIT_MASK, cpu);
+	}
 	ring_buffer_free_read_page(buffer, bpage);
 
 	if (ret < 0)
@@ -172,12 +216,70 @@ static enum event_status read_page(int cpu)
 	return EVENT_FOUND;
 }
 
+/*
+ * Read the sub-buffers in place, as a reader which mapped
+ * per_cpu/cpuN/trace_pipe_raw would.
+ */
+static enum event_status read_mapped(int cpu)
+{
+	struct mapped_reader *reader = &per_cpu(mapped_readers, cpu);
+	struct trace_buffer_meta *meta;
+	struct rb_page *rpage;
+	unsigned long commit;
+
+	if (!reader->mapped)
+		return EVENT_DROPPED;
+
+	if (ring_buffer_map_get_reader(buffer, cpu)) {
+		KILL_TEST();
+		return EVENT_DROPPED;
+	}
+
+	meta = page_address(ring_buffer_map_page(buffer, cpu, 0));
+	if (meta->reader.id != reader->id) {
+		reader->id = meta->reader.id;
+		reader->pos = meta->reader.read;
+		lost += meta->reader.lost_events;
+	}
+
+	rpage = page_address(ring_buffer_map_page(buffer, cpu,
+						  reader->id + 1));
+	commit = local_read(&rpage->commit) & RB_COMMIT_MASK;
+	if (reader->pos >= commit)
+		return EVENT_DROPPED;
+
+	read_page_events(rpage, reader->pos, commit, cpu);
+	reader->pos = commit;
+
+	return EVENT_FOUND;
+}
+
+static void ring_buffer_map_readers(int map)
+{
+	struct mapped_reader *reader;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		reader = &per_cpu(mapped_readers, cpu);
+		if (map) {
+			reader->mapped = !ring_buffer_map(buffer, cpu);
+			reader->id = -1;
+		} else if (reader->mapped) {
+			ring_buffer_unmap(buffer, cpu);
+			reader->mapped = 0;
+		}
+	}
+}
+
 static void ring_buffer_consumer(void)
 {
-	/* toggle between reading pages and events */
-	read_events ^= 1;
+	read_mode = (read_mode + 1) % NR_READ_MODES;
 
 	read = 0;
+	lost = 0;
+	if (read_mode == READ_MAPPED)
+		ring_buffer_map_readers(1);
+
 	while (!reader_finish && !kill_test) {
 		int found;
 
@@ -188,10 +290,16 @@ static void ring_buffer_consumer(void)
 			for_each_online_cpu(cpu) {
 				enum event_status stat;
 
-				if (read_events)
+				switch (read_mode) {
+				case READ_EVENTS:
 					stat = read_event(cpu);
-				else
+					break;
+				case READ_PAGES:
 					stat = read_page(cpu);
+					break;
+				default:
+					stat = read_mapped(cpu);
+				}
 
 				if (kill_test)
 					break;
@@ -207,6 +315,9 @@ static void ring_buffer_consumer(void)
 		schedule();
 		__set_current_state(TASK_RUNNING);
 	}
+	if (read_mode == READ_MAPPED)
+		ring_buffer_map_readers(0);
+
 	reader_finish = 0;
 	complete(&read_done);
 }
@@ -221,6 +332,7 @@ static void ring_buffer_producer(void)
 	unsigned long missed = 0;
 	unsigned long hit = 0;
 	unsigned long avg;
+	unsigned long rate;
 	int cnt = 0;
 
 	/*
@@ -315,9 +427,11 @@ static void ring_buffer_producer(void)
 	trace_printk("Overruns: %lld\n", overruns);
 	if (disable_reader)
 		trace_printk("Read:     (reader disabled)\n");
-	else
+	else {
 		trace_printk("Read:     %ld  (by %s)\n", read,
-			read_events ? "events" : "pages");
+			read_mode_names[read_mode]);
+		trace_printk("Lost:     %ld\n", lost);
+	}
 	trace_printk("Entries:  %lld\n", entries);
 	trace_printk("Total:    %lld\n", entries + overruns + read);
 	trace_printk("Missed:   %ld\n", missed);
@@ -332,6 +446,11 @@ static void ring_buffer_producer(void)
 
 	trace_printk("Entries per millisec: %ld\n", hit);
 
+	if (!disable_reader && time) {
+		rate = read / (long)time;
+		trace_printk("Read per millisec: %ld\n", rate);
+	}
+
 	if (hit) {
 		/* Calculate the average time in nanosecs */
 		avg = NSEC_PER_MSEC / hit;
@@ -13,6 +13,7 @@
  */
 #define REALLY_WANT_DEBUGFS
 #include <linux/ring_buffer.h>
+#include <linux/trace_mmap.h>
 #include <generated/utsrelease.h>
 #include <linux/stacktrace.h>
 #include <linux/writeback.h>
@@ -2853,6 +2854,13 @@ struct trace_option_dentry;
 static struct trace_option_dentry *
 create_trace_option_files(struct tracer *tracer);
 
+/*
+ * Number of mappings of trace_pipe_raw files, protected by
+ * trace_types_lock. The pages of a mapped buffer stay in place, which
+ * rules out the tracers that swap buffers with max_tr.
+ */
+static int tracing_buffers_mapped;
+
 static void
 destroy_trace_option_files(struct trace_option_dentry *topts);
 
@@ -2883,6 +2891,12 @@ static int tracing_set_tracer(const char *buf)
 	if (t == current_trace)
 		goto out;
 
+	/* see tracing_buffers_mapped */
+	if (t->use_max_tr && tracing_buffers_mapped) {
+		ret = -EBUSY;
+		goto out;
+	}
+
 	trace_branch_disable();
 	if (current_trace && current_trace->reset)
 		current_trace->reset(tr);
@@ -3716,6 +3730,8 @@ tracing_buffers_read(struct file *filp, char __user *ubuf,
 				    count,
 				    info->cpu, 0);
 	trace_access_unlock(info->cpu);
+	if (ret == -EBUSY)
+		return ret;
 	if (ret < 0)
 		return 0;
 
@@ -3826,6 +3842,7 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	};
 	struct buffer_ref *ref;
 	int entries, size, i;
+	int busy = 0;
 	size_t ret;
 
 	if (splice_grow_spd(pipe, &spd))
@@ -3871,6 +3888,7 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 			ring_buffer_free_read_page(ref->buffer,
 						   ref->page);
 			kfree(ref);
+			busy = r == -EBUSY;
 			break;
 		}
 
@@ -3899,7 +3917,9 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 
 	/* did we read anything? */
 	if (!spd.nr_pages) {
-		if (flags & SPLICE_F_NONBLOCK)
+		if (busy)
+			ret = -EBUSY;
+		else if (flags & SPLICE_F_NONBLOCK)
 			ret = -EAGAIN;
 		else
 			ret = 0;
@@ -3913,11 +3933,96 @@ out:
 	return ret;
 }
 
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+
+	mutex_lock(&trace_types_lock);
+	if (!WARN_ON(ring_buffer_map(info->tr->buffer, info->cpu)))
+		tracing_buffers_mapped++;
+	mutex_unlock(&trace_types_lock);
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+
+	mutex_lock(&trace_types_lock);
+	if (!WARN_ON(ring_buffer_unmap(info->tr->buffer, info->cpu)))
+		tracing_buffers_mapped--;
+	mutex_unlock(&trace_types_lock);
+}
+
+static int tracing_buffers_mmap_fault(struct vm_area_struct *vma,
+				      struct vm_fault *vmf)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+
+	vmf->page = ring_buffer_map_page(info->tr->buffer, info->cpu,
+					 vmf->pgoff);
+	if (!vmf->page)
+		return VM_FAULT_SIGBUS;
+
+	get_page(vmf->page);
+	return 0;
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+	.fault		= tracing_buffers_mmap_fault,
+};
+
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	int ret;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	mutex_lock(&trace_types_lock);
+	if (current_trace && current_trace->use_max_tr) {
+		ret = -EBUSY;
+		goto out;
+	}
+	ret = ring_buffer_map(info->tr->buffer, info->cpu);
+	if (ret)
+		goto out;
+	tracing_buffers_mapped++;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_RESERVED | VM_DONTEXPAND;
+	vma->vm_ops = &tracing_buffers_vmops;
+ out:
+	mutex_unlock(&trace_types_lock);
+
+	return ret;
+}
+
+static long tracing_buffers_ioctl(struct file *filp, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	int ret;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOTTY;
+
+	trace_access_lock(info->cpu);
+	ret = ring_buffer_map_get_reader(info->tr->buffer, info->cpu);
+	trace_access_unlock(info->cpu);
+
+	return ret;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
+	.mmap		= tracing_buffers_mmap,
+	.unlocked_ioctl	= tracing_buffers_ioctl,
 	.llseek		= no_llseek,
 };
 
@@ -3945,6 +4050,12 @@ tracing_stats_read(struct file *filp, char __user *ubuf,
 	cnt = ring_buffer_commit_overrun_cpu(tr->buffer, cpu);
 	trace_seq_printf(s, "commit overrun: %ld\n", cnt);
 
+	cnt = ring_buffer_dropped_events_cpu(tr->buffer, cpu);
+	trace_seq_printf(s, "dropped events: %ld\n", cnt);
+
+	cnt = ring_buffer_read_events_cpu(tr->buffer, cpu);
+	trace_seq_printf(s, "read events: %ld\n", cnt);
+
 	count = simple_read_from_buffer(ubuf, count, ppos, s->buffer, s->len);
 
 	kfree(s);
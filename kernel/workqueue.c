@@ -41,6 +41,9 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/hash.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_sched.h"
 
@@ -128,6 +131,7 @@ struct worker {
 	};
 
 	struct work_struct	*current_work;	/* L: work being processed */
+	work_func_t		current_func;	/* L: current_work's fn */
 	struct cpu_workqueue_struct *current_cwq; /* L: current_work's cwq */
 	struct list_head	scheduled;	/* L: scheduled works */
 	struct task_struct	*task;		/* I: worker task */
@@ -167,6 +171,16 @@ struct global_cwq {
 	unsigned int		trustee_state;	/* L: trustee state */
 	wait_queue_head_t	trustee_wait;	/* trustee wait */
 	struct worker		*first_idle;	/* L: first idle worker */
+
+#ifdef CONFIG_WQ_STATS
+	struct wq_func_stat	*func_stats;	/* L: per work function */
+	unsigned long		nr_func_dropped; /* L: works not accounted */
+	unsigned long		nr_maydays;	/* L: rescuers summoned */
+	unsigned long		nr_rescued;	/* L: works run by rescuers */
+	unsigned long		nr_stalls;	/* L: stalls detected */
+	unsigned long		last_progress;	/* L: jiffies of last start */
+	bool			stalled;	/* L: stall reported */
+#endif
 } ____cacheline_aligned_in_smp;
 
 /*
@@ -907,6 +921,163 @@ static inline struct list_head *gcwq_determine_ins_pos(struct global_cwq *gcwq,
 	return &twork->entry;
 }
 
+#ifdef CONFIG_WQ_STATS
+/*
+ * Workqueue statistics.  Every gcwq keeps a small hash table, keyed by
+ * work function, of how long the works waited between being queued and
+ * starting to execute, and how long they ran, both as log2 histograms
+ * of microseconds.  The table is updated under gcwq->lock when a worker
+ * comes back from the work function, the same lock it takes anyway.
+ *
+ * A gcwq with pending works which has not started one for
+ * wq_stall_thresh seconds is reported as stalled, once until it makes
+ * progress again.
+ */
+enum {
+	WQ_STATS_FUNC_BITS	= 7,
+	WQ_STATS_FUNCS		= 1 << WQ_STATS_FUNC_BITS, /* per gcwq */
+	WQ_STATS_HIST		= 20,	/* <1us, <2us, ... >=256ms */
+};
+
+struct wq_func_stat {
+	work_func_t		func;
+	unsigned long		nr;
+	u64			delay_sum;
+	u64			delay_max;
+	u64			run_sum;
+	u64			run_max;
+	unsigned int		delay_hist[WQ_STATS_HIST];
+	unsigned int		run_hist[WQ_STATS_HIST];
+};
+
+static unsigned int wq_stall_thresh = 30;	/* seconds, 0 to disable */
+
+static void wq_stall_timer_fn(unsigned long data);
+static DEFINE_TIMER(wq_stall_timer, wq_stall_timer_fn, 0, 0);
+static bool wq_stall_timer_ready;	/* set once timers can be armed */
+
+/* The timer stops while the threshold is 0; setting one starts it again */
+static int wq_stall_thresh_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret && wq_stall_timer_ready && wq_stall_thresh)
+		mod_timer(&wq_stall_timer, round_jiffies(jiffies + HZ));
+	return ret;
+}
+
+static struct kernel_param_ops wq_stall_thresh_ops = {
+	.set	= wq_stall_thresh_set,
+	.get	= param_get_uint,
+};
+module_param_cb(stall_thresh, &wq_stall_thresh_ops, &wq_stall_thresh, 0644);
+
+static void wq_stats_touch(struct global_cwq *gcwq)
+{
+	/* an idle gcwq starts its stall clock with the first pending work */
+	if (list_empty(&gcwq->worklist))
+		gcwq->last_progress = jiffies;
+}
+
+static void wq_stats_insert(struct global_cwq *gcwq, struct work_struct *work)
+{
+	work->queued_at = local_clock();
+	wq_stats_touch(gcwq);
+}
+
+static inline u64 wq_stats_queued(struct work_struct *work)
+{
+	return work->queued_at;
+}
+
+static inline u64 wq_stats_clock(void)
+{
+	return local_clock();
+}
+
+static void wq_stats_start(struct global_cwq *gcwq)
+{
+	gcwq->last_progress = jiffies;
+	gcwq->stalled = false;
+}
+
+static void wq_stats_hist(unsigned int *hist, u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+
+	hist[min(us ? fls64(us) : 0, WQ_STATS_HIST - 1)]++;
+}
+
+/*
+ * Account a work of @func which was queued at @queued, started at @start
+ * and returned at @end.  Unbound workers may move between cpus, whose
+ * clocks are not synchronized, hence the clamping.
+ */
+static void wq_stats_account(struct global_cwq *gcwq, work_func_t func,
+			     u64 queued, u64 start, u64 end)
+{
+	u64 delay = start > queued ? start - queued : 0;
+	u64 run = end > start ? end - start : 0;
+	struct wq_func_stat *st = NULL;
+	unsigned long hash;
+	int i;
+
+	trace_workqueue_work_latency(func, gcwq->cpu, delay, run);
+
+	if (!gcwq->func_stats)
+		return;
+
+	hash = hash_ptr(func, WQ_STATS_FUNC_BITS);
+	for (i = 0; i < WQ_STATS_FUNCS; i++) {
+		st = &gcwq->func_stats[(hash + i) & (WQ_STATS_FUNCS - 1)];
+		if (st->func == func || !st->func)
+			break;
+	}
+	if (i == WQ_STATS_FUNCS) {
+		gcwq->nr_func_dropped++;
+		return;
+	}
+
+	st->func = func;
+	st->nr++;
+	st->delay_sum += delay;
+	st->delay_max = max(st->delay_max, delay);
+	wq_stats_hist(st->delay_hist, delay);
+	st->run_sum += run;
+	st->run_max = max(st->run_max, run);
+	wq_stats_hist(st->run_hist, run);
+}
+
+static inline void wq_stats_mayday(struct global_cwq *gcwq)
+{
+	gcwq->nr_maydays++;
+}
+
+static inline void wq_stats_rescued(struct global_cwq *gcwq)
+{
+	gcwq->nr_rescued++;
+}
+
+static void wq_stats_init_gcwq(struct global_cwq *gcwq)
+{
+	gcwq->func_stats = kcalloc(WQ_STATS_FUNCS, sizeof(struct wq_func_stat),
+				   GFP_KERNEL);
+	gcwq->last_progress = jiffies;
+}
+#else	/* CONFIG_WQ_STATS */
+static inline void wq_stats_touch(struct global_cwq *gcwq) { }
+static inline void wq_stats_insert(struct global_cwq *gcwq,
+				   struct work_struct *work) { }
+static inline u64 wq_stats_queued(struct work_struct *work) { return 0; }
+static inline u64 wq_stats_clock(void) { return 0; }
+static inline void wq_stats_start(struct global_cwq *gcwq) { }
+static inline void wq_stats_account(struct global_cwq *gcwq, work_func_t func,
+				    u64 queued, u64 start, u64 end) { }
+static inline void wq_stats_mayday(struct global_cwq *gcwq) { }
+static inline void wq_stats_rescued(struct global_cwq *gcwq) { }
+static inline void wq_stats_init_gcwq(struct global_cwq *gcwq) { }
+#endif	/* CONFIG_WQ_STATS */
+
 /**
  * insert_work - insert a work into gcwq
  * @cwq: cwq @work belongs to
@@ -928,6 +1099,7 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 
 	/* we own @work, set data and link */
 	set_work_cwq(work, cwq, extra_flags);
+	wq_stats_insert(gcwq, work);
 
 	/*
 	 * Ensure that we get the right work->data if we see the
@@ -1505,8 +1677,11 @@ static bool send_mayday(struct work_struct *work)
 	/* WORK_CPU_UNBOUND can't be set in cpumask, use cpu 0 instead */
 	if (cpu == WORK_CPU_UNBOUND)
 		cpu = 0;
-	if (!mayday_test_and_set_cpu(cpu, wq->mayday_mask))
+	if (!mayday_test_and_set_cpu(cpu, wq->mayday_mask)) {
+		trace_workqueue_mayday(cwq);
+		wq_stats_mayday(cwq->gcwq);
 		wake_up_process(wq->rescuer->task);
+	}
 	return true;
 }
 
@@ -1732,6 +1907,7 @@ static void cwq_activate_first_delayed(struct cpu_workqueue_struct *cwq)
 	struct list_head *pos = gcwq_determine_ins_pos(cwq->gcwq, cwq);
 
 	trace_workqueue_activate_work(work);
+	wq_stats_touch(cwq->gcwq);
 	move_linked_works(work, pos, NULL);
 	__clear_bit(WORK_STRUCT_DELAYED_BIT, work_data_bits(work));
 	cwq->nr_active++;
@@ -1809,6 +1985,7 @@ __acquires(&gcwq->lock)
 	struct hlist_head *bwh = busy_worker_head(gcwq, work);
 	bool cpu_intensive = cwq->wq->flags & WQ_CPU_INTENSIVE;
 	work_func_t f = work->func;
+	u64 queued = wq_stats_queued(work), start, end;
 	int work_color;
 	struct worker *collision;
 #ifdef CONFIG_LOCKDEP
@@ -1837,8 +2014,10 @@ __acquires(&gcwq->lock)
 	debug_work_deactivate(work);
 	hlist_add_head(&worker->hentry, bwh);
 	worker->current_work = work;
+	worker->current_func = f;
 	worker->current_cwq = cwq;
 	work_color = get_work_color(work);
+	wq_stats_start(gcwq);
 
 	/* record the current cpu number in the work data and dequeue */
 	set_work_cpu(work, gcwq->cpu);
@@ -1872,7 +2051,9 @@ __acquires(&gcwq->lock)
 	lock_map_acquire_read(&cwq->wq->lockdep_map);
 	lock_map_acquire(&lockdep_map);
 	trace_workqueue_execute_start(work);
+	start = wq_stats_clock();
 	f(work);
+	end = wq_stats_clock();
 	/*
 	 * While we must be careful to not use "work" after this, the trace
 	 * point will only record its address.
@@ -1897,9 +2078,12 @@ __acquires(&gcwq->lock)
 	if (unlikely(cpu_intensive))
 		worker_clr_flags(worker, WORKER_CPU_INTENSIVE);
 
+	wq_stats_account(gcwq, f, queued, start, end);
+
 	/* we're done with it, release */
 	hlist_del_init(&worker->hentry);
 	worker->current_work = NULL;
+	worker->current_func = NULL;
 	worker->current_cwq = NULL;
 	cwq_dec_nr_in_flight(cwq, work_color, false);
 }
@@ -2067,9 +2251,12 @@ repeat:
 		 * process'em.
 		 */
 		BUG_ON(!list_empty(&rescuer->scheduled));
-		list_for_each_entry_safe(work, n, &gcwq->worklist, entry)
-			if (get_work_cwq(work) == cwq)
+		list_for_each_entry_safe(work, n, &gcwq->worklist, entry) {
+			if (get_work_cwq(work) == cwq) {
 				move_linked_works(work, scheduled, &n);
+				wq_stats_rescued(gcwq);
+			}
+		}
 
 		process_scheduled_works(rescuer);
 
@@ -3749,6 +3936,225 @@ out_unlock:
 }
 #endif /* CONFIG_FREEZER */
 
+#ifdef CONFIG_WQ_STATS
+static const char *gcwq_name(struct global_cwq *gcwq, char *buf, size_t len)
+{
+	if (gcwq->cpu == WORK_CPU_UNBOUND)
+		return "unbound";
+	snprintf(buf, len, "cpu%u", gcwq->cpu);
+	return buf;
+}
+
+static void wq_stall_check(struct global_cwq *gcwq, unsigned long thresh)
+{
+	struct work_struct *work;
+	struct worker *worker;
+	struct hlist_node *pos;
+	unsigned long flags;
+	unsigned int stalled;
+	char name[16];
+	int i;
+
+	spin_lock_irqsave(&gcwq->lock, flags);
+
+	/* works of freezable workqueues are held back while freezing */
+	if (gcwq->stalled || list_empty(&gcwq->worklist) ||
+	    gcwq->flags & GCWQ_FREEZING ||
+	    time_before(jiffies, gcwq->last_progress + thresh))
+		goto out_unlock;
+
+	gcwq->stalled = true;
+	gcwq->nr_stalls++;
+	stalled = jiffies_to_msecs(jiffies - gcwq->last_progress);
+	work = list_first_entry(&gcwq->worklist, struct work_struct, entry);
+	trace_workqueue_stall(gcwq->cpu, work->func, stalled,
+			      atomic_read(get_gcwq_nr_running(gcwq->cpu)),
+			      gcwq->nr_idle);
+
+	printk(KERN_WARNING "workqueue: %s stalled for %u ms, nr_running %d, "
+	       "%d of %d workers idle, first pending %pf\n",
+	       gcwq_name(gcwq, name, sizeof(name)), stalled,
+	       atomic_read(get_gcwq_nr_running(gcwq->cpu)), gcwq->nr_idle,
+	       gcwq->nr_workers, work->func);
+	for_each_busy_worker(worker, i, pos, gcwq)
+		printk(KERN_WARNING "  %s/%d executing %pf\n",
+		       worker->task->comm, task_pid_nr(worker->task),
+		       worker->current_func);
+out_unlock:
+	spin_unlock_irqrestore(&gcwq->lock, flags);
+}
+
+static void wq_stall_timer_fn(unsigned long data)
+{
+	unsigned long thresh = ACCESS_ONCE(wq_stall_thresh) * HZ;
+	unsigned int cpu;
+
+	if (!thresh)
+		return;
+
+	if (!workqueue_freezing) {
+		for_each_online_gcwq_cpu(cpu)
+			wq_stall_check(get_gcwq(cpu), thresh);
+	}
+
+	/* look again after a quarter of the threshold */
+	mod_timer(&wq_stall_timer,
+		  round_jiffies(jiffies + max(thresh / 4, (unsigned long)HZ)));
+}
+
+static int wq_pools_show(struct seq_file *m, void *v)
+{
+	unsigned int cpu;
+	char name[16];
+
+	seq_printf(m, "%-8s %7s %7s %5s %7s %7s %7s %6s %11s\n", "# pool",
+		   "running", "workers", "idle", "pending", "maydays",
+		   "rescued", "stalls", "progress_ms");
+
+	for_each_gcwq_cpu(cpu) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
+		struct work_struct *work;
+		int pending = 0;
+
+		spin_lock_irq(&gcwq->lock);
+		list_for_each_entry(work, &gcwq->worklist, entry)
+			pending++;
+		seq_printf(m, "%-8s %7d %7d %5d %7d %7lu %7lu %6lu %11u\n",
+			   gcwq_name(gcwq, name, sizeof(name)),
+			   atomic_read(get_gcwq_nr_running(cpu)),
+			   gcwq->nr_workers, gcwq->nr_idle, pending,
+			   gcwq->nr_maydays, gcwq->nr_rescued, gcwq->nr_stalls,
+			   jiffies_to_msecs(jiffies - gcwq->last_progress));
+		spin_unlock_irq(&gcwq->lock);
+	}
+	return 0;
+}
+
+static int wq_pools_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_pools_show, NULL);
+}
+
+static const struct file_operations wq_pools_fops = {
+	.open		= wq_pools_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int wq_functions_show(struct seq_file *m, void *v)
+{
+	bool hist = m->private;
+	unsigned int cpu;
+	char name[16];
+	int i, j;
+
+	if (hist) {
+		seq_puts(m, "# log2 histograms, bucket upper bounds in us:");
+		for (j = 0; j < WQ_STATS_HIST - 1; j++)
+			seq_printf(m, " %u", 1U << j);
+		seq_puts(m, " inf\n");
+	} else {
+		seq_printf(m, "%-8s %9s %11s %11s %11s %11s  %s\n", "# pool",
+			   "works", "delay_avg", "delay_max", "run_avg",
+			   "run_max", "function (times in us)");
+	}
+
+	for_each_gcwq_cpu(cpu) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
+
+		if (!gcwq->func_stats)
+			continue;
+
+		spin_lock_irq(&gcwq->lock);
+		gcwq_name(gcwq, name, sizeof(name));
+		for (i = 0; i < WQ_STATS_FUNCS; i++) {
+			struct wq_func_stat *st = &gcwq->func_stats[i];
+
+			if (!st->func)
+				continue;
+			if (!hist) {
+				seq_printf(m, "%-8s %9lu %11llu %11llu %11llu %11llu  %pf\n",
+					   name, st->nr,
+					   div_u64(div64_u64(st->delay_sum, st->nr),
+						   NSEC_PER_USEC),
+					   div_u64(st->delay_max, NSEC_PER_USEC),
+					   div_u64(div64_u64(st->run_sum, st->nr),
+						   NSEC_PER_USEC),
+					   div_u64(st->run_max, NSEC_PER_USEC),
+					   st->func);
+				continue;
+			}
+			seq_printf(m, "%s %pf\n  delay:", name, st->func);
+			for (j = 0; j < WQ_STATS_HIST; j++)
+				seq_printf(m, " %u", st->delay_hist[j]);
+			seq_puts(m, "\n  run:  ");
+			for (j = 0; j < WQ_STATS_HIST; j++)
+				seq_printf(m, " %u", st->run_hist[j]);
+			seq_putc(m, '\n');
+		}
+		if (gcwq->nr_func_dropped)
+			seq_printf(m, "# %s: %lu works of functions not in the table\n",
+				   name, gcwq->nr_func_dropped);
+		spin_unlock_irq(&gcwq->lock);
+	}
+	return 0;
+}
+
+static int wq_functions_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_functions_show, inode->i_private);
+}
+
+/* any write resets the per function statistics */
+static ssize_t wq_functions_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	unsigned int cpu;
+
+	for_each_gcwq_cpu(cpu) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
+
+		if (!gcwq->func_stats)
+			continue;
+
+		spin_lock_irq(&gcwq->lock);
+		memset(gcwq->func_stats, 0,
+		       WQ_STATS_FUNCS * sizeof(struct wq_func_stat));
+		gcwq->nr_func_dropped = 0;
+		spin_unlock_irq(&gcwq->lock);
+	}
+	return count;
+}
+
+static const struct file_operations wq_functions_fops = {
+	.open		= wq_functions_open,
+	.read		= seq_read,
+	.write		= wq_functions_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_stats_init(void)
+{
+	struct dentry *dir;
+
+	wq_stall_timer_ready = true;
+	if (wq_stall_thresh)
+		mod_timer(&wq_stall_timer, round_jiffies(jiffies + HZ));
+
+	dir = debugfs_create_dir("workqueue", NULL);
+	if (!dir)
+		return -ENOMEM;
+	debugfs_create_file("pools", 0444, dir, NULL, &wq_pools_fops);
+	debugfs_create_file("functions", 0644, dir, NULL, &wq_functions_fops);
+	debugfs_create_file("histograms", 0644, dir, (void *)1,
+			    &wq_functions_fops);
+	return 0;
+}
+__initcall(wq_stats_init);
+#endif	/* CONFIG_WQ_STATS */
+
 static int __init init_workqueues(void)
 {
 	unsigned int cpu;
@@ -3780,6 +4186,8 @@ static int __init init_workqueues(void)
 
 		gcwq->trustee_state = TRUSTEE_DONE;
 		init_waitqueue_head(&gcwq->trustee_wait);
+
+		wq_stats_init_gcwq(gcwq);
 	}
 
 	/* create the initial worker */
@@ -53,10 +53,16 @@ struct cleancache_ops cleancache_register_ops(struct cleancache_ops *ops)
 }
 EXPORT_SYMBOL(cleancache_register_ops);
 
-/* Called by a cleancache-enabled filesystem at time of mount */
+/*
+ * Called by a cleancache-enabled filesystem at time of mount.  Backends
+ * that apply a per-filesystem policy get to see the superblock.
+ */
 void __cleancache_init_fs(struct super_block *sb)
 {
-	sb->cleancache_poolid = (*cleancache_ops.init_fs)(PAGE_SIZE);
+	if (cleancache_ops.init_sb)
+		sb->cleancache_poolid = (*cleancache_ops.init_sb)(sb, PAGE_SIZE);
+	else
+		sb->cleancache_poolid = (*cleancache_ops.init_fs)(PAGE_SIZE);
 }
 EXPORT_SYMBOL(__cleancache_init_fs);
 
@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/ktime.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -42,6 +45,9 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+
+	bool kcompactd;			/* a slice of background compaction */
+	unsigned int nr_batches;	/* migration batches left in the slice */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -464,6 +470,10 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	/* kcompactd continues in its next slice */
+	if (cc->kcompactd && !cc->nr_batches)
+		return COMPACT_PARTIAL;
+
 	/*
 	 * order == -1 is expected when compacting via
 	 * /proc/sys/vm/compact_memory
@@ -562,6 +572,14 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
 	cc->free_pfn &= ~(pageblock_nr_pages-1);
 
+	/* kcompactd resumes where its last slice stopped */
+	if (cc->kcompactd && zone->compact_cached_free_pfn) {
+		cc->migrate_pfn = max(cc->migrate_pfn,
+				      zone->compact_cached_migrate_pfn);
+		cc->free_pfn = min(cc->free_pfn,
+				   zone->compact_cached_free_pfn);
+	}
+
 	migrate_prep_local();
 
 	while ((ret = compact_finished(zone, cc)) == COMPACT_CONTINUE) {
@@ -587,6 +605,11 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 
 		count_vm_event(COMPACTBLOCKS);
 		count_vm_events(COMPACTPAGES, nr_migrate - nr_remaining);
+		if (cc->kcompactd) {
+			count_vm_events(KCOMPACTD_MIGRATED,
+					nr_migrate - nr_remaining);
+			cc->nr_batches--;
+		}
 		if (nr_remaining)
 			count_vm_events(COMPACTPAGEFAILED, nr_remaining);
 		trace_mm_compaction_migratepages(nr_migrate - nr_remaining,
@@ -605,6 +628,16 @@ out:
 	cc->nr_freepages -= release_freepages(&cc->freepages);
 	VM_BUG_ON(cc->nr_freepages != 0);
 
+	if (cc->kcompactd) {
+		if (ret == COMPACT_COMPLETE) {
+			zone->compact_cached_migrate_pfn = 0;
+			zone->compact_cached_free_pfn = 0;
+		} else {
+			zone->compact_cached_migrate_pfn = cc->migrate_pfn;
+			zone->compact_cached_free_pfn = cc->free_pfn;
+		}
+	}
+
 	return ret;
 }
 
@@ -648,6 +681,7 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	struct zoneref *z;
 	struct zone *zone;
 	int rc = COMPACT_SKIPPED;
+	ktime_t start;
 
 	/*
 	 * Check whether it is worth even starting compaction. The order check is
@@ -658,6 +692,7 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 		return rc;
 
 	count_vm_event(COMPACTSTALL);
+	start = ktime_get();
 
 	/* Compact each zone in the list */
 	for_each_zone_zonelist_nodemask(zone, z, zonelist, high_zoneidx,
@@ -672,6 +707,8 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			break;
 	}
 
+	count_vm_events(COMPACTSTALL_US, ktime_us_delta(ktime_get(), start));
+
 	return rc;
 }
 
@@ -746,6 +783,251 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd, background compaction
+ *
+ * Direct compaction runs in the allocating task, once an allocation of
+ * order > 0 has failed: a wifi driver refilling its order-2 receive
+ * buffers or a fork needing an order-1 stack stalls until a zone is
+ * compacted.  kcompactd, one thread per node, checks every
+ * KCOMPACTD_INTERVAL, and when a high-order allocation had to wake
+ * kswapd, how much of the free memory of each zone is unusable for
+ * allocations of sysctl_kcompactd_order, the unusable free space index.
+ * Above sysctl_kcompactd_threshold it compacts the zone in slices of
+ * KCOMPACTD_SLICE migration batches, until the index dropped
+ * KCOMPACTD_HYST below the threshold.
+ *
+ * Slices only run while a cpu is left over for them, and the thread runs
+ * at the lowest priority: the work is done while the system is idle,
+ * before the allocations come.  Migration is asynchronous, so kcompactd
+ * does not wait for writeback or page locks either.  The interval is a
+ * deferrable timer, which never wakes an idle cpu, and with
+ * sysctl_kcompactd_order 0 the thread sleeps until it is turned on.
+ */
+int sysctl_kcompactd_order = PAGE_ALLOC_COSTLY_ORDER;
+int sysctl_kcompactd_threshold = 500;
+
+#define KCOMPACTD_INTERVAL	(HZ / 2)
+#define KCOMPACTD_SLICE		16
+#define KCOMPACTD_HYST		100
+
+/* After a complete pass that did not help, leave the zone alone this long */
+#define KCOMPACTD_BACKOFF	(30 * HZ)
+
+/*
+ * The unusable free space index for sysctl_kcompactd_order over all
+ * populated zones, weighted by their size: 0 when all free memory can
+ * be used for such allocations, 1000 when none of it can.
+ */
+unsigned long compaction_frag_score(void)
+{
+	int order = sysctl_kcompactd_order ? : PAGE_ALLOC_COSTLY_ORDER;
+	unsigned long pages = 0;
+	struct zone *zone;
+	u64 score = 0;
+
+	for_each_populated_zone(zone) {
+		score += (u64)unusable_index(zone, order) * zone->present_pages;
+		pages += zone->present_pages;
+	}
+
+	return pages ? div_u64(score, pages) : 0;
+}
+
+static bool kcompactd_zone_fragmented(struct zone *zone, int order,
+				      int threshold)
+{
+	unsigned long watermark;
+
+	if (!populated_zone(zone))
+		return false;
+
+	/* Migration needs free pages to copy to, freeing them is kswapd's job */
+	watermark = low_wmark_pages(zone) + (2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return false;
+
+	return unusable_index(zone, order) > threshold;
+}
+
+/* Is a cpu left over for compaction? kcompactd itself is running */
+static bool kcompactd_idle(void)
+{
+	return nr_running() <= num_online_cpus();
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = sysctl_kcompactd_order;
+	int threshold = sysctl_kcompactd_threshold;
+	bool woken = false;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		int ret;
+
+		if (time_before(jiffies, zone->compact_daemon_next))
+			continue;
+		if (!kcompactd_zone_fragmented(zone, order, threshold))
+			continue;
+
+		if (!woken) {
+			count_vm_event(KCOMPACTD_WAKE);
+			lru_add_drain();
+			woken = true;
+		}
+
+		do {
+			struct compact_control cc = {
+				.nr_freepages = 0,
+				.nr_migratepages = 0,
+				.order = -1,
+				.zone = zone,
+				.sync = false,
+				.kcompactd = true,
+				.nr_batches = KCOMPACTD_SLICE,
+			};
+
+			if (kthread_should_stop() || !kcompactd_idle())
+				return;
+
+			INIT_LIST_HEAD(&cc.freepages);
+			INIT_LIST_HEAD(&cc.migratepages);
+			ret = compact_zone(zone, &cc);
+			VM_BUG_ON(!list_empty(&cc.freepages));
+			VM_BUG_ON(!list_empty(&cc.migratepages));
+
+			if (ret == COMPACT_COMPLETE) {
+				if (kcompactd_zone_fragmented(zone, order,
+							threshold))
+					zone->compact_daemon_next = jiffies +
+							KCOMPACTD_BACKOFF;
+				break;
+			}
+			cond_resched();
+		} while (kcompactd_zone_fragmented(zone, order,
+					threshold - KCOMPACTD_HYST));
+	}
+}
+
+static void kcompactd_kick(pg_data_t *pgdat)
+{
+	pgdat->kcompactd_kicked = 1;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+static void kcompactd_timer_fn(unsigned long data)
+{
+	kcompactd_kick((pg_data_t *)data);
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	struct timer_list timer;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_user_nice(current, 19);
+	set_freezable();
+	setup_deferrable_timer_on_stack(&timer, kcompactd_timer_fn,
+					(unsigned long)pgdat);
+
+	while (!kthread_should_stop()) {
+		if (sysctl_kcompactd_order)
+			mod_timer(&timer, jiffies + KCOMPACTD_INTERVAL);
+		wait_event_freezable(pgdat->kcompactd_wait,
+				pgdat->kcompactd_kicked ||
+				kthread_should_stop());
+		del_timer_sync(&timer);
+		pgdat->kcompactd_kicked = 0;
+
+		if (sysctl_kcompactd_order)
+			kcompactd_do_work(pgdat);
+	}
+
+	destroy_timer_on_stack(&timer);
+	return 0;
+}
+
+/*
+ * Kick kcompactd after an allocation of @order found @zone below its low
+ * watermark, rather than waiting for the next interval.
+ */
+void wakeup_kcompactd(struct zone *zone, int order)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+
+	if (!sysctl_kcompactd_order || order > sysctl_kcompactd_order ||
+	    !pgdat->kcompactd)
+		return;
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	kcompactd_kick(pgdat);
+}
+
+/* Turning background compaction on wakes the threads sleeping without it */
+int sysctl_kcompactd_order_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret, nid;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write || !sysctl_kcompactd_order)
+		return ret;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		if (NODE_DATA(nid)->kcompactd)
+			kcompactd_kick(NODE_DATA(nid));
+	return 0;
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		ret = -1;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
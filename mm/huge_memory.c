@@ -55,6 +55,14 @@ static DECLARE_WAIT_QUEUE_HEAD(khugepaged_wait);
  * fault.
  */
 static unsigned int khugepaged_max_ptes_none __read_mostly = HPAGE_PMD_NR-1;
+/*
+ * The same for the areas madvised MADV_HUGEPAGE, whose owner asked for
+ * hugepages, so that max_ptes_none can keep the rest from growing.
+ */
+static unsigned int khugepaged_max_ptes_none_madvise __read_mostly =
+	HPAGE_PMD_NR-1;
+/* collapse the stacks too, whose tops are rarely used */
+static unsigned int khugepaged_collapse_stack __read_mostly = 1;
 
 static int khugepaged(void *none);
 static int mm_slots_hash_init(void);
@@ -471,9 +479,63 @@ static struct kobj_attribute khugepaged_max_ptes_none_attr =
 	__ATTR(max_ptes_none, 0644, khugepaged_max_ptes_none_show,
 	       khugepaged_max_ptes_none_store);
 
+static ssize_t khugepaged_max_ptes_none_madvise_show(struct kobject *kobj,
+						     struct kobj_attribute *attr,
+						     char *buf)
+{
+	return sprintf(buf, "%u\n", khugepaged_max_ptes_none_madvise);
+}
+static ssize_t khugepaged_max_ptes_none_madvise_store(struct kobject *kobj,
+						      struct kobj_attribute *attr,
+						      const char *buf,
+						      size_t count)
+{
+	int err;
+	unsigned long max_ptes_none;
+
+	err = strict_strtoul(buf, 10, &max_ptes_none);
+	if (err || max_ptes_none > HPAGE_PMD_NR-1)
+		return -EINVAL;
+
+	khugepaged_max_ptes_none_madvise = max_ptes_none;
+
+	return count;
+}
+static struct kobj_attribute khugepaged_max_ptes_none_madvise_attr =
+	__ATTR(max_ptes_none_madvise, 0644,
+	       khugepaged_max_ptes_none_madvise_show,
+	       khugepaged_max_ptes_none_madvise_store);
+
+static ssize_t khugepaged_collapse_stack_show(struct kobject *kobj,
+					      struct kobj_attribute *attr,
+					      char *buf)
+{
+	return sprintf(buf, "%u\n", khugepaged_collapse_stack);
+}
+static ssize_t khugepaged_collapse_stack_store(struct kobject *kobj,
+					       struct kobj_attribute *attr,
+					       const char *buf, size_t count)
+{
+	int err;
+	unsigned long val;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || val > 1)
+		return -EINVAL;
+
+	khugepaged_collapse_stack = val;
+
+	return count;
+}
+static struct kobj_attribute khugepaged_collapse_stack_attr =
+	__ATTR(collapse_stack, 0644, khugepaged_collapse_stack_show,
+	       khugepaged_collapse_stack_store);
+
 static struct attribute *khugepaged_attr[] = {
 	&khugepaged_defrag_attr.attr,
 	&khugepaged_max_ptes_none_attr.attr,
+	&khugepaged_max_ptes_none_madvise_attr.attr,
+	&khugepaged_collapse_stack_attr.attr,
 	&pages_to_scan_attr.attr,
 	&pages_collapsed_attr.attr,
 	&full_scans_attr.attr,
@@ -1656,6 +1718,23 @@ static void release_all_pte_pages(pte_t *pte)
 	release_pte_pages(pte, pte + HPAGE_PMD_NR);
 }
 
+/* How many unmapped ptes khugepaged may fill in @vma, by its type */
+static unsigned int khugepaged_vma_max_ptes_none(struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_HUGEPAGE)
+		return khugepaged_max_ptes_none_madvise;
+	return khugepaged_max_ptes_none;
+}
+
+/* Whether khugepaged leaves @vma alone for its type */
+static bool khugepaged_skip_vma_type(struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_HUGEPAGE)
+		return false;
+	return !khugepaged_collapse_stack &&
+		(vma->vm_flags & (VM_GROWSDOWN | VM_GROWSUP));
+}
+
 static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 					unsigned long address,
 					pte_t *pte)
@@ -1663,11 +1742,12 @@ static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 	struct page *page;
 	pte_t *_pte;
 	int referenced = 0, isolated = 0, none = 0;
+	unsigned int max_ptes_none = khugepaged_vma_max_ptes_none(vma);
 	for (_pte = pte; _pte < pte+HPAGE_PMD_NR;
 	     _pte++, address += PAGE_SIZE) {
 		pte_t pteval = *_pte;
 		if (pte_none(pteval)) {
-			if (++none <= khugepaged_max_ptes_none)
+			if (++none <= max_ptes_none)
 				continue;
 			else {
 				release_pte_pages(pte, _pte);
@@ -1843,6 +1923,8 @@ static void collapse_huge_page(struct mm_struct *mm,
 	if ((!(vma->vm_flags & VM_HUGEPAGE) && !khugepaged_always()) ||
 	    (vma->vm_flags & VM_NOHUGEPAGE))
 		goto out;
+	if (khugepaged_skip_vma_type(vma))
+		goto out;
 
 	if (!vma->anon_vma || vma->vm_ops)
 		goto out;
@@ -1954,6 +2036,7 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 	pmd_t *pmd;
 	pte_t *pte, *_pte;
 	int ret = 0, referenced = 0, none = 0;
+	unsigned int max_ptes_none = khugepaged_vma_max_ptes_none(vma);
 	struct page *page;
 	unsigned long _address;
 	spinlock_t *ptl;
@@ -1978,7 +2061,7 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 	     _pte++, _address += PAGE_SIZE) {
 		pte_t pteval = *_pte;
 		if (pte_none(pteval)) {
-			if (++none <= khugepaged_max_ptes_none)
+			if (++none <= max_ptes_none)
 				continue;
 			else
 				goto out_unmap;
@@ -2084,6 +2167,8 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 			progress++;
 			continue;
 		}
+		if (khugepaged_skip_vma_type(vma))
+			goto skip;
 		if (!vma->anon_vma || vma->vm_ops)
 			goto skip;
 		if (is_vma_temporary_stack(vma))
@@ -78,6 +78,11 @@
  *    take 10 attempts to find a page in the unstable tree, once it is found,
  *    it is secured in the stable tree.  (When we scan a new page, we first
  *    compare it against the stable tree, and then against the unstable tree.)
+ *
+ * Areas are made mergeable by madvise(MADV_MERGEABLE), or all anonymous areas
+ * of a process at once by putting it into merge-any mode, which its memory
+ * cgroup does for the processes of a group with memory.ksm set: that suits
+ * a zygote, whose children start out with the same heap and copy it.
  */
 
 /**
@@ -129,6 +134,8 @@ struct stable_node {
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
  * @oldchecksum: previous checksum of the page at that virtual address
+ * @dirty_history: whether the page was written before each of the last scans
+ * @skip: number of scans still to leave out the page, with skip_volatile
  * @node: rb node of this rmap_item in the unstable tree
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
@@ -139,6 +146,8 @@ struct rmap_item {
 	struct mm_struct *mm;
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
+	u8 dirty_history;
+	u8 skip;
 	union {
 		struct rb_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
@@ -189,6 +198,24 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Whether ksmd adapts its batch to the merge yield: see ksm_adapt_scan() */
+static unsigned int ksm_adaptive_scan;
+
+/* Smallest adapted batch; ksm_thread_pages_to_scan is the largest */
+static unsigned int ksm_pages_to_scan_min = 16;
+
+/* The adapted batch */
+static unsigned int ksm_pages_to_scan_cur = 100;
+
+/* Pages newly merged per KSM_YIELD_SCALE pages scanned, a moving average */
+static unsigned int ksm_merge_yield;
+
+/* Whether ksmd leaves out pages written to often: see ksm_skip_page() */
+static unsigned int ksm_skip_volatile;
+
+/* The number of pages left out of scans by that */
+static unsigned long ksm_pages_skipped;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -247,6 +274,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -453,6 +481,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
@@ -540,6 +569,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
@@ -1157,6 +1187,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
 }
 
 /*
@@ -1265,6 +1296,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	if (rmap_item) {
 		/* It has already been zeroed */
 		rmap_item->mm = mm_slot->mm;
+		rmap_item->mm->ksm_rmap_items++;
 		rmap_item->address = addr;
 		rmap_item->rmap_list = *rmap_list;
 		*rmap_list = rmap_item;
@@ -1272,7 +1304,77 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
-static struct rmap_item *scan_get_next_rmap_item(struct page **page)
+/*
+ * Clear the dirty bit of the pte mapping @page, moving it to the page as
+ * page_mkclean() does: returns 1 if the page was written to since the
+ * last call.  The TLB is flushed, so that the next write sets it again.
+ */
+static int ksm_page_test_clear_dirty(struct vm_area_struct *vma,
+				     struct page *page, unsigned long address)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	spinlock_t *ptl;
+	pte_t *ptep, entry;
+	int dirty = 0;
+
+	if (PageTransCompound(page))
+		return 0;
+
+	ptep = page_check_address(page, mm, address, &ptl, 0);
+	if (!ptep)
+		return 0;
+
+	if (pte_dirty(*ptep)) {
+		flush_cache_page(vma, address, pte_pfn(*ptep));
+		entry = ptep_clear_flush_notify(vma, address, ptep);
+		set_page_dirty(page);
+		set_pte_at(mm, address, ptep, pte_mkclean(entry));
+		dirty = 1;
+	}
+
+	pte_unmap_unlock(ptep, ptl);
+	return dirty;
+}
+
+/*
+ * A page written to between scans fails the checksum test, and if merged
+ * anyway, is soon copied again on the next write: a waste of ksmd's time.
+ * With skip_volatile, ksmd keeps the history of the dirty bit of every
+ * page over its last eight scans, and leaves a page found written on at
+ * least two of them out of the next one, three, seven or fifteen scans,
+ * the more the more often it was written.  A single write, as when a
+ * child copies a page of its parent after fork, does not count.
+ *
+ * Returns true if the page is to be left out of this scan; it is then
+ * removed from the trees as cmp_and_merge_page() would do.
+ */
+static bool ksm_skip_page(struct vm_area_struct *vma, struct page *page,
+			  struct rmap_item *rmap_item, unsigned long address)
+{
+	int written;
+
+	if (!rmap_item->skip) {
+		written = ksm_page_test_clear_dirty(vma, page, address);
+		rmap_item->dirty_history <<= 1;
+		rmap_item->dirty_history |= written;
+		written = hweight8(rmap_item->dirty_history);
+		if (!(rmap_item->dirty_history & 1) || written < 2)
+			return false;
+		rmap_item->skip = (1 << min(written - 1, 4)) - 1;
+	} else
+		rmap_item->skip--;
+
+	remove_rmap_item_from_tree(rmap_item);
+	ksm_pages_skipped++;
+	return true;
+}
+
+/*
+ * Pages left out by skip_volatile are taken from *@budget, the pages still
+ * to scan in this batch; NULL is returned once it is used up.
+ */
+static struct rmap_item *scan_get_next_rmap_item(struct page **page,
+						 unsigned int *budget)
 {
 	struct mm_struct *mm;
 	struct mm_slot *slot;
@@ -1346,6 +1448,18 @@ next_mm:
 				if (rmap_item) {
 					ksm_scan.rmap_list =
 							&rmap_item->rmap_list;
+					if (ksm_skip_volatile &&
+					    ksm_skip_page(vma, *page, rmap_item,
+							  ksm_scan.address)) {
+						put_page(*page);
+						ksm_scan.address += PAGE_SIZE;
+						if (!--*budget) {
+							up_read(&mm->mmap_sem);
+							return NULL;
+						}
+						cond_resched();
+						continue;
+					}
 					ksm_scan.address += PAGE_SIZE;
 				} else
 					put_page(*page);
@@ -1403,6 +1517,39 @@ next_mm:
 	return NULL;
 }
 
+/*
+ * With adaptive_scan, the batch of ksmd follows the merge yield, the pages
+ * newly merged per page scanned over the last batches: ksmd scans up to
+ * pages_to_scan pages a batch while a good share of them merges, as after
+ * a burst of forks from a zygote, and slows down to pages_to_scan_min
+ * while hardly anything merges.
+ */
+#define KSM_YIELD_SCALE		10000
+#define KSM_YIELD_HIGH		100	/* 1%: double the batch */
+#define KSM_YIELD_LOW		10	/* 0.1%: shrink it by an eighth */
+
+static void ksm_adapt_scan(unsigned int scanned, long merged)
+{
+	unsigned int nr = ksm_pages_to_scan_cur;
+	unsigned int yield;
+
+	if (!scanned)
+		return;
+	if (merged < 0)
+		merged = 0;
+	/* merging two pages of the unstable tree counts twice */
+	yield = div_u64((u64)min_t(unsigned long, merged, scanned) *
+			KSM_YIELD_SCALE, scanned);
+	ksm_merge_yield = (ksm_merge_yield * 7 + yield) / 8;
+
+	if (ksm_merge_yield >= KSM_YIELD_HIGH)
+		nr = nr > UINT_MAX / 2 ? UINT_MAX : nr * 2;
+	else if (ksm_merge_yield < KSM_YIELD_LOW)
+		nr -= max(nr / 8, 1U);
+	ksm_pages_to_scan_cur = clamp(nr, ksm_pages_to_scan_min,
+				      ksm_thread_pages_to_scan);
+}
+
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages - number of pages we want to scan before we return.
@@ -1411,16 +1558,24 @@ static void ksm_do_scan(unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	unsigned long merged = ksm_pages_shared + ksm_pages_sharing;
+	unsigned int scanned = 0;
 
-	while (scan_npages-- && likely(!freezing(current))) {
+	while (scan_npages && likely(!freezing(current))) {
 		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
+		rmap_item = scan_get_next_rmap_item(&page, &scan_npages);
 		if (!rmap_item)
-			return;
+			break;
+		scan_npages--;
+		scanned++;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
 		put_page(page);
 	}
+
+	if (ksm_adaptive_scan)
+		ksm_adapt_scan(scanned, (long)(ksm_pages_shared +
+				ksm_pages_sharing - merged));
 }
 
 static int ksmd_should_run(void)
@@ -1436,7 +1591,8 @@ static int ksm_scan_thread(void *nothing)
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
 		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_do_scan(ksm_adaptive_scan ? ksm_pages_to_scan_cur :
+				    ksm_thread_pages_to_scan);
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -1452,6 +1608,18 @@ static int ksm_scan_thread(void *nothing)
 	return 0;
 }
 
+/* Whether an area with @vm_flags may be made VM_MERGEABLE */
+static inline int ksm_vm_flags_ok(unsigned long vm_flags)
+{
+	/*
+	 * Be somewhat over-protective for now!
+	 */
+	return !(vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
+			     VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
+			     VM_RESERVED  | VM_HUGETLB | VM_INSERTPAGE |
+			     VM_NONLINEAR | VM_MIXEDMAP | VM_SAO));
+}
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
 {
@@ -1460,13 +1628,7 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 
 	switch (advice) {
 	case MADV_MERGEABLE:
-		/*
-		 * Be somewhat over-protective for now!
-		 */
-		if (*vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
-				 VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
-				 VM_RESERVED  | VM_HUGETLB | VM_INSERTPAGE |
-				 VM_NONLINEAR | VM_MIXEDMAP | VM_SAO))
+		if (!ksm_vm_flags_ok(*vm_flags))
 			return 0;		/* just ignore the advice */
 
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
@@ -1495,6 +1657,64 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 	return 0;
 }
 
+/*
+ * The flags of a new anonymous area of @mm in merge-any mode, called from
+ * ksm_vm_flags() with mmap_sem held for writing, as for madvise: the area
+ * is VM_MERGEABLE unless madvise would refuse, or registering fails.
+ */
+unsigned long __ksm_vm_flags(struct mm_struct *mm, unsigned long vm_flags)
+{
+	if (!ksm_vm_flags_ok(vm_flags))
+		return vm_flags;
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags) && __ksm_enter(mm))
+		return vm_flags;
+	return vm_flags | VM_MERGEABLE;
+}
+
+/**
+ * ksm_enable_merge_any - make all anonymous areas of @mm mergeable
+ * @mm: the mm, with a reference held by the caller
+ *
+ * Puts @mm into merge-any mode: its private anonymous areas, present and
+ * future, are VM_MERGEABLE as if madvised; children inherit the mode, and
+ * it survives exec.
+ */
+int ksm_enable_merge_any(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	int err = 0;
+
+	down_write(&mm->mmap_sem);
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		goto out;
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
+		err = __ksm_enter(mm);
+		if (err)
+			goto out;
+	}
+	set_bit(MMF_VM_MERGE_ANY, &mm->flags);
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (!vma->vm_file)
+			vma->vm_flags = __ksm_vm_flags(mm, vma->vm_flags);
+	}
+out:
+	up_write(&mm->mmap_sem);
+	return err;
+}
+
+/**
+ * ksm_disable_merge_any - take @mm out of merge-any mode
+ * @mm: the mm, with a reference held by the caller
+ *
+ * New areas are no longer made mergeable; the areas which are stay so,
+ * until madvise(MADV_UNMERGEABLE) or exit.
+ */
+void ksm_disable_merge_any(struct mm_struct *mm)
+{
+	clear_bit(MMF_VM_MERGE_ANY, &mm->flags);
+}
+
 int __ksm_enter(struct mm_struct *mm)
 {
 	struct mm_slot *mm_slot;
@@ -1867,11 +2087,111 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 		return -EINVAL;
 
 	ksm_thread_pages_to_scan = nr_pages;
+	ksm_pages_to_scan_cur = nr_pages;
 
 	return count;
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t pages_to_scan_min_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_pages_to_scan_min);
+}
+
+static ssize_t pages_to_scan_min_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr_pages;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	ksm_pages_to_scan_min = nr_pages;
+
+	return count;
+}
+KSM_ATTR(pages_to_scan_min);
+
+static ssize_t pages_to_scan_current_show(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive_scan ?
+		       ksm_pages_to_scan_cur : ksm_thread_pages_to_scan);
+}
+KSM_ATTR_RO(pages_to_scan_current);
+
+static ssize_t adaptive_scan_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive_scan);
+}
+
+static ssize_t adaptive_scan_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int err;
+	unsigned long enable;
+
+	err = strict_strtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	if (enable && !ksm_adaptive_scan) {
+		/* start from the top, the next batches tell how to go on */
+		ksm_pages_to_scan_cur = ksm_thread_pages_to_scan;
+		ksm_merge_yield = KSM_YIELD_HIGH;
+	}
+	ksm_adaptive_scan = enable;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(adaptive_scan);
+
+static ssize_t merge_yield_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_merge_yield);
+}
+KSM_ATTR_RO(merge_yield);
+
+static ssize_t skip_volatile_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_skip_volatile);
+}
+
+static ssize_t skip_volatile_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int err;
+	unsigned long enable;
+
+	err = strict_strtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	ksm_skip_volatile = enable;
+
+	return count;
+}
+KSM_ATTR(skip_volatile);
+
+static ssize_t pages_skipped_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1969,6 +2289,12 @@ KSM_ATTR_RO(full_scans);
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&pages_to_scan_min_attr.attr,
+	&pages_to_scan_current_attr.attr,
+	&adaptive_scan_attr.attr,
+	&merge_yield_attr.attr,
+	&skip_volatile_attr.attr,
+	&pages_skipped_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
@@ -49,6 +49,8 @@
 #include <linux/page_cgroup.h>
 #include <linux/cpu.h>
 #include <linux/oom.h>
+#include <linux/ksm.h>
+#include <linux/vmpressure.h>
 #include "internal.h"
 
 #include <asm/uaccess.h>
@@ -252,6 +254,10 @@ struct mem_cgroup {
 	unsigned int	swappiness;
 	/* OOM-Killer disable */
 	int		oom_kill_disable;
+	/* KSM may merge all anonymous memory of the tasks */
+	bool		ksm;
+	/* global reclaim scans the group at a priority this much higher */
+	int		reclaim_priority;
 
 	/* set when res.limit == memsw.limit */
 	bool		memsw_is_minimum;
@@ -268,6 +274,9 @@ struct mem_cgroup {
 	/* For oom notifier event fd */
 	struct list_head oom_notify;
 
+	/* reclaim pressure levels and their listeners */
+	struct vmpressure vmpressure;
+
 	/*
 	 * Should we move charges of a task when a task is moved into this
 	 * mem_cgroup ? And what type of charges should we move ?
@@ -1340,6 +1349,69 @@ static unsigned int get_swappiness(struct mem_cgroup *memcg)
 	return memcg->swappiness;
 }
 
+/* Number of memory cgroups with a reclaim_priority */
+static atomic_t nr_reclaim_priority_groups = ATOMIC_INIT(0);
+
+/**
+ * mem_cgroup_reclaim_priority_next - iterate over prioritized groups
+ * @prev: group returned by the previous call, or NULL to start
+ * @priority: set to the reclaim_priority of the group returned
+ * @swappiness: set to the swappiness of the group returned
+ *
+ * Walks the memory cgroups with a reclaim_priority, the groups of
+ * background applications, which global reclaim shrinks before the rest
+ * of a zone.  Returns the group after @prev with a reference held, or
+ * NULL at the end, and drops the reference on @prev.
+ */
+struct mem_cgroup *mem_cgroup_reclaim_priority_next(struct mem_cgroup *prev,
+						    int *priority,
+						    unsigned int *swappiness)
+{
+	struct cgroup_subsys_state *css;
+	struct mem_cgroup *mem = NULL;
+	int nextid = 1, found;
+
+	if (prev) {
+		nextid = css_id(&prev->css) + 1;
+		css_put(&prev->css);
+	}
+	if (mem_cgroup_disabled() ||
+	    !atomic_read(&nr_reclaim_priority_groups))
+		return NULL;
+
+	while (!mem) {
+		rcu_read_lock();
+		css = css_get_next(&mem_cgroup_subsys, nextid,
+				   &root_mem_cgroup->css, &found);
+		if (css) {
+			mem = container_of(css, struct mem_cgroup, css);
+			if (!mem->reclaim_priority || !css_tryget(css))
+				mem = NULL;
+		}
+		rcu_read_unlock();
+		if (!css)
+			break;
+		nextid = found + 1;
+	}
+	if (mem) {
+		*priority = mem->reclaim_priority;
+		*swappiness = get_swappiness(mem);
+	}
+	return mem;
+}
+
+/*
+ * mem_cgroup_reclaim_priority_break - stop iterating over prioritized groups
+ * @mem: group returned by the last mem_cgroup_reclaim_priority_next()
+ *
+ * Drops the reference held on @mem when the walk ends before it returned
+ * NULL.
+ */
+void mem_cgroup_reclaim_priority_break(struct mem_cgroup *mem)
+{
+	css_put(&mem->css);
+}
+
 static void mem_cgroup_start_move(struct mem_cgroup *mem)
 {
 	int cpu;
@@ -4328,6 +4400,80 @@ static int mem_control_stat_show(struct cgroup *cont, struct cftype *cft,
 	return 0;
 }
 
+#ifdef CONFIG_KSM
+static u64 mem_cgroup_ksm_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	return mem_cgroup_from_cont(cgrp)->ksm;
+}
+
+/* Called for every task of the group, and may sleep */
+static void mem_cgroup_ksm_set_task(struct task_struct *p,
+				    struct cgroup_scanner *scan)
+{
+	struct mm_struct *mm = get_task_mm(p);
+
+	if (!mm)
+		return;
+	if (scan->data)
+		ksm_enable_merge_any(mm);
+	else
+		ksm_disable_merge_any(mm);
+	mmput(mm);
+}
+
+/*
+ * Put all tasks of the group into KSM's merge-any mode, or take them out
+ * of it.  Tasks moved into the group later, and the children of its tasks,
+ * follow the setting; areas of a task that were mergeable stay so.
+ */
+static int mem_cgroup_ksm_write(struct cgroup *cgrp, struct cftype *cft,
+				u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	struct cgroup_scanner scan;
+
+	if (val > 1)
+		return -EINVAL;
+
+	cgroup_lock();
+	memcg->ksm = val;
+	cgroup_unlock();
+
+	scan.cg = cgrp;
+	scan.test_task = NULL;
+	scan.process_task = mem_cgroup_ksm_set_task;
+	scan.heap = NULL;
+	scan.data = val ? memcg : NULL;
+	return cgroup_scan_tasks(&scan);
+}
+#endif
+
+static u64 mem_cgroup_reclaim_priority_read(struct cgroup *cgrp,
+					    struct cftype *cft)
+{
+	return mem_cgroup_from_cont(cgrp)->reclaim_priority;
+}
+
+static int mem_cgroup_reclaim_priority_write(struct cgroup *cgrp,
+					     struct cftype *cft, u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+
+	/* global reclaim of the root group is the rest of the zone */
+	if (val > DEF_PRIORITY || cgrp->parent == NULL)
+		return -EINVAL;
+
+	cgroup_lock();
+	if (!memcg->reclaim_priority && val)
+		atomic_inc(&nr_reclaim_priority_groups);
+	else if (memcg->reclaim_priority && !val)
+		atomic_dec(&nr_reclaim_priority_groups);
+	memcg->reclaim_priority = val;
+	cgroup_unlock();
+
+	return 0;
+}
+
 static u64 mem_cgroup_swappiness_read(struct cgroup *cgrp, struct cftype *cft)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
@@ -4784,6 +4930,24 @@ static struct cftype mem_cgroup_files[] = {
 		.unregister_event = mem_cgroup_oom_unregister_event,
 		.private = MEMFILE_PRIVATE(_OOM_TYPE, OOM_CONTROL),
 	},
+	{
+		.name = "pressure_level",
+		.read_map = vmpressure_read,
+		.register_event = vmpressure_register_event,
+		.unregister_event = vmpressure_unregister_event,
+	},
+#ifdef CONFIG_KSM
+	{
+		.name = "ksm",
+		.read_u64 = mem_cgroup_ksm_read,
+		.write_u64 = mem_cgroup_ksm_write,
+	},
+#endif
+	{
+		.name = "reclaim_priority",
+		.read_u64 = mem_cgroup_reclaim_priority_read,
+		.write_u64 = mem_cgroup_reclaim_priority_write,
+	},
 #ifdef CONFIG_NUMA
 	{
 		.name = "numa_stat",
@@ -4959,6 +5123,36 @@ static struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *mem)
 	return mem_cgroup_from_res_counter(mem->res.parent, res);
 }
 
+/*
+ * Global reclaim has no mem_cgroup and reports its pressure to the root
+ * group, before the root group exists to nobody.
+ */
+struct vmpressure *memcg_to_vmpressure(struct mem_cgroup *mem)
+{
+	if (!mem)
+		mem = root_mem_cgroup;
+	if (!mem)
+		return NULL;
+	return &mem->vmpressure;
+}
+
+struct vmpressure *cgroup_to_vmpressure(struct cgroup *cgrp)
+{
+	return &mem_cgroup_from_cont(cgrp)->vmpressure;
+}
+
+/* Pressure not handled by a group goes to its parent with use_hierarchy */
+struct vmpressure *vmpressure_parent(struct vmpressure *vmpr)
+{
+	struct mem_cgroup *mem;
+
+	mem = container_of(vmpr, struct mem_cgroup, vmpressure);
+	mem = parent_mem_cgroup(mem);
+	if (!mem)
+		return NULL;
+	return &mem->vmpressure;
+}
+
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
 static void __init enable_swap_cgroup(void)
 {
@@ -5029,6 +5223,10 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 		parent = mem_cgroup_from_cont(cont->parent);
 		mem->use_hierarchy = parent->use_hierarchy;
 		mem->oom_kill_disable = parent->oom_kill_disable;
+		mem->ksm = parent->ksm;
+		mem->reclaim_priority = parent->reclaim_priority;
+		if (mem->reclaim_priority)
+			atomic_inc(&nr_reclaim_priority_groups);
 	}
 
 	if (parent && parent->use_hierarchy) {
@@ -5048,6 +5246,7 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	mem->last_scanned_child = 0;
 	mem->last_scanned_node = MAX_NUMNODES;
 	INIT_LIST_HEAD(&mem->oom_notify);
+	vmpressure_init(&mem->vmpressure);
 
 	if (parent)
 		mem->swappiness = get_swappiness(parent);
@@ -5073,6 +5272,9 @@ static void mem_cgroup_destroy(struct cgroup_subsys *ss,
 {
 	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
 
+	if (mem->reclaim_priority)
+		atomic_dec(&nr_reclaim_priority_groups);
+	vmpressure_cleanup(&mem->vmpressure);
 	mem_cgroup_put(mem);
 }
 
@@ -5572,6 +5774,10 @@ static void mem_cgroup_move_task(struct cgroup_subsys *ss,
 		if (mc.to)
 			mem_cgroup_move_charge(mm);
 		put_swap_token(mm);
+		if (mem_cgroup_from_cont(cont)->ksm)
+			ksm_enable_merge_any(mm);
+		else if (mem_cgroup_from_cont(old_cont)->ksm)
+			ksm_disable_merge_any(mm);
 		mmput(mm);
 	}
 	if (mc.to)
@@ -198,6 +198,7 @@ static void check_sync_rss_stat(struct task_struct *task)
 static int tlb_next_batch(struct mmu_gather *tlb)
 {
 	struct mmu_gather_batch *batch;
+	gfp_t gfp_mask = GFP_NOWAIT | __GFP_NOWARN;
 
 	batch = tlb->active;
 	if (batch->next) {
@@ -205,10 +206,23 @@ static int tlb_next_batch(struct mmu_gather *tlb)
 		return 1;
 	}
 
-	batch = (void *)__get_free_pages(GFP_NOWAIT | __GFP_NOWARN, 0);
+	if (tlb->batch_count == MAX_GATHER_BATCH_COUNT)
+		return 0;
+
+	/*
+	 * Tearing down a whole address space gives back far more than the
+	 * page a batch takes: let it dip into the reserves, so that a task
+	 * killed under memory pressure does not fall back to a TLB flush
+	 * every MMU_GATHER_BUNDLE pages just when its memory is needed.
+	 */
+	if (tlb->fullmm)
+		gfp_mask |= __GFP_HIGH;
+
+	batch = (void *)__get_free_pages(gfp_mask, 0);
 	if (!batch)
 		return 0;
 
+	tlb->batch_count++;
 	batch->next = NULL;
 	batch->nr   = 0;
 	batch->max  = MAX_GATHER_BATCH;
@@ -231,6 +245,7 @@ void tlb_gather_mmu(struct mmu_gather *tlb, struct mm_struct *mm, bool fullmm)
 	tlb->fullmm     = fullmm;
 	tlb->need_flush = 0;
 	tlb->fast_mode  = (num_possible_cpus() == 1);
+	tlb->batch_count = 0;
 	tlb->local.next = NULL;
 	tlb->local.nr   = 0;
 	tlb->local.max  = ARRAY_SIZE(tlb->__pages);
@@ -33,6 +33,10 @@
 #include <linux/mempolicy.h>
 #include <linux/security.h>
 #include <linux/ptrace.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/hrtimer.h>
+#include <linux/vmstat.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/memkill.h>
@@ -40,6 +44,7 @@
 int sysctl_panic_on_oom;
 int sysctl_oom_kill_allocating_task;
 int sysctl_oom_dump_tasks = 1;
+int sysctl_reap_mem_on_sigkill;
 static DEFINE_SPINLOCK(zone_scan_lock);
 
 /**
@@ -420,6 +425,202 @@ static void dump_header(struct task_struct *p, gfp_t gfp_mask, int order,
 		dump_tasks(mem, nodemask);
 }
 
+#ifdef CONFIG_MMU
+/*
+ * The oom reaper frees the anonymous memory of a killed task right after
+ * the kill, instead of waiting for the task to get to exit_mmap(), which
+ * may take long: the task may first have to wait for a lock, or for the
+ * cpu when the system is busy, and then tears down all of its address
+ * space in its own context.  The reaper unmaps only the private areas,
+ * whose pages no one can see once all the users of the mm are dying;
+ * exit_mmap() takes care of the rest.  Queued are the victims of the OOM
+ * killer and, with vm.reap_mem_on_sigkill, every process sent SIGKILL.
+ */
+static struct task_struct *oom_reaper_th;
+static DECLARE_WAIT_QUEUE_HEAD(oom_reaper_wait);
+static struct task_struct *oom_reaper_list;
+static DEFINE_SPINLOCK(oom_reaper_lock);
+
+/* Attempts, HZ/10 apart, to take the mmap_sem of a victim */
+#define OOM_REAPER_ATTEMPTS	10
+
+/*
+ * Whether all the tasks using @mm are on their way out, so that nothing
+ * can see its private memory go away.
+ */
+static bool mm_users_dying(struct mm_struct *mm)
+{
+	struct task_struct *g, *p;
+	bool ret = true;
+
+	rcu_read_lock();
+	do_each_thread(g, p) {
+		if (p->mm == mm && !fatal_signal_pending(p) &&
+		    !(p->flags & PF_EXITING)) {
+			ret = false;
+			goto out;
+		}
+	} while_each_thread(g, p);
+out:
+	rcu_read_unlock();
+	return ret;
+}
+
+/*
+ * Unmaps the private areas of the mm of @tsk, and sets @freed to the
+ * anonymous and swap pages this gave back.  Returns 1 if it did, 0 if there
+ * is nothing to do, and -EAGAIN if the mmap_sem is not available.
+ */
+static int __oom_reap_task(struct task_struct *tsk, unsigned long *freed)
+{
+	struct vm_area_struct *vma;
+	struct task_struct *p;
+	struct mm_struct *mm;
+	unsigned long before, after;
+	int ret = 0;
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return 0;
+	mm = p->mm;
+	/* with a reference on mm_users, exit_mmap() waits for us */
+	if (!atomic_inc_not_zero(&mm->mm_users)) {
+		task_unlock(p);
+		return 0;
+	}
+	task_unlock(p);
+
+	if (!down_read_trylock(&mm->mmap_sem)) {
+		ret = -EAGAIN;
+		goto out_mm;
+	}
+	/* a core dump still needs the memory */
+	if (test_bit(MMF_OOM_REAPED, &mm->flags) || mm->core_state ||
+	    !mm_users_dying(mm))
+		goto out_unlock;
+
+	before = get_mm_counter(mm, MM_ANONPAGES) +
+		 get_mm_counter(mm, MM_SWAPENTS);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		/* mlocked areas have to be munlocked before they are unmapped */
+		if (vma->vm_flags & (VM_LOCKED | VM_SHARED | VM_PFNMAP | VM_IO))
+			continue;
+		zap_page_range(vma, vma->vm_start, vma->vm_end - vma->vm_start,
+			       NULL);
+	}
+	after = get_mm_counter(mm, MM_ANONPAGES) +
+		get_mm_counter(mm, MM_SWAPENTS);
+	*freed = before > after ? before - after : 0;
+	set_bit(MMF_OOM_REAPED, &mm->flags);
+	ret = 1;
+out_unlock:
+	up_read(&mm->mmap_sem);
+out_mm:
+	/* the last reference does the rest of the teardown here */
+	mmput(mm);
+	return ret;
+}
+
+static void oom_reap_task(struct task_struct *tsk, ktime_t queued)
+{
+	ktime_t start = ktime_get();
+	unsigned long freed = 0;
+	int attempts = 0, ret;
+	s64 latency_us;
+
+	while ((ret = __oom_reap_task(tsk, &freed)) == -EAGAIN &&
+	       ++attempts < OOM_REAPER_ATTEMPTS)
+		schedule_timeout_interruptible(HZ / 10);
+
+	if (ret == -EAGAIN)
+		pr_info("oom_reaper: unable to reap pid:%d (%s)\n",
+			task_pid_nr(tsk), tsk->comm);
+	if (ret == 1) {
+		latency_us = ktime_us_delta(ktime_get(), queued);
+		count_vm_event(OOM_REAP_TASKS);
+		count_vm_events(OOM_REAP_PAGES, freed);
+		count_vm_events(OOM_REAP_US, latency_us);
+		trace_oom_reap(task_pid_nr(tsk), tsk->comm, freed, latency_us,
+			       ktime_us_delta(ktime_get(), start));
+	}
+	put_task_struct(tsk);
+}
+
+static int oom_reaper(void *unused)
+{
+	struct task_struct *tsk;
+	ktime_t queued;
+
+	set_freezable();
+	/* it frees memory, like kswapd */
+	current->flags |= PF_MEMALLOC;
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(oom_reaper_wait, oom_reaper_list ||
+				     kthread_should_stop());
+
+		spin_lock_irq(&oom_reaper_lock);
+		tsk = oom_reaper_list;
+		if (tsk) {
+			oom_reaper_list = tsk->oom_reaper_list;
+			tsk->oom_reaper_list = NULL;
+			queued = tsk->oom_reaper_queued;
+			tsk->oom_reaper_queued = ktime_set(0, 0);
+		}
+		spin_unlock_irq(&oom_reaper_lock);
+
+		if (tsk)
+			oom_reap_task(tsk, queued);
+	}
+	return 0;
+}
+
+/**
+ * wake_oom_reaper - have the memory of a killed task freed
+ * @tsk: task which was sent SIGKILL
+ *
+ * Queues @tsk to the oom reaper, which unmaps its private memory unless
+ * the mm is used by tasks which were not killed.  May be called in atomic
+ * context.
+ */
+void wake_oom_reaper(struct task_struct *tsk)
+{
+	unsigned long flags;
+
+	if (!oom_reaper_th || (tsk->flags & PF_KTHREAD))
+		return;
+
+	spin_lock_irqsave(&oom_reaper_lock, flags);
+	if (ktime_to_ns(tsk->oom_reaper_queued)) {
+		spin_unlock_irqrestore(&oom_reaper_lock, flags);
+		return;
+	}
+	get_task_struct(tsk);
+	tsk->oom_reaper_queued = ktime_get();
+	tsk->oom_reaper_list = oom_reaper_list;
+	oom_reaper_list = tsk;
+	spin_unlock_irqrestore(&oom_reaper_lock, flags);
+
+	wake_up(&oom_reaper_wait);
+}
+
+static int __init oom_reaper_init(void)
+{
+	struct task_struct *th;
+
+	th = kthread_run(oom_reaper, NULL, "oom_reaper");
+	if (IS_ERR(th)) {
+		pr_err("Unable to start oom_reaper\n");
+		return PTR_ERR(th);
+	}
+	oom_reaper_th = th;
+	return 0;
+}
+subsys_initcall(oom_reaper_init);
+#endif /* CONFIG_MMU */
+
 #define K(x) ((x) << (PAGE_SHIFT-10))
 static int oom_kill_task(struct task_struct *p, struct mem_cgroup *mem,
 			 int order, unsigned int victim_points)
@@ -468,6 +669,7 @@ static int oom_kill_task(struct task_struct *p, struct mem_cgroup *mem,
 
 	set_tsk_thread_flag(p, TIF_MEMDIE);
 	force_sig(SIGKILL, p);
+	wake_oom_reaper(p);
 
 	return 0;
 }
@@ -2053,8 +2053,11 @@ void wake_all_kswapd(unsigned int order, struct zonelist *zonelist,
 	struct zoneref *z;
 	struct zone *zone;
 
-	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx)
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx) {
 		wakeup_kswapd(zone, order, classzone_idx);
+		if (order)
+			wakeup_kcompactd(zone, order);
+	}
 }
 
 static inline int
@@ -2337,6 +2340,216 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 }
 EXPORT_SYMBOL(__alloc_pages_nodemask);
 
+/**
+ * alloc_pages_bulk - allocate a number of order-0 pages at once
+ * @gfp_mask: GFP flags for the allocation
+ * @nr_pages: the number of pages wanted
+ * @pages: array to store the pages to
+ *
+ * Takes the pages from the per-cpu lists of the first allowed zone which
+ * stays above its low watermark with all of them, refilling the lists
+ * from the buddy allocator a batch at a time, with interrupts disabled
+ * once for all of them rather than once per page.  When that gets no
+ * page at all, one is allocated with alloc_pages(), with the usual
+ * reclaim and failure handling.
+ *
+ * Returns the number of pages stored to @pages, which can be less than
+ * @nr_pages; it is 0 only if alloc_pages() failed too.
+ */
+unsigned int alloc_pages_bulk(gfp_t gfp_mask, unsigned int nr_pages,
+			      struct page **pages)
+{
+	struct zonelist *zonelist = node_zonelist(numa_node_id(), gfp_mask);
+	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
+	int migratetype = allocflags_to_migratetype(gfp_mask);
+	int cold = !!(gfp_mask & __GFP_COLD);
+	struct zone *preferred_zone, *zone;
+	struct per_cpu_pages *pcp;
+	struct list_head *list;
+	struct zoneref *z;
+	unsigned long flags;
+	unsigned int nr = 0, i, good;
+
+	if (!nr_pages)
+		return 0;
+	if (nr_pages == 1)
+		goto single;
+
+	gfp_mask &= gfp_allowed_mask;
+
+	get_mems_allowed();
+	first_zones_zonelist(zonelist, high_zoneidx,
+				&cpuset_current_mems_allowed, &preferred_zone);
+	if (!preferred_zone)
+		goto out;
+
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx) {
+		if (!cpuset_zone_allowed_softwall(zone,
+						  gfp_mask | __GFP_HARDWALL))
+			continue;
+		if (zone_watermark_ok(zone, 0, low_wmark_pages(zone) + nr_pages,
+				      zone_idx(preferred_zone), 0))
+			break;
+	}
+	if (!zone)
+		goto out;
+
+	local_irq_save(flags);
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list = &pcp->lists[migratetype];
+	while (nr < nr_pages) {
+		struct page *page;
+
+		if (list_empty(list)) {
+			pcp->count += rmqueue_bulk(zone, 0,
+					pcp->batch, list,
+					migratetype, cold);
+			if (unlikely(list_empty(list)))
+				break;
+		}
+
+		if (cold)
+			page = list_entry(list->prev, struct page, lru);
+		else
+			page = list_entry(list->next, struct page, lru);
+
+		list_del(&page->lru);
+		pcp->count--;
+		pages[nr++] = page;
+	}
+
+	__count_zone_vm_events(PGALLOC, zone, nr);
+	for (i = 0; i < nr; i++)
+		zone_statistics(preferred_zone, zone, gfp_mask);
+	local_irq_restore(flags);
+
+	/* Like buffered_rmqueue(), leave out the pages failing the checks */
+	for (i = good = 0; i < nr; i++) {
+		VM_BUG_ON(bad_range(zone, pages[i]));
+		if (prep_new_page(pages[i], 0, gfp_mask))
+			continue;
+		trace_mm_page_alloc(pages[i], 0, gfp_mask, migratetype);
+		pages[good++] = pages[i];
+	}
+	nr = good;
+out:
+	put_mems_allowed();
+	if (nr)
+		return nr;
+single:
+	pages[0] = alloc_pages(gfp_mask, 0);
+	return pages[0] ? 1 : 0;
+}
+EXPORT_SYMBOL(alloc_pages_bulk);
+
+/*
+ * Page fragments
+ *
+ * page_frag_alloc() hands out buffers of up to a page, carved one after
+ * the other out of a per-cpu page of PAGE_FRAG_CACHE_MAX_SIZE, or of a
+ * single page when no such page is available.  The page is given a large
+ * reference count up front, of which every fragment takes one without
+ * touching the count; the rest is dropped once the page is used up.
+ * The fragments are freed with page_frag_free(), and the page goes back
+ * to the allocator with the last of them.
+ */
+#define PAGE_FRAG_CACHE_MAX_SIZE	__ALIGN_MASK(32768, ~PAGE_MASK)
+#define PAGE_FRAG_CACHE_MAX_ORDER	get_order(PAGE_FRAG_CACHE_MAX_SIZE)
+#define PAGE_FRAG_CACHE_BIAS		(PAGE_FRAG_CACHE_MAX_SIZE + 1)
+
+struct page_frag_cache {
+	struct page *page;
+	unsigned int offset;
+	unsigned int size;
+	/* references of the page not handed out with a fragment yet */
+	unsigned int pagecnt_bias;
+};
+
+static DEFINE_PER_CPU(struct page_frag_cache, page_frag_cache);
+
+static struct page *page_frag_refill(struct page_frag_cache *nc,
+				     gfp_t gfp_mask)
+{
+	struct page *page = NULL;
+
+	gfp_mask &= ~(__GFP_WAIT | __GFP_HIGHMEM);
+	if (PAGE_FRAG_CACHE_MAX_ORDER) {
+		page = alloc_pages(gfp_mask | __GFP_COMP | __GFP_NOWARN |
+				   __GFP_NORETRY, PAGE_FRAG_CACHE_MAX_ORDER);
+		nc->size = PAGE_FRAG_CACHE_MAX_SIZE;
+	}
+	if (unlikely(!page)) {
+		page = alloc_page(gfp_mask);
+		nc->size = PAGE_SIZE;
+	}
+
+	nc->page = page;
+	if (page) {
+		atomic_set(&page->_count, PAGE_FRAG_CACHE_BIAS);
+		nc->pagecnt_bias = PAGE_FRAG_CACHE_BIAS;
+		nc->offset = 0;
+	}
+	return page;
+}
+
+/**
+ * page_frag_alloc - allocate a buffer from the per-cpu page fragment cache
+ * @fragsz: size of the buffer, at most PAGE_SIZE
+ * @gfp_mask: GFP flags for refilling the cache
+ *
+ * The buffer is cache line aligned and in lowmem.  The cache is refilled
+ * with interrupts disabled, so __GFP_WAIT is ignored; this is meant for
+ * filling receive rings and the like, from any context.
+ *
+ * Returns the buffer, to be freed with page_frag_free(), or %NULL.
+ */
+void *page_frag_alloc(unsigned int fragsz, gfp_t gfp_mask)
+{
+	struct page_frag_cache *nc;
+	unsigned long flags;
+	void *data = NULL;
+
+	fragsz = ALIGN(fragsz, SMP_CACHE_BYTES);
+	if (WARN_ON_ONCE(fragsz > PAGE_SIZE))
+		return NULL;
+
+	local_irq_save(flags);
+	nc = &__get_cpu_var(page_frag_cache);
+	if (unlikely(!nc->page)) {
+refill:
+		if (!page_frag_refill(nc, gfp_mask))
+			goto out;
+	}
+
+	if (nc->offset + fragsz > nc->size) {
+		/* Still in use by fragments, which will free it */
+		if (!atomic_sub_and_test(nc->pagecnt_bias, &nc->page->_count))
+			goto refill;
+		/* All fragments were freed already, start over */
+		atomic_set(&nc->page->_count, PAGE_FRAG_CACHE_BIAS);
+		nc->pagecnt_bias = PAGE_FRAG_CACHE_BIAS;
+		nc->offset = 0;
+	}
+
+	data = page_address(nc->page) + nc->offset;
+	nc->offset += fragsz;
+	nc->pagecnt_bias--;
+out:
+	local_irq_restore(flags);
+	return data;
+}
+EXPORT_SYMBOL(page_frag_alloc);
+
+/**
+ * page_frag_free - free a buffer allocated by page_frag_alloc()
+ * @addr: the buffer
+ */
+void page_frag_free(void *addr)
+{
+	put_page(virt_to_head_page(addr));
+}
+EXPORT_SYMBOL(page_frag_free);
+
 /*
  * Common helper functions.
  */
@@ -4326,6 +4539,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat_page_cgroup_init(pgdat);
 	
 	for (j = 0; j < MAX_NR_ZONES; j++) {
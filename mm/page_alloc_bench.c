@@ -0,0 +1,157 @@
+/*
+ * page_alloc_bench.c - page allocator microbenchmark
+ *
+ * Compares, on loading, the rate of allocating and freeing order-0 pages
+ * one at a time with alloc_page() against batches of alloc_pages_bulk(),
+ * and the rate of small buffers from page_frag_alloc() against kmalloc().
+ * The results go to the kernel log, after which loading fails, so that
+ * the module can be loaded again for the next run:
+ *
+ *	# modprobe page_alloc_bench batch=32 loops=100000 fragsz=256
+ *	# dmesg | tail
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+
+static unsigned int batch = 16;
+module_param(batch, uint, 0);
+MODULE_PARM_DESC(batch, "pages per alloc_pages_bulk() call (default 16)");
+
+static unsigned int loops = 100000;
+module_param(loops, uint, 0);
+MODULE_PARM_DESC(loops, "rounds of each test (default 100000)");
+
+static unsigned int fragsz = 256;
+module_param(fragsz, uint, 0);
+MODULE_PARM_DESC(fragsz, "size of the page_frag_alloc() and kmalloc() buffers "
+		 "(default 256)");
+
+/* Per second of the nanoseconds @ns for @nr operations */
+static unsigned long long per_sec(unsigned long long nr, s64 ns)
+{
+	if (ns <= 0)
+		return 0;
+	return div64_u64(nr * NSEC_PER_SEC, ns);
+}
+
+static s64 bench_single(struct page **pages)
+{
+	ktime_t start = ktime_get();
+	unsigned int i, j;
+
+	for (i = 0; i < loops; i++) {
+		for (j = 0; j < batch; j++) {
+			pages[j] = alloc_page(GFP_KERNEL);
+			if (!pages[j])
+				break;
+		}
+		while (j)
+			__free_page(pages[--j]);
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static s64 bench_bulk(struct page **pages, unsigned long long *nr)
+{
+	ktime_t start = ktime_get();
+	unsigned int i, j;
+
+	for (i = 0; i < loops; i++) {
+		j = alloc_pages_bulk(GFP_KERNEL, batch, pages);
+		*nr += j;
+		while (j)
+			__free_page(pages[--j]);
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static s64 bench_frag(void **bufs)
+{
+	ktime_t start = ktime_get();
+	unsigned int i, j;
+
+	for (i = 0; i < loops; i++) {
+		for (j = 0; j < batch; j++) {
+			bufs[j] = page_frag_alloc(fragsz, GFP_KERNEL);
+			if (!bufs[j])
+				break;
+		}
+		while (j)
+			page_frag_free(bufs[--j]);
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static s64 bench_kmalloc(void **bufs)
+{
+	ktime_t start = ktime_get();
+	unsigned int i, j;
+
+	for (i = 0; i < loops; i++) {
+		for (j = 0; j < batch; j++) {
+			bufs[j] = kmalloc(fragsz, GFP_KERNEL);
+			if (!bufs[j])
+				break;
+		}
+		while (j)
+			kfree(bufs[--j]);
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int __init page_alloc_bench_init(void)
+{
+	unsigned long long total = (unsigned long long)loops * batch;
+	unsigned long long nr_bulk = 0;
+	struct page **pages;
+	void **bufs;
+	s64 ns;
+
+	if (!batch || !loops || !fragsz || fragsz > PAGE_SIZE)
+		return -EINVAL;
+
+	pages = kmalloc(batch * sizeof(*pages), GFP_KERNEL);
+	bufs = kmalloc(batch * sizeof(*bufs), GFP_KERNEL);
+	if (!pages || !bufs) {
+		kfree(pages);
+		kfree(bufs);
+		return -ENOMEM;
+	}
+
+	printk(KERN_INFO "page_alloc_bench: %u rounds of %u\n", loops, batch);
+
+	ns = bench_single(pages);
+	printk(KERN_INFO "page_alloc_bench: alloc_page:       %llu pages/s, "
+	       "%lld ns/page\n", per_sec(total, ns), div64_s64(ns, total));
+
+	ns = bench_bulk(pages, &nr_bulk);
+	printk(KERN_INFO "page_alloc_bench: alloc_pages_bulk: %llu pages/s, "
+	       "%lld ns/page, %llu of %llu pages\n", per_sec(nr_bulk, ns),
+	       nr_bulk ? div64_s64(ns, nr_bulk) : 0, nr_bulk, total);
+
+	ns = bench_frag(bufs);
+	printk(KERN_INFO "page_alloc_bench: page_frag_alloc:  %llu bufs/s, "
+	       "%lld ns/buf of %u bytes\n", per_sec(total, ns),
+	       div64_s64(ns, total), fragsz);
+
+	ns = bench_kmalloc(bufs);
+	printk(KERN_INFO "page_alloc_bench: kmalloc:          %llu bufs/s, "
+	       "%lld ns/buf of %u bytes\n", per_sec(total, ns),
+	       div64_s64(ns, total), fragsz);
+
+	kfree(pages);
+	kfree(bufs);
+	return -EAGAIN;
+}
+module_init(page_alloc_bench_init);
+MODULE_LICENSE("GPL");
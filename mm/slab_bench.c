@@ -0,0 +1,213 @@
+/*
+ * slab_bench.c - concurrent kmalloc()/kfree() microbenchmark
+ *
+ * Runs a thread bound to each online cpu, each of which allocates a batch
+ * of objects with kmalloc() and frees them again with kfree(), in two
+ * modes:
+ *
+ *  local:  every thread frees its own batch, which mostly stays within
+ *          the cpu slab of its cpu
+ *  remote: every thread frees the batch of the thread on the next cpu,
+ *          like objects handed over between cpus by binder or the network
+ *          stack; these frees go to slabs which are not the cpu slab, and
+ *          take the slow path
+ *
+ * The results go to the kernel log, after which loading fails, so that
+ * the module can be loaded again for the next run. To see what the cpu
+ * partial lists of SLUB contribute, compare with them disabled:
+ *
+ *	# modprobe slab_bench size=256
+ *	# echo 0 > /sys/kernel/slab/kmalloc-256/cpu_partial
+ *	# modprobe slab_bench size=256
+ *
+ * With CONFIG_SLUB_STATS, the slow path counters of the cache show where
+ * the time went; tools/slub/slabinfo reports them.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/hrtimer.h>
+
+static unsigned int size = 256;
+module_param(size, uint, 0);
+MODULE_PARM_DESC(size, "size of the objects (default 256)");
+
+static unsigned int batch = 64;
+module_param(batch, uint, 0);
+MODULE_PARM_DESC(batch, "objects allocated before freeing (default 64)");
+
+static unsigned int loops = 10000;
+module_param(loops, uint, 0);
+MODULE_PARM_DESC(loops, "rounds of each mode (default 10000)");
+
+struct bench_thread {
+	struct task_struct *task;
+	void **objs;
+	/* the batch freed by this thread in remote mode */
+	void **peer_objs;
+	int remote;
+	s64 ns;
+	unsigned long failed;
+};
+
+static struct bench_thread *threads;
+static int bench_nr_threads;
+static atomic_t bench_running;
+static DECLARE_COMPLETION(bench_done);
+
+static atomic_t barrier_arrived;
+static atomic_t barrier_gen;
+
+/* Spin until all threads arrived; they run on cpus of their own */
+static void bench_barrier(void)
+{
+	int gen = atomic_read(&barrier_gen);
+
+	if (atomic_inc_return(&barrier_arrived) == bench_nr_threads) {
+		atomic_set(&barrier_arrived, 0);
+		smp_mb();
+		atomic_inc(&barrier_gen);
+		return;
+	}
+	while (atomic_read(&barrier_gen) == gen)
+		cpu_relax();
+}
+
+static void alloc_batch(struct bench_thread *t)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch; i++) {
+		t->objs[i] = kmalloc(size, GFP_KERNEL);
+		if (!t->objs[i])
+			t->failed++;
+	}
+}
+
+static void free_batch(void **objs)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch; i++)
+		kfree(objs[i]);
+}
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	ktime_t start;
+	unsigned int i;
+
+	bench_barrier();
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		alloc_batch(t);
+		if (t->remote) {
+			bench_barrier();
+			free_batch(t->peer_objs);
+			bench_barrier();
+		} else
+			free_batch(t->objs);
+		cond_resched();
+	}
+	t->ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_dec_and_test(&bench_running))
+		complete(&bench_done);
+	return 0;
+}
+
+static int bench_run(int remote)
+{
+	unsigned long long ops = (unsigned long long)loops * batch;
+	unsigned long long all_ops = ops * bench_nr_threads;
+	unsigned long failed = 0;
+	s64 ns, max_ns = 0;
+	int i, cpu;
+
+	INIT_COMPLETION(bench_done);
+	atomic_set(&bench_running, bench_nr_threads);
+	atomic_set(&barrier_arrived, 0);
+
+	i = 0;
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t = &threads[i];
+
+		t->remote = remote;
+		t->peer_objs = threads[(i + 1) % bench_nr_threads].objs;
+		t->task = kthread_create(bench_thread_fn, t, "slab_bench/%d",
+					 cpu);
+		if (IS_ERR(t->task)) {
+			/* the threads created so far would wait forever */
+			while (i--)
+				kthread_stop(threads[i].task);
+			return PTR_ERR(t->task);
+		}
+		kthread_bind(t->task, cpu);
+		if (++i == bench_nr_threads)
+			break;
+	}
+	for (i = 0; i < bench_nr_threads; i++)
+		wake_up_process(threads[i].task);
+	wait_for_completion(&bench_done);
+
+	for (i = 0; i < bench_nr_threads; i++) {
+		max_ns = max(max_ns, threads[i].ns);
+		failed += threads[i].failed;
+	}
+	ns = max_ns;
+
+	printk(KERN_INFO "slab_bench: %-6s %llu kmalloc+kfree/s per cpu, "
+	       "%lld ns each, %llu/s total%s\n", remote ? "remote" : "local",
+	       ns > 0 ? div64_u64(ops * NSEC_PER_SEC, ns) : 0,
+	       div64_s64(ns, ops),
+	       ns > 0 ? div64_u64(all_ops * NSEC_PER_SEC, ns) : 0,
+	       failed ? ", allocations failed" : "");
+	return 0;
+}
+
+static int __init slab_bench_init(void)
+{
+	int i, ret = -ENOMEM;
+
+	if (!size || !batch || !loops)
+		return -EINVAL;
+
+	get_online_cpus();
+	bench_nr_threads = num_online_cpus();
+	threads = kcalloc(bench_nr_threads, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		goto out;
+	for (i = 0; i < bench_nr_threads; i++) {
+		threads[i].objs = kcalloc(batch, sizeof(void *), GFP_KERNEL);
+		if (!threads[i].objs)
+			goto out_free;
+	}
+
+	printk(KERN_INFO "slab_bench: %d cpus, %u rounds of %u objects of "
+	       "%u bytes\n", bench_nr_threads, loops, batch, size);
+	ret = bench_run(0);
+	if (!ret)
+		ret = bench_run(1);
+	if (!ret)
+		ret = -EAGAIN;
+out_free:
+	for (i = 0; i < bench_nr_threads; i++)
+		kfree(threads[i].objs);
+	kfree(threads);
+out:
+	put_online_cpus();
+	return ret;
+}
+module_init(slab_bench_init);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,363 @@
+/*
+ * vmpressure.c - memory pressure level notifications
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/fs.h>
+#include <linux/log2.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/vmstat.h>
+#include <linux/eventfd.h>
+#include <linux/swap.h>
+#include <linux/slab.h>
+#include <linux/jiffies.h>
+#include <linux/memcontrol.h>
+#include <linux/vmpressure.h>
+
+/*
+ * Page reclaim reports, per memory cgroup, how many pages it scanned and
+ * how many of them it could reclaim; global reclaim reports to the root
+ * group.  The less of the scanned pages are reclaimed, the harder reclaim
+ * has to work for every page it frees, and the pressure is
+ *
+ *	pressure = (scanned - reclaimed) * 100 / scanned
+ *
+ * evaluated over windows of at least vmpressure_win scanned pages, about
+ * 2MB with 4K pages, which smooths out single batches of the LRU scan
+ * while still tracking quick changes.  The pressure maps to the levels:
+ *
+ *  low:      reclaim is keeping up, e.g. by dropping clean page cache;
+ *            a good time to give up caches that are cheap to rebuild
+ *  medium:   from vmpressure_level_med on, reclaim is working hard, e.g.
+ *            swapping or writing back dirty pages; background work is
+ *            worth killing
+ *  critical: from vmpressure_level_critical on, or once reclaim of the
+ *            group went down to priority vmpressure_level_critical_prio,
+ *            the OOM killer is not far; user space should kill now
+ */
+static const unsigned long vmpressure_win = SWAP_CLUSTER_MAX * 16;
+static const unsigned int vmpressure_level_med = 60;
+static const unsigned int vmpressure_level_critical = 95;
+
+/*
+ * Reclaim priority at which a single window is taken for critical: at
+ * this priority, reclaim scans the LRU lists in chunks of 1/8 of their
+ * size, after failing at all the smaller ones.
+ */
+static const int vmpressure_level_critical_prio = ilog2(100 / 10);
+
+/*
+ * Hysteresis: once at a level, a group stays there until the pressure
+ * drops vmpressure_hyst percent below the threshold of the level, so that
+ * pressure hovering around a threshold does not flip the level with every
+ * window.  The last level is forgotten after VMPRESSURE_DECAY without
+ * reclaim.
+ */
+static const unsigned int vmpressure_hyst = 10;
+#define VMPRESSURE_DECAY	HZ
+
+/*
+ * Rate limiting: a listener is signalled at once when the level rises,
+ * and at most every VMPRESSURE_RATE while it stays at the same level.
+ */
+#define VMPRESSURE_RATE		(HZ / 10)
+
+static const char * const vmpressure_str_levels[VMPRESSURE_NUM_LEVELS] = {
+	[VMPRESSURE_LOW] = "low",
+	[VMPRESSURE_MEDIUM] = "medium",
+	[VMPRESSURE_CRITICAL] = "critical",
+};
+
+struct vmpressure_event {
+	struct eventfd_ctx *efd;
+	/* the level the listener asked for */
+	enum vmpressure_levels level;
+	/* level of the last window, and when the listener was last signalled */
+	enum vmpressure_levels last_level;
+	unsigned long last;
+	struct list_head node;
+};
+
+static struct vmpressure *work_to_vmpressure(struct work_struct *work)
+{
+	return container_of(work, struct vmpressure, work);
+}
+
+static unsigned long vmpressure_calc_pressure(unsigned long scanned,
+					      unsigned long reclaimed)
+{
+	/* reclaim can free more than it scanned, e.g. with THP */
+	if (reclaimed >= scanned)
+		return 0;
+	return (scanned - reclaimed) * 100 / scanned;
+}
+
+static enum vmpressure_levels vmpressure_calc_level(struct vmpressure *vmpr,
+						    unsigned long pressure)
+{
+	enum vmpressure_levels level = VMPRESSURE_LOW;
+
+	if (pressure >= vmpressure_level_critical)
+		level = VMPRESSURE_CRITICAL;
+	else if (pressure >= vmpressure_level_med)
+		level = VMPRESSURE_MEDIUM;
+
+	if (time_after(jiffies, vmpr->level_stamp + VMPRESSURE_DECAY))
+		return level;
+
+	while (level < vmpr->level) {
+		unsigned int next = level == VMPRESSURE_LOW ?
+			vmpressure_level_med : vmpressure_level_critical;
+
+		if (pressure + vmpressure_hyst < next)
+			break;
+		level++;
+	}
+	return level;
+}
+
+/*
+ * Evaluate a window of @vmpr and signal its listeners.  Returns true if
+ * the group has listeners for the resulting level, which then take care
+ * of the pressure; otherwise it is passed up the hierarchy.
+ */
+static bool vmpressure_event(struct vmpressure *vmpr,
+			     unsigned long scanned, unsigned long reclaimed)
+{
+	struct vmpressure_event *ev;
+	enum vmpressure_levels level;
+	bool handled = false;
+
+	mutex_lock(&vmpr->events_lock);
+
+	level = vmpressure_calc_level(vmpr,
+			vmpressure_calc_pressure(scanned, reclaimed));
+	vmpr->level = level;
+	vmpr->level_stamp = jiffies;
+	vmpr->nr_windows[level]++;
+
+	list_for_each_entry(ev, &vmpr->events, node) {
+		if (level < ev->level) {
+			ev->last_level = level;
+			continue;
+		}
+		handled = true;
+		if (level > ev->last_level ||
+		    time_after_eq(jiffies, ev->last + VMPRESSURE_RATE)) {
+			eventfd_signal(ev->efd, 1);
+			ev->last = jiffies;
+		}
+		ev->last_level = level;
+	}
+
+	mutex_unlock(&vmpr->events_lock);
+
+	return handled;
+}
+
+static void vmpressure_work_fn(struct work_struct *work)
+{
+	struct vmpressure *vmpr = work_to_vmpressure(work);
+	unsigned long scanned;
+	unsigned long reclaimed;
+
+	spin_lock(&vmpr->sr_lock);
+	scanned = vmpr->scanned;
+	reclaimed = vmpr->reclaimed;
+	vmpr->scanned = 0;
+	vmpr->reclaimed = 0;
+	spin_unlock(&vmpr->sr_lock);
+
+	/* the window was taken by an earlier run of the work */
+	if (!scanned)
+		return;
+
+	do {
+		if (vmpressure_event(vmpr, scanned, reclaimed))
+			break;
+	} while ((vmpr = vmpressure_parent(vmpr)));
+}
+
+/**
+ * vmpressure() - account memory pressure through scanned/reclaimed ratio
+ * @gfp:	reclaimer's gfp mask
+ * @memcg:	cgroup memory controller handle, %NULL for global reclaim
+ * @scanned:	number of pages scanned
+ * @reclaimed:	number of pages reclaimed
+ *
+ * Called by page reclaim after every zone it shrank.  Once a window of
+ * pages was scanned, the pressure is evaluated and the listeners are
+ * signalled from a work item, outside of reclaim.
+ *
+ * This function does not return any value.
+ */
+void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
+		unsigned long scanned, unsigned long reclaimed)
+{
+	struct vmpressure *vmpr;
+
+	if (mem_cgroup_disabled())
+		return;
+
+	/*
+	 * Only account the pressure user space can help with.  A
+	 * shortage of DMA or normal memory for kernel allocations that
+	 * can not do I/O is not relieved by killing tasks, and would
+	 * mostly give false alarms.
+	 */
+	if (!(gfp & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+
+	if (!scanned)
+		return;
+
+	vmpr = memcg_to_vmpressure(memcg);
+	if (!vmpr)
+		return;
+
+	spin_lock(&vmpr->sr_lock);
+	vmpr->scanned += scanned;
+	vmpr->reclaimed += reclaimed;
+	scanned = vmpr->scanned;
+	spin_unlock(&vmpr->sr_lock);
+
+	if (scanned < vmpressure_win)
+		return;
+	schedule_work(&vmpr->work);
+}
+
+/**
+ * vmpressure_prio() - account memory pressure through reclaimer priority level
+ * @gfp:	reclaimer's gfp mask
+ * @memcg:	cgroup memory controller handle, %NULL for global reclaim
+ * @prio:	reclaimer's priority
+ *
+ * Called by direct reclaim before every priority level.  Reclaim going
+ * down to vmpressure_level_critical_prio is critical pressure, whatever
+ * the ratio of the windows.
+ *
+ * This function does not return any value.
+ */
+void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio)
+{
+	if (prio > vmpressure_level_critical_prio)
+		return;
+
+	/* a full window of nothing reclaimed */
+	vmpressure(gfp, memcg, vmpressure_win, 0);
+}
+
+/**
+ * vmpressure_register_event() - bind vmpressure notifications to an eventfd
+ * @cgrp:	cgroup that is interested in vmpressure notifications
+ * @cft:	cgroup control files handle
+ * @eventfd:	eventfd context to link notifications with
+ * @args:	"low", "medium" or "critical"
+ *
+ * The eventfd is signalled when the pressure of @cgrp reaches the level
+ * given in @args or a higher one.
+ */
+int vmpressure_register_event(struct cgroup *cgrp, struct cftype *cft,
+			      struct eventfd_ctx *eventfd, const char *args)
+{
+	struct vmpressure *vmpr = cgroup_to_vmpressure(cgrp);
+	struct vmpressure_event *ev;
+	int level;
+
+	for (level = 0; level < VMPRESSURE_NUM_LEVELS; level++) {
+		if (!strcmp(vmpressure_str_levels[level], args))
+			break;
+	}
+	if (level >= VMPRESSURE_NUM_LEVELS)
+		return -EINVAL;
+
+	ev = kzalloc(sizeof(*ev), GFP_KERNEL);
+	if (!ev)
+		return -ENOMEM;
+
+	ev->efd = eventfd;
+	ev->level = level;
+	ev->last_level = VMPRESSURE_LOW;
+	ev->last = jiffies - VMPRESSURE_RATE;
+
+	mutex_lock(&vmpr->events_lock);
+	list_add(&ev->node, &vmpr->events);
+	mutex_unlock(&vmpr->events_lock);
+
+	return 0;
+}
+
+/**
+ * vmpressure_unregister_event() - unbind eventfd from vmpressure
+ * @cgrp:	cgroup handle
+ * @cft:	cgroup control files handle
+ * @eventfd:	eventfd context that was used to link vmpressure with the @cgrp
+ */
+void vmpressure_unregister_event(struct cgroup *cgrp, struct cftype *cft,
+				 struct eventfd_ctx *eventfd)
+{
+	struct vmpressure *vmpr = cgroup_to_vmpressure(cgrp);
+	struct vmpressure_event *ev, *tmp;
+
+	mutex_lock(&vmpr->events_lock);
+	list_for_each_entry_safe(ev, tmp, &vmpr->events, node) {
+		if (ev->efd != eventfd)
+			continue;
+		list_del(&ev->node);
+		kfree(ev);
+	}
+	mutex_unlock(&vmpr->events_lock);
+}
+
+/*
+ * The level of the last window and the number of windows seen at every
+ * level, for tuning listeners and for the curious.
+ */
+int vmpressure_read(struct cgroup *cgrp, struct cftype *cft,
+		    struct cgroup_map_cb *cb)
+{
+	struct vmpressure *vmpr = cgroup_to_vmpressure(cgrp);
+	char name[32];
+	int level;
+
+	mutex_lock(&vmpr->events_lock);
+	cb->fill(cb, "level", vmpr->level);
+	for (level = 0; level < VMPRESSURE_NUM_LEVELS; level++) {
+		snprintf(name, sizeof(name), "%s_windows",
+			 vmpressure_str_levels[level]);
+		cb->fill(cb, name, vmpr->nr_windows[level]);
+	}
+	mutex_unlock(&vmpr->events_lock);
+
+	return 0;
+}
+
+/**
+ * vmpressure_init() - initialize vmpressure control structure
+ * @vmpr:	Structure to be initialized
+ */
+void vmpressure_init(struct vmpressure *vmpr)
+{
+	spin_lock_init(&vmpr->sr_lock);
+	mutex_init(&vmpr->events_lock);
+	INIT_LIST_HEAD(&vmpr->events);
+	INIT_WORK(&vmpr->work, vmpressure_work_fn);
+	vmpr->level = VMPRESSURE_LOW;
+	vmpr->level_stamp = jiffies;
+}
+
+/**
+ * vmpressure_cleanup() - wait for the work of a group going away
+ * @vmpr:	Structure of the group
+ *
+ * The group is not reclaimed from anymore, so no new work is queued.
+ */
+void vmpressure_cleanup(struct vmpressure *vmpr)
+{
+	flush_work(&vmpr->work);
+}
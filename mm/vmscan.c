@@ -43,6 +43,7 @@
 #include <linux/sysctl.h>
 #include <linux/oom.h>
 #include <linux/prefetch.h>
+#include <linux/vmpressure.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -105,6 +106,9 @@ struct scan_control {
 	 */
 	reclaim_mode_t reclaim_mode;
 
+	/* Reclaim pages regardless of their recent references */
+	int ignore_references;
+
 	/* Which cgroup do we reclaim from */
 	struct mem_cgroup *mem_cgroup;
 
@@ -479,9 +483,11 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  A page cache page @reclaimed from
+ * the LRU leaves a shadow entry behind, see workingset.c.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -527,10 +533,13 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		swapcache_free(swap, page);
 	} else {
 		void (*freepage)(struct page *);
+		void *shadow = NULL;
 
 		freepage = mapping->a_ops->freepage;
 
-		__delete_from_page_cache(page);
+		if (reclaimed && page_is_file_cache(page))
+			shadow = workingset_eviction(mapping, page);
+		__delete_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 
@@ -553,7 +562,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -657,6 +666,10 @@ static enum page_references page_check_references(struct page *page,
 	if (sc->reclaim_mode & RECLAIM_MODE_LUMPYRECLAIM)
 		return PAGEREF_RECLAIM;
 
+	/* Process reclaim - the caller chose the pages */
+	if (sc->ignore_references)
+		return PAGEREF_RECLAIM;
+
 	/*
 	 * Mlock lost the isolation race with us.  Let try_to_unmap()
 	 * move the page to the unevictable list.
@@ -751,7 +764,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			goto keep;
 
 		VM_BUG_ON(PageActive(page));
-		VM_BUG_ON(page_zone(page) != zone);
+		VM_BUG_ON(zone && page_zone(page) != zone);
 
 		sc->nr_scanned++;
 
@@ -907,7 +920,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -958,7 +971,8 @@ keep_lumpy:
 	 * back off and wait for congestion to clear because further reclaim
 	 * will encounter the same problem
 	 */
-	if (nr_dirty && nr_dirty == nr_congested && scanning_global_lru(sc))
+	if (zone && nr_dirty && nr_dirty == nr_congested &&
+	    scanning_global_lru(sc))
 		zone_set_flag(zone, ZONE_CONGESTED);
 
 	free_page_list(&free_pages);
@@ -968,6 +982,42 @@ keep_lumpy:
 	return nr_reclaimed;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Reclaim the pages on @page_list, which /proc/<pid>/reclaim isolated from
+ * the LRU lists of any zones, regardless of their recent references: user
+ * space chose the process.  The pages which cannot be reclaimed go back to
+ * the LRU lists.  Returns the number of reclaimed pages.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.may_writepage = !laptop_mode,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.ignore_references = 1,
+	};
+	unsigned long nr_reclaimed;
+	struct page *page;
+
+	list_for_each_entry(page, page_list, lru) {
+		dec_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+		ClearPageActive(page);
+	}
+
+	nr_reclaimed = shrink_page_list(page_list, NULL, &sc);
+
+	while (!list_empty(page_list)) {
+		page = lru_to_page(page_list);
+		list_del(&page->lru);
+		putback_lru_page(page);
+	}
+	return nr_reclaimed;
+}
+#endif
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -1934,6 +1984,54 @@ static inline bool should_continue_reclaim(struct zone *zone,
 	}
 }
 
+static void shrink_zone(int priority, struct zone *zone,
+				struct scan_control *sc);
+
+/*
+ * Global reclaim first shrinks the memory cgroups with a reclaim_priority,
+ * the groups of background applications, at a scan priority lowered by it:
+ * each step doubles the pressure on the group against the rest of the
+ * zone, though it only reaches priority 0 along with the zone.  They give
+ * back at most SWAP_CLUSTER_MAX pages a call, as kswapd asks for ULONG_MAX.
+ * Returns the number of pages reclaimed.
+ */
+static unsigned long shrink_zone_reclaim_priority(int priority,
+						  struct zone *zone,
+						  struct scan_control *sc)
+{
+	unsigned long nr_to_reclaim = min_t(unsigned long, sc->nr_to_reclaim,
+					    SWAP_CLUSTER_MAX);
+	unsigned long nr_reclaimed = 0;
+	struct mem_cgroup *mem = NULL;
+	unsigned int swappiness;
+	int prio;
+
+	while ((mem = mem_cgroup_reclaim_priority_next(mem, &prio,
+						       &swappiness))) {
+		struct scan_control msc = {
+			.gfp_mask = sc->gfp_mask,
+			.may_writepage = sc->may_writepage,
+			.may_unmap = sc->may_unmap,
+			.may_swap = sc->may_swap,
+			.nr_to_reclaim = nr_to_reclaim - nr_reclaimed,
+			.hibernation_mode = sc->hibernation_mode,
+			.swappiness = swappiness,
+			.order = 0,
+			.mem_cgroup = mem,
+		};
+
+		shrink_zone(priority ? max(priority - prio, 1) : 0, zone, &msc);
+		nr_reclaimed += msc.nr_reclaimed;
+		sc->nr_scanned += msc.nr_scanned;
+		if (nr_reclaimed >= nr_to_reclaim) {
+			mem_cgroup_reclaim_priority_break(mem);
+			break;
+		}
+	}
+	sc->nr_reclaimed += nr_reclaimed;
+	return nr_reclaimed;
+}
+
 /*
  * This is a basic per-zone page freer.  Used by both kswapd and direct reclaim.
  */
@@ -1945,6 +2043,13 @@ static void shrink_zone(int priority, struct zone *zone,
 	enum lru_list l;
 	unsigned long nr_reclaimed, nr_scanned;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
+	unsigned long total_scanned = sc->nr_scanned;
+	unsigned long total_reclaimed = sc->nr_reclaimed;
+
+	/* the background groups alone may give back enough */
+	if (scanning_global_lru(sc) &&
+	    shrink_zone_reclaim_priority(priority, zone, sc) >= nr_to_reclaim)
+		goto out;
 
 restart:
 	nr_reclaimed = 0;
@@ -1988,6 +2093,11 @@ restart:
 					sc->nr_scanned - nr_scanned, sc))
 		goto restart;
 
+out:
+	vmpressure(sc->gfp_mask, sc->mem_cgroup,
+		   sc->nr_scanned - total_scanned,
+		   sc->nr_reclaimed - total_reclaimed);
+
 	throttle_vm_writeout(sc->gfp_mask);
 }
 
@@ -2106,6 +2216,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		count_vm_event(ALLOCSTALL);
 
 	for (priority = DEF_PRIORITY; priority >= 0; priority--) {
+		vmpressure_prio(sc->gfp_mask, sc->mem_cgroup, priority);
 		sc->nr_scanned = 0;
 		if (!priority)
 			disable_swap_token(sc->mem_cgroup);
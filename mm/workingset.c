@@ -0,0 +1,175 @@
+/*
+ * workingset.c - refault distance based working set detection
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
+#include <linux/pagemap.h>
+#include <linux/atomic.h>
+
+/*
+ *		Double CLOCK lists
+ *
+ * Per zone, two clock lists are maintained for file pages: the
+ * inactive and the active list.  Freshly faulted pages start out at
+ * the head of the inactive list and page reclaim scans pages from the
+ * tail.  Pages that are accessed multiple times on the inactive list
+ * are promoted to the active list, to protect them from reclaim,
+ * whereas active pages are demoted to the inactive list when the
+ * active list grows too big.
+ *
+ *   fault ------------------------+
+ *                                 |
+ *              +--------------+   |            +-------------+
+ *   reclaim <- |   inactive   | <-+-- demotion |    active   | <--+
+ *              +--------------+                +-------------+    |
+ *                     |                                           |
+ *                     +-------------- promotion ------------------+
+ *
+ *
+ *		Access frequency and refault distance
+ *
+ * A workload is thrashing when its pages are frequently used but they
+ * are evicted from the inactive list every time before another access
+ * would have promoted them to the active list.  The active list is
+ * balanced against the inactive list by inactive_file_is_low() alone,
+ * which can not tell a working set that is being pushed out by a large
+ * stream of use-once pages from healthy streaming.
+ *
+ * The sum of evictions and activations of the inactive list, the
+ * inactive age, is recorded in a shadow entry left in the page cache
+ * radix tree slot of every reclaimed file page.  When the page is
+ * faulted in again, the difference between the inactive age then and
+ * the one recorded at eviction is the refault distance: the minimum
+ * number of inactive list slots the page would have needed to stay
+ * resident.
+ *
+ * If the refault distance is not larger than the active list, the page
+ * would have been activated had the active list given up that many
+ * pages to the inactive list.  It is then activated right away, to
+ * compete with the current active pages for the memory; if it is not
+ * used again while active, it is demoted again like any other page.
+ *
+ *
+ *		Shadow entries
+ *
+ * A shadow entry packs the zone of the page and the inactive age at
+ * its eviction into an exceptional radix tree entry.  Shadow entries
+ * live as long as the page cache of their inode, and are removed by
+ * truncation or when the slot is refilled.  A mapping keeps no more
+ * shadow entries than there are file pages on the LRU lists: beyond
+ * that, the refault distance of the oldest ones would be larger than
+ * the active list anyway.
+ *
+ * Refaults and the activations among them are counted in the
+ * workingset_refault and workingset_activate items of /proc/vmstat and
+ * /proc/zoneinfo.
+ */
+
+#define EVICTION_SHIFT	(RADIX_TREE_EXCEPTIONAL_SHIFT + \
+			 ZONES_SHIFT + NODES_SHIFT)
+#define EVICTION_MASK	(~0UL >> EVICTION_SHIFT)
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow,
+			  struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction;
+	unsigned long refault;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	refault = atomic_long_read(&(*zone)->inactive_age);
+	/*
+	 * The unsigned subtraction here gives an accurate distance
+	 * across inactive_age overflows in most cases.
+	 *
+	 * There is a special case: usually, shadow entries have a
+	 * short lifetime and are either refaulted or truncated along
+	 * with the inode before they get too old.  But a shadow entry
+	 * of a file that is not refaulted for a long time can be older
+	 * than a full wrap-around of the counter; its distance then
+	 * appears smaller than it is, and the page is activated
+	 * needlessly.  That is one activation, corrected by the next
+	 * demotion.
+	 */
+	*distance = (refault - eviction) & EVICTION_MASK;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @mapping->page_tree in place
+ * of the evicted @page so that a later refault can be detected, or
+ * %NULL when @mapping keeps enough of them already.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	if (mapping->nrshadows >= global_page_state(NR_ACTIVE_FILE) +
+				  global_page_state(NR_INACTIVE_FILE))
+		return NULL;
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates and evaluates the refault distance of the previously
+ * evicted page in the context of the zone it was allocated in.
+ *
+ * Returns %true if the page should be activated, %false otherwise.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
@@ -0,0 +1,697 @@
+/*
+ * Compressed cleancache backend
+ *
+ * Keeps clean page cache pages evicted from selected filesystems in RAM,
+ * compressed with LZO, so that reading them again costs a decompression
+ * instead of a trip to the storage device.  This is a plain cleancache
+ * backend: it needs neither tmem nor the zcache staging driver.
+ *
+ * Only mounts with a non-zero size limit get a pool.  The limit comes from
+ * /sys/kernel/mm/zcleancache/mounts (per block device name) or, failing
+ * that, from default_kb, and is looked up when the filesystem is mounted.
+ * Each pool is an LRU: once its compressed pages exceed the limit, or the
+ * VM asks through the shrinker, the coldest pages are dropped.  Pages are
+ * exclusive, i.e. a successful get removes them from the pool since they
+ * are back in the page cache.  See Documentation/vm/zcleancache.txt.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/module.h>
+#include <linux/cleancache.h>
+#include <linux/highmem.h>
+#include <linux/kobject.h>
+#include <linux/list.h>
+#include <linux/lzo.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/radix-tree.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+
+#define ZCC_MAX_POOLS		32
+#define ZCC_MAX_RULES		16
+#define ZCC_BATCH		16
+
+/* pages which do not compress below this are not worth keeping */
+#define ZCC_MAX_LEN		(PAGE_SIZE * 3 / 4)
+
+struct zcc_pool {
+	spinlock_t lock;
+	struct rb_root objects;
+	struct list_head lru;		/* head is the most recently put */
+	unsigned long max_bytes;
+	unsigned long stored_bytes;
+	unsigned long stored_pages;
+
+	/* statistics, under lock */
+	unsigned long puts;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evicts;
+	unsigned long rejects;
+	unsigned long flushes;
+
+	struct kobject kobj;
+};
+
+/* all cached pages of one file */
+struct zcc_object {
+	struct rb_node node;
+	struct cleancache_filekey key;
+	struct radix_tree_root pages;
+	unsigned long nr_pages;
+};
+
+struct zcc_entry {
+	struct list_head lru;
+	struct zcc_object *obj;
+	pgoff_t index;
+	unsigned int len;
+	unsigned char data[0];
+};
+
+struct zcc_rule {
+	char name[32];
+	unsigned long max_kb;
+};
+
+/* protects the rules and pool creation and destruction */
+static DEFINE_MUTEX(zcc_mutex);
+static struct zcc_rule zcc_rules[ZCC_MAX_RULES];
+static int zcc_nr_rules;
+static unsigned long zcc_default_kb;
+static struct zcc_pool *zcc_pools[ZCC_MAX_POOLS];
+static struct kobject *zcc_kobj;
+
+/* total pages stored in all pools, for the shrinker */
+static atomic_long_t zcc_total_pages = ATOMIC_LONG_INIT(0);
+
+static DEFINE_PER_CPU(unsigned char *, zcc_wrkmem);
+static DEFINE_PER_CPU(unsigned char *, zcc_dstmem);
+
+static inline struct zcc_pool *zcc_get_pool(int pool_id)
+{
+	if (pool_id < 0 || pool_id >= ZCC_MAX_POOLS)
+		return NULL;
+	return zcc_pools[pool_id];
+}
+
+static inline unsigned long zcc_entry_size(struct zcc_entry *entry)
+{
+	return sizeof(*entry) + entry->len;
+}
+
+static struct zcc_object *zcc_find_object(struct zcc_pool *pool,
+					  struct cleancache_filekey *key)
+{
+	struct rb_node *node = pool->objects.rb_node;
+
+	while (node) {
+		struct zcc_object *obj = rb_entry(node, struct zcc_object, node);
+		int cmp = memcmp(key, &obj->key, sizeof(*key));
+
+		if (cmp < 0)
+			node = node->rb_left;
+		else if (cmp > 0)
+			node = node->rb_right;
+		else
+			return obj;
+	}
+	return NULL;
+}
+
+static void zcc_insert_object(struct zcc_pool *pool, struct zcc_object *obj)
+{
+	struct rb_node **link = &pool->objects.rb_node, *parent = NULL;
+
+	while (*link) {
+		struct zcc_object *this;
+
+		parent = *link;
+		this = rb_entry(parent, struct zcc_object, node);
+		if (memcmp(&obj->key, &this->key, sizeof(obj->key)) < 0)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&obj->node, parent, link);
+	rb_insert_color(&obj->node, &pool->objects);
+}
+
+/*
+ * Unlink an entry from its pool, freeing its object once empty.  The
+ * caller frees the entry itself.  Called with pool->lock held.
+ */
+static void zcc_remove_entry(struct zcc_pool *pool, struct zcc_entry *entry)
+{
+	struct zcc_object *obj = entry->obj;
+
+	radix_tree_delete(&obj->pages, entry->index);
+	list_del(&entry->lru);
+	pool->stored_bytes -= zcc_entry_size(entry);
+	pool->stored_pages--;
+	atomic_long_dec(&zcc_total_pages);
+	if (!--obj->nr_pages) {
+		rb_erase(&obj->node, &pool->objects);
+		kfree(obj);
+	}
+}
+
+/* Drop the coldest page of a pool.  Called with pool->lock held. */
+static void zcc_evict_one(struct zcc_pool *pool)
+{
+	struct zcc_entry *entry;
+
+	entry = list_entry(pool->lru.prev, struct zcc_entry, lru);
+	zcc_remove_entry(pool, entry);
+	kfree(entry);
+	pool->evicts++;
+}
+
+/* Returns 1 if a page was dropped.  Called with pool->lock held. */
+static int zcc_flush_index(struct zcc_pool *pool,
+			   struct cleancache_filekey *key, pgoff_t index)
+{
+	struct zcc_object *obj = zcc_find_object(pool, key);
+	struct zcc_entry *entry;
+
+	if (!obj)
+		return 0;
+	entry = radix_tree_lookup(&obj->pages, index);
+	if (!entry)
+		return 0;
+	zcc_remove_entry(pool, entry);
+	kfree(entry);
+	return 1;
+}
+
+/*
+ * Called from __delete_from_page_cache() with the mapping's tree_lock
+ * held, so nothing here may sleep.
+ */
+static void zcc_put_page(int pool_id, struct cleancache_filekey key,
+			 pgoff_t index, struct page *page)
+{
+	struct zcc_pool *pool = zcc_get_pool(pool_id);
+	struct zcc_entry *entry = NULL;
+	struct zcc_object *obj;
+	unsigned char *src, *dst;
+	unsigned long flags;
+	size_t len;
+	int ret;
+
+	if (!pool)
+		return;
+
+	local_irq_save(flags);
+	if (pool->max_bytes) {
+		dst = __get_cpu_var(zcc_dstmem);
+		src = kmap_atomic(page, KM_USER0);
+		ret = lzo1x_1_compress(src, PAGE_SIZE, dst, &len,
+				       __get_cpu_var(zcc_wrkmem));
+		kunmap_atomic(src, KM_USER0);
+		if (ret == LZO_E_OK && len <= ZCC_MAX_LEN)
+			entry = kmalloc(sizeof(*entry) + len, GFP_ATOMIC |
+					__GFP_NORETRY | __GFP_NOWARN |
+					__GFP_NOMEMALLOC);
+		if (entry) {
+			memcpy(entry->data, dst, len);
+			entry->len = len;
+			entry->index = index;
+		}
+	}
+
+	spin_lock(&pool->lock);
+	/* an older copy must never be returned in place of this one */
+	zcc_flush_index(pool, &key, index);
+	if (!entry)
+		goto reject;
+
+	obj = zcc_find_object(pool, &key);
+	if (!obj) {
+		obj = kmalloc(sizeof(*obj), GFP_ATOMIC | __GFP_NORETRY |
+			      __GFP_NOWARN | __GFP_NOMEMALLOC);
+		if (!obj)
+			goto reject_free;
+		obj->key = key;
+		INIT_RADIX_TREE(&obj->pages, GFP_ATOMIC | __GFP_NOWARN);
+		obj->nr_pages = 0;
+		zcc_insert_object(pool, obj);
+	}
+	if (radix_tree_insert(&obj->pages, index, entry)) {
+		if (!obj->nr_pages) {
+			rb_erase(&obj->node, &pool->objects);
+			kfree(obj);
+		}
+		goto reject_free;
+	}
+	entry->obj = obj;
+	obj->nr_pages++;
+	list_add(&entry->lru, &pool->lru);
+	pool->stored_bytes += zcc_entry_size(entry);
+	pool->stored_pages++;
+	pool->puts++;
+	atomic_long_inc(&zcc_total_pages);
+
+	while (pool->stored_bytes > pool->max_bytes)
+		zcc_evict_one(pool);
+	spin_unlock(&pool->lock);
+	local_irq_restore(flags);
+	return;
+
+reject_free:
+	kfree(entry);
+reject:
+	pool->rejects++;
+	spin_unlock(&pool->lock);
+	local_irq_restore(flags);
+}
+
+static int zcc_get_page(int pool_id, struct cleancache_filekey key,
+			pgoff_t index, struct page *page)
+{
+	struct zcc_pool *pool = zcc_get_pool(pool_id);
+	struct zcc_entry *entry = NULL;
+	struct zcc_object *obj;
+	unsigned char *dst;
+	unsigned long flags;
+	size_t len = PAGE_SIZE;
+	int ret;
+
+	if (!pool)
+		return -1;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	obj = zcc_find_object(pool, &key);
+	if (obj)
+		entry = radix_tree_lookup(&obj->pages, index);
+	if (entry) {
+		zcc_remove_entry(pool, entry);
+		pool->hits++;
+	} else {
+		pool->misses++;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+	if (!entry)
+		return -1;
+
+	dst = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_decompress_safe(entry->data, entry->len, dst, &len);
+	kunmap_atomic(dst, KM_USER0);
+	kfree(entry);
+
+	if (WARN_ON_ONCE(ret != LZO_E_OK || len != PAGE_SIZE))
+		return -1;
+	return 0;
+}
+
+static void zcc_flush_page(int pool_id, struct cleancache_filekey key,
+			   pgoff_t index)
+{
+	struct zcc_pool *pool = zcc_get_pool(pool_id);
+	unsigned long flags;
+
+	if (!pool)
+		return;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (zcc_flush_index(pool, &key, index))
+		pool->flushes++;
+	spin_unlock_irqrestore(&pool->lock, flags);
+}
+
+static void zcc_flush_inode(int pool_id, struct cleancache_filekey key)
+{
+	struct zcc_pool *pool = zcc_get_pool(pool_id);
+	struct zcc_entry *batch[ZCC_BATCH];
+	struct zcc_object *obj;
+	unsigned long flags;
+	int i, n, last;
+
+	if (!pool)
+		return;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	obj = zcc_find_object(pool, &key);
+	while (obj) {
+		n = radix_tree_gang_lookup(&obj->pages, (void **)batch, 0,
+					   ZCC_BATCH);
+		/* removing the last entry frees the object */
+		last = (n == obj->nr_pages);
+		for (i = 0; i < n; i++) {
+			zcc_remove_entry(pool, batch[i]);
+			kfree(batch[i]);
+			pool->flushes++;
+		}
+		if (last || !n)
+			break;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+}
+
+static void zcc_pool_drain(struct zcc_pool *pool)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	while (!list_empty(&pool->lru)) {
+		struct zcc_entry *entry;
+
+		entry = list_entry(pool->lru.next, struct zcc_entry, lru);
+		zcc_remove_entry(pool, entry);
+		kfree(entry);
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+}
+
+static void zcc_flush_fs(int pool_id)
+{
+	struct zcc_pool *pool;
+
+	mutex_lock(&zcc_mutex);
+	pool = zcc_get_pool(pool_id);
+	if (pool) {
+		zcc_pools[pool_id] = NULL;
+		zcc_pool_drain(pool);
+		kobject_put(&pool->kobj);
+	}
+	mutex_unlock(&zcc_mutex);
+}
+
+/*
+ * Shrinker: compressed pages are cheap to recreate compared to the memory
+ * they pin, so give them up round robin across the pools when asked.
+ */
+static int zcc_shrink(struct shrinker *shrink, struct shrink_control *sc)
+{
+	static int next_pool;
+	int nr = sc->nr_to_scan;
+	int i, idle = 0;
+
+	if (nr) {
+		if (!mutex_trylock(&zcc_mutex))
+			return -1;
+		for (i = next_pool; nr > 0 && idle < ZCC_MAX_POOLS;
+		     i = (i + 1) % ZCC_MAX_POOLS) {
+			struct zcc_pool *pool = zcc_pools[i];
+			unsigned long flags;
+
+			if (!pool || list_empty(&pool->lru)) {
+				idle++;
+				continue;
+			}
+			idle = 0;
+			spin_lock_irqsave(&pool->lock, flags);
+			if (!list_empty(&pool->lru)) {
+				zcc_evict_one(pool);
+				nr--;
+			}
+			spin_unlock_irqrestore(&pool->lock, flags);
+		}
+		next_pool = i;
+		mutex_unlock(&zcc_mutex);
+	}
+	return atomic_long_read(&zcc_total_pages);
+}
+
+static struct shrinker zcc_shrinker = {
+	.shrink = zcc_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+/* Size limit for a mount, from its rule or the default.  zcc_mutex held. */
+static unsigned long zcc_policy_kb(const char *name)
+{
+	int i;
+
+	for (i = 0; i < zcc_nr_rules; i++)
+		if (!strcmp(zcc_rules[i].name, name))
+			return zcc_rules[i].max_kb;
+	return zcc_default_kb;
+}
+
+/* per pool sysfs files, in /sys/kernel/mm/zcleancache/<dev>/ */
+
+#define to_zcc_pool(k) container_of(k, struct zcc_pool, kobj)
+
+static ssize_t max_kb_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", to_zcc_pool(kobj)->max_bytes >> 10);
+}
+
+static ssize_t max_kb_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct zcc_pool *pool = to_zcc_pool(kobj);
+	unsigned long kb, flags;
+
+	if (strict_strtoul(buf, 10, &kb) || kb > (ULONG_MAX >> 10))
+		return -EINVAL;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	pool->max_bytes = kb << 10;
+	while (pool->stored_bytes > pool->max_bytes)
+		zcc_evict_one(pool);
+	spin_unlock_irqrestore(&pool->lock, flags);
+	return count;
+}
+
+static ssize_t stat_show(struct kobject *kobj,
+			 struct kobj_attribute *attr, char *buf)
+{
+	struct zcc_pool *pool = to_zcc_pool(kobj);
+	unsigned long flags;
+	ssize_t ret;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	ret = sprintf(buf, "%lu %lu %lu %lu %lu %lu %lu %lu\n",
+		      pool->stored_pages, pool->stored_bytes >> 10,
+		      pool->puts, pool->hits, pool->misses,
+		      pool->evicts, pool->rejects, pool->flushes);
+	spin_unlock_irqrestore(&pool->lock, flags);
+	return ret;
+}
+
+static struct kobj_attribute max_kb_attr =
+	__ATTR(max_kb, 0644, max_kb_show, max_kb_store);
+static struct kobj_attribute stat_attr = __ATTR_RO(stat);
+
+static struct attribute *zcc_pool_attrs[] = {
+	&max_kb_attr.attr,
+	&stat_attr.attr,
+	NULL,
+};
+
+static void zcc_pool_release(struct kobject *kobj)
+{
+	kfree(to_zcc_pool(kobj));
+}
+
+static struct kobj_type zcc_pool_ktype = {
+	.sysfs_ops = &kobj_sysfs_ops,
+	.release = zcc_pool_release,
+	.default_attrs = zcc_pool_attrs,
+};
+
+static int zcc_init_sb(struct super_block *sb, size_t pagesize)
+{
+	struct zcc_pool *pool;
+	unsigned long kb;
+	int pool_id = -1;
+	int i;
+
+	if (pagesize != PAGE_SIZE)
+		return -1;
+
+	mutex_lock(&zcc_mutex);
+	kb = zcc_policy_kb(sb->s_id);
+	if (!kb)
+		goto out;
+
+	for (i = 0; i < ZCC_MAX_POOLS; i++)
+		if (!zcc_pools[i])
+			break;
+	if (i == ZCC_MAX_POOLS)
+		goto out;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		goto out;
+	spin_lock_init(&pool->lock);
+	pool->objects = RB_ROOT;
+	INIT_LIST_HEAD(&pool->lru);
+	pool->max_bytes = kb << 10;
+	if (kobject_init_and_add(&pool->kobj, &zcc_pool_ktype, zcc_kobj,
+				 "%s", sb->s_id)) {
+		kobject_put(&pool->kobj);
+		goto out;
+	}
+	zcc_pools[i] = pool;
+	pool_id = i;
+out:
+	mutex_unlock(&zcc_mutex);
+	return pool_id;
+}
+
+/* only mounts chosen by sb->s_id are cached */
+static int zcc_init_fs(size_t pagesize)
+{
+	return -1;
+}
+
+static int zcc_init_shared_fs(char *uuid, size_t pagesize)
+{
+	return -1;
+}
+
+static struct cleancache_ops zcc_cleancache_ops = {
+	.init_fs = zcc_init_fs,
+	.init_sb = zcc_init_sb,
+	.init_shared_fs = zcc_init_shared_fs,
+	.get_page = zcc_get_page,
+	.put_page = zcc_put_page,
+	.flush_page = zcc_flush_page,
+	.flush_inode = zcc_flush_inode,
+	.flush_fs = zcc_flush_fs,
+};
+
+/* global sysfs files, in /sys/kernel/mm/zcleancache/ */
+
+static ssize_t default_kb_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", zcc_default_kb);
+}
+
+static ssize_t default_kb_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long kb;
+
+	if (strict_strtoul(buf, 10, &kb) || kb > (ULONG_MAX >> 10))
+		return -EINVAL;
+
+	mutex_lock(&zcc_mutex);
+	zcc_default_kb = kb;
+	mutex_unlock(&zcc_mutex);
+	return count;
+}
+
+static ssize_t mounts_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	mutex_lock(&zcc_mutex);
+	for (i = 0; i < zcc_nr_rules; i++)
+		len += sprintf(buf + len, "%s %lu\n", zcc_rules[i].name,
+			       zcc_rules[i].max_kb);
+	mutex_unlock(&zcc_mutex);
+	return len;
+}
+
+/*
+ * "<dev> <max_kb>" sets the limit used when <dev> is mounted, and updates
+ * the pool of <dev> if it is mounted already.
+ */
+static ssize_t mounts_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	char name[32];
+	unsigned long kb;
+	int i, ret = count;
+
+	if (sscanf(buf, "%31s %lu", name, &kb) != 2 || kb > (ULONG_MAX >> 10))
+		return -EINVAL;
+
+	mutex_lock(&zcc_mutex);
+	for (i = 0; i < zcc_nr_rules; i++)
+		if (!strcmp(zcc_rules[i].name, name))
+			break;
+	if (i == zcc_nr_rules) {
+		if (zcc_nr_rules == ZCC_MAX_RULES) {
+			ret = -ENOSPC;
+			goto out;
+		}
+		strcpy(zcc_rules[i].name, name);
+		zcc_nr_rules++;
+	}
+	zcc_rules[i].max_kb = kb;
+
+	for (i = 0; i < ZCC_MAX_POOLS; i++) {
+		struct zcc_pool *pool = zcc_pools[i];
+		unsigned long flags;
+
+		if (!pool || strcmp(kobject_name(&pool->kobj), name))
+			continue;
+		spin_lock_irqsave(&pool->lock, flags);
+		pool->max_bytes = kb << 10;
+		while (pool->stored_bytes > pool->max_bytes)
+			zcc_evict_one(pool);
+		spin_unlock_irqrestore(&pool->lock, flags);
+	}
+out:
+	mutex_unlock(&zcc_mutex);
+	return ret;
+}
+
+static struct kobj_attribute default_kb_attr =
+	__ATTR(default_kb, 0644, default_kb_show, default_kb_store);
+static struct kobj_attribute mounts_attr =
+	__ATTR(mounts, 0644, mounts_show, mounts_store);
+
+static struct attribute *zcc_attrs[] = {
+	&default_kb_attr.attr,
+	&mounts_attr.attr,
+	NULL,
+};
+
+static struct attribute_group zcc_attr_group = {
+	.attrs = zcc_attrs,
+};
+
+static int __init zcc_init(void)
+{
+	struct cleancache_ops old_ops;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		per_cpu(zcc_wrkmem, cpu) = kmalloc(LZO1X_MEM_COMPRESS,
+						   GFP_KERNEL);
+		per_cpu(zcc_dstmem, cpu) = kmalloc(
+				lzo1x_worst_compress(PAGE_SIZE), GFP_KERNEL);
+		if (!per_cpu(zcc_wrkmem, cpu) || !per_cpu(zcc_dstmem, cpu))
+			goto nomem;
+	}
+
+	zcc_kobj = kobject_create_and_add("zcleancache", mm_kobj);
+	if (!zcc_kobj)
+		goto nomem;
+	if (sysfs_create_group(zcc_kobj, &zcc_attr_group)) {
+		kobject_put(zcc_kobj);
+		goto nomem;
+	}
+
+	old_ops = cleancache_register_ops(&zcc_cleancache_ops);
+	if (old_ops.init_fs != NULL)
+		pr_warning("zcleancache: cleancache_ops overridden\n");
+	register_shrinker(&zcc_shrinker);
+	return 0;
+
+nomem:
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(zcc_wrkmem, cpu));
+		kfree(per_cpu(zcc_dstmem, cpu));
+	}
+	return -ENOMEM;
+}
+module_init(zcc_init)
@@ -0,0 +1,265 @@
+/*
+ * fsync-storm.c -- many SQLite-like writers hammering fsync
+ *
+ * Each thread mimics a database in WAL mode: it appends a page sized record
+ * to its own write-ahead log and fdatasync()s it, and every few records it
+ * checkpoints by overwriting a page of its database file in place and
+ * fsync()ing that. Run from several threads against the same filesystem,
+ * this is what a phone full of apps syncing their databases looks like.
+ *
+ * The tool reports fsyncs per second with the p50, p99 and maximum latency
+ * of a single fsync, and the number of jbd2 commits per second taken from
+ * /proc/fs/jbd2/<dev>/info, so the effect of commit batching
+ * (/sys/fs/ext4/<dev>/fsync_batch_us) can be measured.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -O2 -o fsync-storm fsync-storm.c -lpthread */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PAGE		4096
+#define DB_PAGES	256
+#define WAL_PAGES	1024
+
+static const char *dir = ".";
+static const char *jbd2_dev;
+static int seconds = 10;
+static unsigned int checkpoint_every = 16;
+static volatile int stop;
+
+struct thread_result {
+	pthread_t thread;
+	int id;
+	unsigned long nr;
+	unsigned long alloc;
+	unsigned int *lat_us;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void record(struct thread_result *res, double usecs)
+{
+	if (res->nr == res->alloc) {
+		res->alloc = res->alloc ? res->alloc * 2 : 4096;
+		res->lat_us = realloc(res->lat_us,
+				      res->alloc * sizeof(*res->lat_us));
+		if (!res->lat_us) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	res->lat_us[res->nr++] = usecs;
+}
+
+static int timed_sync(struct thread_result *res, int fd, int datasync)
+{
+	double start = now();
+	int ret = datasync ? fdatasync(fd) : fsync(fd);
+
+	record(res, (now() - start) * 1e6);
+	return ret;
+}
+
+static int open_file(int id, const char *suffix)
+{
+	char name[4096];
+	int fd;
+
+	snprintf(name, sizeof(name), "%s/storm-%d.%s", dir, id, suffix);
+	fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		perror(name);
+	return fd;
+}
+
+static void *writer(void *arg)
+{
+	struct thread_result *res = arg;
+	char page[PAGE];
+	unsigned long n = 0;
+	int db, wal;
+
+	db = open_file(res->id, "db");
+	wal = open_file(res->id, "db-wal");
+	if (db < 0 || wal < 0)
+		exit(1);
+
+	memset(page, 'a' + res->id % 26, sizeof(page));
+	/* preallocate the database so checkpoints are pure overwrites */
+	for (n = 0; n < DB_PAGES; n++)
+		if (pwrite(db, page, PAGE, n * PAGE) != PAGE)
+			goto err;
+	if (fsync(db))
+		goto err;
+
+	for (n = 0; !stop; n++) {
+		if (pwrite(wal, page, PAGE, (n % WAL_PAGES) * PAGE) != PAGE)
+			goto err;
+		if (timed_sync(res, wal, 1))
+			goto err;
+		if (n % checkpoint_every != checkpoint_every - 1)
+			continue;
+		if (pwrite(db, page, PAGE, (n % DB_PAGES) * PAGE) != PAGE)
+			goto err;
+		if (timed_sync(res, db, 0))
+			goto err;
+	}
+	close(db);
+	close(wal);
+	return NULL;
+err:
+	perror("writer");
+	exit(1);
+}
+
+static long jbd2_commits(void)
+{
+	char name[256], line[256];
+	long commits = -1;
+	FILE *f;
+
+	if (!jbd2_dev)
+		return -1;
+	snprintf(name, sizeof(name), "/proc/fs/jbd2/%s/info", jbd2_dev);
+	f = fopen(name, "r");
+	if (!f)
+		return -1;
+	if (fgets(line, sizeof(line), f))
+		commits = strtol(line, NULL, 10);
+	fclose(f);
+	return commits;
+}
+
+static int cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a;
+	unsigned int y = *(const unsigned int *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t threads] [-s seconds] [-c checkpoint] [-j jbd2dev] [dir]\n"
+		"  -t  number of writer threads (default 8)\n"
+		"  -s  run time in seconds (default 10)\n"
+		"  -c  fsync the database every this many WAL fdatasyncs (default 16)\n"
+		"  -j  jbd2 journal to count commits of, e.g. sda1-8\n"
+		"The files are created in the current directory if none is given.\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct thread_result *res;
+	unsigned long total = 0, i;
+	unsigned int *lat;
+	long commits_before, commits_after;
+	int nthreads = 8;
+	int opt, t;
+	double start, secs;
+
+	while ((opt = getopt(argc, argv, "t:s:c:j:h")) != -1) {
+		switch (opt) {
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'c':
+			checkpoint_every = atoi(optarg);
+			break;
+		case 'j':
+			jbd2_dev = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nthreads <= 0 || seconds <= 0 || !checkpoint_every)
+		usage(argv[0]);
+	if (optind < argc)
+		dir = argv[optind];
+
+	res = calloc(nthreads, sizeof(*res));
+	if (!res)
+		return 1;
+
+	commits_before = jbd2_commits();
+	start = now();
+	for (t = 0; t < nthreads; t++) {
+		res[t].id = t;
+		if (pthread_create(&res[t].thread, NULL, writer, &res[t])) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	sleep(seconds);
+	stop = 1;
+	for (t = 0; t < nthreads; t++) {
+		pthread_join(res[t].thread, NULL);
+		total += res[t].nr;
+	}
+	secs = now() - start;
+	commits_after = jbd2_commits();
+
+	if (!total) {
+		fprintf(stderr, "no fsync completed\n");
+		return 1;
+	}
+	lat = malloc(total * sizeof(*lat));
+	if (!lat)
+		return 1;
+	for (i = 0, t = 0; t < nthreads; t++) {
+		memcpy(lat + i, res[t].lat_us, res[t].nr * sizeof(*lat));
+		i += res[t].nr;
+	}
+	qsort(lat, total, sizeof(*lat), cmp_uint);
+
+	printf("threads %d, %.3f s\n", nthreads, secs);
+	printf("fsyncs %lu: %.0f fsyncs/s, latency p50 %uus p99 %uus max %uus\n",
+	       total, total / secs, lat[total / 2], lat[total * 99 / 100],
+	       lat[total - 1]);
+	if (commits_before >= 0 && commits_after >= 0)
+		printf("jbd2 commits %ld: %.0f commits/s, %.1f fsyncs/commit\n",
+		       commits_after - commits_before,
+		       (commits_after - commits_before) / secs,
+		       commits_after > commits_before ?
+		       (double)total / (commits_after - commits_before) : 0.0);
+	else if (jbd2_dev)
+		printf("(/proc/fs/jbd2/%s/info not available)\n", jbd2_dev);
+
+	for (t = 0; t < nthreads; t++) {
+		char name[4096];
+
+		snprintf(name, sizeof(name), "%s/storm-%d.db", dir, t);
+		unlink(name);
+		snprintf(name, sizeof(name), "%s/storm-%d.db-wal", dir, t);
+		unlink(name);
+	}
+	return 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * lookup-bench.c -- replay a list of paths through stat(2)
+ *
+ * Captures of package manager or media scanner activity (e.g. from strace
+ * or an fs tracepoint) are turned into a list of paths, one per line, and
+ * replayed here from one or more threads. The tool reports lookups per
+ * second, how many of them missed (ENOENT and friends), and the change of
+ * the per superblock rcu-walk counters in /proc/fs/lookup_stats over the
+ * run, so dcache tunables can be compared on a lookup heavy workload.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -O2 -o lookup-bench lookup-bench.c -lpthread */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOOKUP_STATS	"/proc/fs/lookup_stats"
+#define MAX_SB		64
+#define MAX_COLS	16
+
+static char **paths;
+static size_t nr_paths;
+static int iterations = 10;
+static int use_lstat;
+
+struct thread_result {
+	pthread_t thread;
+	unsigned long hits;
+	unsigned long misses;
+};
+
+struct sb_stats {
+	char dev[64];
+	char type[32];
+	int ncols;
+	unsigned long col[MAX_COLS];
+};
+
+static char stat_header[512];
+
+static int read_lookup_stats(struct sb_stats *sbs)
+{
+	FILE *f = fopen(LOOKUP_STATS, "r");
+	char line[512];
+	int n = 0;
+
+	if (!f)
+		return -1;
+
+	if (fgets(stat_header, sizeof(stat_header), f) == NULL) {
+		fclose(f);
+		return -1;
+	}
+
+	while (n < MAX_SB && fgets(line, sizeof(line), f)) {
+		struct sb_stats *s = &sbs[n];
+		char *p, *tok;
+		int i = 0;
+
+		tok = strtok_r(line, " \n", &p);
+		if (!tok)
+			continue;
+		snprintf(s->dev, sizeof(s->dev), "%s", tok);
+		tok = strtok_r(NULL, " \n", &p);
+		snprintf(s->type, sizeof(s->type), "%s", tok ? tok : "?");
+		while (i < MAX_COLS && (tok = strtok_r(NULL, " \n", &p)))
+			s->col[i++] = strtoul(tok, NULL, 10);
+		s->ncols = i;
+		n++;
+	}
+	fclose(f);
+	return n;
+}
+
+static void print_lookup_stats_delta(struct sb_stats *before, int nb,
+				     struct sb_stats *after, int na)
+{
+	int i, j, k;
+
+	printf("\n%s", stat_header);
+	for (i = 0; i < na; i++) {
+		struct sb_stats *b = NULL;
+		int changed = 0;
+
+		for (j = 0; j < nb; j++)
+			if (!strcmp(before[j].dev, after[i].dev) &&
+			    !strcmp(before[j].type, after[i].type))
+				b = &before[j];
+		if (!b)
+			continue;
+		/* the first three columns are gauges, the rest counters */
+		for (k = 3; k < after[i].ncols; k++)
+			if (after[i].col[k] != b->col[k])
+				changed = 1;
+		if (!changed)
+			continue;
+
+		printf("%-16s %-10s", after[i].dev, after[i].type);
+		for (k = 0; k < after[i].ncols; k++)
+			printf(" %lu", k < 3 ? after[i].col[k] :
+			       after[i].col[k] - b->col[k]);
+		printf("\n");
+	}
+}
+
+static int load_paths(FILE *f)
+{
+	size_t alloc = 0;
+	char *line = NULL;
+	size_t len = 0;
+	ssize_t r;
+
+	while ((r = getline(&line, &len, f)) > 0) {
+		if (line[r - 1] == '\n')
+			line[--r] = '\0';
+		if (!r)
+			continue;
+		if (nr_paths == alloc) {
+			alloc = alloc ? alloc * 2 : 1024;
+			paths = realloc(paths, alloc * sizeof(*paths));
+			if (!paths)
+				return -1;
+		}
+		paths[nr_paths] = strdup(line);
+		if (!paths[nr_paths])
+			return -1;
+		nr_paths++;
+	}
+	free(line);
+	return 0;
+}
+
+static void *replay(void *arg)
+{
+	struct thread_result *res = arg;
+	struct stat st;
+	size_t i;
+	int it;
+
+	for (it = 0; it < iterations; it++) {
+		for (i = 0; i < nr_paths; i++) {
+			int ret = use_lstat ? lstat(paths[i], &st) :
+					      stat(paths[i], &st);
+			if (ret)
+				res->misses++;
+			else
+				res->hits++;
+		}
+	}
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-i iterations] [-t threads] [-l] [pathlist]\n"
+		"  -i  number of passes over the path list (default 10)\n"
+		"  -t  number of threads replaying the list (default 1)\n"
+		"  -l  use lstat() instead of stat()\n"
+		"The path list is read from stdin if no file is given.\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct sb_stats before[MAX_SB], after[MAX_SB];
+	struct thread_result *res;
+	unsigned long hits = 0, misses = 0;
+	struct timespec start, end;
+	int nthreads = 1;
+	int nb, na, opt, i, passes;
+	double secs;
+	FILE *f = stdin;
+
+	while ((opt = getopt(argc, argv, "i:t:lh")) != -1) {
+		switch (opt) {
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'l':
+			use_lstat = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (iterations <= 0 || nthreads <= 0)
+		usage(argv[0]);
+
+	if (optind < argc) {
+		f = fopen(argv[optind], "r");
+		if (!f) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+	if (load_paths(f)) {
+		perror("loading path list");
+		return 1;
+	}
+	if (!nr_paths) {
+		fprintf(stderr, "empty path list\n");
+		return 1;
+	}
+
+	res = calloc(nthreads, sizeof(*res));
+	if (!res)
+		return 1;
+
+	/* one untimed pass to populate the dcache */
+	passes = iterations;
+	iterations = 1;
+	replay(&res[0]);
+	memset(&res[0], 0, sizeof(res[0]));
+	iterations = passes;
+
+	nb = read_lookup_stats(before);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&res[i].thread, NULL, replay, &res[i])) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(res[i].thread, NULL);
+		hits += res[i].hits;
+		misses += res[i].misses;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	na = read_lookup_stats(after);
+
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("paths %zu, passes %d, threads %d\n",
+	       nr_paths, iterations, nthreads);
+	printf("lookups %lu (hit %lu, miss %lu) in %.3f s: %.0f lookups/s, "
+	       "%.1f ns/lookup\n", hits + misses, hits, misses, secs,
+	       (hits + misses) / secs, secs * 1e9 * nthreads / (hits + misses));
+
+	if (nb > 0 && na > 0)
+		print_lookup_stats_delta(before, nb, after, na);
+	else
+		printf("(%s not available)\n", LOOKUP_STATS);
+
+	return 0;
+}
@@ -3,6 +3,10 @@
 
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
+extern int bench_sched_cgroup(int argc, const char **argv, const char *prefix);
+extern int bench_sched_ui(int argc, const char **argv, const char *prefix);
+extern int bench_sched_capacity(int argc, const char **argv, const char *prefix);
+extern int bench_profile_stacks(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
@@ -0,0 +1,355 @@
+/*
+ *
+ * profile-stacks.c
+ *
+ * stacks: Benchmark for the overhead of always-on callchain sampling
+ *
+ * A cpu-bound child does a fixed unit of work in a loop of nested calls
+ * and counts the units it completes. It runs once unprofiled, then, at
+ * each sample frequency, profiled by a cpu-clock event sampling its
+ * callchains in two ways:
+ *
+ *  record:    every sample is written to the mmap ring buffer, which is
+ *             drained as perf record would, without writing a file
+ *  aggregate: attr.aggregate_stacks counts the callchains in the kernel,
+ *             the table is read with PERF_EVENT_IOC_READ_STACKS every
+ *             second
+ *
+ * Reported are the work rate of the child in each run and its slowdown
+ * against the unprofiled one.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define RING_PAGES	64
+
+enum mode {
+	MODE_NONE,
+	MODE_RECORD,
+	MODE_AGGREGATE,
+};
+
+static const char * const mode_names[] = {
+	"none", "record", "aggregate",
+};
+
+static int duration = 5;
+static int freq;
+
+static const struct option options[] = {
+	OPT_INTEGER('d', "duration", &duration,
+		    "Run time of each mode in seconds"),
+	OPT_INTEGER('F', "freq", &freq,
+		    "Sample frequency in Hz (default 100 and 1000)"),
+	OPT_END()
+};
+
+static const char * const bench_profile_stacks_usage[] = {
+	"perf bench profile stacks <options>",
+	NULL
+};
+
+struct result {
+	double		rate;		/* work units per second */
+	unsigned long	samples;
+	unsigned long	stacks;		/* aggregate: distinct callchains */
+	unsigned long	lost;		/* record: lost, aggregate: dropped */
+};
+
+/* a record of PERF_EVENT_IOC_READ_STACKS */
+struct stack_record {
+	u64	count;
+	u32	pid;
+	u32	nr;
+	u64	ip[0];
+};
+
+static volatile unsigned long *work;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* A few levels of calls, so that the samples have callchains to walk */
+static unsigned long __attribute__((noinline)) work_leaf(unsigned long x)
+{
+	int i;
+
+	for (i = 0; i < 1024; i++)
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+	return x;
+}
+
+static unsigned long __attribute__((noinline)) work_mid(unsigned long x)
+{
+	x = work_leaf(x);
+	if (x & 1)
+		x = work_leaf(x);
+	return x;
+}
+
+static unsigned long __attribute__((noinline)) work_top(unsigned long x)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+		x = work_mid(x);
+	return x;
+}
+
+static void __attribute__((noreturn)) worker(void)
+{
+	volatile unsigned long sink = 0;
+
+	for (;;) {
+		sink += work_top(sink);
+		__sync_fetch_and_add(work, 1);
+	}
+}
+
+static int open_event(pid_t pid, enum mode mode, int hz)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_SOFTWARE;
+	attr.config = PERF_COUNT_SW_CPU_CLOCK;
+	attr.freq = 1;
+	attr.sample_freq = hz;
+	attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID |
+			   PERF_SAMPLE_CALLCHAIN;
+	attr.exclude_hv = 1;
+	attr.aggregate_stacks = mode == MODE_AGGREGATE;
+
+	return sys_perf_event_open(&attr, pid, -1, -1, 0);
+}
+
+/* Consume the ring buffer, counting the samples and the lost ones */
+static void drain(struct perf_mmap *md, struct result *res)
+{
+	unsigned int head = perf_mmap__read_head(md);
+	unsigned char *data = md->base + sysconf(_SC_PAGESIZE);
+	struct perf_event_header *header;
+	unsigned int old = md->prev;
+
+	while (old != head) {
+		header = (void *)&data[old & md->mask];
+		/* the records are u64 aligned and do not wrap in the header */
+		if (header->type == PERF_RECORD_SAMPLE)
+			res->samples++;
+		else if (header->type == PERF_RECORD_LOST)
+			res->lost += ((u64 *)(header + 1))[1];
+		if (!header->size)
+			break;
+		old += header->size;
+	}
+	md->prev = head;
+	perf_mmap__write_tail(md, head);
+}
+
+/* Read and reset the aggregated stacks */
+static int read_stacks(int fd, struct perf_stack_read *rd, void **buf,
+		       struct result *res)
+{
+	struct stack_record *rec;
+	unsigned char *p, *end;
+
+	rd->buf = (unsigned long)*buf;
+	while (ioctl(fd, PERF_EVENT_IOC_READ_STACKS, rd)) {
+		if (errno != ENOSPC)
+			return -1;
+		free(*buf);
+		*buf = malloc(rd->size);
+		if (!*buf)
+			return -1;
+		rd->buf = (unsigned long)*buf;
+	}
+
+	/* walk the records like a profiler folding them would */
+	p = *buf;
+	end = p + rd->size;
+	while (p < end) {
+		rec = (struct stack_record *)p;
+		if (rec->count)
+			res->stacks++;
+		p += sizeof(*rec) + rec->nr * sizeof(u64);
+	}
+	res->samples += rd->samples;
+	res->lost += rd->dropped;
+	return 0;
+}
+
+static int run(enum mode mode, int hz, struct result *res)
+{
+	struct perf_stack_read rd;
+	struct perf_mmap md;
+	unsigned long long start, end, next, t;
+	unsigned long w0, w1;
+	size_t ring_size = (RING_PAGES + 1) * sysconf(_SC_PAGESIZE);
+	void *buf = NULL;
+	int fd = -1, ret = -1;
+	pid_t pid;
+
+	memset(res, 0, sizeof(*res));
+	memset(&md, 0, sizeof(md));
+	memset(&rd, 0, sizeof(rd));
+
+	pid = fork();
+	if (pid < 0)
+		return -1;
+	if (!pid)
+		worker();
+
+	if (mode != MODE_NONE) {
+		fd = open_event(pid, mode, hz);
+		if (fd < 0) {
+			fprintf(stderr, "cannot open %s event: %s\n",
+				mode_names[mode], strerror(errno));
+			goto out;
+		}
+	}
+	if (mode == MODE_RECORD) {
+		md.base = mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+			       MAP_SHARED, fd, 0);
+		if (md.base == MAP_FAILED) {
+			perror("mmap");
+			goto out;
+		}
+		md.mask = RING_PAGES * sysconf(_SC_PAGESIZE) - 1;
+	}
+
+	start = now_ns();
+	w0 = *work;
+	end = start + duration * 1000000000ULL;
+	next = start + 1000000000ULL;
+	while ((t = now_ns()) < end) {
+		if (mode == MODE_RECORD) {
+			drain(&md, res);
+			usleep(10000);
+		} else if (mode == MODE_AGGREGATE && t >= next) {
+			if (read_stacks(fd, &rd, &buf, res)) {
+				perror("PERF_EVENT_IOC_READ_STACKS");
+				goto out;
+			}
+			next += 1000000000ULL;
+		} else {
+			usleep(10000);
+		}
+	}
+	w1 = *work;
+	t = now_ns();
+
+	if (mode == MODE_RECORD)
+		drain(&md, res);
+	else if (mode == MODE_AGGREGATE && read_stacks(fd, &rd, &buf, res))
+		goto out;
+
+	res->rate = (w1 - w0) * 1e9 / (t - start);
+	ret = 0;
+out:
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	if (md.base && md.base != MAP_FAILED)
+		munmap(md.base, ring_size);
+	if (fd >= 0)
+		close(fd);
+	free(buf);
+	return ret;
+}
+
+static void print_result(enum mode mode, int hz, struct result *res,
+			 double base)
+{
+	double overhead = base ? 100.0 * (base - res->rate) / base : 0.0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		if (mode == MODE_NONE) {
+			printf(" %9s        : %.1f units/s\n",
+			       mode_names[mode], res->rate);
+			break;
+		}
+		printf(" %9s %5d Hz: %.1f units/s, overhead %.2f%%, %lu samples",
+		       mode_names[mode], hz, res->rate, overhead, res->samples);
+		if (mode == MODE_AGGREGATE)
+			printf(", %lu stacks, %lu dropped\n", res->stacks,
+			       res->lost);
+		else
+			printf(", %lu lost\n", res->lost);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %d %.1f %.2f %lu %lu\n", mode_names[mode], hz,
+		       res->rate, overhead, res->samples, res->lost);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_profile_stacks(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	static const int default_freqs[] = { 100, 1000 };
+	struct result res;
+	const int *freqs = default_freqs;
+	int nr_freqs = ARRAY_SIZE(default_freqs);
+	enum mode mode;
+	double base;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_profile_stacks_usage, 0);
+	if (duration <= 0 || freq < 0)
+		usage_with_options(bench_profile_stacks_usage, options);
+	if (freq) {
+		freqs = &freq;
+		nr_freqs = 1;
+	}
+
+	work = mmap(NULL, sizeof(*work), PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (work == MAP_FAILED)
+		return -1;
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# cpu-clock callchain sampling, %d s per run\n\n",
+		       duration);
+
+	if (run(MODE_NONE, 0, &res))
+		return -1;
+	base = res.rate;
+	print_result(MODE_NONE, 0, &res, base);
+
+	for (i = 0; i < nr_freqs; i++) {
+		for (mode = MODE_RECORD; mode <= MODE_AGGREGATE; mode++) {
+			if (run(mode, freqs[i], &res))
+				return -1;
+			print_result(mode, freqs[i], &res, base);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ *
+ * sched-capacity.c
+ *
+ * capacity: Benchmark for the throughput and idle residency of a mix of
+ *           light and heavy tasks
+ *
+ * Light tasks run a short burst every period and sleep for the rest of
+ * it, heavy tasks spin. Reported are the work done by the heavy tasks,
+ * the share of their bursts the light tasks completed in time, and the
+ * residency of the cpus in their idle states, in total and in the
+ * deepest one, from /sys/devices/system/cpu/cpuN/cpuidle.
+ *
+ * With --compare the run is repeated with the CAPACITY_MODEL sched
+ * feature on and off, which needs debugfs and CONFIG_SCHED_DEBUG.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define SCHED_FEATURES	"/sys/kernel/debug/sched_features"
+#define MAX_STATES	16
+
+static int duration = 10;
+static int nr_light = -1;
+static int nr_heavy = -1;
+static int period_ms = 10;
+static int duty = 10;
+static bool compare;
+
+static const struct option options[] = {
+	OPT_INTEGER('d', "duration", &duration,
+		    "Run time in seconds"),
+	OPT_INTEGER('l', "light", &nr_light,
+		    "Number of light tasks (default the number of cpus)"),
+	OPT_INTEGER('H', "heavy", &nr_heavy,
+		    "Number of heavy tasks (default half the cpus)"),
+	OPT_INTEGER('p', "period", &period_ms,
+		    "Period of the light tasks in ms"),
+	OPT_INTEGER('u', "duty", &duty,
+		    "Busy percentage of the light tasks"),
+	OPT_BOOLEAN('C', "compare", &compare,
+		    "Run with and without CAPACITY_MODEL"),
+	OPT_END()
+};
+
+static const char * const bench_sched_capacity_usage[] = {
+	"perf bench sched capacity <options>",
+	NULL
+};
+
+struct counters {
+	unsigned long	work;		/* spin loops of the heavy tasks */
+	unsigned long	bursts;		/* bursts of the light tasks */
+	unsigned long	late;		/* ... which ended after the period */
+};
+
+static volatile struct counters *counters;
+static int nr_cpus;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int write_file(const char *path, const char *buf)
+{
+	FILE *f = fopen(path, "w");
+	int ret = 0;
+
+	if (!f)
+		return -1;
+	if (fputs(buf, f) < 0)
+		ret = -1;
+	if (fclose(f))
+		ret = -1;
+	return ret;
+}
+
+/* Sum of the residency in us of @cpu in all idle states, and in the deepest */
+static int read_idle(int cpu, unsigned long long *total,
+		     unsigned long long *deepest)
+{
+	char path[PATH_MAX];
+	unsigned long long t;
+	int state, found = 0;
+	FILE *f;
+
+	*total = *deepest = 0;
+	for (state = 0; state < MAX_STATES; state++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cpuidle/state%d/time",
+			 cpu, state);
+		f = fopen(path, "r");
+		if (!f)
+			break;
+		if (fscanf(f, "%llu", &t) == 1) {
+			*total += t;
+			*deepest = t;
+			found = 1;
+		}
+		fclose(f);
+	}
+	return found ? 0 : -1;
+}
+
+static void light_task(void)
+{
+	unsigned long long period = period_ms * 1000000ULL;
+	unsigned long long busy = period * duty / 100;
+	unsigned long long start;
+	struct timespec next;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (;;) {
+		start = now_ns();
+		while (now_ns() - start < busy)
+			;
+		__sync_fetch_and_add(&counters->bursts, 1);
+
+		next.tv_nsec += period;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		if (now_ns() > next.tv_sec * 1000000000ULL + next.tv_nsec) {
+			__sync_fetch_and_add(&counters->late, 1);
+			clock_gettime(CLOCK_MONOTONIC, &next);
+			continue;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &next, NULL) == EINTR)
+			;
+	}
+}
+
+static void heavy_task(void)
+{
+	unsigned long n = 0;
+
+	for (;;) {
+		if (!(++n & 0xffff))
+			__sync_fetch_and_add(&counters->work, 1);
+	}
+}
+
+static int run(void)
+{
+	unsigned long long *idle0, *deep0;
+	unsigned long long idle1, deep1, idle = 0, deep = 0, start, elapsed;
+	int nr_tasks = nr_light + nr_heavy, i, have_idle = 1;
+	unsigned long expected;
+	pid_t *pids;
+
+	pids = calloc(nr_tasks, sizeof(pid_t));
+	idle0 = calloc(nr_cpus, sizeof(*idle0));
+	deep0 = calloc(nr_cpus, sizeof(*deep0));
+	if (!pids || !idle0 || !deep0)
+		return -1;
+	memset((void *)counters, 0, sizeof(*counters));
+
+	for (i = 0; i < nr_cpus; i++)
+		if (read_idle(i, &idle0[i], &deep0[i]))
+			have_idle = 0;
+
+	start = now_ns();
+	for (i = 0; i < nr_tasks; i++) {
+		pids[i] = fork();
+		if (!pids[i]) {
+			if (i < nr_light)
+				light_task();
+			heavy_task();
+		}
+	}
+
+	sleep(duration);
+
+	for (i = 0; i < nr_tasks; i++) {
+		if (pids[i] > 0)
+			kill(pids[i], SIGKILL);
+	}
+	elapsed = now_ns() - start;
+	for (i = 0; i < nr_cpus; i++) {
+		if (have_idle && !read_idle(i, &idle1, &deep1)) {
+			idle += idle1 - idle0[i];
+			deep += deep1 - deep0[i];
+		}
+	}
+	for (i = 0; i < nr_tasks; i++) {
+		if (pids[i] > 0)
+			waitpid(pids[i], NULL, 0);
+	}
+	free(pids);
+	free(idle0);
+	free(deep0);
+
+	expected = nr_light * (elapsed / (period_ms * 1000000ULL));
+	elapsed /= 1000;	/* us, like the idle residency */
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: %.1f Munits/s\n", "heavy work",
+		       counters->work * 65536.0 / elapsed);
+		printf(" %14s: %lu of %lu (%.1f%%), %lu late\n", "light bursts",
+		       counters->bursts, expected,
+		       expected ? 100.0 * counters->bursts / expected : 0.0,
+		       counters->late);
+		if (have_idle)
+			printf(" %14s: %.1f%%, deepest state %.1f%%\n",
+			       "idle residency",
+			       100.0 * idle / (elapsed * nr_cpus),
+			       100.0 * deep / (elapsed * nr_cpus));
+		else
+			printf(" %14s: not available\n", "idle residency");
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.1f %lu %lu %.1f %.1f\n",
+		       counters->work * 65536.0 / elapsed,
+		       counters->bursts, counters->late,
+		       have_idle ? 100.0 * idle / (elapsed * nr_cpus) : 0.0,
+		       have_idle ? 100.0 * deep / (elapsed * nr_cpus) : 0.0);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+	return 0;
+}
+
+int bench_sched_capacity(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	int i, ret = 0;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_capacity_usage, 0);
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_light < 0)
+		nr_light = nr_cpus;
+	if (nr_heavy < 0)
+		nr_heavy = nr_cpus / 2;
+	if (duration <= 0 || period_ms <= 0 || duty <= 0 || duty >= 100 ||
+	    !(nr_light + nr_heavy))
+		usage_with_options(bench_sched_capacity_usage, options);
+
+	counters = mmap(NULL, sizeof(*counters), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (counters == MAP_FAILED)
+		return -1;
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d light tasks (%d%% of %d ms), %d heavy tasks, %d cpus, %d s\n\n",
+		       nr_light, duty, period_ms, nr_heavy, nr_cpus, duration);
+
+	if (!compare) {
+		ret = run();
+	} else {
+		static const char * const feats[] = {
+			"CAPACITY_MODEL", "NO_CAPACITY_MODEL",
+		};
+
+		for (i = 0; i < 2 && !ret; i++) {
+			if (write_file(SCHED_FEATURES, feats[i])) {
+				fprintf(stderr, "cannot set %s in %s\n",
+					feats[i], SCHED_FEATURES);
+				ret = -1;
+				break;
+			}
+			if (bench_format == BENCH_FORMAT_DEFAULT)
+				printf("%s:\n", feats[i]);
+			ret = run();
+		}
+		/* leave the default, off, behind */
+		write_file(SCHED_FEATURES, feats[1]);
+	}
+	return ret;
+}
@@ -0,0 +1,324 @@
+/*
+ *
+ * sched-cgroup.c
+ *
+ * cgroup: Benchmark for how fast group shares follow a task that
+ *         switches cpu cgroups
+ *
+ * Two cpu cgroups, "fg" and "bg", are created below the cpu controller
+ * mount. fg runs a cpu hog on every cpu, bg one hog on the probe's cpu.
+ * A probe task, pinned next to the hogs, counts its progress in shared
+ * memory. Its steady state rate in either group is measured first, then
+ * it is moved back and forth between the groups, and the time until its
+ * rate settles within a tolerance of the steady state of the new group
+ * is recorded. This is how long the group shares lag behind the real
+ * load, i.e. what a foreground switch costs.
+ *
+ * With --compare the run is repeated with the ENTITY_LOAD_AVG sched
+ * feature on and off, which needs debugfs and CONFIG_SCHED_DEBUG.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sched.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define SCHED_FEATURES	"/sys/kernel/debug/sched_features"
+#define SAMPLE_US	2000
+#define WINDOW		5		/* samples per rate window */
+#define MAX_WAIT_MS	5000
+
+static const char *mnt = "/dev/cpuctl";
+static int rounds = 20;
+static int settle_ms = 1000;
+static int tolerance = 10;
+static int nr_hogs;
+static bool compare;
+
+static const struct option options[] = {
+	OPT_STRING('m', "mount", &mnt, "dir",
+		   "cpu cgroup mount point (default /dev/cpuctl)"),
+	OPT_INTEGER('r', "rounds", &rounds,
+		    "Number of switches in each direction"),
+	OPT_INTEGER('s', "settle", &settle_ms,
+		    "Time given to reach steady state, in ms"),
+	OPT_INTEGER('t', "tolerance", &tolerance,
+		    "Settled when within this percentage of steady state"),
+	OPT_INTEGER('c', "cpus", &nr_hogs,
+		    "Number of cpus with a foreground hog (default all)"),
+	OPT_BOOLEAN('C', "compare", &compare,
+		    "Run with and without ENTITY_LOAD_AVG"),
+	OPT_END()
+};
+
+static const char * const bench_sched_cgroup_usage[] = {
+	"perf bench sched cgroup <options>",
+	NULL
+};
+
+static volatile unsigned long *progress;
+static pid_t *hogs;
+static pid_t probe;
+static char fg_path[PATH_MAX], bg_path[PATH_MAX];
+
+static unsigned long long now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static int write_file(const char *path, const char *buf)
+{
+	FILE *f = fopen(path, "w");
+	int ret = 0;
+
+	if (!f)
+		return -1;
+	if (fputs(buf, f) < 0)
+		ret = -1;
+	if (fclose(f))
+		ret = -1;
+	return ret;
+}
+
+static int attach(const char *group, pid_t pid)
+{
+	char path[PATH_MAX], buf[32];
+
+	snprintf(path, sizeof(path), "%s/tasks", group);
+	snprintf(buf, sizeof(buf), "%d", pid);
+	return write_file(path, buf);
+}
+
+static pid_t spawn(int cpu, const char *group, bool count)
+{
+	cpu_set_t set;
+	pid_t pid = fork();
+
+	if (pid)
+		return pid;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+	if (group && attach(group, getpid()))
+		exit(1);
+	if (count)
+		for (;;)
+			(*progress)++;
+	for (;;)
+		;
+}
+
+static void stop_tasks(void)
+{
+	int i;
+
+	for (i = 0; i <= nr_hogs; i++) {
+		if (hogs[i] > 0) {
+			kill(hogs[i], SIGKILL);
+			waitpid(hogs[i], NULL, 0);
+		}
+	}
+	if (probe > 0) {
+		kill(probe, SIGKILL);
+		waitpid(probe, NULL, 0);
+	}
+	rmdir(fg_path);
+	rmdir(bg_path);
+}
+
+/* progress per ms over @ms */
+static double measure_rate(int ms)
+{
+	unsigned long start = *progress;
+	unsigned long long t = now_us();
+
+	usleep(ms * 1000);
+	return (*progress - start) * 1000.0 / (now_us() - t);
+}
+
+/* Move the probe into @group, return the us until its rate settles. */
+static long switch_latency(const char *group, double steady)
+{
+	unsigned long samples[WINDOW + 1];
+	unsigned long long stamps[WINDOW + 1], start;
+	double rate, slack = steady * tolerance / 100;
+	int n;
+
+	start = now_us();
+	if (attach(group, probe))
+		return -1;
+
+	for (n = 0; ; n++) {
+		int i = n % (WINDOW + 1);
+
+		samples[i] = *progress;
+		stamps[i] = now_us();
+		if (n >= WINDOW) {
+			int old = (n - WINDOW) % (WINDOW + 1);
+
+			rate = (samples[i] - samples[old]) * 1000.0 /
+				(stamps[i] - stamps[old]);
+			if (rate >= steady - slack && rate <= steady + slack)
+				return stamps[old] - start;
+		}
+		if (stamps[i] - start > MAX_WAIT_MS * 1000ULL)
+			return MAX_WAIT_MS * 1000L;
+		usleep(SAMPLE_US);
+	}
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+	long x = *(const long *)a, y = *(const long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *what, long *lat, int nr)
+{
+	qsort(lat, nr, sizeof(*lat), cmp_long);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %-14s: p50 %8.2f ms   p99 %8.2f ms   max %8.2f ms\n",
+		       what, lat[nr / 2] / 1000.0, lat[nr * 99 / 100] / 1000.0,
+		       lat[nr - 1] / 1000.0);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%ld %ld\n", lat[nr / 2], lat[nr * 99 / 100]);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+static int run(void)
+{
+	double fg_rate, bg_rate;
+	long *to_fg, *to_bg;
+	int i;
+
+	to_fg = calloc(rounds, sizeof(long));
+	to_bg = calloc(rounds, sizeof(long));
+	if (!to_fg || !to_bg)
+		return -1;
+
+	if (attach(bg_path, probe))
+		goto fail;
+	usleep(settle_ms * 1000);
+	bg_rate = measure_rate(200);
+	if (attach(fg_path, probe))
+		goto fail;
+	usleep(settle_ms * 1000);
+	fg_rate = measure_rate(200);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf(" %-14s: fg %.0f/ms, bg %.0f/ms\n", "probe rate",
+		       fg_rate, bg_rate);
+
+	for (i = 0; i < rounds; i++) {
+		to_bg[i] = switch_latency(bg_path, bg_rate);
+		usleep(settle_ms * 1000);
+		to_fg[i] = switch_latency(fg_path, fg_rate);
+		usleep(settle_ms * 1000);
+		if (to_bg[i] < 0 || to_fg[i] < 0)
+			goto fail;
+	}
+
+	report("bg -> fg", to_fg, rounds);
+	report("fg -> bg", to_bg, rounds);
+	free(to_fg);
+	free(to_bg);
+	return 0;
+
+fail:
+	fprintf(stderr, "moving the probe failed: %s\n", strerror(errno));
+	free(to_fg);
+	free(to_bg);
+	return -1;
+}
+
+int bench_sched_cgroup(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	int nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, ret = 0;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_cgroup_usage, 0);
+	if (nr_hogs <= 0 || nr_hogs > nr_cpus)
+		nr_hogs = nr_cpus;
+	if (rounds <= 0 || settle_ms <= 0 || tolerance <= 0)
+		usage_with_options(bench_sched_cgroup_usage, options);
+
+	progress = mmap(NULL, sizeof(*progress), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	hogs = calloc(nr_hogs + 1, sizeof(pid_t));
+	if (progress == MAP_FAILED || !hogs)
+		return -1;
+
+	snprintf(fg_path, sizeof(fg_path), "%s/perf-bench-fg", mnt);
+	snprintf(bg_path, sizeof(bg_path), "%s/perf-bench-bg", mnt);
+	if ((mkdir(fg_path, 0755) && errno != EEXIST) ||
+	    (mkdir(bg_path, 0755) && errno != EEXIST)) {
+		fprintf(stderr, "cannot create groups in %s: %s\n",
+			mnt, strerror(errno));
+		return -1;
+	}
+
+	for (i = 0; i < nr_hogs; i++)
+		hogs[i] = spawn(i, fg_path, false);
+	hogs[nr_hogs] = spawn(0, bg_path, false);
+	probe = spawn(0, NULL, true);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d foreground hogs, %d rounds, settled within %d%%\n\n",
+		       nr_hogs, rounds, tolerance);
+
+	if (!compare) {
+		ret = run();
+	} else {
+		static const char * const feats[] = {
+			"ENTITY_LOAD_AVG", "NO_ENTITY_LOAD_AVG",
+		};
+
+		for (i = 0; i < 2 && !ret; i++) {
+			if (write_file(SCHED_FEATURES, feats[i])) {
+				fprintf(stderr, "cannot set %s in %s\n",
+					feats[i], SCHED_FEATURES);
+				ret = -1;
+				break;
+			}
+			if (bench_format == BENCH_FORMAT_DEFAULT)
+				printf("%s:\n", feats[i]);
+			ret = run();
+		}
+		/* leave the default behind */
+		write_file(SCHED_FEATURES, feats[0]);
+	}
+
+	stop_tasks();
+	return ret;
+}
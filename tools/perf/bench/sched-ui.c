@@ -0,0 +1,241 @@
+/*
+ *
+ * sched-ui.c
+ *
+ * ui: Benchmark for the wakeup latency of a UI-like thread against a
+ *     batch load, with the two in separate cpu cgroups
+ *
+ * The UI thread sleeps until the start of every frame, then does a fixed
+ * amount of work. The time between the frame start and the thread running
+ * is its wakeup latency, a frame whose work ends after the next frame
+ * start is missed. Batch tasks spin in the background group meanwhile.
+ * The foreground group's cpu.latency_class, cpu.min_freq and
+ * cpu.prefer_idle can be set from the command line, to compare runs with
+ * and without a foreground boost.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static const char *mnt = "/dev/cpuctl";
+static int duration = 10;
+static int nr_batch;
+static int frame_ms = 16;
+static int work_ms = 4;
+static int latency_class = -1;
+static int min_freq = -1;
+static int prefer_idle = -1;
+
+static const struct option options[] = {
+	OPT_STRING('m', "mount", &mnt, "dir",
+		   "cpu cgroup mount point (default /dev/cpuctl)"),
+	OPT_INTEGER('d', "duration", &duration,
+		    "Run time in seconds"),
+	OPT_INTEGER('b', "batch", &nr_batch,
+		    "Number of batch tasks (default twice the cpus)"),
+	OPT_INTEGER('f', "frame", &frame_ms,
+		    "Frame period in ms"),
+	OPT_INTEGER('w', "work", &work_ms,
+		    "Work per frame in ms"),
+	OPT_INTEGER('l', "latency-class", &latency_class,
+		    "cpu.latency_class of the UI group"),
+	OPT_INTEGER('F', "min-freq", &min_freq,
+		    "cpu.min_freq of the UI group, in kHz"),
+	OPT_INTEGER('i', "prefer-idle", &prefer_idle,
+		    "cpu.prefer_idle of the UI group"),
+	OPT_END()
+};
+
+static const char * const bench_sched_ui_usage[] = {
+	"perf bench sched ui <options>",
+	NULL
+};
+
+static char ui_path[PATH_MAX], batch_path[PATH_MAX];
+
+static unsigned long long ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts_ns(&ts);
+}
+
+static int write_file(const char *dir, const char *name, long val)
+{
+	char path[PATH_MAX];
+	FILE *f;
+	int ret = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	if (fprintf(f, "%ld", val) < 0)
+		ret = -1;
+	if (fclose(f))
+		ret = -1;
+	return ret;
+}
+
+static int set_attr(const char *name, int val)
+{
+	if (val < 0)
+		return 0;
+	if (write_file(ui_path, name, val)) {
+		fprintf(stderr, "cannot set %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static void spin_ns(unsigned long long ns)
+{
+	unsigned long long end = now_ns() + ns;
+
+	while (now_ns() < end)
+		;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int bench_sched_ui(int argc, const char **argv,
+		   const char *prefix __used)
+{
+	unsigned long long frame_ns, *lat, start, late;
+	struct timespec next;
+	int nr_frames, missed = 0, i, ret = -1;
+	pid_t *batch;
+
+	argc = parse_options(argc, argv, options, bench_sched_ui_usage, 0);
+	if (nr_batch <= 0)
+		nr_batch = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	if (duration <= 0 || frame_ms <= 0 || work_ms < 0 ||
+	    work_ms >= frame_ms)
+		usage_with_options(bench_sched_ui_usage, options);
+
+	frame_ns = frame_ms * 1000000ULL;
+	nr_frames = duration * 1000 / frame_ms;
+	if (!nr_frames)
+		usage_with_options(bench_sched_ui_usage, options);
+	lat = calloc(nr_frames, sizeof(*lat));
+	batch = calloc(nr_batch, sizeof(*batch));
+	if (!lat || !batch)
+		return -1;
+
+	snprintf(ui_path, sizeof(ui_path), "%s/perf-bench-ui", mnt);
+	snprintf(batch_path, sizeof(batch_path), "%s/perf-bench-batch", mnt);
+	if ((mkdir(ui_path, 0755) && errno != EEXIST) ||
+	    (mkdir(batch_path, 0755) && errno != EEXIST)) {
+		fprintf(stderr, "cannot create groups in %s: %s\n",
+			mnt, strerror(errno));
+		return -1;
+	}
+	if (set_attr("cpu.latency_class", latency_class) ||
+	    set_attr("cpu.min_freq", min_freq) ||
+	    set_attr("cpu.prefer_idle", prefer_idle))
+		goto out_rmdir;
+
+	for (i = 0; i < nr_batch; i++) {
+		batch[i] = fork();
+		if (!batch[i]) {
+			if (write_file(batch_path, "tasks", getpid()))
+				exit(1);
+			for (;;)
+				;
+		}
+	}
+
+	/* the UI thread is this task, with as little timer slack as we can */
+	prctl(PR_SET_TIMERSLACK, 1);
+	if (write_file(ui_path, "tasks", getpid())) {
+		fprintf(stderr, "cannot join %s: %s\n", ui_path,
+			strerror(errno));
+		goto out_kill;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (i = 0; i < nr_frames; i++) {
+		next.tv_nsec += frame_ns;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &next, NULL) == EINTR)
+			;
+		start = now_ns();
+		late = start - ts_ns(&next);
+		lat[i] = late;
+		spin_ns(work_ms * 1000000ULL);
+		if (now_ns() - ts_ns(&next) > frame_ns)
+			missed++;
+	}
+
+	write_file(mnt, "tasks", getpid());
+	ret = 0;
+
+	qsort(lat, nr_frames, sizeof(*lat), cmp_ull);
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d frames of %d ms with %d ms of work, %d batch tasks\n\n",
+		       nr_frames, frame_ms, work_ms, nr_batch);
+		printf(" %14s: p50 %llu us, p99 %llu us, max %llu us\n",
+		       "wakeup latency", lat[nr_frames / 2] / 1000,
+		       lat[nr_frames * 99 / 100] / 1000,
+		       lat[nr_frames - 1] / 1000);
+		printf(" %14s: %d (%.2f%%)\n", "missed frames", missed,
+		       100.0 * missed / nr_frames);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu %llu %d\n", lat[nr_frames / 2] / 1000,
+		       lat[nr_frames * 99 / 100] / 1000, missed);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+out_kill:
+	for (i = 0; i < nr_batch; i++) {
+		if (batch[i] > 0) {
+			kill(batch[i], SIGKILL);
+			waitpid(batch[i], NULL, 0);
+		}
+	}
+out_rmdir:
+	rmdir(ui_path);
+	rmdir(batch_path);
+	free(lat);
+	free(batch);
+	return ret;
+}
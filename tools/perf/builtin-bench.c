@@ -13,6 +13,7 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  profile ... overhead of sampling profilers
  *
  */
 
@@ -42,6 +43,15 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "cgroup",
+	  "Latency of group shares following a task between cgroups",
+	  bench_sched_cgroup    },
+	{ "ui",
+	  "Wakeup latency of a UI-like thread against a batch load",
+	  bench_sched_ui        },
+	{ "capacity",
+	  "Throughput and idle residency of light and heavy tasks",
+	  bench_sched_capacity  },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -58,6 +68,16 @@ static struct bench_suite mem_suites[] = {
 	  NULL             }
 };
 
+static struct bench_suite profile_suites[] = {
+	{ "stacks",
+	  "Overhead of callchain sampling, recorded and aggregated",
+	  bench_profile_stacks },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL                 }
+};
+
 struct bench_subsys {
 	const char *name;
 	const char *summary;
@@ -71,6 +91,9 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "profile",
+	  "overhead of sampling profilers",
+	  profile_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },
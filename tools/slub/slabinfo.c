@@ -39,6 +39,8 @@ struct slabinfo {
 	unsigned long cpuslab_flush, deactivate_full, deactivate_empty;
 	unsigned long deactivate_to_head, deactivate_to_tail;
 	unsigned long deactivate_remote_frees, order_fallback;
+	unsigned long cpu_partial_alloc, cpu_partial_free;
+	unsigned long cpu_partial_node, cpu_partial_drain;
 	int numa[MAX_NODES];
 	int numa_partial[MAX_NODES];
 } slabinfo[MAX_SLABS];
@@ -475,6 +477,19 @@ static void slab_stats(struct slabinfo *s)
 			s->deactivate_empty, (s->deactivate_empty * 100) / total,
 			s->deactivate_to_head, (s->deactivate_to_head * 100) / total,
 			s->deactivate_to_tail, (s->deactivate_to_tail * 100) / total);
+
+	/* How many slow path allocs and frees the cpu partial lists took */
+	if (s->cpu_partial_alloc || s->cpu_partial_free)
+		printf("CPU partial Alloc=%lu(%lu%% of slowpath) "
+			"Free=%lu(%lu%% of slowpath) Node=%lu Drain=%lu\n",
+			s->cpu_partial_alloc,
+			total_alloc - s->alloc_fastpath ?
+			s->cpu_partial_alloc * 100 /
+				(total_alloc - s->alloc_fastpath) : 0,
+			s->cpu_partial_free,
+			s->free_slowpath ?
+			s->cpu_partial_free * 100 / s->free_slowpath : 0,
+			s->cpu_partial_node, s->cpu_partial_drain);
 }
 
 static void report(struct slabinfo *s)
@@ -1190,6 +1205,10 @@ static void read_slab_dir(void)
 			slab->deactivate_to_tail = get_obj("deactivate_to_tail");
 			slab->deactivate_remote_frees = get_obj("deactivate_remote_frees");
 			slab->order_fallback = get_obj("order_fallback");
+			slab->cpu_partial_alloc = get_obj("cpu_partial_alloc");
+			slab->cpu_partial_free = get_obj("cpu_partial_free");
+			slab->cpu_partial_node = get_obj("cpu_partial_node");
+			slab->cpu_partial_drain = get_obj("cpu_partial_drain");
 			chdir("..");
 			if (slab->name[0] == ':')
 				alias_targets++;